@@ -0,0 +1,27 @@
+/*
+ * CRC32 using the ARMv8 CRC32 instructions
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <u-boot/crc.h>
+
+/*
+ * The CRC32B/CRC32X instructions use the same bit-reflected polynomial as
+ * crc32() and, like crc32_no_comp(), do not complement the CRC.
+ */
+uint32_t arch_crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len)
+{
+	for (; len && ((ulong)buf & 7); len--)
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" ((u32)*buf++));
+
+	for (; len >= 8; len -= 8, buf += 8)
+		asm("crc32x %w0, %w0, %x1" : "+r" (crc)
+		    : "r" (*(const u64 *)buf));
+
+	for (; len; len--)
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" ((u32)*buf++));
+
+	return crc;
+}
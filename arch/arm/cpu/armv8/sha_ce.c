@@ -0,0 +1,140 @@
+/*
+ * SHA-1 and SHA-256 using the ARMv8 crypto extensions
+ *
+ * This uses the compiler's <arm_neon.h>, which brings its own <stdint.h>,
+ * so avoid U-Boot's headers, which define the same types.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <errno.h>
+#include <arm_neon.h>
+
+/* Check ID_AA64ISAR0_EL1 for the SHA1 (bits 11:8) or SHA2 (15:12) fields */
+static int sha_ce_present(int shift)
+{
+	uint64_t isar0;
+
+	asm("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return (isar0 >> shift) & 0xf;
+}
+
+/* Replace msg0 with the next four words of the message schedule */
+#define SHA1_SCHEDULE(msg0, msg1, msg2, msg3)				\
+	msg0 = vsha1su1q_u32(vsha1su0q_u32(msg0, msg1, msg2), msg3)
+
+int arch_sha1_blocks(uint32_t state[5], const uint8_t *data,
+		     unsigned int blocks)
+{
+	static const uint32_t k[] = {
+		0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6
+	};
+	uint32x4_t abcd, abcd_save, msg[4], tmp;
+	uint32_t e, e_next, e_save;
+	int i;
+
+	if (!sha_ce_present(8))
+		return -ENOSYS;
+
+	abcd = vld1q_u32(state);
+	e = state[4];
+
+	for (; blocks; blocks--, data += 64) {
+		abcd_save = abcd;
+		e_save = e;
+
+		for (i = 0; i < 4; i++)
+			msg[i] = vreinterpretq_u32_u8(
+				vrev32q_u8(vld1q_u8(data + i * 16)));
+
+		/* Twenty groups of four rounds */
+		for (i = 0; i < 20; i++) {
+			tmp = vaddq_u32(msg[i % 4], vdupq_n_u32(k[i / 5]));
+			e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+			if (i < 5)
+				abcd = vsha1cq_u32(abcd, e, tmp);
+			else if (i >= 10 && i < 15)
+				abcd = vsha1mq_u32(abcd, e, tmp);
+			else
+				abcd = vsha1pq_u32(abcd, e, tmp);
+			e = e_next;
+			if (i < 16)
+				SHA1_SCHEDULE(msg[i % 4], msg[(i + 1) % 4],
+					      msg[(i + 2) % 4], msg[(i + 3) % 4]);
+		}
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		e += e_save;
+	}
+
+	vst1q_u32(state, abcd);
+	state[4] = e;
+
+	return 0;
+}
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* Replace msg0 with the next four words of the message schedule */
+#define SHA256_SCHEDULE(msg0, msg1, msg2, msg3)				\
+	msg0 = vsha256su1q_u32(vsha256su0q_u32(msg0, msg1), msg2, msg3)
+
+int arch_sha256_blocks(uint32_t state[8], const uint8_t *data,
+		       unsigned int blocks)
+{
+	uint32x4_t abcd, efgh, abcd_save, efgh_save, msg[4], tmp, tmp_abcd;
+	int i;
+
+	if (!sha_ce_present(12))
+		return -ENOSYS;
+
+	abcd = vld1q_u32(state);
+	efgh = vld1q_u32(state + 4);
+
+	for (; blocks; blocks--, data += 64) {
+		abcd_save = abcd;
+		efgh_save = efgh;
+
+		for (i = 0; i < 4; i++)
+			msg[i] = vreinterpretq_u32_u8(
+				vrev32q_u8(vld1q_u8(data + i * 16)));
+
+		/* Sixteen groups of four rounds */
+		for (i = 0; i < 16; i++) {
+			tmp = vaddq_u32(msg[i % 4], vld1q_u32(&sha256_k[i * 4]));
+			tmp_abcd = abcd;
+			abcd = vsha256hq_u32(abcd, efgh, tmp);
+			efgh = vsha256h2q_u32(efgh, tmp_abcd, tmp);
+			if (i < 12)
+				SHA256_SCHEDULE(msg[i % 4], msg[(i + 1) % 4],
+						msg[(i + 2) % 4],
+						msg[(i + 3) % 4]);
+		}
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		efgh = vaddq_u32(efgh, efgh_save);
+	}
+
+	vst1q_u32(state, abcd);
+	vst1q_u32(state + 4, efgh);
+
+	return 0;
+}
@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -206,6 +207,51 @@ uint64_t __attribute__((no_instrument_function)) os_get_nsec(void)
 #endif
 }
 
+struct os_thread {
+	pthread_t thread;
+	int (*func)(void *arg);
+	void *arg;
+	int ret;
+};
+
+static void *os_thread_run(void *data)
+{
+	struct os_thread *thread = data;
+
+	thread->ret = thread->func(thread->arg);
+
+	return NULL;
+}
+
+void *os_thread_start(int (*func)(void *arg), void *arg)
+{
+	struct os_thread *thread;
+
+	thread = os_malloc(sizeof(*thread));
+	if (!thread)
+		return NULL;
+	thread->func = func;
+	thread->arg = arg;
+	if (pthread_create(&thread->thread, NULL, os_thread_run, thread)) {
+		os_free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+int os_thread_join(void *data)
+{
+	struct os_thread *thread = data;
+	int ret;
+
+	pthread_join(thread->thread, NULL);
+	ret = thread->ret;
+	os_free(thread);
+
+	return ret;
+}
+
 static char *short_opts;
 static struct option *long_opts;
 
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2015 The Chromium OS Authors.
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <errno.h>
+#include <stdint.h>
+
+/* Use the host CPU's SHA instructions when it has them */
+#if defined(__x86_64__) || defined(__i386__)
+#include "../../x86/lib/sha_ni.c"
+#else
+int arch_sha1_blocks(uint32_t state[5], const uint8_t *data,
+		     unsigned int blocks)
+{
+	return -ENOSYS;
+}
+
+int arch_sha256_blocks(uint32_t state[8], const uint8_t *data,
+		       unsigned int blocks)
+{
+	return -ENOSYS;
+}
+#endif
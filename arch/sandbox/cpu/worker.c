@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2015 The Chromium OS Authors.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <os.h>
+#include <worker.h>
+
+/* Host threads stand in for secondary CPUs */
+#ifndef CONFIG_SANDBOX_WORKER_THREADS
+#define CONFIG_SANDBOX_WORKER_THREADS	3
+#endif
+
+static void *worker_thread[CONFIG_SANDBOX_WORKER_THREADS];
+
+int arch_worker_cpus(void)
+{
+	return CONFIG_SANDBOX_WORKER_THREADS;
+}
+
+int arch_worker_start(int cpu, int (*func)(void *arg), void *arg)
+{
+	if (cpu >= CONFIG_SANDBOX_WORKER_THREADS || worker_thread[cpu])
+		return -EBUSY;
+	worker_thread[cpu] = os_thread_start(func, arg);
+
+	return worker_thread[cpu] ? 0 : -ENOMEM;
+}
+
+int arch_worker_wait(int cpu)
+{
+	void *thread = worker_thread[cpu];
+
+	worker_thread[cpu] = NULL;
+
+	return os_thread_join(thread);
+}
@@ -14,4 +14,25 @@ void sandbox_eth_disable_response(int index, bool disable);
 
 void sandbox_eth_skip_timeout(void);
 
+/**
+ * struct sandbox_eth_tftp_stats - traffic seen by the mock TFTP server
+ *
+ * @blocks: Number of DATA packets sent
+ * @acks: Number of ACKs received, i.e. round trips
+ */
+struct sandbox_eth_tftp_stats {
+	ulong blocks;
+	ulong acks;
+};
+
+void sandbox_eth_tftp_setup(ulong file_size, ulong drop_block);
+
+void sandbox_eth_tftp_get_stats(struct sandbox_eth_tftp_stats *stats);
+
+/* Contents of the file served by the mock TFTP server */
+static inline u8 sandbox_eth_tftp_byte(ulong offset)
+{
+	return offset % 251;
+}
+
 #endif /* __ETH_H */
@@ -0,0 +1,228 @@
+/*
+ * SHA-1 and SHA-256 using the x86 SHA extensions (SHA-NI)
+ *
+ * This file is also built into sandbox against the host's headers, so it
+ * only relies on the compiler's intrinsics headers.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef CONFIG_SANDBOX
+#include <common.h>
+#endif
+#include <errno.h>
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHA_NI_TARGET	__attribute__((target("sha,sse4.1,ssse3")))
+
+/* SHA-NI needs SSSE3 and SSE4.1 for shuffling the state and message */
+static int sha_ni_present(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+	    !(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+		return 0;
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	return ebx & bit_SHA;
+}
+
+#define SHA1_GROUP(e_next, e_save, msg, func) do {		\
+	e_next = _mm_sha1nexte_epu32(e_next, msg);		\
+	e_save = abcd;						\
+	abcd = _mm_sha1rnds4_epu32(abcd, e_next, func);		\
+} while (0)
+
+/* Replace msg0 with the next four words of the message schedule */
+#define SHA1_SCHEDULE(msg0, msg1, msg2, msg3)				\
+	msg0 = _mm_sha1msg2_epu32(_mm_xor_si128(			\
+			_mm_sha1msg1_epu32(msg0, msg1), msg2), msg3)
+
+SHA_NI_TARGET
+int arch_sha1_blocks(unsigned int state[5], const unsigned char *data,
+		     unsigned int blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+					    0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e0, e1, e_save;
+	__m128i msg0, msg1, msg2, msg3;
+
+	if (!sha_ni_present())
+		return -ENOSYS;
+
+	/* Hold A in the top lane, as the instructions expect */
+	abcd = _mm_loadu_si128((const __m128i *)state);
+	abcd = _mm_shuffle_epi32(abcd, 0x1b);
+	e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+	for (; blocks; blocks--, data += 64) {
+		abcd_save = abcd;
+		e_save = e0;
+
+		msg0 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data), mask);
+		msg1 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+		msg2 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+		msg3 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+
+		/* Rounds 0-19 */
+		e0 = _mm_add_epi32(e0, msg0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		SHA1_SCHEDULE(msg0, msg1, msg2, msg3);
+		SHA1_GROUP(e1, e0, msg1, 0);
+		SHA1_SCHEDULE(msg1, msg2, msg3, msg0);
+		SHA1_GROUP(e0, e1, msg2, 0);
+		SHA1_SCHEDULE(msg2, msg3, msg0, msg1);
+		SHA1_GROUP(e1, e0, msg3, 0);
+		SHA1_SCHEDULE(msg3, msg0, msg1, msg2);
+		SHA1_GROUP(e0, e1, msg0, 0);
+		SHA1_SCHEDULE(msg0, msg1, msg2, msg3);
+
+		/* Rounds 20-39 */
+		SHA1_GROUP(e1, e0, msg1, 1);
+		SHA1_SCHEDULE(msg1, msg2, msg3, msg0);
+		SHA1_GROUP(e0, e1, msg2, 1);
+		SHA1_SCHEDULE(msg2, msg3, msg0, msg1);
+		SHA1_GROUP(e1, e0, msg3, 1);
+		SHA1_SCHEDULE(msg3, msg0, msg1, msg2);
+		SHA1_GROUP(e0, e1, msg0, 1);
+		SHA1_SCHEDULE(msg0, msg1, msg2, msg3);
+		SHA1_GROUP(e1, e0, msg1, 1);
+		SHA1_SCHEDULE(msg1, msg2, msg3, msg0);
+
+		/* Rounds 40-59 */
+		SHA1_GROUP(e0, e1, msg2, 2);
+		SHA1_SCHEDULE(msg2, msg3, msg0, msg1);
+		SHA1_GROUP(e1, e0, msg3, 2);
+		SHA1_SCHEDULE(msg3, msg0, msg1, msg2);
+		SHA1_GROUP(e0, e1, msg0, 2);
+		SHA1_SCHEDULE(msg0, msg1, msg2, msg3);
+		SHA1_GROUP(e1, e0, msg1, 2);
+		SHA1_SCHEDULE(msg1, msg2, msg3, msg0);
+		SHA1_GROUP(e0, e1, msg2, 2);
+		SHA1_SCHEDULE(msg2, msg3, msg0, msg1);
+
+		/* Rounds 60-79 */
+		SHA1_GROUP(e1, e0, msg3, 3);
+		SHA1_SCHEDULE(msg3, msg0, msg1, msg2);
+		SHA1_GROUP(e0, e1, msg0, 3);
+		SHA1_GROUP(e1, e0, msg1, 3);
+		SHA1_GROUP(e0, e1, msg2, 3);
+		SHA1_GROUP(e1, e0, msg3, 3);
+
+		e0 = _mm_sha1nexte_epu32(e0, e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	abcd = _mm_shuffle_epi32(abcd, 0x1b);
+	_mm_storeu_si128((__m128i *)state, abcd);
+	state[4] = _mm_extract_epi32(e0, 3);
+
+	return 0;
+}
+
+static const unsigned int sha256_k[64] __attribute__((aligned(16))) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* Four rounds, using message words 'msg' and round constants 'i' to i + 3 */
+#define SHA256_ROUNDS(msg, i) do {					\
+	tmp = _mm_add_epi32(msg,					\
+		_mm_load_si128((const __m128i *)&sha256_k[i]));		\
+	state1 = _mm_sha256rnds2_epu32(state1, state0, tmp);		\
+	tmp = _mm_shuffle_epi32(tmp, 0x0e);				\
+	state0 = _mm_sha256rnds2_epu32(state0, state1, tmp);		\
+} while (0)
+
+/* Replace msg0 with the next four words of the message schedule */
+#define SHA256_SCHEDULE(msg0, msg1, msg2, msg3)				\
+	msg0 = _mm_sha256msg2_epu32(_mm_add_epi32(			\
+			_mm_sha256msg1_epu32(msg0, msg1),		\
+			_mm_alignr_epi8(msg3, msg2, 4)), msg3)
+
+SHA_NI_TARGET
+int arch_sha256_blocks(unsigned int state[8], const unsigned char *data,
+		       unsigned int blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	__m128i state0, state1, save0, save1, tmp;
+	__m128i msg0, msg1, msg2, msg3;
+	int i;
+
+	if (!sha_ni_present())
+		return -ENOSYS;
+
+	/* The instructions want the state as ABEF and CDGH */
+	tmp = _mm_loadu_si128((const __m128i *)state);
+	state1 = _mm_loadu_si128((const __m128i *)(state + 4));
+	tmp = _mm_shuffle_epi32(tmp, 0xb1);
+	state1 = _mm_shuffle_epi32(state1, 0x1b);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+	for (; blocks; blocks--, data += 64) {
+		save0 = state0;
+		save1 = state1;
+
+		msg0 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data), mask);
+		msg1 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+		msg2 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+		msg3 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+
+		for (i = 0; i < 48; i += 16) {
+			SHA256_ROUNDS(msg0, i);
+			SHA256_SCHEDULE(msg0, msg1, msg2, msg3);
+			SHA256_ROUNDS(msg1, i + 4);
+			SHA256_SCHEDULE(msg1, msg2, msg3, msg0);
+			SHA256_ROUNDS(msg2, i + 8);
+			SHA256_SCHEDULE(msg2, msg3, msg0, msg1);
+			SHA256_ROUNDS(msg3, i + 12);
+			SHA256_SCHEDULE(msg3, msg0, msg1, msg2);
+		}
+		SHA256_ROUNDS(msg0, 48);
+		SHA256_ROUNDS(msg1, 52);
+		SHA256_ROUNDS(msg2, 56);
+		SHA256_ROUNDS(msg3, 60);
+
+		state0 = _mm_add_epi32(state0, save0);
+		state1 = _mm_add_epi32(state1, save1);
+	}
+
+	/* Back to ABCD and EFGH */
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i *)state, state0);
+	_mm_storeu_si128((__m128i *)(state + 4), state1);
+
+	return 0;
+}
@@ -10,6 +10,7 @@
 #include <bootretry.h>
 #include <cli.h>
 #include <fdtdec.h>
+#include <initcall.h>
 #include <menu.h>
 #include <post.h>
 #include <u-boot/sha256.h>
@@ -258,6 +259,7 @@ static int abortboot_normal(int bootdelay)
 # endif
 				break;
 			}
+			initcall_defer_poll();
 			udelay(10000);
 		} while (!abort && get_timer(ts) < 1000);
 
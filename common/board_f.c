@@ -16,6 +16,7 @@
 #include <environment.h>
 #include <dm.h>
 #include <fdtdec.h>
+#include <fdt_index.h>
 #include <fs.h>
 #if defined(CONFIG_CMD_IDE)
 #include <ide.h>
@@ -726,6 +727,10 @@ static int initf_dm(void)
 #if defined(CONFIG_DM) && defined(CONFIG_SYS_MALLOC_F_LEN)
 	int ret;
 
+#ifdef CONFIG_OF_LIBFDT_INDEX
+	/* Without an index, lookups just take longer */
+	fdt_index_build(gd->fdt_blob);
+#endif
 	ret = dm_init_and_scan(true);
 	if (ret)
 		return ret;
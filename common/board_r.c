@@ -21,6 +21,7 @@
 #include <dm.h>
 #include <environment.h>
 #include <fdtdec.h>
+#include <fdt_index.h>
 #if defined(CONFIG_CMD_IDE)
 #include <ide.h>
 #endif
@@ -282,6 +283,21 @@ static int initr_noncached(void)
 }
 #endif
 
+#ifdef CONFIG_OF_LIBFDT_INDEX
+static int initr_fdt_index(void)
+{
+	/*
+	 * The index built in initf_dm() is for the tree before it was
+	 * relocated, and was allocated from the early malloc() pool, which
+	 * free() cannot release. Forget it and index the relocated tree.
+	 */
+	gd->fdt_index = NULL;
+	fdt_index_build(gd->fdt_blob);
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_DM
 static int initr_dm(void)
 {
@@ -404,6 +420,27 @@ static int initr_mmc(void)
 	mmc_initialize(gd->bd);
 	return 0;
 }
+
+#ifdef CONFIG_INITCALL_DEFER
+/* Cards started by mmc_initialize() can power up while init goes on */
+static int initr_mmc_start(void)
+{
+	initr_mmc();
+	return mmc_preinit_poll();
+}
+
+static struct initcall_defer initr_mmc_defer = {
+	.name = "mmc",
+	.id = BOOTSTAGE_ID_ACCUM_MMC,
+	.start = initr_mmc_start,
+	.poll = mmc_preinit_poll,
+};
+
+static int initr_mmc_deferred(void)
+{
+	return initcall_defer_start(&initr_mmc_defer);
+}
+#endif
 #endif
 
 #ifdef CONFIG_HAS_DATAFLASH
@@ -586,6 +623,20 @@ static int initr_net(void)
 #endif
 	return 0;
 }
+
+#ifdef CONFIG_INITCALL_DEFER
+/* Nothing needs the network until a command uses it */
+static struct initcall_defer initr_net_defer = {
+	.name = "net",
+	.id = BOOTSTAGE_ID_ACCUM_NET,
+	.finish = initr_net,
+};
+
+static int initr_net_deferred(void)
+{
+	return initcall_defer_start(&initr_net_defer);
+}
+#endif
 #endif
 
 #ifdef CONFIG_POST
@@ -708,6 +759,9 @@ init_fnc_t init_sequence_r[] = {
 	initr_noncached,
 #endif
 	bootstage_relocate,
+#ifdef CONFIG_OF_LIBFDT_INDEX
+	initr_fdt_index,
+#endif
 #ifdef CONFIG_DM
 	initr_dm,
 #endif
@@ -782,8 +836,12 @@ init_fnc_t init_sequence_r[] = {
 	initr_onenand,
 #endif
 #ifdef CONFIG_GENERIC_MMC
+#ifdef CONFIG_INITCALL_DEFER
+	initr_mmc_deferred,
+#else
 	initr_mmc,
 #endif
+#endif
 #ifdef CONFIG_HAS_DATAFLASH
 	initr_dataflash,
 #endif
@@ -853,8 +911,12 @@ init_fnc_t init_sequence_r[] = {
 #endif
 #ifdef CONFIG_CMD_NET
 	INIT_FUNC_WATCHDOG_RESET
+#ifdef CONFIG_INITCALL_DEFER
+	initr_net_deferred,
+#else
 	initr_net,
 #endif
+#endif
 #ifdef CONFIG_POST
 	initr_post,
 #endif
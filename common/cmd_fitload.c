@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2015 The Chromium OS Authors.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <fs.h>
+#include <image.h>
+#include <mapmem.h>
+
+#ifndef CONFIG_SYS_BOOTM_LEN
+/* use 8MByte as default max gunzip size */
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
+struct fitload_file {
+	const char *ifname;
+	const char *dev_part;
+	const char *filename;
+};
+
+/*
+ * Each piece is read with a separate fs_read(), which closes the filesystem
+ * again. With CONFIG_FS_MOUNT_CACHE selecting the partition again reuses the
+ * mount, and neither filesystem walks the file from its start for each
+ * piece: FAT carries on in the cluster chain from where the last read of
+ * the file began and ext4 maps the offset through the file's extents. So
+ * reading the FIT in pieces costs about the same as loading it in one go.
+ */
+static int fitload_read(struct fit_stream *stream, ulong offset, void *buf,
+			ulong len)
+{
+	struct fitload_file *file = stream->priv;
+	loff_t actread;
+
+	if (fs_set_blk_dev(file->ifname, file->dev_part, FS_TYPE_ANY))
+		return -ENODEV;
+	if (fs_read(file->filename, map_to_sysmem(buf), offset, len, &actread))
+		return -EIO;
+
+	return 0;
+}
+
+static int do_fitload(cmd_tbl_t *cmdtp, int flag, int argc,
+		      char * const argv[])
+{
+	static const char * const props[] = {
+		FIT_KERNEL_PROP,
+		FIT_FDT_PROP,
+		FIT_RAMDISK_PROP,
+	};
+	struct fitload_file file;
+	struct fit_stream stream;
+	char name[20];
+	ulong load, len;
+	int conf_noffset, noffset;
+	int ret, i;
+
+	if (argc < 4 || argc > 5)
+		return CMD_RET_USAGE;
+
+	file.ifname = argv[1];
+	file.dev_part = argv[2];
+	file.filename = argv[3];
+	stream.read = fitload_read;
+	stream.priv = &file;
+	if (fit_stream_open(&stream))
+		return CMD_RET_FAILURE;
+
+	conf_noffset = fit_conf_get_node(stream.fit, argc > 4 ? argv[4] : NULL);
+	if (conf_noffset < 0) {
+		puts("Could not find configuration node\n");
+		ret = CMD_RET_FAILURE;
+		goto out;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(props); i++) {
+		noffset = fit_conf_get_prop_node(stream.fit, conf_noffset,
+						 props[i]);
+		if (noffset < 0)
+			continue;
+		if (fit_image_get_load(stream.fit, noffset, &load)) {
+			printf("No load address for '%s', skipped\n",
+			       fit_get_name(stream.fit, noffset, NULL));
+			continue;
+		}
+
+		printf("## Loading %s from '%s' to %08lx\n", props[i],
+		       fit_get_name(stream.fit, noffset, NULL), load);
+		ret = fit_stream_load(&stream, noffset, load,
+				      CONFIG_SYS_BOOTM_LEN, &len);
+		if (ret) {
+			ret = CMD_RET_FAILURE;
+			goto out;
+		}
+
+		snprintf(name, sizeof(name), "fit_%s_addr", props[i]);
+		setenv_hex(name, load);
+		snprintf(name, sizeof(name), "fit_%s_size", props[i]);
+		setenv_hex(name, len);
+	}
+	ret = CMD_RET_SUCCESS;
+
+out:
+	fit_stream_close(&stream);
+
+	return ret;
+}
+
+U_BOOT_CMD(
+	fitload,	5,	0,	do_fitload,
+	"load the images of a FIT configuration from a filesystem",
+	"<interface> <dev[:part]> <filename> [<config>]\n"
+	"    - Load the kernel, FDT and ramdisk of configuration 'config'\n"
+	"      (default: the default configuration) in FIT 'filename'\n"
+	"      to their load addresses, checking their hashes. The FIT is\n"
+	"      read in pieces rather than loaded into memory first.\n"
+	"      Sets fit_<image>_addr and fit_<image>_size for each image."
+);
@@ -96,3 +96,23 @@ U_BOOT_CMD(
 	"fstype <interface> <dev>:<part> <varname>\n"
 	"- set environment variable to filesystem type\n"
 );
+
+#ifdef CONFIG_FS_MOUNT_CACHE
+static int do_fs(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	if (argc != 2 || strcmp(argv[1], "reset"))
+		return CMD_RET_USAGE;
+
+	fs_invalidate(NULL);
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	fs,	2,	0,	do_fs,
+	"filesystem mount cache",
+	"reset\n"
+	"    - Unmount the cached filesystem, so that the next command\n"
+	"      probes and mounts the partition again."
+);
+#endif
@@ -13,6 +13,7 @@
 #include <config.h>
 #include <watchdog.h>
 #include <command.h>
+#include <fs.h>
 #include <image.h>
 #include <asm/byteorder.h>
 #include <asm/io.h>
@@ -230,6 +231,7 @@ int do_ide(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 			printf("\nIDE write: device %d block # %ld, count %ld ... ",
 				curr_device, blk, cnt);
 #endif
+			fs_invalidate(&ide_dev_desc[curr_device]);
 			n = ide_write(curr_device, blk, cnt, (ulong *) addr);
 
 			printf("%ld blocks written: %s\n",
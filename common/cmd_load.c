@@ -10,15 +10,21 @@
  */
 #include <common.h>
 #include <command.h>
+#include <div64.h>
+#include <mapmem.h>
 #include <s_record.h>
 #include <net.h>
 #include <exports.h>
 #include <xyzModem.h>
+#include <asm/unaligned.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
 #if defined(CONFIG_CMD_LOADB)
 static ulong load_serial_ymodem(ulong offset, int mode);
+# if defined(CONFIG_CMD_LOADW)
+static ulong load_serial_window(ulong offset);
+# endif
 #endif
 
 #if defined(CONFIG_CMD_LOADS)
@@ -464,6 +470,19 @@ static int do_load_serial_bin(cmd_tbl_t *cmdtp, int flag, int argc,
 
 		addr = load_serial_ymodem(offset, xyzModem_ymodem);
 
+#ifdef CONFIG_CMD_LOADW
+	} else if (strcmp(argv[0], "loadw") == 0) {
+		printf("## Ready for binary (streaming) download "
+			"to 0x%08lX at %d bps...\n",
+			offset,
+			load_baudrate);
+
+		addr = load_serial_window(offset);
+		if (addr == ~0) {
+			printf("## Binary (streaming) download aborted\n");
+			rcode = 1;
+		}
+#endif
 	} else if (strcmp(argv[0],"loadx")==0) {
 		printf("## Ready for binary (xmodem) download "
 			"to 0x%08lX at %d bps...\n",
@@ -1004,6 +1023,179 @@ static ulong load_serial_ymodem(ulong offset, int mode)
 	return offset;
 }
 
+#if defined(CONFIG_CMD_LOADW)
+/*
+ * Streaming binary download
+ *
+ * xmodem and ymodem wait for each block to be acknowledged before the next
+ * is sent, so the line sits idle for a round trip per block. Here the
+ * sender keeps sending frames, up to a window it chooses, and we only
+ * tell it how far we have got. Frames are written straight to memory.
+ *
+ * Each frame is:
+ *
+ *	STX, flags (LOADW_FLAG_...), 0, length (16 bits), sequence (32 bits),
+ *	data (length bytes, at most LOADW_MAX_DATA), CRC32 (32 bits)
+ *
+ * Numbers are little-endian and the CRC32 covers everything after the STX
+ * up to the end of the data. Sequence numbers start at 0.
+ *
+ * We reply with ACK or NAK followed by the sequence number of the next
+ * frame we want, as eight hex digits. ACK says that all frames before that
+ * one have arrived; NAK asks the sender to go back and send from that
+ * frame. The replies are printable so that they survive any translation
+ * of line endings on the way out. Until the first frame arrives, we send
+ * a NAK for frame 0 every second, which tells the sender we are ready.
+ * The transfer ends when the frame with LOADW_FLAG_LAST is acknowledged.
+ *
+ * A sender is provided in tools/sersend.c
+ */
+#define LOADW_STX		0x02
+#define LOADW_ACK		0x06
+#define LOADW_NAK		0x15
+#define LOADW_CTRL_C		0x03
+#define LOADW_FLAG_LAST		(1 << 0)
+#define LOADW_HDR_SIZE		8	/* not including the STX */
+#define LOADW_MAX_DATA		4096
+#define LOADW_ACK_EVERY		8	/* frames between ACKs */
+#define LOADW_TIMEOUT		1000	/* ms to wait for a character */
+#define LOADW_RETRIES		60
+
+static void loadw_reply(int type, uint seq)
+{
+	char msg[16];
+
+	sprintf(msg, "%c%08x", type, seq);
+	puts(msg);
+}
+
+/* Get a character, returning -ETIMEDOUT if none arrives in time */
+static int loadw_getc(void)
+{
+	ulong start;
+
+	if (!tstc()) {
+		start = get_timer(0);
+		while (!tstc()) {
+			if (get_timer(start) > LOADW_TIMEOUT)
+				return -ETIMEDOUT;
+		}
+	}
+
+	return getc();
+}
+
+static int loadw_read(uchar *buf, int size)
+{
+	int ch;
+
+	for (; size; size--) {
+		ch = loadw_getc();
+		if (ch < 0)
+			return ch;
+		*buf++ = ch;
+	}
+
+	return 0;
+}
+
+static ulong load_serial_window(ulong offset)
+{
+	uchar hdr[LOADW_HDR_SIZE], crc_buf[4];
+	uchar *buf;
+	uint seq, expect = 0, nak_seq = ~0, high = 0;
+	ulong size = 0, start = 0;
+	int ch, len, flags, idle = 0;
+	bool started = false, last = false, good;
+	u32 crc;
+
+#ifndef CONFIG_SYS_NO_FLASH
+	if (addr2info(offset)) {
+		printf("## Cannot stream to flash, use a RAM address\n");
+		return ~0;
+	}
+#endif
+	/* The size is not known until the end, so map from here onwards */
+	buf = map_sysmem(offset, 0);
+	loadw_reply(LOADW_NAK, 0);
+	while (!last) {
+		ch = loadw_getc();
+		if (ch == -ETIMEDOUT) {
+			if (++idle > LOADW_RETRIES)
+				break;
+			loadw_reply(LOADW_NAK, expect);
+			continue;
+		}
+		if (ch != LOADW_STX) {
+			/* Let the user give up before the sender starts */
+			if (!started && ch == LOADW_CTRL_C)
+				break;
+			continue;
+		}
+		started = true;
+		if (loadw_read(hdr, sizeof(hdr)))
+			continue;
+		flags = hdr[0];
+		len = get_unaligned_le16(hdr + 2);
+		seq = get_unaligned_le32(hdr + 4);
+		if (len > LOADW_MAX_DATA)
+			continue;
+
+		/*
+		 * Read into place even if this is not the frame we want,
+		 * since nothing there has been accepted yet
+		 */
+		if (loadw_read(buf + size, len) ||
+		    loadw_read(crc_buf, sizeof(crc_buf)))
+			continue;
+		crc = crc32(0, hdr, sizeof(hdr));
+		crc = crc32(crc, buf + size, len);
+		good = crc == get_unaligned_le32(crc_buf);
+		if (!good || seq > expect) {
+			/*
+			 * Ask for a resend once per lost frame, or again if
+			 * the sender has gone back and we missed it again
+			 */
+			if (nak_seq != expect || (good && seq <= high)) {
+				loadw_reply(LOADW_NAK, expect);
+				nak_seq = expect;
+				high = good ? seq : expect;
+			} else if (good) {
+				high = seq;
+			}
+			continue;
+		} else if (seq < expect) {
+			/* The sender missed an ACK */
+			loadw_reply(LOADW_ACK, expect);
+			continue;
+		}
+
+		if (!expect)
+			start = get_timer(0);
+		size += len;
+		idle = 0;
+		last = flags & LOADW_FLAG_LAST;
+		if (++expect % LOADW_ACK_EVERY == 0 || last)
+			loadw_reply(LOADW_ACK, expect);
+	}
+	unmap_sysmem(buf);
+	if (!last)
+		return ~0;
+
+	/* Give the sender a chance to stop before we print anything */
+	start = max(get_timer(start), 1UL);
+	udelay(100000);
+	printf("## %u frames in %lu ms, %llu bytes/s\n", expect, start,
+	       (unsigned long long)lldiv((u64)size * 1000, start));
+	flush_cache(offset, size);
+
+	printf("## Total Size      = 0x%08lx = %ld Bytes\n", size, size);
+	setenv_hex("filesize", size);
+
+	return offset;
+}
+#endif /* CONFIG_CMD_LOADW */
+
 #endif
 
 /* -------------------------------------------------------------------- */
@@ -1079,6 +1271,17 @@ U_BOOT_CMD(
 	" with offset 'off' and baudrate 'baud'"
 );
 
+#if defined(CONFIG_CMD_LOADW)
+U_BOOT_CMD(
+	loadw, 3, 0,	do_load_serial_bin,
+	"load binary file over serial line (streaming mode)",
+	"[ off ] [ baud ]\n"
+	"    - load binary file to RAM over serial line"
+	" with offset 'off' and baudrate 'baud'\n"
+	"      (use tools/sersend to send the file)"
+);
+#endif
+
 #endif	/* CONFIG_CMD_LOADB */
 
 /* -------------------------------------------------------------------- */
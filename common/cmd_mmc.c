@@ -7,6 +7,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <fs.h>
 #include <mmc.h>
 
 static int curr_device = -1;
@@ -382,6 +383,7 @@ static int do_mmc_write(cmd_tbl_t *cmdtp, int flag,
 		printf("Error: card is write protected!\n");
 		return CMD_RET_FAILURE;
 	}
+	fs_invalidate(&mmc->block_dev);
 	n = mmc->block_dev.block_write(curr_device, blk, cnt, addr);
 	printf("%d blocks written: %s\n", n, (n == cnt) ? "OK" : "ERROR");
 
@@ -410,6 +412,7 @@ static int do_mmc_erase(cmd_tbl_t *cmdtp, int flag,
 		printf("Error: card is write protected!\n");
 		return CMD_RET_FAILURE;
 	}
+	fs_invalidate(&mmc->block_dev);
 	n = mmc->block_dev.block_erase(curr_device, blk, cnt);
 	printf("%d blocks erased: %s\n", n, (n == cnt) ? "OK" : "ERROR");
 
@@ -1082,6 +1082,8 @@ static int do_env_import(cmd_tbl_t *cmdtp, int flag,
 		return 1;
 	}
 	gd->flags |= GD_FLG_ENV_READY;
+	if (del)
+		env_log_changed_all();
 
 	return 0;
 
@@ -12,6 +12,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <fs.h>
 #include <part.h>
 #include <sata.h>
 
@@ -189,6 +190,7 @@ static int do_sata(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			printf("\nSATA write: device %d block # %ld, count %ld ... ",
 				sata_curr_device, blk, cnt);
 
+			fs_invalidate(&sata_dev_desc[sata_curr_device]);
 			n = sata_write(sata_curr_device, blk, cnt, (u32 *)addr);
 
 			printf("%ld blocks written: %s\n",
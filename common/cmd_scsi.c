@@ -10,6 +10,7 @@
  */
 #include <common.h>
 #include <command.h>
+#include <fs.h>
 #include <inttypes.h>
 #include <asm/processor.h>
 #include <scsi.h>
@@ -345,6 +346,7 @@ int do_scsi (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 				printf("\nSCSI write: device %d block # %ld, "
 				       "count %ld ... ",
 				       scsi_curr_dev, blk, cnt);
+				fs_invalidate(&scsi_dev_desc[scsi_curr_dev]);
 				n = scsi_write(scsi_curr_dev, blk, cnt,
 					       (ulong *)addr);
 				printf("%ld blocks written: %s\n", n,
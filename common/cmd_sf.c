@@ -147,48 +147,115 @@ static int do_spi_flash_probe(int argc, char * const argv[])
 	return 0;
 }
 
+/* Check whether data is all 0xff, as it is once erased */
+static bool spi_flash_is_erased(const char *buf, size_t len)
+{
+	while (len--) {
+		if (*buf++ != (char)0xff)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Write data to erased SPI flash, skipping pages which would stay erased
+ *
+ * @param flash		flash context pointer
+ * @param offset	flash offset to write
+ * @param len		number of bytes to write
+ * @param buf		buffer to write from
+ * @return 0 if OK, non-zero on error
+ */
+static int spi_flash_write_erased(struct spi_flash *flash, u32 offset,
+		size_t len, const char *buf)
+{
+	size_t page = flash->page_size;
+	size_t pos, start, todo;
+
+	for (pos = 0; pos < len;) {
+		todo = min(len - pos, page - (offset + pos) % page);
+		if (spi_flash_is_erased(buf + pos, todo)) {
+			pos += todo;
+			continue;
+		}
+
+		/* Write the run of pages with something in them */
+		start = pos;
+		do {
+			pos += todo;
+			todo = min(len - pos, page - (offset + pos) % page);
+		} while (pos < len && !spi_flash_is_erased(buf + pos, todo));
+		if (spi_flash_write(flash, offset + start, pos - start,
+				    buf + start))
+			return -EIO;
+	}
+
+	return 0;
+}
+
 /**
  * Write a block of data to SPI flash, first checking if it is different from
  * what is already there.
  *
+ * The block is checked a sector at a time. Each run of sectors which need
+ * to change is erased together, so that larger erase commands can be used,
+ * then written, leaving out pages which would stay erased.
+ *
  * If the data being written is the same, then *skipped is incremented by len.
  *
  * @param flash		flash context pointer
- * @param offset	flash offset to write
+ * @param offset	flash offset to write, a multiple of the sector size
  * @param len		number of bytes to write
  * @param buf		buffer to write from
- * @param cmp_buf	read buffer to use to compare data
+ * @param cmp_buf	read buffer to use to compare data, large enough to
+ *			hold len rounded up to a whole number of sectors
  * @param skipped	Count of skipped data (incremented by this function)
  * @return NULL if OK, else a string containing the stage which failed
  */
 static const char *spi_flash_update_block(struct spi_flash *flash, u32 offset,
 		size_t len, const char *buf, char *cmp_buf, size_t *skipped)
 {
-	char *ptr = (char *)buf;
+	size_t sector = flash->sector_size;
+	size_t size = roundup(len, sector);
+	size_t pos, start, todo;
 
 	debug("offset=%#x, sector_size=%#x, len=%#zx\n",
 	      offset, flash->sector_size, len);
-	/* Read the entire sector so to allow for rewriting */
-	if (spi_flash_read(flash, offset, flash->sector_size, cmp_buf))
+	/* Read the entire sectors so to allow for rewriting */
+	if (spi_flash_read(flash, offset, size, cmp_buf))
 		return "read";
-	/* Compare only what is meaningful (len) */
-	if (memcmp(cmp_buf, buf, len) == 0) {
-		debug("Skip region %x size %zx: no change\n",
-		      offset, len);
-		*skipped += len;
-		return NULL;
-	}
-	/* Erase the entire sector */
-	if (spi_flash_erase(flash, offset, flash->sector_size))
-		return "erase";
-	/* If it's a partial sector, copy the data into the temp-buffer */
-	if (len != flash->sector_size) {
-		memcpy(cmp_buf, buf, len);
-		ptr = cmp_buf;
+
+	for (pos = 0; pos < len;) {
+		/* Compare only what is meaningful (len) */
+		todo = min(len - pos, sector);
+		if (memcmp(cmp_buf + pos, buf + pos, todo) == 0) {
+			debug("Skip region %zx size %zx: no change\n",
+			      offset + pos, todo);
+			*skipped += todo;
+			pos += sector;
+			continue;
+		}
+
+		/*
+		 * Collect the run of sectors which change. For a partial
+		 * sector, the rest of it keeps its old contents.
+		 */
+		start = pos;
+		do {
+			memcpy(cmp_buf + pos, buf + pos, todo);
+			pos += sector;
+			if (pos >= len)
+				break;
+			todo = min(len - pos, sector);
+		} while (memcmp(cmp_buf + pos, buf + pos, todo));
+
+		if (spi_flash_erase(flash, offset + start, pos - start))
+			return "erase";
+		if (spi_flash_write_erased(flash, offset + start, pos - start,
+					   cmp_buf + start))
+			return "write";
 	}
-	/* Write one complete sector */
-	if (spi_flash_write(flash, offset, flash->sector_size, ptr))
-		return "write";
 
 	return NULL;
 }
@@ -214,16 +281,23 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 	const ulong start_time = get_timer(0);
 	size_t scale = 1;
 	const char *start_buf = buf;
+	size_t block;
 	ulong delta;
 
+	/*
+	 * Work through aligned blocks which the largest erase command can
+	 * cover, so that it can be used where a whole block changes
+	 */
+	block = max(flash->sector_size, flash->erase_size_64k);
 	if (end - buf >= 200)
 		scale = (end - buf) / 100;
-	cmp_buf = malloc(flash->sector_size);
+	cmp_buf = malloc(block);
 	if (cmp_buf) {
 		ulong last_update = get_timer(0);
 
 		for (; buf < end && !err_oper; buf += todo, offset += todo) {
-			todo = min_t(size_t, end - buf, flash->sector_size);
+			todo = min_t(size_t, end - buf,
+				     block - offset % block);
 			if (get_timer(last_update) > 100) {
 				printf("   \rUpdating, %zu%% %lu B/s",
 				       100 - (end - buf) / scale,
@@ -292,6 +366,7 @@ static int do_spi_flash_read_write(int argc, char * const argv[])
 		ret = spi_flash_update(flash, offset, len, buf);
 	} else if (strncmp(argv[0], "read", 4) == 0 ||
 			strncmp(argv[0], "write", 5) == 0) {
+		ulong start_time = get_timer(0);
 		int read;
 
 		read = strncmp(argv[0], "read", 4) == 0;
@@ -302,10 +377,12 @@ static int do_spi_flash_read_write(int argc, char * const argv[])
 
 		printf("SF: %zu bytes @ %#x %s: ", (size_t)len, (u32)offset,
 		       read ? "Read" : "Written");
-		if (ret)
+		if (ret) {
 			printf("ERROR %d\n", ret);
-		else
-			printf("OK\n");
+		} else {
+			printf("OK, ");
+			print_size(bytes_per_second(len, start_time), "/s\n");
+		}
 	}
 
 	unmap_physmem(buf, len);
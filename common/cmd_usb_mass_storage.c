@@ -8,13 +8,15 @@
 #include <errno.h>
 #include <common.h>
 #include <command.h>
+#include <fs.h>
 #include <g_dnl.h>
+#include <malloc.h>
 #include <part.h>
 #include <usb.h>
 #include <usb_mass_storage.h>
 
-static int ums_read_sector(struct ums *ums_dev,
-			   ulong start, lbaint_t blkcnt, void *buf)
+static int ums_blk_read(struct ums *ums_dev,
+			ulong start, lbaint_t blkcnt, void *buf)
 {
 	block_dev_desc_t *block_dev = ums_dev->block_dev;
 	lbaint_t blkstart = start + ums_dev->start_sector;
@@ -23,19 +25,262 @@ static int ums_read_sector(struct ums *ums_dev,
 	return block_dev->block_read(dev_num, blkstart, blkcnt, buf);
 }
 
-static int ums_write_sector(struct ums *ums_dev,
-			    ulong start, lbaint_t blkcnt, const void *buf)
+static int ums_blk_write(struct ums *ums_dev,
+			 ulong start, lbaint_t blkcnt, const void *buf)
 {
 	block_dev_desc_t *block_dev = ums_dev->block_dev;
 	lbaint_t blkstart = start + ums_dev->start_sector;
 	int dev_num = block_dev->dev;
 
+	/* The host may change any filesystem on the device */
+	fs_invalidate(block_dev);
+
 	return block_dev->block_write(dev_num, blkstart, blkcnt, buf);
 }
 
+/*
+ * The host reads and writes at most FSG_BUFLEN at a time, which leaves the
+ * device waiting on the latency of each small transfer. Sectors are cached
+ * in a few buffers, each holding a run of sectors that does not overlap
+ * any other: sequential reads fill a whole buffer ahead of the host, and
+ * consecutive writes are gathered into one and written back together when
+ * the buffer is needed again or the host synchronises the cache.
+ */
+struct ums_cache_buf {
+	lbaint_t start;		/* first sector held */
+	lbaint_t count;		/* number of sectors held, 0 if unused */
+	ulong used;		/* value of ums_cache.tick when last used */
+	bool dirty;
+	void *data;
+};
+
+static struct ums_cache {
+	struct ums_cache_buf *bufs;
+	int num_bufs;		/* 0 if there is no cache */
+	lbaint_t buf_blks;	/* sectors in each buffer */
+	ulong next_read;	/* sector after the last one read */
+	ulong tick;
+} ums_cache;
+
+static int ums_cache_writeback(struct ums *ums_dev, struct ums_cache_buf *b)
+{
+	int ret;
+
+	if (!b->dirty)
+		return 0;
+
+	ret = ums_blk_write(ums_dev, b->start, b->count, b->data);
+	b->dirty = false;
+	if (ret != b->count) {
+		/* The data is lost, but the error is only reported once */
+		b->count = 0;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/*
+ * Find the buffer holding @sect. Also returns in @gapp the number of sectors
+ * from @sect which no buffer holds, so can be added without an overlap.
+ */
+static struct ums_cache_buf *ums_cache_find(struct ums *ums_dev, ulong sect,
+					    lbaint_t *gapp)
+{
+	struct ums_cache_buf *b, *found = NULL;
+	lbaint_t gap = 0;
+	int i;
+
+	if (sect < ums_dev->num_sectors)
+		gap = ums_dev->num_sectors - sect;
+
+	for (i = 0, b = ums_cache.bufs; i < ums_cache.num_bufs; i++, b++) {
+		if (!b->count)
+			continue;
+		if (sect >= b->start && sect < b->start + b->count)
+			found = b;
+		else if (b->start > sect && b->start - sect < gap)
+			gap = b->start - sect;
+	}
+	*gapp = gap;
+
+	return found;
+}
+
+/* Find a buffer with room for more sectors, which ends just before @sect */
+static struct ums_cache_buf *ums_cache_find_tail(ulong sect)
+{
+	struct ums_cache_buf *b;
+	int i;
+
+	for (i = 0, b = ums_cache.bufs; i < ums_cache.num_bufs; i++, b++) {
+		if (b->count && b->count < ums_cache.buf_blks &&
+		    b->start + b->count == sect)
+			return b;
+	}
+
+	return NULL;
+}
+
+/* Get an empty buffer, writing back the least recently used if needed */
+static int ums_cache_get(struct ums *ums_dev, struct ums_cache_buf **bp)
+{
+	struct ums_cache_buf *b, *lru = ums_cache.bufs;
+	int i, ret;
+
+	for (i = 0, b = ums_cache.bufs; i < ums_cache.num_bufs; i++, b++) {
+		if (!b->count) {
+			lru = b;
+			break;
+		}
+		if (b->used < lru->used)
+			lru = b;
+	}
+
+	ret = ums_cache_writeback(ums_dev, lru);
+	lru->count = 0;
+	*bp = lru;
+
+	return ret;
+}
+
+static int ums_read_sector(struct ums *ums_dev,
+			   ulong start, lbaint_t blkcnt, void *buf)
+{
+	struct ums_cache_buf *b;
+	lbaint_t n, gap, left = blkcnt;
+	bool sequential;
+
+	if (!ums_cache.num_bufs)
+		return ums_blk_read(ums_dev, start, blkcnt, buf);
+
+	sequential = start == ums_cache.next_read;
+	while (left) {
+		b = ums_cache_find(ums_dev, start, &gap);
+		if (!b && !gap)
+			break;		/* past the end of the disk */
+		if (!b && sequential) {
+			/* Read ahead a whole buffer */
+			n = min(gap, ums_cache.buf_blks);
+			if (ums_cache_get(ums_dev, &b) ||
+			    ums_blk_read(ums_dev, start, n, b->data) != n)
+				break;
+			b->start = start;
+			b->count = n;
+		}
+		if (b) {
+			n = min(left, b->start + b->count - start);
+			memcpy(buf, b->data + (start - b->start) * SECTOR_SIZE,
+			       n * SECTOR_SIZE);
+			b->used = ++ums_cache.tick;
+		} else {
+			/* Nothing cached here, so read straight from the disk */
+			n = min(left, gap);
+			if (ums_blk_read(ums_dev, start, n, buf) != n)
+				break;
+		}
+		start += n;
+		buf += n * SECTOR_SIZE;
+		left -= n;
+	}
+	ums_cache.next_read = start;
+
+	return blkcnt - left;
+}
+
+static int ums_write_sector(struct ums *ums_dev,
+			    ulong start, lbaint_t blkcnt, const void *buf)
+{
+	struct ums_cache_buf *b;
+	lbaint_t n, gap, left = blkcnt;
+
+	if (!ums_cache.num_bufs)
+		return ums_blk_write(ums_dev, start, blkcnt, buf);
+
+	while (left) {
+		b = ums_cache_find(ums_dev, start, &gap);
+		if (!b && !gap)
+			break;		/* past the end of the disk */
+		if (b) {
+			n = min(left, b->start + b->count - start);
+		} else {
+			/* Add to the end of a buffer, or start a new one */
+			b = ums_cache_find_tail(start);
+			if (!b) {
+				if (ums_cache_get(ums_dev, &b))
+					break;
+				b->start = start;
+			}
+			n = min(left, min(gap, ums_cache.buf_blks - b->count));
+			b->count += n;
+		}
+		memcpy(b->data + (start - b->start) * SECTOR_SIZE, buf,
+		       n * SECTOR_SIZE);
+		b->dirty = true;
+		b->used = ++ums_cache.tick;
+		start += n;
+		buf += n * SECTOR_SIZE;
+		left -= n;
+	}
+
+	return blkcnt - left;
+}
+
+static int ums_flush(struct ums *ums_dev)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < ums_cache.num_bufs; i++) {
+		if (ums_cache_writeback(ums_dev, &ums_cache.bufs[i]))
+			ret = -EIO;
+	}
+
+	return ret;
+}
+
+static void ums_cache_free(void)
+{
+	int i;
+
+	for (i = 0; i < ums_cache.num_bufs; i++)
+		free(ums_cache.bufs[i].data);
+	free(ums_cache.bufs);
+	memset(&ums_cache, '\0', sizeof(ums_cache));
+}
+
+static int ums_cache_init(void)
+{
+	ulong num_bufs, buf_size;
+	int i;
+
+	num_bufs = getenv_ulong("ums_cache_bufs", 0, CONFIG_UMS_CACHE_BUFS);
+	buf_size = getenv_ulong("ums_cache_bufsiz", 0,
+				CONFIG_UMS_CACHE_BUFSIZ);
+	if (!num_bufs || buf_size < SECTOR_SIZE)
+		return 0;
+
+	ums_cache.bufs = calloc(num_bufs, sizeof(struct ums_cache_buf));
+	if (!ums_cache.bufs)
+		return -ENOMEM;
+	ums_cache.buf_blks = buf_size / SECTOR_SIZE;
+	for (i = 0; i < num_bufs; i++) {
+		ums_cache.bufs[i].data = memalign(CONFIG_SYS_CACHELINE_SIZE,
+				ums_cache.buf_blks * SECTOR_SIZE);
+		if (!ums_cache.bufs[i].data) {
+			ums_cache_free();
+			return -ENOMEM;
+		}
+		ums_cache.num_bufs++;
+	}
+	ums_cache.next_read = -1UL;
+
+	return 0;
+}
+
 static struct ums ums_dev = {
 	.read_sector = ums_read_sector,
 	.write_sector = ums_write_sector,
+	.flush = ums_flush,
 	.name = "UMS disk",
 };
 
@@ -59,6 +304,10 @@ struct ums *ums_init(const char *devtype, const char *devnum)
 	printf("UMS: disk start sector: %#x, count: %#x\n",
 	       ums_dev.start_sector, ums_dev.num_sectors);
 
+	/* The cache only helps speed, so carry on without it */
+	if (ums_cache_init())
+		printf("UMS: no memory for cache, running uncached\n");
+
 	return &ums_dev;
 }
 
@@ -93,18 +342,21 @@ int do_usb_mass_storage(cmd_tbl_t *cmdtp, int flag,
 				usb_controller,	NULL, 0));
 	if (board_usb_init(controller_index, USB_INIT_DEVICE)) {
 		error("Couldn't init USB controller.");
+		ums_cache_free();
 		return CMD_RET_FAILURE;
 	}
 
 	rc = fsg_init(ums);
 	if (rc) {
 		error("fsg_init failed");
+		ums_cache_free();
 		return CMD_RET_FAILURE;
 	}
 
 	rc = g_dnl_register("usb_dnl_ums");
 	if (rc) {
 		error("g_dnl_register failed");
+		ums_cache_free();
 		return CMD_RET_FAILURE;
 	}
 
@@ -153,6 +405,9 @@ int do_usb_mass_storage(cmd_tbl_t *cmdtp, int flag,
 		}
 	}
 exit:
+	if (ums_flush(ums))
+		puts("UMS: Failed to write back cached data\n");
+	ums_cache_free();
 	g_dnl_unregister();
 	board_usb_cleanup(controller_index, USB_INIT_DEVICE);
 	return CMD_RET_SUCCESS;
@@ -11,6 +11,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <initcall.h>
 #include <linux/ctype.h>
 
 /*
@@ -527,6 +528,8 @@ enum command_ret_t cmd_process(int flag, int argc, char * const argv[],
 
 	/* If OK so far, then do the command */
 	if (!rc) {
+		/* It may need a device whose init was put off until now */
+		initcall_defer_finish_all();
 		if (ticks)
 			*ticks = get_timer(0);
 		rc = cmd_call(cmdtp, flag, argc, argv);
@@ -23,8 +23,25 @@ DECLARE_GLOBAL_DATA_PTR;
  */
 #include <env_default.h>
 
+#ifdef CONFIG_ENV_LOG
+/* Check a change, and note the variable so that saveenv can write it */
+static int env_change_ok(const ENTRY *item, const char *newval,
+			 enum env_op op, int flag)
+{
+	int ret;
+
+	ret = env_flags_validate(item, newval, op, flag);
+	if (!ret)
+		env_log_changed(item->key);
+
+	return ret;
+}
+#else
+#define env_change_ok	env_flags_validate
+#endif
+
 struct hsearch_data env_htab = {
-	.change_ok = env_flags_validate,
+	.change_ok = env_change_ok,
 };
 
 __weak uchar env_get_char_spec(int index)
@@ -123,6 +140,7 @@ void set_default_env(const char *s)
 		error("Environment import failed: errno = %d\n", errno);
 
 	gd->flags |= GD_FLG_ENV_READY;
+	env_log_changed_all();
 }
 
 
@@ -215,6 +233,7 @@ int env_import(const char *buf, int check)
 	if (himport_r(&env_htab, (char *)ep->data, ENV_SIZE, '\0', 0, 0,
 			0, NULL)) {
 		gd->flags |= GD_FLG_ENV_READY;
+		env_log_changed_all();
 		return 1;
 	}
 
@@ -0,0 +1,209 @@
+/*
+ * Log-structured environment storage
+ *
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <environment.h>
+#include <errno.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Variables changed since the environment was last saved or loaded */
+static char *changed[ENV_LOG_MAX_CHANGED];
+static int changed_count;
+static bool changed_all;
+
+void env_log_clear(void)
+{
+	while (changed_count)
+		free(changed[--changed_count]);
+	changed_all = false;
+}
+
+void env_log_changed_all(void)
+{
+	env_log_clear();
+	changed_all = true;
+}
+
+void env_log_changed(const char *name)
+{
+	int i;
+
+	if (changed_all)
+		return;
+	for (i = 0; i < changed_count; i++) {
+		if (!strcmp(changed[i], name))
+			return;
+	}
+
+	/* If a lot has changed, it is as well to save everything */
+	if (changed_count == ENV_LOG_MAX_CHANGED) {
+		env_log_changed_all();
+		return;
+	}
+	changed[changed_count] = strdup(name);
+	if (changed[changed_count])
+		changed_count++;
+	else
+		env_log_changed_all();
+}
+
+static uint32_t env_log_crc(uint32_t len, const void *data)
+{
+	uint32_t crc;
+
+	crc = crc32(0, (const uchar *)&len, sizeof(len));
+
+	return crc32(crc, data, len);
+}
+
+int env_log_scan(const void *buf, int size, uint32_t *genp, int *freep)
+{
+	const struct env_log_header *hdr = buf;
+	const struct env_log_chunk *chunk;
+	const uchar *p, *buf_end = buf + size;
+	int offset;
+
+	if (size < sizeof(*hdr) || hdr->magic != ENV_LOG_MAGIC)
+		return -EINVAL;
+
+	for (offset = sizeof(*hdr); offset + sizeof(*chunk) <= size;
+	     offset += ENV_LOG_CHUNK_SIZE(chunk->len)) {
+		chunk = buf + offset;
+		if (chunk->len > size - offset - sizeof(*chunk) ||
+		    env_log_crc(chunk->len, chunk + 1) != chunk->crc)
+			break;
+	}
+
+	/* The first chunk holds the whole environment, so must be there */
+	if (offset == sizeof(*hdr))
+		return -EINVAL;
+	*genp = hdr->gen;
+
+	/*
+	 * A save may have stopped part-way through writing a chunk. The
+	 * log can only be added to if the flash after it is still erased.
+	 */
+	for (p = buf + offset; p < buf_end && *p == 0xff; p++)
+		;
+	*freep = p == buf_end ? offset : size;
+
+	return offset;
+}
+
+int env_log_find(void *const bufs[], int count, int size, int *endp,
+		 uint32_t *genp, int *freep)
+{
+	int copy, end, free_ofs, best = -ENOENT;
+	uint32_t gen;
+
+	for (copy = 0; copy < count; copy++) {
+		if (!bufs[copy])
+			continue;
+		end = env_log_scan(bufs[copy], size, &gen, &free_ofs);
+		/* The generation number may have wrapped */
+		if (end < 0 || (best >= 0 && (int32_t)(gen - *genp) <= 0))
+			continue;
+		best = copy;
+		*endp = end;
+		*genp = gen;
+		*freep = free_ofs;
+	}
+
+	return best;
+}
+
+int env_log_import(const void *buf, int end)
+{
+	const struct env_log_chunk *chunk;
+	int offset, flag = 0;
+
+	/*
+	 * The first chunk replaces the environment. Later ones replay the
+	 * changes saved after it, which were allowed at the time.
+	 */
+	for (offset = sizeof(struct env_log_header); offset < end;
+	     offset += ENV_LOG_CHUNK_SIZE(chunk->len)) {
+		chunk = buf + offset;
+		if (!himport_r(&env_htab, (const char *)(chunk + 1),
+			       chunk->len, '\0', flag, 0, 0, NULL)) {
+			error("Cannot import environment: errno = %d\n",
+			      errno);
+			return -EINVAL;
+		}
+		flag = H_NOCLEAR | H_FORCE;
+	}
+	gd->flags |= GD_FLG_ENV_READY;
+	env_log_clear();
+
+	return 0;
+}
+
+/* Add a "name=value" entry with escapes, as hexport_r() would */
+static char *env_log_put(char *p, const char *name, const char *value)
+{
+	while (*name)
+		*p++ = *name++;
+	if (value) {
+		*p++ = '=';
+		for (; *value; value++) {
+			if (*value == '\\')
+				*p++ = '\\';
+			*p++ = *value;
+		}
+	}
+	*p++ = '\0';
+
+	return p;
+}
+
+int env_log_build(struct env_log_chunk *chunk, char **datap,
+		  bool *snapshotp)
+{
+	char *data, *p;
+	ENTRY e, *ep[ENV_LOG_MAX_CHANGED];
+	ssize_t len;
+	int i;
+
+	*datap = NULL;
+	if (changed_all)
+		*snapshotp = true;
+
+	if (*snapshotp) {
+		len = hexport_r(&env_htab, '\0', 0, datap, 0, 0, NULL);
+		if (len < 0) {
+			error("Cannot export environment: errno = %d\n",
+			      errno);
+			return -ENOMEM;
+		}
+	} else {
+		/* A variable which no longer exists is saved as its name */
+		for (i = 0, len = 0; i < changed_count; i++) {
+			e.key = changed[i];
+			e.data = NULL;
+			hsearch_r(e, FIND, &ep[i], &env_htab, 0);
+			len += strlen(changed[i]) + 1;
+			if (ep[i])
+				len += 2 * strlen(ep[i]->data) + 1;
+		}
+		data = malloc(len + 1);
+		if (!data)
+			return -ENOMEM;
+		for (i = 0, p = data; i < changed_count; i++)
+			p = env_log_put(p, changed[i],
+					ep[i] ? ep[i]->data : NULL);
+		len = p - data;
+		*datap = data;
+	}
+
+	chunk->len = len;
+	chunk->crc = env_log_crc(len, *datap);
+
+	return 0;
+}
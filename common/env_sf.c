@@ -30,13 +30,13 @@
 # define CONFIG_ENV_SPI_MODE	SPI_MODE_3
 #endif
 
-#ifdef CONFIG_ENV_OFFSET_REDUND
+#if defined(CONFIG_ENV_OFFSET_REDUND) && !defined(CONFIG_ENV_LOG)
 static ulong env_offset		= CONFIG_ENV_OFFSET;
 static ulong env_new_offset	= CONFIG_ENV_OFFSET_REDUND;
 
 #define ACTIVE_FLAG	1
 #define OBSOLETE_FLAG	0
-#endif /* CONFIG_ENV_OFFSET_REDUND */
+#endif /* CONFIG_ENV_OFFSET_REDUND && !CONFIG_ENV_LOG */
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -44,7 +44,176 @@ char *env_name_spec = "SPI Flash";
 
 static struct spi_flash *env_flash;
 
-#if defined(CONFIG_ENV_OFFSET_REDUND)
+#if defined(CONFIG_ENV_LOG)
+#if CONFIG_ENV_SIZE % CONFIG_ENV_SECT_SIZE
+#error "CONFIG_ENV_LOG needs CONFIG_ENV_SIZE to be a multiple of the sector size"
+#endif
+
+/* Offsets of the copies of the log; gd->env_valid is the one in use */
+static const ulong env_log_offset[] = {
+	CONFIG_ENV_OFFSET,
+#ifdef CONFIG_ENV_OFFSET_REDUND
+	CONFIG_ENV_OFFSET_REDUND,
+#endif
+};
+
+/* Generation of the log in use, and where to add to it (0 if none) */
+static uint32_t env_log_gen;
+static int env_log_free;
+
+/* Write a chunk, and the header too if rewriting the log */
+static int env_log_write(ulong offset, const struct env_log_chunk *chunk,
+			 const char *data, bool rewrite)
+{
+	struct env_log_header hdr;
+	int ret;
+
+	if (rewrite) {
+		puts("Erasing SPI flash...");
+		ret = spi_flash_erase(env_flash, offset, CONFIG_ENV_SIZE);
+		if (ret)
+			return ret;
+		offset += sizeof(hdr);
+	}
+
+	puts("Writing to SPI flash...");
+	ret = spi_flash_write(env_flash, offset, sizeof(*chunk), chunk);
+	if (!ret)
+		ret = spi_flash_write(env_flash, offset + sizeof(*chunk),
+				      chunk->len, data);
+	if (ret || !rewrite)
+		return ret;
+
+	/* The log is only valid once the whole environment is written */
+	hdr.magic = ENV_LOG_MAGIC;
+	hdr.gen = env_log_gen + 1;
+
+	return spi_flash_write(env_flash, offset - sizeof(hdr), sizeof(hdr),
+			       &hdr);
+}
+
+int saveenv(void)
+{
+	struct env_log_chunk chunk;
+	bool snapshot = !env_log_free;
+	char *data;
+	int copy, size, ret;
+
+	if (!env_flash) {
+		env_flash = spi_flash_probe(CONFIG_ENV_SPI_BUS,
+			CONFIG_ENV_SPI_CS,
+			CONFIG_ENV_SPI_MAX_HZ, CONFIG_ENV_SPI_MODE);
+		if (!env_flash) {
+			set_default_env("!spi_flash_probe() failed");
+			return 1;
+		}
+	}
+
+	ret = env_log_build(&chunk, &data, &snapshot);
+	if (ret)
+		return 1;
+	if (!chunk.len) {
+		puts("Environment unchanged\n");
+		goto done;
+	}
+
+	/* When the log is full, start again with the whole environment */
+	size = ENV_LOG_CHUNK_SIZE(chunk.len);
+	if (!snapshot && env_log_free + size > CONFIG_ENV_SIZE) {
+		free(data);
+		snapshot = true;
+		ret = env_log_build(&chunk, &data, &snapshot);
+		if (ret)
+			return 1;
+		size = ENV_LOG_CHUNK_SIZE(chunk.len);
+	}
+	if (sizeof(struct env_log_header) + size > CONFIG_ENV_SIZE) {
+		printf("Environment too large: %d bytes\n", size);
+		ret = -ENOSPC;
+		goto done;
+	}
+
+	copy = gd->env_valid > 1 ? gd->env_valid - 1 : 0;
+	if (!snapshot) {
+		ret = env_log_write(env_log_offset[copy] + env_log_free,
+				    &chunk, data, false);
+		if (ret) {
+			/* The chunk may be half-written, so start again */
+			env_log_free = 0;
+			goto done;
+		}
+		env_log_free += size;
+	} else {
+		/* Rewrite the log in the other copy, if there is one */
+		copy = (copy + 1) % ARRAY_SIZE(env_log_offset);
+		ret = env_log_write(env_log_offset[copy], &chunk, data, true);
+		if (ret) {
+			env_log_free = 0;
+			goto done;
+		}
+		env_log_gen++;
+		env_log_free = sizeof(struct env_log_header) + size;
+		gd->env_valid = copy + 1;
+	}
+	env_log_clear();
+
+	puts("done\n");
+#ifdef CONFIG_ENV_OFFSET_REDUND
+	printf("Valid environment: %d\n", (int)gd->env_valid);
+#endif
+
+done:
+	free(data);
+
+	return ret ? 1 : 0;
+}
+
+void env_relocate_spec(void)
+{
+	char *buf[ARRAY_SIZE(env_log_offset)] = { NULL };
+	void *log[ARRAY_SIZE(env_log_offset)] = { NULL };
+	int copy, end, best;
+
+	env_flash = spi_flash_probe(CONFIG_ENV_SPI_BUS, CONFIG_ENV_SPI_CS,
+			CONFIG_ENV_SPI_MAX_HZ, CONFIG_ENV_SPI_MODE);
+	if (!env_flash) {
+		set_default_env("!spi_flash_probe() failed");
+		return;
+	}
+
+	/* Use the copy with the latest generation */
+	for (copy = 0; copy < ARRAY_SIZE(env_log_offset); copy++) {
+		buf[copy] = malloc(CONFIG_ENV_SIZE);
+		if (buf[copy] &&
+		    !spi_flash_read(env_flash, env_log_offset[copy],
+				    CONFIG_ENV_SIZE, buf[copy]))
+			log[copy] = buf[copy];
+	}
+	best = env_log_find(log, ARRAY_SIZE(log), CONFIG_ENV_SIZE, &end,
+			    &env_log_gen, &env_log_free);
+
+	if (best >= 0) {
+		if (!env_log_import(buf[best], end)) {
+			gd->env_valid = best + 1;
+		} else {
+			set_default_env("!import failed");
+			env_log_free = 0;
+		}
+	} else {
+		/* This may be an environment saved before the log was used */
+		env_log_free = 0;
+		if (buf[0])
+			env_import(buf[0], 1);
+		else
+			set_default_env("!malloc() failed");
+	}
+
+	spi_flash_free(env_flash);
+	env_flash = NULL;
+	for (copy = 0; copy < ARRAY_SIZE(env_log_offset); copy++)
+		free(buf[copy]);
+}
+#elif defined(CONFIG_ENV_OFFSET_REDUND)
 int saveenv(void)
 {
 	env_t	env_new;
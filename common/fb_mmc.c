@@ -7,9 +7,11 @@
 #include <config.h>
 #include <common.h>
 #include <fb_mmc.h>
+#include <fs.h>
 #include <part.h>
 #include <aboot.h>
 #include <sparse_format.h>
+#include <malloc.h>
 #include <mmc.h>
 
 #ifndef CONFIG_FASTBOOT_GPT_NAME
@@ -19,6 +21,58 @@
 /* The 64 defined bytes plus the '\0' */
 #define RESPONSE_LEN	(64 + 1)
 
+/* Most blocks of a sparse fill chunk to write with each command */
+#define FB_MMC_FILL_BLKS	128
+
+enum fb_mmc_stream_state {
+	FB_MMC_STREAM_IDLE,	/* not writing the current download */
+	FB_MMC_STREAM_ACTIVE,	/* writing the download as it arrives */
+	FB_MMC_STREAM_DONE,	/* written, waiting for the flash command */
+};
+
+/**
+ * struct fb_mmc_stream - a download being written to flash as it arrives
+ *
+ * @part_name:	Partition selected with 'oem stream' for the next download,
+ *		or "" if none
+ * @state:	What is happening to the current download
+ * @mmc:	MMC device being written
+ * @info:	Partition being written
+ * @buf:	Download buffer
+ * @size:	Size of the download in bytes
+ * @done:	Number of bytes of the download dealt with so far
+ * @blk:	Next block to write
+ * @started:	true once the start of the image has been looked at
+ * @raw_left:	Bytes of data to write before the next sparse chunk header,
+ *		or before the end of a raw image
+ * @sparse:	Sparse image header, NULL for a raw image or if it has not
+ *		arrived yet
+ * @chunks_left: Number of sparse chunks not yet started
+ * @total_blocks: Number of sparse image blocks dealt with so far
+ * @bytes_written: Number of bytes written to the partition
+ * @fill_buf:	Buffer holding the value of a sparse fill chunk, kept for
+ *		the next download
+ * @fail:	Reason the write failed, or NULL if all is well so far
+ */
+static struct fb_mmc_stream {
+	char part_name[sizeof(((disk_partition_t *)0)->name) + 1];
+	enum fb_mmc_stream_state state;
+	struct mmc *mmc;
+	disk_partition_t info;
+	void *buf;
+	unsigned int size;
+	unsigned int done;
+	lbaint_t blk;
+	bool started;
+	unsigned int raw_left;
+	const sparse_header_t *sparse;
+	unsigned int chunks_left;
+	uint32_t total_blocks;
+	uint32_t bytes_written;
+	uint32_t *fill_buf;
+	const char *fail;
+} stream;
+
 static char *response_str;
 
 void fastboot_fail(const char *s)
@@ -92,16 +146,36 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 {
 	block_dev_desc_t *dev_desc;
 	disk_partition_t info;
+	bool match;
 
 	/* initialize the response buffer */
 	response_str = response;
 
+	/* If the download was written as it arrived, just say how it went */
+	if (stream.state == FB_MMC_STREAM_DONE) {
+		stream.state = FB_MMC_STREAM_IDLE;
+		match = !strcmp(cmd, stream.part_name);
+		*stream.part_name = '\0';
+		if (match) {
+			if (stream.fail) {
+				fastboot_fail(stream.fail);
+			} else {
+				printf("........ wrote %u bytes to '%s'\n",
+				       stream.bytes_written, cmd);
+				fastboot_okay("");
+			}
+			return;
+		}
+	}
+
 	dev_desc = get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
 	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
 		error("invalid mmc device\n");
 		fastboot_fail("invalid mmc device");
 		return;
 	}
+	/* Anything mounted from the device is about to be out of date */
+	fs_invalidate(dev_desc);
 
 	if (strcmp(cmd, CONFIG_FASTBOOT_GPT_NAME) == 0) {
 		printf("%s: updating MBR, Primary and Backup GPT(s)\n",
@@ -157,6 +231,7 @@ void fb_mmc_erase(const char *cmd, char *response)
 		fastboot_fail("invalid mmc device");
 		return;
 	}
+	fs_invalidate(dev_desc);
 
 	ret = get_partition_info_efi_by_name_or_alias(dev_desc, cmd, &info);
 	if (ret) {
@@ -188,3 +263,260 @@ void fb_mmc_erase(const char *cmd, char *response)
 	       blks_size * info.blksz, cmd);
 	fastboot_okay("");
 }
+
+void fb_mmc_stream_select(const char *part)
+{
+	while (*part == ' ')
+		part++;
+	strlcpy(stream.part_name, part, sizeof(stream.part_name));
+	stream.state = FB_MMC_STREAM_IDLE;
+	if (*stream.part_name)
+		printf("Downloads will be written to '%s' as they arrive\n",
+		       stream.part_name);
+}
+
+static void fb_mmc_stream_fail(const char *s)
+{
+	if (!stream.fail) {
+		error("%s\n", s);
+		stream.fail = s;
+	}
+}
+
+static void fb_mmc_stream_open(void *download_buffer,
+			       unsigned int download_size)
+{
+	block_dev_desc_t *dev_desc;
+
+	if (!*stream.part_name ||
+	    !strcmp(stream.part_name, CONFIG_FASTBOOT_GPT_NAME))
+		return;
+
+	/* If anything is wrong, leave it to the flash command to report */
+	stream.mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	dev_desc = get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (!stream.mmc || !dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN)
+		return;
+	if (get_partition_info_efi_by_name_or_alias(dev_desc, stream.part_name,
+						    &stream.info))
+		return;
+	if (!stream.fill_buf)
+		stream.fill_buf = memalign(ARCH_DMA_MINALIGN, FB_MMC_FILL_BLKS *
+					   stream.info.blksz);
+	if (!stream.fill_buf)
+		return;
+	fs_invalidate(dev_desc);
+
+	stream.buf = download_buffer;
+	stream.size = download_size;
+	stream.done = 0;
+	stream.blk = stream.info.start;
+	stream.started = false;
+	stream.raw_left = 0;
+	stream.sparse = NULL;
+	stream.chunks_left = 0;
+	stream.total_blocks = 0;
+	stream.bytes_written = 0;
+	stream.fail = NULL;
+	stream.state = FB_MMC_STREAM_ACTIVE;
+}
+
+void fb_mmc_stream_start(void *download_buffer, unsigned int download_size)
+{
+	/*
+	 * The selection only covers one download. It is kept until the next
+	 * flash command, which needs it, unless the previous download used it
+	 * up without one, or this download cannot be written as it arrives.
+	 */
+	if (stream.state != FB_MMC_STREAM_IDLE)
+		*stream.part_name = '\0';
+	stream.state = FB_MMC_STREAM_IDLE;
+	fb_mmc_stream_open(download_buffer, download_size);
+	if (stream.state != FB_MMC_STREAM_ACTIVE)
+		*stream.part_name = '\0';
+}
+
+/* Start writing some blocks, leaving them in progress */
+static void fb_mmc_stream_write(const void *src, lbaint_t blkcnt)
+{
+	if (stream.blk + blkcnt > stream.info.start + stream.info.size) {
+		fb_mmc_stream_fail("Request would exceed partition size!");
+		return;
+	}
+	if (mmc_bwrite_start(stream.mmc, stream.blk, blkcnt, src) != blkcnt) {
+		fb_mmc_stream_fail("flash write failure");
+		return;
+	}
+	stream.blk += blkcnt;
+	stream.bytes_written += blkcnt * stream.info.blksz;
+}
+
+static void fb_mmc_stream_fill(uint32_t fill_val, lbaint_t blkcnt)
+{
+	lbaint_t cur;
+	int i;
+
+	/* The buffer may still be in use by the last fill chunk */
+	if (mmc_bxfer_wait(stream.mmc)) {
+		fb_mmc_stream_fail("flash write failure");
+		return;
+	}
+	for (i = 0; i < FB_MMC_FILL_BLKS * stream.info.blksz / sizeof(fill_val);
+	     i++)
+		stream.fill_buf[i] = fill_val;
+	while (blkcnt && !stream.fail) {
+		cur = min_t(lbaint_t, blkcnt, FB_MMC_FILL_BLKS);
+		fb_mmc_stream_write(stream.fill_buf, cur);
+		blkcnt -= cur;
+	}
+}
+
+/* Look at the start of the image, once enough of it has arrived */
+static bool fb_mmc_stream_header(unsigned int avail)
+{
+	const sparse_header_t *sparse = stream.buf;
+	lbaint_t blkcnt;
+
+	if (avail < sizeof(*sparse) && avail < stream.size)
+		return false;
+	if (avail >= sizeof(*sparse) && is_sparse_image(stream.buf)) {
+		if (avail < sparse->file_hdr_sz)
+			return false;
+		if (sparse->blk_sz != (sparse->blk_sz &
+				       ~(stream.info.blksz - 1))) {
+			fb_mmc_stream_fail("sparse image block size issue");
+			return false;
+		}
+		puts("Flashing Sparse Image\n");
+		stream.sparse = sparse;
+		stream.chunks_left = sparse->total_chunks;
+		stream.done = sparse->file_hdr_sz;
+	} else {
+		blkcnt = DIV_ROUND_UP(stream.size, stream.info.blksz);
+		if (blkcnt > stream.info.size) {
+			fb_mmc_stream_fail("too large for partition");
+			return false;
+		}
+		puts("Flashing Raw Image\n");
+		stream.raw_left = stream.size;
+	}
+	stream.started = true;
+
+	return true;
+}
+
+/* Deal with the next sparse chunk, returning false if it has not arrived */
+static bool fb_mmc_stream_chunk(unsigned int avail)
+{
+	const sparse_header_t *sparse = stream.sparse;
+	const chunk_header_t *chunk = stream.buf + stream.done;
+	unsigned int left = avail - stream.done;
+	unsigned int chunk_data_sz;
+	lbaint_t blkcnt;
+
+	if (left < sparse->chunk_hdr_sz)
+		return false;
+	if (chunk->total_sz < sparse->chunk_hdr_sz) {
+		fb_mmc_stream_fail("Bogus chunk size");
+		return false;
+	}
+
+	chunk_data_sz = sparse->blk_sz * chunk->chunk_sz;
+	blkcnt = chunk_data_sz / stream.info.blksz;
+	switch (chunk->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk->total_sz != sparse->chunk_hdr_sz + chunk_data_sz) {
+			fb_mmc_stream_fail(
+				"Bogus chunk size for chunk type Raw");
+			return false;
+		}
+		/* The data is written as it arrives */
+		stream.raw_left = chunk_data_sz;
+		stream.done += sparse->chunk_hdr_sz;
+		break;
+	case CHUNK_TYPE_FILL:
+		if (chunk->total_sz !=
+		    sparse->chunk_hdr_sz + sizeof(uint32_t)) {
+			fb_mmc_stream_fail(
+				"Bogus chunk size for chunk type FILL");
+			return false;
+		}
+		if (left < chunk->total_sz)
+			return false;
+		fb_mmc_stream_fill(*(uint32_t *)((void *)chunk +
+						 sparse->chunk_hdr_sz), blkcnt);
+		stream.done += chunk->total_sz;
+		break;
+	case CHUNK_TYPE_DONT_CARE:
+		if (stream.blk + blkcnt > stream.info.start + stream.info.size) {
+			fb_mmc_stream_fail(
+				"Request would exceed partition size!");
+			return false;
+		}
+		stream.blk += blkcnt;
+		stream.done += chunk->total_sz;
+		break;
+	case CHUNK_TYPE_CRC32:
+		if (left < chunk->total_sz)
+			return false;
+		stream.done += chunk->total_sz;
+		break;
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk->chunk_type);
+		fb_mmc_stream_fail("Unknown chunk type");
+		return false;
+	}
+	stream.total_blocks += chunk->chunk_sz;
+	stream.chunks_left--;
+
+	return !stream.fail;
+}
+
+void fb_mmc_stream_data(unsigned int download_bytes)
+{
+	lbaint_t blkcnt;
+
+	if (stream.state != FB_MMC_STREAM_ACTIVE || stream.fail)
+		return;
+	if (!stream.started && !fb_mmc_stream_header(download_bytes))
+		return;
+
+	while (!stream.fail) {
+		if (stream.raw_left) {
+			/* Write whichever whole blocks have arrived */
+			blkcnt = min(download_bytes - stream.done,
+				     stream.raw_left) / stream.info.blksz;
+			if (!blkcnt)
+				break;
+			fb_mmc_stream_write(stream.buf + stream.done, blkcnt);
+			stream.done += blkcnt * stream.info.blksz;
+			stream.raw_left -= blkcnt * stream.info.blksz;
+		} else if (!stream.sparse || !stream.chunks_left ||
+			   !fb_mmc_stream_chunk(download_bytes)) {
+			break;
+		}
+	}
+}
+
+void fb_mmc_stream_end(unsigned int download_bytes)
+{
+	if (stream.state != FB_MMC_STREAM_ACTIVE)
+		return;
+
+	fb_mmc_stream_data(download_bytes);
+
+	/* A raw image need not end on a block boundary */
+	if (!stream.fail && !stream.sparse && stream.raw_left) {
+		fb_mmc_stream_write(stream.buf + stream.done, 1);
+		stream.raw_left = 0;
+	}
+	if (mmc_bxfer_wait(stream.mmc))
+		fb_mmc_stream_fail("flash write failure");
+	if (!stream.fail && stream.sparse &&
+	    (stream.chunks_left ||
+	     stream.total_blocks != stream.sparse->total_blks))
+		fb_mmc_stream_fail("sparse image write failure");
+
+	stream.state = FB_MMC_STREAM_DONE;
+}
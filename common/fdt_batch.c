@@ -0,0 +1,432 @@
+/*
+ * Batched changes to a device tree
+ *
+ * Each fdt_setprop() which changes the size of a property moves the rest of
+ * the tree, so making many changes to a large tree is slow. A batch collects
+ * property changes and then writes the whole structure block once, which
+ * also packs out any NOPs.
+ *
+ * Changes are recorded against the offset of their node. libfdt tells the
+ * started batch when it moves part of the tree, so that batch can be built
+ * up while the tree is changed in other ways.
+ *
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <fdt_batch.h>
+#include <fdt_index.h>
+#include <libfdt.h>
+#include <malloc.h>
+
+/* Length of a change which deletes the property */
+#define FDT_BATCH_DELETE	(-1)
+
+/* Batch which the fixup helpers add to, see fdt_batch_start() */
+static struct fdt_batch *fdt_batch_active;
+
+/**
+ * struct fdt_batch_op - A property change waiting to be applied
+ *
+ * @node:	Offset of node, or -1 if the node has been deleted
+ * @seq:	Order in which the change was queued
+ * @len:	Length of new value, or FDT_BATCH_DELETE
+ * @done:	true once the change has been written to the new tree
+ * @name:	Name of property
+ * @val:	New value of property
+ */
+struct fdt_batch_op {
+	int node;
+	int seq;
+	int len;
+	bool done;
+	char *name;
+	void *val;
+};
+
+void fdt_batch_init(struct fdt_batch *batch)
+{
+	memset(batch, '\0', sizeof(*batch));
+}
+
+void fdt_batch_free(struct fdt_batch *batch)
+{
+	int i;
+
+	for (i = 0; i < batch->count; i++)
+		free(batch->op[i].name);
+	free(batch->op);
+	if (fdt_batch_active == batch)
+		fdt_batch_active = NULL;
+	fdt_batch_init(batch);
+}
+
+void fdt_batch_start(struct fdt_batch *batch, void *fdt)
+{
+	fdt_batch_init(batch);
+	batch->fdt = fdt;
+	fdt_batch_active = batch;
+}
+
+struct fdt_batch *fdt_batch_get(const void *fdt)
+{
+	struct fdt_batch *batch = fdt_batch_active;
+
+	return batch && batch->fdt == fdt ? batch : NULL;
+}
+
+static int fdt_batch_add(struct fdt_batch *batch, const void *fdt,
+			 int nodeoffset, const char *name, const void *val,
+			 int len)
+{
+	struct fdt_batch_op *op;
+	int namelen = strlen(name) + 1;
+	int next;
+
+	if (nodeoffset < 0 || nodeoffset % FDT_TAGSIZE ||
+	    fdt_next_tag(fdt, nodeoffset, &next) != FDT_BEGIN_NODE)
+		return -FDT_ERR_BADOFFSET;
+	if (batch->count == batch->max) {
+		op = realloc(batch->op, (batch->max * 2 + 16) * sizeof(*op));
+		if (!op)
+			return -FDT_ERR_NOSPACE;
+		batch->op = op;
+		batch->max = batch->max * 2 + 16;
+	}
+
+	/* The name and value share an allocation */
+	op = &batch->op[batch->count];
+	op->name = malloc(namelen + max(len, 0));
+	if (!op->name)
+		return -FDT_ERR_NOSPACE;
+	memcpy(op->name, name, namelen);
+	op->val = op->name + namelen;
+	if (len > 0)
+		memcpy(op->val, val, len);
+	op->node = nodeoffset;
+	op->seq = batch->count++;
+	op->len = len;
+	op->done = false;
+
+	return 0;
+}
+
+int fdt_batch_setprop(struct fdt_batch *batch, const void *fdt,
+		      int nodeoffset, const char *name, const void *val,
+		      int len)
+{
+	if (len < 0)
+		return -FDT_ERR_BADSTRUCTURE;
+
+	return fdt_batch_add(batch, fdt, nodeoffset, name, val, len);
+}
+
+int fdt_batch_delprop(struct fdt_batch *batch, const void *fdt,
+		      int nodeoffset, const char *name)
+{
+	return fdt_batch_add(batch, fdt, nodeoffset, name, NULL,
+			     FDT_BATCH_DELETE);
+}
+
+void fdt_batch_splice(const void *fdt, int offset, int oldlen, int newlen)
+{
+	struct fdt_batch *batch = fdt_batch_get(fdt);
+	struct fdt_batch_op *op;
+	int i;
+
+	if (!batch)
+		return;
+	for (i = 0, op = batch->op; i < batch->count; i++, op++) {
+		if (op->node < offset)
+			continue;
+		if (op->node < offset + oldlen)
+			op->node = -1;
+		else
+			op->node += newlen - oldlen;
+	}
+}
+
+/*
+ * Drop the changes to nodes which have been deleted, as they would have
+ * gone with the node
+ */
+static void fdt_batch_drop_deleted(struct fdt_batch *batch)
+{
+	struct fdt_batch_op *op;
+	int i, count = 0;
+
+	for (i = 0, op = batch->op; i < batch->count; i++, op++) {
+		if (op->node < 0) {
+			debug("%s: dropping %s\n", __func__, op->name);
+			free(op->name);
+			continue;
+		}
+		batch->op[count++] = *op;
+	}
+	batch->count = count;
+}
+
+/* Move the changes in a batch to the end of another */
+static int fdt_batch_move(struct fdt_batch *to, struct fdt_batch *from)
+{
+	struct fdt_batch_op *op;
+	int i;
+
+	if (to->count + from->count > to->max) {
+		op = realloc(to->op, (to->count + from->count) * sizeof(*op));
+		if (!op)
+			return -FDT_ERR_NOSPACE;
+		to->op = op;
+		to->max = to->count + from->count;
+	}
+	for (i = 0; i < from->count; i++) {
+		op = &to->op[to->count];
+		*op = from->op[i];
+		op->seq = to->count++;
+	}
+	from->count = 0;
+
+	return 0;
+}
+
+static int fdt_batch_op_cmp(const void *a, const void *b)
+{
+	const struct fdt_batch_op *opa = a, *opb = b;
+
+	if (opa->node != opb->node)
+		return opa->node - opb->node;
+
+	return opa->seq - opb->seq;
+}
+
+/* State while writing the new structure and strings blocks */
+struct fdt_batch_state {
+	const void *fdt;
+	char *struct_buf;
+	int struct_size;
+	char *strings;
+	int strings_size;
+};
+
+static int fdt_batch_string(struct fdt_batch_state *st, const char *name)
+{
+	const char *p, *end = st->strings + st->strings_size;
+	int len = strlen(name) + 1;
+
+	for (p = st->strings; p < end; p += strlen(p) + 1) {
+		if (!strcmp(p, name))
+			return p - st->strings;
+	}
+	memcpy(st->strings + st->strings_size, name, len);
+	st->strings_size += len;
+
+	return st->strings_size - len;
+}
+
+static void fdt_batch_copy(struct fdt_batch_state *st, int offset, int len)
+{
+	memcpy(st->struct_buf + st->struct_size,
+	       fdt_offset_ptr(st->fdt, offset, len), len);
+	st->struct_size += len;
+}
+
+static void fdt_batch_put_prop(struct fdt_batch_state *st, int nameoff,
+			       const struct fdt_batch_op *op)
+{
+	struct fdt_property *prop;
+	int size = ALIGN(op->len, FDT_TAGSIZE);
+
+	prop = (struct fdt_property *)(st->struct_buf + st->struct_size);
+	prop->tag = cpu_to_fdt32(FDT_PROP);
+	prop->len = cpu_to_fdt32(op->len);
+	prop->nameoff = cpu_to_fdt32(nameoff);
+	memcpy(prop->data, op->val, op->len);
+	memset(prop->data + op->len, '\0', size - op->len);
+	st->struct_size += sizeof(*prop) + size;
+}
+
+/*
+ * Find the last change to a property in a node's changes, and mark all its
+ * changes as done
+ */
+static struct fdt_batch_op *fdt_batch_find(struct fdt_batch_op *op,
+					   int count, const char *name)
+{
+	struct fdt_batch_op *last = NULL;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!op[i].done && !strcmp(op[i].name, name)) {
+			op[i].done = true;
+			last = &op[i];
+		}
+	}
+
+	return last;
+}
+
+/* Add the new properties for a node, after its existing ones */
+static void fdt_batch_add_props(struct fdt_batch_state *st,
+				struct fdt_batch_op *op, int count)
+{
+	struct fdt_batch_op *last;
+	int i, nameoff;
+
+	for (i = 0; i < count; i++) {
+		if (op[i].done)
+			continue;
+		last = fdt_batch_find(op, count, op[i].name);
+		if (last->len == FDT_BATCH_DELETE)
+			continue;
+		nameoff = fdt_batch_string(st, last->name);
+		fdt_batch_put_prop(st, nameoff, last);
+	}
+}
+
+/* Write the new structure block, returning 0 or -FDT_ERR_... */
+static int fdt_batch_build(struct fdt_batch *batch,
+			   struct fdt_batch_state *st)
+{
+	const void *fdt = st->fdt;
+	const struct fdt_property *prop;
+	struct fdt_batch_op *op = batch->op, *node_op = NULL, *last;
+	struct fdt_batch_op *end = op + batch->count;
+	int offset, next, node_count = 0;
+	uint32_t tag;
+
+	offset = 0;
+	do {
+		tag = fdt_next_tag(fdt, offset, &next);
+		if (next < 0)
+			return next;
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			if (node_op)
+				fdt_batch_add_props(st, node_op, node_count);
+			/* Any changes left before here are not at a node */
+			if (op != end && op->node < offset)
+				return -FDT_ERR_BADOFFSET;
+			node_op = op;
+			while (op != end && op->node == offset)
+				op++;
+			node_count = op - node_op;
+			fdt_batch_copy(st, offset, next - offset);
+			break;
+		case FDT_END_NODE:
+			if (node_op)
+				fdt_batch_add_props(st, node_op, node_count);
+			node_op = NULL;
+			fdt_batch_copy(st, offset, next - offset);
+			break;
+		case FDT_PROP:
+			prop = fdt_get_property_by_offset(fdt, offset, NULL);
+			last = !node_op ? NULL : fdt_batch_find(node_op,
+					node_count, fdt_string(fdt,
+						fdt32_to_cpu(prop->nameoff)));
+			if (!last)
+				fdt_batch_copy(st, offset, next - offset);
+			else if (last->len != FDT_BATCH_DELETE)
+				fdt_batch_put_prop(st,
+					fdt32_to_cpu(prop->nameoff), last);
+			break;
+		case FDT_NOP:
+			break;
+		case FDT_END:
+			fdt_batch_copy(st, offset, next - offset);
+			break;
+		default:
+			return -FDT_ERR_BADSTRUCTURE;
+		}
+		offset = next;
+	} while (tag != FDT_END);
+
+	return op == end ? 0 : -FDT_ERR_BADOFFSET;
+}
+
+int fdt_batch_apply(struct fdt_batch *batch, void *fdt)
+{
+	struct fdt_batch *started = fdt_batch_get(fdt);
+	struct fdt_batch_state st;
+	int struct_extra = 0, strings_extra = 0;
+	int rsv_offset, rsv_size, needed;
+	char *buf;
+	int ret, i;
+
+	/* Rewriting the tree now would lose track of the started batch */
+	if (started && started != batch) {
+		ret = fdt_batch_move(started, batch);
+		goto out;
+	}
+	ret = fdt_check_header(fdt);
+	if (ret)
+		goto out;
+	if (fdt_version(fdt) < 17) {
+		ret = -FDT_ERR_BADVERSION;
+		goto out;
+	}
+	fdt_batch_drop_deleted(batch);
+	if (!batch->count)
+		goto out;
+
+	qsort(batch->op, batch->count, sizeof(*batch->op), fdt_batch_op_cmp);
+	for (i = 0; i < batch->count; i++) {
+		if (batch->op[i].len == FDT_BATCH_DELETE)
+			continue;
+		struct_extra += sizeof(struct fdt_property) +
+			ALIGN(batch->op[i].len, FDT_TAGSIZE);
+		strings_extra += strlen(batch->op[i].name) + 1;
+	}
+
+	buf = malloc(fdt_size_dt_struct(fdt) + struct_extra +
+		     fdt_size_dt_strings(fdt) + strings_extra);
+	if (!buf) {
+		ret = -FDT_ERR_NOSPACE;
+		goto out;
+	}
+	st.fdt = fdt;
+	st.struct_buf = buf;
+	st.struct_size = 0;
+	st.strings = buf + fdt_size_dt_struct(fdt) + struct_extra;
+	st.strings_size = fdt_size_dt_strings(fdt);
+	memcpy(st.strings, (char *)fdt + fdt_off_dt_strings(fdt),
+	       st.strings_size);
+
+	ret = fdt_batch_build(batch, &st);
+	if (ret)
+		goto out_buf;
+
+	/* Lay out the tree as fdt_pack() would, in the space it has now */
+	rsv_offset = ALIGN(sizeof(struct fdt_header), 8);
+	rsv_size = (fdt_num_mem_rsv(fdt) + 1) *
+		sizeof(struct fdt_reserve_entry);
+	needed = rsv_offset + rsv_size + st.struct_size + st.strings_size;
+	if (needed > fdt_totalsize(fdt)) {
+		ret = -FDT_ERR_NOSPACE;
+		goto out_buf;
+	}
+
+	fdt_index_invalidate(fdt);
+	memmove((char *)fdt + rsv_offset,
+		(char *)fdt + fdt_off_mem_rsvmap(fdt), rsv_size);
+	fdt_set_off_mem_rsvmap(fdt, rsv_offset);
+	fdt_set_off_dt_struct(fdt, rsv_offset + rsv_size);
+	fdt_set_size_dt_struct(fdt, st.struct_size);
+	memcpy((char *)fdt + fdt_off_dt_struct(fdt), st.struct_buf,
+	       st.struct_size);
+	fdt_set_off_dt_strings(fdt, rsv_offset + rsv_size + st.struct_size);
+	fdt_set_size_dt_strings(fdt, st.strings_size);
+	memcpy((char *)fdt + fdt_off_dt_strings(fdt), st.strings,
+	       st.strings_size);
+	fdt_set_version(fdt, 17);
+	debug("%s: %d changes, structure block %d bytes\n", __func__,
+	      batch->count, st.struct_size);
+
+out_buf:
+	free(buf);
+out:
+	fdt_batch_free(batch);
+
+	return ret;
+}
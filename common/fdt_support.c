@@ -334,11 +334,27 @@ void do_fixup_by_path_u32(void *fdt, const char *path, const char *prop,
 	do_fixup_by_path(fdt, path, prop, &tmp, sizeof(tmp), create);
 }
 
+/*
+ * Get the batch to queue a fixup's changes in: the one started for the
+ * tree, if any, else 'own', which the caller applies when done
+ */
+static struct fdt_batch *fdt_fixup_batch(void *fdt, struct fdt_batch *own)
+{
+	struct fdt_batch *batch = fdt_batch_get(fdt);
+
+	if (batch)
+		return batch;
+	fdt_batch_init(own);
+
+	return own;
+}
+
 void do_fixup_by_prop(void *fdt,
 		      const char *pname, const void *pval, int plen,
 		      const char *prop, const void *val, int len,
 		      int create)
 {
+	struct fdt_batch own, *batch;
 	int off;
 #if defined(DEBUG)
 	int i;
@@ -347,12 +363,19 @@ void do_fixup_by_prop(void *fdt,
 		debug(" %.2x", *(u8*)(val+i));
 	debug("\n");
 #endif
+	batch = fdt_fixup_batch(fdt, &own);
 	off = fdt_node_offset_by_prop_value(fdt, -1, pname, pval, plen);
 	while (off != -FDT_ERR_NOTFOUND) {
 		if (create || (fdt_get_property(fdt, off, prop, NULL) != NULL))
-			fdt_setprop(fdt, off, prop, val, len);
+			fdt_batch_setprop(batch, fdt, off, prop, val, len);
 		off = fdt_node_offset_by_prop_value(fdt, off, pname, pval, plen);
 	}
+	if (batch != &own)
+		return;
+	off = fdt_batch_apply(batch, fdt);
+	if (off)
+		printf("Unable to update property %s, err=%s\n", prop,
+		       fdt_strerror(off));
 }
 
 void do_fixup_by_prop_u32(void *fdt,
@@ -366,7 +389,8 @@ void do_fixup_by_prop_u32(void *fdt,
 void do_fixup_by_compat(void *fdt, const char *compat,
 			const char *prop, const void *val, int len, int create)
 {
-	int off = -1;
+	struct fdt_batch own, *batch;
+	int off;
 #if defined(DEBUG)
 	int i;
 	debug("Updating property '%s' = ", prop);
@@ -374,12 +398,19 @@ void do_fixup_by_compat(void *fdt, const char *compat,
 		debug(" %.2x", *(u8*)(val+i));
 	debug("\n");
 #endif
+	batch = fdt_fixup_batch(fdt, &own);
 	off = fdt_node_offset_by_compatible(fdt, -1, compat);
 	while (off != -FDT_ERR_NOTFOUND) {
 		if (create || (fdt_get_property(fdt, off, prop, NULL) != NULL))
-			fdt_setprop(fdt, off, prop, val, len);
+			fdt_batch_setprop(batch, fdt, off, prop, val, len);
 		off = fdt_node_offset_by_compatible(fdt, off, compat);
 	}
+	if (batch != &own)
+		return;
+	off = fdt_batch_apply(batch, fdt);
+	if (off)
+		printf("Unable to update property %s:%s, err=%s\n", compat,
+		       prop, fdt_strerror(off));
 }
 
 void do_fixup_by_compat_u32(void *fdt, const char *compat,
@@ -472,7 +503,8 @@ int fdt_fixup_memory(void *blob, u64 start, u64 size)
 
 void fdt_fixup_ethernet(void *fdt)
 {
-	int node, i, j;
+	struct fdt_batch own, *batch;
+	int node, i, j, off, err;
 	char enet[16], *tmp, *end;
 	char mac[16];
 	const char *path;
@@ -493,6 +525,8 @@ void fdt_fixup_ethernet(void *fdt)
 		strcpy(mac, "ethaddr");
 	}
 
+	/* Set all the addresses together, since each may move the tree */
+	batch = fdt_fixup_batch(fdt, &own);
 	i = 0;
 	while ((tmp = getenv(mac)) != NULL) {
 		sprintf(enet, "ethernet%d", i);
@@ -509,12 +543,27 @@ void fdt_fixup_ethernet(void *fdt)
 				tmp = (*end) ? end+1 : end;
 		}
 
-		do_fixup_by_path(fdt, path, "mac-address", &mac_addr, 6, 0);
-		do_fixup_by_path(fdt, path, "local-mac-address",
-				&mac_addr, 6, 1);
+		off = fdt_path_offset(fdt, path);
+		if (off < 0) {
+			printf("Unable to update property %s:%s, err=%s\n",
+			       path, "local-mac-address", fdt_strerror(off));
+		} else {
+			if (fdt_get_property(fdt, off, "mac-address", NULL))
+				fdt_batch_setprop(batch, fdt, off,
+						  "mac-address", mac_addr, 6);
+			fdt_batch_setprop(batch, fdt, off, "local-mac-address",
+					  mac_addr, 6);
+		}
 
 		sprintf(mac, "eth%daddr", ++i);
 	}
+
+	if (batch != &own)
+		return;
+	err = fdt_batch_apply(batch, fdt);
+	if (err)
+		printf("Unable to update MAC addresses, err=%s\n",
+		       fdt_strerror(err));
 }
 
 /* Resize the fdt to its actual size + a bit of padding */
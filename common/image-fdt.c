@@ -468,9 +468,18 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 {
 	ulong *initrd_start = &images->initrd_start;
 	ulong *initrd_end = &images->initrd_end;
+	struct fdt_batch batch;
 	int ret = -EPERM;
 	int fdt_ret;
 
+	fdt_batch_init(&batch);
+#ifdef CONFIG_FDT_FIXUP_BATCH
+	/*
+	 * The board's fixups do not depend on the order of their changes, so
+	 * the fixup helpers can queue them all for a single pass over the tree
+	 */
+	fdt_batch_start(&batch, blob);
+#endif
 	if (fdt_root(blob) < 0) {
 		printf("ERROR: root node setup failed\n");
 		goto err;
@@ -499,6 +508,12 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 		}
 	}
 	fdt_fixup_ethernet(blob);
+#ifdef CONFIG_FDT_FIXUP_BATCH
+	fdt_ret = fdt_batch_apply(&batch, blob);
+	if (fdt_ret)
+		printf("WARNING: batched fdt fixups failed: %s\n",
+		       fdt_strerror(fdt_ret));
+#endif
 
 	/* Delete the old LMB reservation */
 	lmb_free(lmb, (phys_addr_t)(u32)(uintptr_t)blob,
@@ -527,6 +542,7 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 
 	return 0;
 err:
+	fdt_batch_free(&batch);
 	printf(" - must RESET the board to recover.\n\n");
 
 	return ret;
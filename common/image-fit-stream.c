@@ -0,0 +1,533 @@
+/*
+ * Load images from a FIT without reading the whole FIT into memory first
+ *
+ * Copyright (c) 2015 The Chromium OS Authors.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <watchdog.h>
+#include <u-boot/zlib.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/*
+ * The FIT is read in chunks of this size, both when walking its structure
+ * and when loading an image. Each chunk is hashed and decompressed while it
+ * is still in the cache.
+ */
+#ifndef CONFIG_FIT_STREAM_CHUNK
+#define CONFIG_FIT_STREAM_CHUNK		(64 << 10)
+#endif
+
+#define FIT_STREAM_MAX_HASHES		4
+
+/* Replaces the "data" property of each image in the copy of the FIT */
+#define FIT_STREAM_DATA_PROP		"stream-data"
+
+struct fit_walk {
+	struct fit_stream *stream;
+	char *win;			/* Window onto the FIT */
+	ulong win_start;		/* Offset of the window in the FIT */
+	ulong win_len;
+	ulong size;			/* Size of the FIT */
+	char *out;			/* Structure block being built */
+	int out_len;
+	int out_size;
+};
+
+/*
+ * Return a pointer to 'len' bytes at 'offset' in the FIT, reading a new
+ * window if needed.
+ */
+static const void *fit_walk_get(struct fit_walk *walk, ulong offset, ulong len)
+{
+	if (len > CONFIG_FIT_STREAM_CHUNK || offset + len > walk->size ||
+	    offset + len < offset)
+		return NULL;
+
+	if (offset < walk->win_start ||
+	    offset + len > walk->win_start + walk->win_len) {
+		walk->win_start = offset;
+		walk->win_len = min((ulong)CONFIG_FIT_STREAM_CHUNK,
+				    walk->size - offset);
+		if (walk->stream->read(walk->stream, offset, walk->win,
+				       walk->win_len)) {
+			walk->win_len = 0;
+			return NULL;
+		}
+	}
+
+	return walk->win + offset - walk->win_start;
+}
+
+/* Make room for 'len' more bytes in the structure block */
+static void *fit_walk_out(struct fit_walk *walk, int len)
+{
+	void *ptr;
+
+	if (walk->out_len + len > walk->out_size) {
+		int size = max(walk->out_size * 2, walk->out_len + len);
+
+		ptr = realloc(walk->out, size);
+		if (!ptr)
+			return NULL;
+		walk->out = ptr;
+		walk->out_size = size;
+	}
+	ptr = walk->out + walk->out_len;
+	memset(ptr, '\0', len);
+	walk->out_len += len;
+
+	return ptr;
+}
+
+/* Copy 'len' bytes at 'offset' in the FIT into the structure block */
+static int fit_walk_copy(struct fit_walk *walk, ulong offset, int len)
+{
+	char *dst = fit_walk_out(walk, ALIGN(len, FDT_TAGSIZE));
+	const void *src;
+	int count;
+
+	if (!dst)
+		return -ENOMEM;
+	for (; len; len -= count) {
+		count = min(len, CONFIG_FIT_STREAM_CHUNK);
+		src = fit_walk_get(walk, offset, count);
+		if (!src)
+			return -EIO;
+		memcpy(dst, src, count);
+		dst += count;
+		offset += count;
+	}
+
+	return 0;
+}
+
+/*
+ * Copy the structure block of the FIT, replacing the data of each image
+ * with its offset and size so that it can be read later.
+ */
+static int fit_walk_struct(struct fit_walk *walk, ulong offset, ulong end,
+			   const char *strings, int strings_size,
+			   int data_nameoff)
+{
+	const struct fdt_property *prop;
+	const fdt32_t *tagp;
+	const char *name;
+	fdt32_t *cell;
+	uint32_t tag;
+	int len, ret;
+
+	do {
+		if (offset + FDT_TAGSIZE > end)
+			return -EINVAL;
+		tagp = fit_walk_get(walk, offset, FDT_TAGSIZE);
+		if (!tagp)
+			return -EIO;
+		tag = fdt32_to_cpu(*tagp);
+
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			len = min(end - offset - FDT_TAGSIZE,
+				  (ulong)CONFIG_FIT_STREAM_CHUNK);
+			name = fit_walk_get(walk, offset + FDT_TAGSIZE, len);
+			if (!name)
+				return -EIO;
+			len = strnlen(name, len);
+			ret = fit_walk_copy(walk, offset, FDT_TAGSIZE + len + 1);
+			if (ret)
+				return ret;
+			offset += FDT_TAGSIZE + ALIGN(len + 1, FDT_TAGSIZE);
+			break;
+		case FDT_PROP:
+			prop = fit_walk_get(walk, offset, sizeof(*prop));
+			if (!prop)
+				return -EIO;
+			len = fdt32_to_cpu(prop->len);
+			if (len < 0 ||
+			    fdt32_to_cpu(prop->nameoff) >= strings_size)
+				return -EINVAL;
+			name = strings + fdt32_to_cpu(prop->nameoff);
+			if (strcmp(name, FIT_DATA_PROP)) {
+				ret = fit_walk_copy(walk, offset,
+						    sizeof(*prop) + len);
+				if (ret)
+					return ret;
+			} else {
+				cell = fit_walk_out(walk, sizeof(*prop) + 8);
+				if (!cell)
+					return -ENOMEM;
+				*cell++ = cpu_to_fdt32(FDT_PROP);
+				*cell++ = cpu_to_fdt32(8);
+				*cell++ = cpu_to_fdt32(data_nameoff);
+				*cell++ = cpu_to_fdt32(offset + sizeof(*prop));
+				*cell = cpu_to_fdt32(len);
+			}
+			offset += sizeof(*prop) + ALIGN(len, FDT_TAGSIZE);
+			break;
+		case FDT_END_NODE:
+		case FDT_NOP:
+		case FDT_END:
+			ret = fit_walk_copy(walk, offset, FDT_TAGSIZE);
+			if (ret)
+				return ret;
+			offset += FDT_TAGSIZE;
+			break;
+		default:
+			return -EINVAL;
+		}
+	} while (tag != FDT_END);
+
+	return 0;
+}
+
+int fit_stream_open(struct fit_stream *stream)
+{
+	struct fit_walk walk;
+	struct fdt_header header;
+	struct fdt_header *fdt;
+	char *strings = NULL;
+	int strings_size;
+	int ret;
+
+	memset(&walk, '\0', sizeof(walk));
+	stream->fit = NULL;
+
+	ret = stream->read(stream, 0, &header, sizeof(header));
+	if (ret)
+		return ret;
+	if (fdt_magic(&header) != FDT_MAGIC ||
+	    fdt_version(&header) < 0x10 ||
+	    fdt_off_dt_strings(&header) + fdt_size_dt_strings(&header) >
+			fdt_totalsize(&header) ||
+	    fdt_off_dt_struct(&header) + fdt_size_dt_struct(&header) >
+			fdt_totalsize(&header)) {
+		puts("Bad FIT format\n");
+		return -EINVAL;
+	}
+
+	/* Add the name of the property which replaces the image data */
+	strings_size = fdt_size_dt_strings(&header);
+	strings = malloc(strings_size + sizeof(FIT_STREAM_DATA_PROP));
+	walk.win = malloc(CONFIG_FIT_STREAM_CHUNK);
+	if (!strings || !walk.win) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	ret = stream->read(stream, fdt_off_dt_strings(&header), strings,
+			   strings_size);
+	if (ret)
+		goto err;
+	strcpy(strings + strings_size, FIT_STREAM_DATA_PROP);
+
+	walk.stream = stream;
+	walk.size = fdt_totalsize(&header);
+	ret = fit_walk_struct(&walk, fdt_off_dt_struct(&header),
+			      fdt_off_dt_struct(&header) +
+			      fdt_size_dt_struct(&header),
+			      strings, strings_size, strings_size);
+	if (ret) {
+		printf("Cannot read FIT structure (err=%d)\n", ret);
+		goto err;
+	}
+
+	/* Assemble the copy, with an empty memory reservation map */
+	fdt = calloc(1, sizeof(*fdt) + sizeof(struct fdt_reserve_entry) +
+		     walk.out_len + strings_size +
+		     sizeof(FIT_STREAM_DATA_PROP));
+	if (!fdt) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	fdt->magic = cpu_to_fdt32(FDT_MAGIC);
+	fdt->version = cpu_to_fdt32(17);
+	fdt->last_comp_version = cpu_to_fdt32(16);
+	fdt->off_mem_rsvmap = cpu_to_fdt32(sizeof(*fdt));
+	fdt->off_dt_struct = cpu_to_fdt32(sizeof(*fdt) +
+					  sizeof(struct fdt_reserve_entry));
+	fdt->size_dt_struct = cpu_to_fdt32(walk.out_len);
+	fdt->off_dt_strings = cpu_to_fdt32(fdt_off_dt_struct(fdt) +
+					   walk.out_len);
+	fdt->size_dt_strings = cpu_to_fdt32(strings_size +
+					    sizeof(FIT_STREAM_DATA_PROP));
+	fdt->totalsize = cpu_to_fdt32(fdt_off_dt_strings(fdt) +
+				      fdt_size_dt_strings(fdt));
+	memcpy((char *)fdt + fdt_off_dt_struct(fdt), walk.out, walk.out_len);
+	memcpy((char *)fdt + fdt_off_dt_strings(fdt), strings,
+	       fdt_size_dt_strings(fdt));
+
+	if (!fit_check_format(fdt)) {
+		puts("Bad FIT format\n");
+		free(fdt);
+		ret = -EINVAL;
+		goto err;
+	}
+	debug("%s: FIT structure is %d bytes of %u\n", __func__,
+	      fdt_totalsize(fdt), fdt_totalsize(&header));
+	stream->fit = fdt;
+
+err:
+	free(walk.out);
+	free(walk.win);
+	free(strings);
+
+	return ret;
+}
+
+void fit_stream_close(struct fit_stream *stream)
+{
+	free(stream->fit);
+	stream->fit = NULL;
+}
+
+struct fit_stream_hash {
+	struct hash_algo *algo;
+	void *ctx;
+	int noffset;
+};
+
+/* Set up progressive hashing for each hash node of an image */
+static int fit_stream_hash_init(const void *fit, int image_noffset,
+				struct fit_stream_hash *hash, int *countp)
+{
+	const fdt32_t *ignore;
+	char *algo;
+	int noffset;
+	int count = 0;
+
+	/*
+	 * Signatures cover the data, which is never held in memory as a
+	 * whole here, so refuse to load anything if they are required.
+	 */
+	if (IMAGE_ENABLE_VERIFY && gd_fdt_blob() &&
+	    fdt_subnode_offset(gd_fdt_blob(), 0, FIT_SIG_NODENAME) >= 0) {
+		puts("Signed FIT images cannot be streamed\n");
+		return -EPERM;
+	}
+
+	fdt_for_each_subnode(fit, noffset, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo)) {
+			puts("Can't get hash algo property\n");
+			return -EINVAL;
+		}
+		ignore = fdt_getprop(fit, noffset, FIT_IGNORE_PROP, NULL);
+		if (IMAGE_ENABLE_IGNORE && ignore && *ignore)
+			continue;
+		if (fdt_getprop(fit, noffset, FIT_CHUNK_SIZE_PROP, NULL)) {
+			puts("Chunked hashes cannot be streamed\n");
+			return -ENOSYS;
+		}
+		if (count == FIT_STREAM_MAX_HASHES) {
+			puts("Too many hash nodes\n");
+			return -E2BIG;
+		}
+		if (hash_progressive_lookup_algo(algo, &hash[count].algo)) {
+			printf("Unsupported hash algorithm '%s'\n", algo);
+			return -EPROTONOSUPPORT;
+		}
+		if (hash[count].algo->hash_init(hash[count].algo,
+						&hash[count].ctx))
+			return -ENOMEM;
+		hash[count++].noffset = noffset;
+		*countp = count;
+	}
+
+	return 0;
+}
+
+/* Check the result of each hash, freeing the contexts */
+static int fit_stream_hash_check(const void *fit, struct fit_stream_hash *hash,
+				 int count)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	uint8_t *fit_value;
+	int fit_value_len;
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		struct hash_algo *algo = hash[i].algo;
+
+		if (algo->hash_finish(algo, hash[i].ctx, value,
+				      sizeof(value))) {
+			ret = -EINVAL;
+			continue;
+		}
+		/* The FIT holds CRC32 values in big-endian order */
+		if (!strcmp(algo->name, "crc32"))
+			*(uint32_t *)value = cpu_to_uimage(*(uint32_t *)value);
+		printf("%s", algo->name);
+		if (fit_image_hash_get_value(fit, hash[i].noffset, &fit_value,
+					     &fit_value_len) ||
+		    fit_value_len != algo->digest_size ||
+		    memcmp(value, fit_value, fit_value_len)) {
+			puts("- ");
+			ret = -EBADMSG;
+		} else {
+			puts("+ ");
+		}
+	}
+
+	return ret;
+}
+
+int fit_stream_load(struct fit_stream *stream, int noffset, ulong load,
+		    ulong max_len, ulong *lenp)
+{
+	struct fit_stream_hash hash[FIT_STREAM_MAX_HASHES];
+	const void *fit = stream->fit;
+	const fdt32_t *cell;
+	ulong offset, size, done, count;
+	int hash_count = 0;
+	uint8_t comp;
+	void *buf = NULL;
+	void *ptr;
+	int ret, i, len;
+#ifdef CONFIG_GZIP
+	bool ended = false;
+	z_stream s;
+#endif
+
+	cell = fdt_getprop(fit, noffset, FIT_STREAM_DATA_PROP, &len);
+	if (!cell || len != 8) {
+		puts("Can't get image data/size\n");
+		return -ENOENT;
+	}
+	offset = fdt32_to_cpu(cell[0]);
+	size = fdt32_to_cpu(cell[1]);
+
+	if (fit_image_get_comp(fit, noffset, &comp))
+		comp = IH_COMP_NONE;
+	switch (comp) {
+	case IH_COMP_NONE:
+		if (size > max_len) {
+			puts("Image too large\n");
+			return -E2BIG;
+		}
+		break;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		buf = malloc(CONFIG_FIT_STREAM_CHUNK);
+		if (!buf)
+			return -ENOMEM;
+		s.zalloc = gzalloc;
+		s.zfree = gzfree;
+		/* Let zlib handle the gzip header and check its CRC */
+		if (inflateInit2(&s, 16 + MAX_WBITS) != Z_OK) {
+			free(buf);
+			return -ENOMEM;
+		}
+		s.next_out = map_sysmem(load, max_len);
+		s.avail_out = max_len;
+		break;
+#endif
+	default:
+		printf("%s compression cannot be streamed\n",
+		       genimg_get_comp_name(comp));
+		return -ENOSYS;
+	}
+
+	ret = fit_stream_hash_init(fit, noffset, hash, &hash_count);
+	if (ret)
+		goto err;
+
+	for (done = 0; done < size; done += count) {
+		count = min(size - done, (ulong)CONFIG_FIT_STREAM_CHUNK);
+		ptr = buf ? buf : map_sysmem(load + done, count);
+
+		ret = stream->read(stream, offset + done, ptr, count);
+		if (ret)
+			goto err;
+
+		for (i = 0; i < hash_count; i++) {
+			struct hash_algo *algo = hash[i].algo;
+
+			ret = algo->hash_update(algo, hash[i].ctx, ptr, count,
+						done + count == size);
+			if (ret) {
+				/* The failed context has been freed */
+				hash[i] = hash[--hash_count];
+				goto err;
+			}
+		}
+
+#ifdef CONFIG_GZIP
+		/* Anything after the end of the compressed data is ignored */
+		if (comp == IH_COMP_GZIP && !ended) {
+			s.next_in = ptr;
+			s.avail_in = count;
+			while (s.avail_in) {
+				ret = inflate(&s, Z_NO_FLUSH);
+				if (ret == Z_STREAM_END) {
+					ended = true;
+					break;
+				}
+				/*
+				 * A full output buffer is only a problem if
+				 * inflate() needs more room: the trailer may
+				 * still be left to check.
+				 */
+				if (ret == Z_BUF_ERROR && !s.avail_out) {
+					puts("Image too large\n");
+					ret = -E2BIG;
+					goto err;
+				}
+				if (ret != Z_OK) {
+					printf("Error: inflate() returned %d\n",
+					       ret);
+					ret = -EINVAL;
+					goto err;
+				}
+			}
+		}
+#endif
+		WATCHDOG_RESET();
+	}
+
+#ifdef CONFIG_GZIP
+	if (comp == IH_COMP_GZIP) {
+		if (!ended) {
+			puts("Error: truncated compressed data\n");
+			ret = -EINVAL;
+			goto err;
+		}
+		size = s.total_out;
+	}
+#endif
+
+	puts("   Verifying Hash Integrity ... ");
+	ret = fit_stream_hash_check(fit, hash, hash_count);
+	hash_count = 0;
+	if (ret) {
+		puts(" error!\n");
+		goto err;
+	}
+	puts("OK\n");
+	*lenp = size;
+
+err:
+	for (i = 0; i < hash_count; i++) {
+		uint8_t value[FIT_MAX_HASH_LEN];
+
+		hash[i].algo->hash_finish(hash[i].algo, hash[i].ctx, value,
+					  sizeof(value));
+	}
+#ifdef CONFIG_GZIP
+	if (comp == IH_COMP_GZIP)
+		inflateEnd(&s);
+#endif
+	free(buf);
+
+	return ret;
+}
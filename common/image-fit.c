@@ -16,6 +16,7 @@
 #else
 #include <common.h>
 #include <errno.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
 DECLARE_GLOBAL_DATA_PTR;
@@ -26,6 +27,7 @@ DECLARE_GLOBAL_DATA_PTR;
 #include <u-boot/md5.h>
 #include <u-boot/sha1.h>
 #include <u-boot/sha256.h>
+#include <worker.h>
 
 /*****************************************************************************/
 /* New uImage format routines */
@@ -926,8 +928,289 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+#if defined(CONFIG_WORKER) && !defined(USE_HOSTCC)
+/*
+ * Like calculate_hash(), but only using the plain software routines, which
+ * do not reset the watchdog or use a hash accelerator. This is what runs on
+ * the secondary CPUs.
+ */
+static int calculate_hash_sw(const void *data, int data_len, const char *algo,
+			     uint8_t *value, int *value_len)
+{
+	if (IMAGE_ENABLE_CRC32 && strcmp(algo, "crc32") == 0) {
+		*((uint32_t *)value) = cpu_to_uimage(crc32(0, data, data_len));
+		*value_len = 4;
+	} else if (IMAGE_ENABLE_SHA1 && strcmp(algo, "sha1") == 0) {
+		sha1_csum(data, data_len, value);
+		*value_len = 20;
+	} else if (IMAGE_ENABLE_SHA256 && strcmp(algo, "sha256") == 0) {
+		sha256_context ctx;
+
+		sha256_starts(&ctx);
+		sha256_update(&ctx, data, data_len);
+		sha256_finish(&ctx, value);
+		*value_len = SHA256_SUM_LEN;
+	} else if (IMAGE_ENABLE_MD5 && strcmp(algo, "md5") == 0) {
+		md5((unsigned char *)data, data_len, value);
+		*value_len = 16;
+	} else {
+		debug("Unsupported hash alogrithm\n");
+		return -1;
+	}
+	return 0;
+}
+#define fit_hash_part_calc	calculate_hash_sw
+#else
+/* Everything runs on the boot CPU */
+#define fit_hash_part_calc	calculate_hash
+#endif
+
+/**
+ * struct fit_hash_job - Calculation of the value of a hash node
+ *
+ * @noffset:		Offset of the hash node
+ * @algo:		Hash algorithm
+ * @data:		Image data
+ * @size:		Size of image data in bytes
+ * @chunk_size:		Size of each chunk, or 0 to hash the data in one piece
+ * @chunks:		Number of chunks
+ * @chunk_values:	Value of each chunk, FIT_MAX_HASH_LEN bytes apart
+ * @value:		Value of the hash node
+ * @value_len:		Length of @value in bytes
+ * @err:		0 if @value is valid, -ve on error
+ */
+struct fit_hash_job {
+	int noffset;
+	char *algo;
+	const uint8_t *data;
+	size_t size;
+	size_t chunk_size;
+	int chunks;
+	uint8_t *chunk_values;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+	int err;
+};
+
+/* Part of a job, which can run on any CPU: the whole hash or one chunk */
+struct fit_hash_part {
+	struct fit_hash_job *job;
+	int chunk;
+	int value_len;
+};
+
+static int fit_hash_part_run(void *arg)
+{
+	struct fit_hash_part *part = arg;
+	struct fit_hash_job *job = part->job;
+	size_t offset, size;
+
+	if (!job->chunk_size)
+		return fit_hash_part_calc(job->data, job->size, job->algo,
+					  job->value, &job->value_len);
+
+	offset = part->chunk * job->chunk_size;
+	size = job->size - offset;
+	if (size > job->chunk_size)
+		size = job->chunk_size;
+	return fit_hash_part_calc(job->data + offset, size, job->algo,
+				  job->chunk_values +
+				  part->chunk * FIT_MAX_HASH_LEN,
+				  &part->value_len);
+}
+
+/**
+ * fit_hash_job_init() - Set up the calculation of a hash node
+ *
+ * @return number of parts the job needs, or -ve on error
+ */
+static int fit_hash_job_init(const void *fit, int noffset, const void *data,
+			     size_t size, struct fit_hash_job *job)
+{
+	const fdt32_t *cell;
+	int len;
+
+	memset(job, '\0', sizeof(*job));
+	job->noffset = noffset;
+	job->data = data;
+	job->size = size;
+	job->err = -EINVAL;
+	if (fit_image_hash_get_algo(fit, noffset, &job->algo))
+		return -ENOENT;
+
+	cell = fdt_getprop(fit, noffset, FIT_CHUNK_SIZE_PROP, &len);
+	if (!cell)
+		return 1;
+	if (len != sizeof(*cell) || !fdt32_to_cpu(*cell))
+		return -EINVAL;
+	job->chunk_size = fdt32_to_cpu(*cell);
+	job->chunks = (size + job->chunk_size - 1) / job->chunk_size;
+	job->chunk_values = malloc((job->chunks ? job->chunks : 1) *
+				   FIT_MAX_HASH_LEN);
+	if (!job->chunk_values)
+		return -ENOMEM;
+
+	return job->chunks;
+}
+
+/* Calculate the jobs, spreading their parts across the available CPUs */
+static void fit_hash_jobs_run(struct fit_hash_job *jobs, int *parts,
+			      int count)
+{
+	struct fit_hash_part *part = NULL;
+	struct worker_job *work = NULL;
+	int total, i, j, n;
+	int value_len;
+
+	for (i = 0, total = 0; i < count; i++) {
+		if (parts[i] > 0)
+			total += parts[i];
+	}
+	if (total) {
+		part = calloc(total, sizeof(*part));
+		work = calloc(total, sizeof(*work));
+		if (!part || !work)
+			goto out;
+	}
+
+	for (i = 0, n = 0; i < count; i++) {
+		for (j = 0; j < parts[i]; j++, n++) {
+			part[n].job = &jobs[i];
+			part[n].chunk = j;
+			work[n].func = fit_hash_part_run;
+			work[n].arg = &part[n];
+		}
+		if (parts[i] >= 0)
+			jobs[i].err = 0;
+	}
+	worker_run_all(work, total);
+
+	for (n = 0; n < total; n++) {
+		if (work[n].ret)
+			part[n].job->err = -EINVAL;
+	}
+
+	/* The value of a chunked hash is the hash of its chunks' values */
+	for (i = 0, n = 0; i < count; i++) {
+		struct fit_hash_job *job = &jobs[i];
+
+		if (parts[i] > 0)
+			n += parts[i];
+		if (!job->chunk_size || job->err)
+			continue;
+		value_len = job->chunks ? part[n - job->chunks].value_len : 0;
+		for (j = 1; j < job->chunks; j++)
+			memmove(job->chunk_values + j * value_len,
+				job->chunk_values + j * FIT_MAX_HASH_LEN,
+				value_len);
+		if (calculate_hash(job->chunk_values, job->chunks * value_len,
+				   job->algo, job->value, &job->value_len))
+			job->err = -EINVAL;
+	}
+
+out:
+	free(work);
+	free(part);
+}
+
+static void fit_hash_jobs_free(struct fit_hash_job *jobs, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		free(jobs[i].chunk_values);
+	free(jobs);
+}
+
+int fit_image_hash_calc(const void *fit, int noffset, const void *data,
+			size_t size, uint8_t *value, int *value_len)
+{
+	struct fit_hash_job job;
+	int parts, ret;
+
+	parts = fit_hash_job_init(fit, noffset, data, size, &job);
+	fit_hash_jobs_run(&job, &parts, 1);
+	ret = job.err;
+	if (!ret) {
+		memcpy(value, job.value, job.value_len);
+		*value_len = job.value_len;
+	}
+	free(job.chunk_values);
+
+	return ret;
+}
+
+#ifndef USE_HOSTCC
+/**
+ * fit_image_add_hash_jobs() - Add a job for each hash node of an image
+ *
+ * Nodes which are to be ignored are skipped, as are images whose data
+ * cannot be found. The caller reports these when checking the hashes.
+ *
+ * @jobsp:	Pointer to the job list, which is extended
+ * @partsp:	Pointer to the list of the number of parts of each job
+ * @countp:	Pointer to the number of jobs, which is updated
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+static int fit_image_add_hash_jobs(const void *fit, int image_noffset,
+				   struct fit_hash_job **jobsp, int **partsp,
+				   int *countp)
+{
+	struct fit_hash_job *jobs;
+	const void *data;
+	size_t size;
+	int noffset;
+	int ignore;
+	int *parts;
+
+	if (fit_image_get_data(fit, image_noffset, &data, &size))
+		return 0;
+
+	fdt_for_each_subnode(fit, noffset, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+
+		jobs = realloc(*jobsp, (*countp + 1) * sizeof(*jobs));
+		if (jobs)
+			*jobsp = jobs;
+		parts = realloc(*partsp, (*countp + 1) * sizeof(*parts));
+		if (parts)
+			*partsp = parts;
+		if (!jobs || !parts)
+			return -ENOMEM;
+		parts[*countp] = fit_hash_job_init(fit, noffset, data, size,
+						   &jobs[*countp]);
+		(*countp)++;
+	}
+
+	return 0;
+}
+
+static struct fit_hash_job *fit_hash_job_find(struct fit_hash_job *jobs,
+					      int count, int noffset)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (jobs[i].noffset == noffset)
+			return &jobs[i];
+	}
+
+	return NULL;
+}
+#endif /* !USE_HOSTCC */
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size, struct fit_hash_job *job,
+				char **err_msgp)
 {
 	uint8_t value[FIT_MAX_HASH_LEN];
 	int value_len;
@@ -958,7 +1241,11 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (job && !job->err) {
+		memcpy(value, job->value, job->value_len);
+		value_len = job->value_len;
+	} else if (fit_image_hash_calc(fit, noffset, data, size, value,
+				       &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -974,21 +1261,14 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	return 0;
 }
 
-/**
- * fit_image_verify - verify data intergity
- * @fit: pointer to the FIT format image header
- * @image_noffset: component image node offset
- *
- * fit_image_verify() goes over component image hash nodes,
- * re-calculates each data hash and compares with the value stored in hash
- * node.
- *
- * returns:
- *     1, if all hashes are valid
- *     0, otherwise (or on error)
+/*
+ * Verify an image using hash values which may already have been calculated
+ * in 'jobs'.
  */
-int fit_image_verify(const void *fit, int image_noffset)
+static int fit_image_verify_jobs(const void *fit, int image_noffset,
+				 struct fit_hash_job *jobs, int count)
 {
+	struct fit_hash_job *job = NULL;
 	const void	*data;
 	size_t		size;
 	int		noffset = 0;
@@ -1021,8 +1301,11 @@ int fit_image_verify(const void *fit, int image_noffset)
 		 */
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
+#ifndef USE_HOSTCC
+			job = fit_hash_job_find(jobs, count, noffset);
+#endif
 			if (fit_image_check_hash(fit, noffset, data, size,
-						 &err_msg))
+						 job, &err_msg))
 				goto error;
 			puts("+ ");
 		} else if (IMAGE_ENABLE_VERIFY && verify_all &&
@@ -1051,6 +1334,38 @@ error:
 	return 0;
 }
 
+/**
+ * fit_image_verify - verify data intergity
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ *
+ * fit_image_verify() goes over component image hash nodes,
+ * re-calculates each data hash and compares with the value stored in hash
+ * node. The hashes are calculated in parallel where possible.
+ *
+ * returns:
+ *     1, if all hashes are valid
+ *     0, otherwise (or on error)
+ */
+int fit_image_verify(const void *fit, int image_noffset)
+{
+	struct fit_hash_job *jobs = NULL;
+	int *parts = NULL;
+	int count = 0;
+	int ret;
+
+#ifndef USE_HOSTCC
+	if (!fit_image_add_hash_jobs(fit, image_noffset, &jobs, &parts,
+				     &count))
+		fit_hash_jobs_run(jobs, parts, count);
+#endif
+	ret = fit_image_verify_jobs(fit, image_noffset, jobs, count);
+	fit_hash_jobs_free(jobs, count);
+	free(parts);
+
+	return ret;
+}
+
 /**
  * fit_all_image_verify - verify data intergity for all images
  * @fit: pointer to the FIT format image header
@@ -1064,10 +1379,14 @@ error:
  */
 int fit_all_image_verify(const void *fit)
 {
+	struct fit_hash_job *jobs = NULL;
+	int *parts = NULL;
+	int job_count = 0;
 	int images_noffset;
 	int noffset;
 	int ndepth;
 	int count;
+	int ret = 1;
 
 	/* Find images parent node offset */
 	images_noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
@@ -1077,6 +1396,16 @@ int fit_all_image_verify(const void *fit)
 		return 0;
 	}
 
+#ifndef USE_HOSTCC
+	/* Calculate the hashes of all images together, to use every CPU */
+	fdt_for_each_subnode(fit, noffset, images_noffset) {
+		if (fit_image_add_hash_jobs(fit, noffset, &jobs, &parts,
+					    &job_count))
+			break;
+	}
+	fit_hash_jobs_run(jobs, parts, job_count);
+#endif
+
 	/* Process all image subnodes, check hashes for each */
 	printf("## Checking hash(es) for FIT Image at %08lx ...\n",
 	       (ulong)fit);
@@ -1092,12 +1421,18 @@ int fit_all_image_verify(const void *fit)
 			printf("   Hash(es) for Image %u (%s): ", count++,
 			       fit_get_name(fit, noffset, NULL));
 
-			if (!fit_image_verify(fit, noffset))
-				return 0;
+			if (!fit_image_verify_jobs(fit, noffset, jobs,
+						   job_count)) {
+				ret = 0;
+				break;
+			}
 			printf("\n");
 		}
 	}
-	return 1;
+	fit_hash_jobs_free(jobs, job_count);
+	free(parts);
+
+	return ret;
 }
 
 /**
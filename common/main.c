@@ -10,6 +10,7 @@
 #include <common.h>
 #include <autoboot.h>
 #include <cli.h>
+#include <initcall.h>
 #include <version.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -75,6 +76,7 @@ void main_loop(void)
 	run_preboot_environment_command();
 
 #if defined(CONFIG_UPDATE_TFTP)
+	initcall_defer_finish_all();
 	update_tftp(0UL);
 #endif /* CONFIG_UPDATE_TFTP */
 
@@ -909,6 +909,15 @@ __weak int usb_alloc_device(struct usb_device *udev)
 {
 	return 0;
 }
+
+/*
+ * Host controllers which can take large bulk transfers override this, so
+ * that class drivers do not have to assume the smallest common limit.
+ */
+__weak int usb_get_max_xfer_size(struct usb_device *udev, size_t *size)
+{
+	return -ENOSYS;
+}
 #endif /* !CONFIG_DM_USB */
 
 #ifndef CONFIG_DM_USB
@@ -37,6 +37,7 @@
 #include <command.h>
 #include <dm.h>
 #include <errno.h>
+#include <fs.h>
 #include <inttypes.h>
 #include <mapmem.h>
 #include <asm/byteorder.h>
@@ -95,18 +96,14 @@ struct us_data {
 	ccb		*srb;			/* current srb */
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
+	unsigned short	max_xfer_blk;		/* blocks per read/write */
 };
 
-#ifdef CONFIG_USB_EHCI
-/*
- * The U-Boot EHCI driver can handle any transfer length as long as there is
- * enough free heap space left, but the SCSI READ(10) and WRITE(10) commands are
- * limited to 65535 blocks.
- */
-#define USB_MAX_XFER_BLK	65535
-#else
+/* Blocks per transfer if the host controller does not report its limit */
 #define USB_MAX_XFER_BLK	20
-#endif
+
+/* The SCSI READ(10) and WRITE(10) commands are limited to 65535 blocks */
+#define USB_MAX_RW10_BLK	65535
 
 static struct us_data usb_stor[USB_MAX_STOR_DEV];
 
@@ -222,6 +219,10 @@ static int usb_stor_probe_device(struct usb_device *dev)
 
 void usb_stor_reset(void)
 {
+	int i;
+
+	for (i = 0; i < usb_max_devs; i++)
+		fs_invalidate(&usb_dev_desc[i]);
 	usb_max_devs = 0;
 }
 
@@ -1063,12 +1064,12 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > ss->max_xfer_blk)
+			smallblks = ss->max_xfer_blk;
 		else
 			smallblks = (unsigned short) blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == ss->max_xfer_blk)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1091,7 +1092,7 @@ retry_it:
 	      start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= ss->max_xfer_blk)
 		debug("\n");
 	return blkcnt;
 }
@@ -1134,12 +1135,12 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 		 */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > ss->max_xfer_blk)
+			smallblks = ss->max_xfer_blk;
 		else
 			smallblks = (unsigned short) blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == ss->max_xfer_blk)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1161,7 +1162,7 @@ retry_it:
 	      PRIxPTR "\n", start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= ss->max_xfer_blk)
 		debug("\n");
 	return blkcnt;
 
@@ -1205,6 +1206,7 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 	}
 
 	memset(ss, 0, sizeof(struct us_data));
+	ss->max_xfer_blk = USB_MAX_XFER_BLK;
 
 	/* At this point, we know we've got a live one */
 	debug("\n\nUSB Mass Storage device detected\n");
@@ -1311,6 +1313,26 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 	return 1;
 }
 
+/*
+ * Transfer as many blocks with each command as the host controller allows, so
+ * that large reads are not held up by a command and status cycle for every
+ * few kilobytes.
+ */
+static void usb_stor_set_max_xfer_blk(struct usb_device *dev,
+				      struct us_data *ss, u32 blksz)
+{
+	size_t size;
+
+	if (!blksz || usb_get_max_xfer_size(dev, &size))
+		return;
+	size /= blksz;
+	if (size > USB_MAX_RW10_BLK)
+		size = USB_MAX_RW10_BLK;
+	if (size)
+		ss->max_xfer_blk = size;
+	debug("%s: %u blocks per transfer\n", __func__, ss->max_xfer_blk);
+}
+
 int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 		      block_dev_desc_t *dev_desc)
 {
@@ -1394,6 +1416,7 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 	dev_desc->blksz = blksz;
 	dev_desc->log2blksz = LOG2(dev_desc->blksz);
 	dev_desc->type = perq;
+	usb_stor_set_max_xfer_blk(dev, ss, blksz);
 	debug(" address %d\n", dev_desc->target);
 	debug("partype: %d\n", dev_desc->part_type);
 
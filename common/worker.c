@@ -0,0 +1,75 @@
+/*
+ * Running work on secondary CPUs
+ *
+ * Copyright (c) 2015 The Chromium OS Authors.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <watchdog.h>
+#include <worker.h>
+
+/* Every 'step'th job in a list, starting at 'first' */
+struct worker_share {
+	struct worker_job *jobs;
+	int count;
+	int first;
+	int step;
+	bool boot_cpu;
+};
+
+static int worker_run_share(void *arg)
+{
+	struct worker_share *share = arg;
+	struct worker_job *job;
+	int i;
+
+	for (i = share->first; i < share->count; i += share->step) {
+		job = &share->jobs[i];
+		job->ret = job->func(job->arg);
+		/* Jobs leave the watchdog alone, so keep it quiet here */
+		if (share->boot_cpu)
+			WATCHDOG_RESET();
+	}
+
+	return 0;
+}
+
+void worker_run_all(struct worker_job *jobs, int count)
+{
+	struct worker_share share[WORKER_MAX_CPUS];
+	bool started[WORKER_MAX_CPUS];
+	int cpus, i;
+
+	if (!count)
+		return;
+
+	/*
+	 * Jobs are handed out in turn rather than in blocks, so that a list
+	 * of similar jobs is split evenly whatever its length.
+	 */
+	cpus = min(arch_worker_cpus() + 1, WORKER_MAX_CPUS);
+	cpus = min(cpus, count);
+	for (i = 0; i < cpus; i++) {
+		share[i].jobs = jobs;
+		share[i].count = count;
+		share[i].first = i;
+		share[i].step = cpus;
+		share[i].boot_cpu = !i;
+	}
+
+	for (i = 1; i < cpus; i++)
+		started[i] = !arch_worker_start(i - 1, worker_run_share,
+						&share[i]);
+	worker_run_share(&share[0]);
+
+	for (i = 1; i < cpus; i++) {
+		if (started[i]) {
+			arch_worker_wait(i - 1);
+		} else {
+			share[i].boot_cpu = true;
+			worker_run_share(&share[i]);
+		}
+	}
+}
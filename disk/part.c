@@ -7,6 +7,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <fs.h>
 #include <ide.h>
 #include <malloc.h>
 #include <part.h>
@@ -251,6 +252,9 @@ void dev_print (block_dev_desc_t *dev_desc)
 
 void init_part(block_dev_desc_t *dev_desc)
 {
+	/* Anything mounted from the old contents is no longer valid */
+	fs_invalidate(dev_desc);
+
 #ifdef CONFIG_ISO_PARTITION
 	if (test_part_iso(dev_desc) == 0) {
 		dev_desc->part_type = PART_TYPE_ISO;
@@ -13,6 +13,7 @@
 #include <asm/unaligned.h>
 #include <common.h>
 #include <command.h>
+#include <fs.h>
 #include <ide.h>
 #include <inttypes.h>
 #include <malloc.h>
@@ -361,6 +362,9 @@ int write_gpt_table(block_dev_desc_t *dev_desc,
 					   * sizeof(gpt_entry)), dev_desc);
 	u32 calc_crc32;
 
+	/* Anything mounted from the device will be out of date */
+	fs_invalidate(dev_desc);
+
 	debug("max lba: %x\n", (u32) dev_desc->lba);
 	/* Setup the Protective MBR */
 	if (set_protective_mbr(dev_desc) < 0)
@@ -580,6 +584,8 @@ int write_mbr_and_gpt_partitions(block_dev_desc_t *dev_desc, void *buf)
 	if (is_valid_gpt_buf(dev_desc, buf))
 		return -1;
 
+	fs_invalidate(dev_desc);
+
 	/* determine start of GPT Header in the buffer */
 	gpt_h = buf + (GPT_PRIMARY_PARTITION_TABLE_LBA *
 		       dev_desc->blksz);
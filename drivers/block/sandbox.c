@@ -8,6 +8,7 @@
 #include <common.h>
 #include <part.h>
 #include <os.h>
+#include <fs.h>
 #include <malloc.h>
 #include <sandboxblockdev.h>
 #include <asm/errno.h>
@@ -66,6 +67,7 @@ int host_dev_bind(int dev, char *filename)
 	if (!host_dev)
 		return -1;
 	if (host_dev->blk_dev.priv) {
+		fs_invalidate(&host_dev->blk_dev);
 		os_close(host_dev->fd);
 		host_dev->blk_dev.priv = NULL;
 	}
@@ -179,7 +179,7 @@ int device_remove(struct udevice *dev)
 
 	device_free(dev);
 
-	dev->seq = -1;
+	uclass_set_seq(dev, -1);
 	dev->flags &= ~DM_FLAG_ACTIVATED;
 
 	return ret;
@@ -264,7 +264,7 @@ int device_probe_child(struct udevice *dev, void *parent_priv)
 		ret = seq;
 		goto fail;
 	}
-	dev->seq = seq;
+	uclass_set_seq(dev, seq);
 
 	dev->flags |= DM_FLAG_ACTIVATED;
 
@@ -306,7 +306,7 @@ fail_uclass:
 fail:
 	dev->flags &= ~DM_FLAG_ACTIVATED;
 
-	dev->seq = -1;
+	uclass_set_seq(dev, -1);
 	device_free(dev);
 
 	return ret;
@@ -16,7 +16,11 @@
 #include <dm/uclass.h>
 #include <dm/util.h>
 #include <fdtdec.h>
+#include <malloc.h>
 #include <linux/compiler.h>
+#include <linux/err.h>
+
+DECLARE_GLOBAL_DATA_PTR;
 
 struct driver *lists_driver_lookup_name(const char *name)
 {
@@ -138,56 +142,238 @@ static int driver_check_compatible(const void *blob, int offset,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
-		   struct udevice **devp)
+#ifdef CONFIG_DM_COMPAT_INDEX
+/* Marks an empty slot in the index */
+#define COMPAT_SLOT_FREE	0xffff
+
+/**
+ * struct dm_compat_slot - One compatible string in the index
+ *
+ * This uses indexes rather than pointers to keep the table small.
+ *
+ * @drv:	Index of driver in the driver linker list
+ * @match:	Index into that driver's of_match list
+ */
+struct dm_compat_slot {
+	u16 drv;
+	u16 match;
+};
+
+/**
+ * struct dm_compat_index - Hash table from compatible string to driver
+ *
+ * This uses open addressing with linear probing. A string which is
+ * claimed by several drivers has a slot for each one.
+ *
+ * @driver:	Start of the driver linker list
+ * @mask:	Number of slots - 1 (the number of slots is a power of two)
+ * @slot:	Slots, with drv set to COMPAT_SLOT_FREE if not used
+ */
+struct dm_compat_index {
+	struct driver *driver;
+	uint mask;
+	struct dm_compat_slot slot[0];
+};
+
+static uint compat_hash(const char *str, int len)
+{
+	uint hash = 2166136261u;
+
+	while (len--)
+		hash = (hash ^ (u8)*str++) * 16777619;
+
+	return hash;
+}
+
+static struct dm_compat_index *compat_index_build(void)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
 	const struct udevice_id *id;
+	struct dm_compat_index *index;
+	struct dm_compat_slot *slot;
+	uint count = 0, size, pos;
+	struct driver *entry;
+	int match;
+
+	if (n_ents >= COMPAT_SLOT_FREE)
+		return ERR_PTR(-E2BIG);
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (id = entry->of_match; id && id->compatible; id++)
+			count++;
+	}
+
+	/* Keep the table at most half full, so that probes stay short */
+	for (size = 8; size < count * 2; size <<= 1)
+		;
+	index = malloc(sizeof(*index) + size * sizeof(index->slot[0]));
+	if (!index)
+		return ERR_PTR(-ENOMEM);
+	index->driver = driver;
+	index->mask = size - 1;
+	memset(index->slot, 0xff, size * sizeof(index->slot[0]));
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		id = entry->of_match;
+		for (match = 0; id && id[match].compatible; match++) {
+			pos = compat_hash(id[match].compatible,
+					  strlen(id[match].compatible));
+			for (pos &= index->mask;
+			     index->slot[pos].drv != COMPAT_SLOT_FREE;
+			     pos = (pos + 1) & index->mask)
+				;
+			slot = &index->slot[pos];
+			slot->drv = entry - driver;
+			slot->match = match;
+		}
+	}
+
+	return index;
+}
+
+/**
+ * compat_index_lookup() - Find the driver to bind to a node, using the index
+ *
+ * This picks the same driver that a scan of the driver list would: the
+ * first driver which matches any of the node's compatible strings, and the
+ * first of that driver's of_match entries which matches.
+ *
+ * @param blob:		Device tree pointer
+ * @param offset:	Offset of node in device tree
+ * @param drvp:		Returns the driver found
+ * @param of_idp:	Returns the match that was found
+ * @return 0 if there is a match, -ENOENT if no match, -ENODEV if the node
+ * does not have a compatible string, -EINVAL if there is a device tree
+ * error, -ENOSYS if the index is not available
+ */
+static int compat_index_lookup(const void *blob, int offset,
+			       struct driver **drvp,
+			       const struct udevice_id **of_idp)
+{
+	struct dm_compat_index *index = gd->dm_compat_index;
+	const struct dm_compat_slot *best = NULL;
+	const struct dm_compat_slot *slot;
+	const char *compat, *end;
 	struct driver *entry;
-	struct udevice *dev;
-	bool found = false;
 	const char *name;
-	int result = 0;
-	int ret = 0;
+	int len, slen;
+	uint pos;
 
-	dm_dbg("bind node %s\n", fdt_get_name(blob, offset, NULL));
-	if (devp)
-		*devp = NULL;
+	/*
+	 * Before relocation only a few nodes are bound and the malloc() area
+	 * is small, so leave it for the devices and scan the drivers instead
+	 */
+	if (!(gd->flags & GD_FLG_RELOC))
+		return -ENOSYS;
+	if (!index) {
+		index = compat_index_build();
+		gd->dm_compat_index = index;
+	}
+	if (IS_ERR(index))
+		return -ENOSYS;
+
+	compat = fdt_getprop(blob, offset, "compatible", &len);
+	if (!compat)
+		return len == -FDT_ERR_NOTFOUND ? -ENODEV : -EINVAL;
+
+	for (end = compat + len; compat < end; compat += slen + 1) {
+		slen = strnlen(compat, end - compat);
+		pos = compat_hash(compat, slen) & index->mask;
+		for (slot = &index->slot[pos]; slot->drv != COMPAT_SLOT_FREE;
+		     pos = (pos + 1) & index->mask, slot = &index->slot[pos]) {
+			if (best && (slot->drv > best->drv ||
+				     (slot->drv == best->drv &&
+				      slot->match > best->match)))
+				continue;
+			entry = index->driver + slot->drv;
+			name = entry->of_match[slot->match].compatible;
+			if (!strncmp(name, compat, slen) && !name[slen])
+				best = slot;
+		}
+	}
+	if (!best)
+		return -ENOENT;
+	entry = index->driver + best->drv;
+	*drvp = entry;
+	*of_idp = &entry->of_match[best->match];
+
+	return 0;
+}
+#endif
+
+/**
+ * lists_find_compatible() - Find the driver to bind to a node
+ *
+ * @param blob:		Device tree pointer
+ * @param offset:	Offset of node in device tree
+ * @param drvp:		Returns the driver found
+ * @param of_idp:	Returns the match that was found
+ * @return 0 if there is a match, -ENOENT if no match, -ENODEV if the node
+ * does not have a compatible string, other error <0 if there is a device
+ * tree error
+ */
+static int lists_find_compatible(const void *blob, int offset,
+				 struct driver **drvp,
+				 const struct udevice_id **of_idp)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+	int ret = -ENOENT;
+
+#ifdef CONFIG_DM_COMPAT_INDEX
+	ret = compat_index_lookup(blob, offset, drvp, of_idp);
+	if (ret != -ENOSYS)
+		return ret;
+	ret = -ENOENT;
+#endif
 	for (entry = driver; entry != driver + n_ents; entry++) {
 		ret = driver_check_compatible(blob, offset, entry->of_match,
-					      &id);
-		name = fdt_get_name(blob, offset, NULL);
-		if (ret == -ENOENT) {
-			continue;
-		} else if (ret == -ENODEV) {
-			dm_dbg("Device '%s' has no compatible string\n", name);
-			break;
-		} else if (ret) {
-			dm_warn("Device tree error at offset %d\n", offset);
-			result = ret;
+					      of_idp);
+		if (ret != -ENOENT) {
+			*drvp = entry;
 			break;
 		}
+	}
 
-		dm_dbg("   - found match at '%s'\n", entry->name);
-		ret = device_bind(parent, entry, name, NULL, offset, &dev);
-		if (ret) {
-			dm_warn("Error binding driver '%s'\n", entry->name);
-			return ret;
-		} else {
-			dev->driver_data = id->data;
-			found = true;
-			if (devp)
-				*devp = dev;
-		}
-		break;
+	return ret;
+}
+
+int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
+		   struct udevice **devp)
+{
+	const struct udevice_id *id;
+	struct driver *entry;
+	struct udevice *dev;
+	const char *name;
+	int ret;
+
+	name = fdt_get_name(blob, offset, NULL);
+	dm_dbg("bind node %s\n", name);
+	if (devp)
+		*devp = NULL;
+	ret = lists_find_compatible(blob, offset, &entry, &id);
+	if (ret == -ENOENT) {
+		dm_dbg("No match for node '%s'\n", name);
+		return 0;
+	} else if (ret == -ENODEV) {
+		dm_dbg("Device '%s' has no compatible string\n", name);
+		return 0;
+	} else if (ret) {
+		dm_warn("Device tree error at offset %d\n", offset);
+		return ret;
 	}
 
-	if (!found && !result && ret != -ENODEV) {
-		dm_dbg("No match for node '%s'\n",
-		       fdt_get_name(blob, offset, NULL));
+	dm_dbg("   - found match at '%s'\n", entry->name);
+	ret = device_bind(parent, entry, name, NULL, offset, &dev);
+	if (ret) {
+		dm_warn("Error binding driver '%s'\n", entry->name);
+		return ret;
 	}
+	dev->driver_data = id->data;
+	if (devp)
+		*devp = dev;
 
-	return result;
+	return 0;
 }
 #endif
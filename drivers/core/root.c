@@ -105,6 +105,9 @@ int dm_init(void)
 		return -EINVAL;
 	}
 	INIT_LIST_HEAD(&DM_UCLASS_ROOT_NON_CONST);
+#ifdef CONFIG_DM_UCLASS_TABLE
+	memset(gd->uclass_table, '\0', sizeof(gd->uclass_table));
+#endif
 
 #if defined(CONFIG_NEEDS_MANUAL_RELOC)
 	fix_drivers();
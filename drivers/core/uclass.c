@@ -25,11 +25,10 @@ struct uclass *uclass_find(enum uclass_id key)
 
 	if (!gd->dm_root)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
+#ifdef CONFIG_DM_UCLASS_TABLE
+	if (key >= 0 && key < UCLASS_COUNT)
+		return gd->uclass_table[key];
+#endif
 	list_for_each_entry(uc, &gd->uclass_root, sibling_node) {
 		if (uc->uc_drv->id == key)
 			return uc;
@@ -74,6 +73,9 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, &DM_UCLASS_ROOT_NON_CONST);
+#ifdef CONFIG_DM_UCLASS_TABLE
+	gd->uclass_table[id] = uc;
+#endif
 
 	if (uc_drv->init) {
 		ret = uc_drv->init(uc);
@@ -90,6 +92,9 @@ fail:
 		uc->priv = NULL;
 	}
 	list_del(&uc->sibling_node);
+#ifdef CONFIG_DM_UCLASS_TABLE
+	gd->uclass_table[id] = NULL;
+#endif
 fail_mem:
 	free(uc);
 
@@ -123,6 +128,10 @@ int uclass_destroy(struct uclass *uc)
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
 	list_del(&uc->sibling_node);
+#ifdef CONFIG_DM_UCLASS_TABLE
+	gd->uclass_table[uc_drv->id] = NULL;
+	free(uc->seq_dev);
+#endif
 	if (uc_drv->priv_auto_alloc_size)
 		free(uc->priv);
 	free(uc);
@@ -233,6 +242,14 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 	if (ret)
 		return ret;
 
+#ifdef CONFIG_DM_UCLASS_TABLE
+	if (!find_req_seq && uc->seq_size >= 0) {
+		if (seq_or_req_seq >= 0 && seq_or_req_seq < uc->seq_size)
+			*devp = uc->seq_dev[seq_or_req_seq];
+		debug("   - %s\n", *devp ? "found" : "not found");
+		return *devp ? 0 : -ENODEV;
+	}
+#endif
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		debug("   - %d %d\n", dev->req_seq, dev->seq);
 		if ((find_req_seq ? dev->req_seq : dev->seq) ==
@@ -440,6 +457,49 @@ int uclass_resolve_seq(struct udevice *dev)
 	return seq;
 }
 
+#ifdef CONFIG_DM_UCLASS_TABLE
+/* Make room for 'seq' in the table, giving up on the table if we can't */
+static void uclass_seq_grow(struct uclass *uc, int seq)
+{
+	struct udevice **seq_dev;
+	int size;
+
+	size = max(uc->seq_size * 2, 8);
+	while (size <= seq)
+		size *= 2;
+	seq_dev = seq > DM_MAX_SEQ ? NULL :
+		realloc(uc->seq_dev, size * sizeof(*seq_dev));
+	if (!seq_dev) {
+		free(uc->seq_dev);
+		uc->seq_dev = NULL;
+		uc->seq_size = -1;
+		return;
+	}
+	memset(seq_dev + uc->seq_size, '\0',
+	       (size - uc->seq_size) * sizeof(*seq_dev));
+	uc->seq_dev = seq_dev;
+	uc->seq_size = size;
+}
+#endif
+
+void uclass_set_seq(struct udevice *dev, int seq)
+{
+#ifdef CONFIG_DM_UCLASS_TABLE
+	struct uclass *uc = dev->uclass;
+
+	if (dev->seq >= 0 && dev->seq < uc->seq_size &&
+	    uc->seq_dev[dev->seq] == dev)
+		uc->seq_dev[dev->seq] = NULL;
+	if (seq >= 0 && uc->seq_size >= 0) {
+		if (seq >= uc->seq_size)
+			uclass_seq_grow(uc, seq);
+		if (uc->seq_size >= 0)
+			uc->seq_dev[seq] = dev;
+	}
+#endif
+	dev->seq = seq;
+}
+
 int uclass_pre_probe_device(struct udevice *dev)
 {
 	struct uclass_driver *uc_drv;
@@ -489,7 +549,7 @@ int uclass_pre_remove_device(struct udevice *dev)
 		free(dev->uclass_priv);
 		dev->uclass_priv = NULL;
 	}
-	dev->seq = -1;
+	uclass_set_seq(dev, -1);
 
 	return 0;
 }
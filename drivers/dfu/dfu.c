@@ -16,6 +16,7 @@
 #include <hash.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
+#include <linux/sizes.h>
 
 static LIST_HEAD(dfu_list);
 static int dfu_alt_num;
@@ -132,8 +133,77 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
+/*
+ * Where the medium can write in the background, each half of the buffer is
+ * filled from USB while the other half is being written.
+ */
+static bool dfu_write_pipelined(struct dfu_entity *dfu)
+{
+	return dfu->write_medium_start && dfu_buf_size >= 2 * SZ_64K;
+}
+
+/* Size of the part of the buffer which is filled before it is written */
+static unsigned long dfu_get_fill_size(struct dfu_entity *dfu)
+{
+	if (!dfu_write_pipelined(dfu))
+		return dfu_buf_size;
+
+	return rounddown(dfu_buf_size / 2, CONFIG_SYS_CACHELINE_SIZE);
+}
+
+/* Finish a write started by write_medium_start(), if there is one */
+static int dfu_write_wait(struct dfu_entity *dfu)
+{
+	unsigned long elapsed;
+	int ret;
+
+	if (!dfu->w_busy)
+		return 0;
+
+	ret = dfu->write_medium_wait(dfu);
+	dfu->w_busy = 0;
+	if (ret) {
+		debug("%s: Write error!\n", __func__);
+		return ret;
+	}
+
+	elapsed = get_timer(dfu->w_start);
+	if (elapsed)
+		dfu->w_rate = dfu->w_len / elapsed;
+
+	return 0;
+}
+
+/**
+ * dfu_get_write_timeout() - Get the time for which the host should wait
+ *
+ * When another @size bytes would fill the buffer, dfu_write() must wait for
+ * the write of the other half to finish. Rather than holding up the USB
+ * request for that long, the host can be asked to wait for the time that the
+ * write is expected to take, based on the rate of the last one.
+ *
+ * @dfu:	Entity being written
+ * @size:	Number of bytes the host sends in each block
+ * @return number of milliseconds the host should wait, 0 if none
+ */
+unsigned int dfu_get_write_timeout(struct dfu_entity *dfu, int size)
+{
+	unsigned long expected, elapsed;
+
+	if (!dfu->w_busy || !dfu->w_rate)
+		return 0;
+	if (dfu->i_buf + 2 * size <= dfu->i_buf_end)
+		return 0;
+
+	expected = dfu->w_len / dfu->w_rate;
+	elapsed = get_timer(dfu->w_start);
+
+	return expected > elapsed ? expected - elapsed : 0;
+}
+
 static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 {
+	unsigned long fill_size;
 	long w_size;
 	int ret;
 
@@ -146,7 +216,29 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
 					   dfu->i_buf_start, w_size, 0);
 
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
+	if (dfu_write_pipelined(dfu)) {
+		ret = dfu_write_wait(dfu);
+		if (!ret) {
+			dfu->w_start = get_timer(0);
+			ret = dfu->write_medium_start(dfu, dfu->offset,
+						      dfu->i_buf_start, &w_size);
+		}
+		if (!ret) {
+			dfu->w_len = w_size;
+			dfu->w_busy = 1;
+		}
+
+		/* fill the other half while this one is written */
+		fill_size = dfu_get_fill_size(dfu);
+		if (dfu->i_buf_start == dfu_buf)
+			dfu->i_buf_start = dfu_buf + fill_size;
+		else
+			dfu->i_buf_start = dfu_buf;
+		dfu->i_buf_end = dfu->i_buf_start + fill_size;
+	} else {
+		ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start,
+					&w_size);
+	}
 	if (ret)
 		debug("%s: Write error!\n", __func__);
 
@@ -163,6 +255,9 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 
 void dfu_write_transaction_cleanup(struct dfu_entity *dfu)
 {
+	/* the buffer must not be freed while it is being written */
+	dfu_write_wait(dfu);
+
 	/* clear everything */
 	dfu_free_buf();
 	dfu->crc = 0;
@@ -179,6 +274,8 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	int ret = 0;
 
 	ret = dfu_write_buffer_drain(dfu);
+	if (!ret)
+		ret = dfu_write_wait(dfu);
 	if (ret)
 		return ret;
 
@@ -211,7 +308,8 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		dfu->i_buf_start = dfu_get_buf(dfu);
 		if (dfu->i_buf_start == NULL)
 			return -ENOMEM;
-		dfu->i_buf_end = dfu_get_buf(dfu) + dfu_buf_size;
+		dfu->i_buf_end = dfu->i_buf_start + dfu_get_fill_size(dfu);
+		dfu->w_busy = 0;
 		dfu->i_buf = dfu->i_buf_start;
 
 		dfu->inited = 1;
@@ -14,10 +14,12 @@
 #include <dfu.h>
 #include <ext4fs.h>
 #include <fat.h>
+#include <fs.h>
 #include <mmc.h>
 
 static unsigned char *dfu_file_buf;
 static long dfu_file_buf_len;
+static int dfu_mmc_part_bkp;
 
 static int mmc_access_part(struct dfu_entity *dfu, struct mmc *mmc, int part)
 {
@@ -36,18 +38,10 @@ static int mmc_access_part(struct dfu_entity *dfu, struct mmc *mmc, int part)
 	return 0;
 }
 
-static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
-			u64 offset, void *buf, long *len)
+static int mmc_block_range(struct dfu_entity *dfu, u64 offset, long *len,
+			   u32 *blk_startp, u32 *blk_countp)
 {
-	struct mmc *mmc;
-	u32 blk_start, blk_count, n = 0;
-	int ret, part_num_bkp = 0;
-
-	mmc = find_mmc_device(dfu->data.mmc.dev_num);
-	if (!mmc) {
-		error("Device MMC %d - not found!", dfu->data.mmc.dev_num);
-		return -ENODEV;
-	}
+	u32 blk_start, blk_count;
 
 	/*
 	 * We must ensure that we work in lba_blk_size chunks, so ALIGN
@@ -63,6 +57,28 @@ static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
 		puts("Request would exceed designated area!\n");
 		return -EINVAL;
 	}
+	*blk_startp = blk_start;
+	*blk_countp = blk_count;
+
+	return 0;
+}
+
+static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
+			u64 offset, void *buf, long *len)
+{
+	struct mmc *mmc;
+	u32 blk_start, blk_count, n = 0;
+	int ret, part_num_bkp = 0;
+
+	mmc = find_mmc_device(dfu->data.mmc.dev_num);
+	if (!mmc) {
+		error("Device MMC %d - not found!", dfu->data.mmc.dev_num);
+		return -ENODEV;
+	}
+
+	ret = mmc_block_range(dfu, offset, len, &blk_start, &blk_count);
+	if (ret)
+		return ret;
 
 	if (dfu->data.mmc.hw_partition >= 0) {
 		part_num_bkp = mmc->part_num;
@@ -80,6 +96,7 @@ static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
 					      blk_count, buf);
 		break;
 	case DFU_OP_WRITE:
+		fs_invalidate(&mmc->block_dev);
 		n = mmc->block_dev.block_write(dfu->data.mmc.dev_num, blk_start,
 					       blk_count, buf);
 		break;
@@ -103,6 +120,70 @@ static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
 	return 0;
 }
 
+/*
+ * Start a raw write and return while the card is still programming it, so
+ * that the next buffer can be received in the meantime. The HW partition
+ * stays selected until dfu_write_medium_wait_mmc().
+ */
+static int dfu_write_medium_start_mmc(struct dfu_entity *dfu, u64 offset,
+				      void *buf, long *len)
+{
+	struct mmc *mmc;
+	u32 blk_start, blk_count;
+	int ret;
+
+	mmc = find_mmc_device(dfu->data.mmc.dev_num);
+	if (!mmc) {
+		error("Device MMC %d - not found!", dfu->data.mmc.dev_num);
+		return -ENODEV;
+	}
+
+	ret = mmc_block_range(dfu, offset, len, &blk_start, &blk_count);
+	if (ret)
+		return ret;
+
+	dfu_mmc_part_bkp = mmc->part_num;
+	if (dfu->data.mmc.hw_partition >= 0) {
+		ret = mmc_access_part(dfu, mmc, dfu->data.mmc.hw_partition);
+		if (ret)
+			return ret;
+	}
+
+	debug("%s: dev: %d start: %d cnt: %d buf: 0x%p\n", __func__,
+	      dfu->data.mmc.dev_num, blk_start, blk_count, buf);
+	fs_invalidate(&mmc->block_dev);
+	if (mmc_bwrite_start(mmc, blk_start, blk_count, buf) != blk_count) {
+		error("MMC operation failed");
+		mmc_bxfer_wait(mmc);
+		if (dfu->data.mmc.hw_partition >= 0)
+			mmc_access_part(dfu, mmc, dfu_mmc_part_bkp);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int dfu_write_medium_wait_mmc(struct dfu_entity *dfu)
+{
+	struct mmc *mmc;
+	int ret;
+
+	mmc = find_mmc_device(dfu->data.mmc.dev_num);
+	if (!mmc)
+		return -ENODEV;
+
+	ret = mmc_bxfer_wait(mmc);
+	if (ret)
+		error("MMC operation failed");
+
+	if (dfu->data.mmc.hw_partition >= 0) {
+		if (mmc_access_part(dfu, mmc, dfu_mmc_part_bkp) && !ret)
+			ret = -EIO;
+	}
+
+	return ret ? -EIO : 0;
+}
+
 static int mmc_file_buffer(struct dfu_entity *dfu, void *buf, long *len)
 {
 	if (dfu_file_buf_len + *len > CONFIG_SYS_DFU_MAX_FILE_SIZE) {
@@ -376,6 +457,10 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 	dfu->read_medium = dfu_read_medium_mmc;
 	dfu->write_medium = dfu_write_medium_mmc;
 	dfu->flush_medium = dfu_flush_medium_mmc;
+	if (dfu->layout == DFU_RAW_ADDR) {
+		dfu->write_medium_start = dfu_write_medium_start_mmc;
+		dfu->write_medium_wait = dfu_write_medium_wait_mmc;
+	}
 	dfu->inited = 0;
 	dfu->free_entity = dfu_free_entity_mmc;
 
@@ -104,18 +104,21 @@ static int dwmci_set_transfer_mode(struct dwmci_host *host,
 	return mode;
 }
 
-static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
-		struct mmc_data *data)
+/*
+ * Send the command, using DMA descriptors at @cur_idmac for any data.
+ * This returns once the response is in, while the data is still moving.
+ */
+static int dwmci_send_cmd_common(struct mmc *mmc, struct mmc_cmd *cmd,
+				 struct mmc_data *data,
+				 struct dwmci_idmac *cur_idmac)
 {
 	struct dwmci_host *host = mmc->priv;
-	ALLOC_CACHE_ALIGN_BUFFER(struct dwmci_idmac, cur_idmac,
-				 data ? DIV_ROUND_UP(data->blocks, 8) : 0);
 	int flags = 0, i;
 	unsigned int timeout = 100000;
 	u32 retry = 10000;
-	u32 mask, ctrl;
+	u32 mask;
 	ulong start = get_timer(0);
-	struct bounce_buffer bbstate;
+	struct bounce_buffer *bbstate = &host->bbstate;
 
 	while (dwmci_readl(host, DWMCI_STATUS) & DWMCI_BUSY) {
 		if (get_timer(start) > timeout) {
@@ -128,16 +131,16 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 
 	if (data) {
 		if (data->flags == MMC_DATA_READ) {
-			bounce_buffer_start(&bbstate, (void*)data->dest,
+			bounce_buffer_start(bbstate, (void*)data->dest,
 					    data->blocksize *
 					    data->blocks, GEN_BB_WRITE);
 		} else {
-			bounce_buffer_start(&bbstate, (void*)data->src,
+			bounce_buffer_start(bbstate, (void*)data->src,
 					    data->blocksize *
 					    data->blocks, GEN_BB_READ);
 		}
 		dwmci_prepare_data(host, data, cur_idmac,
-				   bbstate.bounce_buffer);
+				   bbstate->bounce_buffer);
 	}
 
 	dwmci_writel(host, DWMCI_CMDARG, cmd->cmdarg);
@@ -210,24 +213,91 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 		}
 	}
 
-	if (data) {
-		do {
-			mask = dwmci_readl(host, DWMCI_RINTSTS);
-			if (mask & (DWMCI_DATA_ERR | DWMCI_DATA_TOUT)) {
-				printf("%s: DATA ERROR!\n", __func__);
-				return -1;
-			}
-		} while (!(mask & DWMCI_INTMSK_DTO));
+	return 0;
+}
 
-		dwmci_writel(host, DWMCI_RINTSTS, mask);
+/* Wait for the data transfer started by dwmci_send_cmd_common() */
+static int dwmci_data_wait(struct dwmci_host *host)
+{
+	u32 mask, ctrl;
 
-		ctrl = dwmci_readl(host, DWMCI_CTRL);
-		ctrl &= ~(DWMCI_DMA_EN);
-		dwmci_writel(host, DWMCI_CTRL, ctrl);
+	do {
+		mask = dwmci_readl(host, DWMCI_RINTSTS);
+		if (mask & (DWMCI_DATA_ERR | DWMCI_DATA_TOUT)) {
+			printf("%s: DATA ERROR!\n", __func__);
+			return -1;
+		}
+	} while (!(mask & DWMCI_INTMSK_DTO));
+
+	dwmci_writel(host, DWMCI_RINTSTS, mask);
+
+	ctrl = dwmci_readl(host, DWMCI_CTRL);
+	ctrl &= ~(DWMCI_DMA_EN);
+	dwmci_writel(host, DWMCI_CTRL, ctrl);
+
+	bounce_buffer_stop(&host->bbstate);
+
+	return 0;
+}
 
-		bounce_buffer_stop(&bbstate);
+static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+		struct mmc_data *data)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct dwmci_idmac, cur_idmac,
+				 data ? DIV_ROUND_UP(data->blocks, 8) : 0);
+	int ret;
+
+	ret = dwmci_send_cmd_common(mmc, cmd, data, cur_idmac);
+	if (!ret && data)
+		ret = dwmci_data_wait(mmc->priv);
+	if (ret)
+		return ret;
+
+	udelay(100);
+
+	return 0;
+}
+
+/*
+ * The DMA descriptors must last until the data has moved, so they are
+ * allocated here rather than on the stack
+ */
+static int dwmci_send_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd,
+				struct mmc_data *data)
+{
+	struct dwmci_host *host = mmc->priv;
+	int ret;
+
+	if (!data)
+		return dwmci_send_cmd(mmc, cmd, data);
+
+	host->idmac = memalign(ARCH_DMA_MINALIGN,
+			       DIV_ROUND_UP(data->blocks, 8) *
+			       sizeof(struct dwmci_idmac));
+	if (!host->idmac)
+		return -ENOMEM;
+
+	ret = dwmci_send_cmd_common(mmc, cmd, data, host->idmac);
+	if (ret) {
+		free(host->idmac);
+		host->idmac = NULL;
 	}
 
+	return ret;
+}
+
+static int dwmci_send_cmd_wait(struct mmc *mmc, struct mmc_cmd *cmd,
+			       struct mmc_data *data)
+{
+	struct dwmci_host *host = mmc->priv;
+	int ret;
+
+	ret = dwmci_data_wait(host);
+	free(host->idmac);
+	host->idmac = NULL;
+	if (ret)
+		return ret;
+
 	udelay(100);
 
 	return 0;
@@ -368,6 +438,8 @@ static const struct mmc_ops dwmci_ops = {
 	.send_cmd	= dwmci_send_cmd,
 	.set_ios	= dwmci_set_ios,
 	.init		= dwmci_init,
+	.send_cmd_start	= dwmci_send_cmd_start,
+	.send_cmd_wait	= dwmci_send_cmd_wait,
 };
 
 int add_dwmci(struct dwmci_host *host, u32 max_clk, u32 min_clk)
@@ -388,7 +460,7 @@ int add_dwmci(struct dwmci_host *host, u32 max_clk, u32 min_clk)
 		host->cfg.host_caps |= MMC_MODE_4BIT;
 		host->cfg.host_caps &= ~MMC_MODE_8BIT;
 	}
-	host->cfg.host_caps |= MMC_MODE_HS | MMC_MODE_HS_52MHz;
+	host->cfg.host_caps |= MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_CMD23;
 
 	host->cfg.b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
 
@@ -190,33 +190,83 @@ struct mmc *find_mmc_device(int dev_num)
 	return NULL;
 }
 
-static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
-			   lbaint_t blkcnt)
+static int mmc_send_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd,
+			      struct mmc_data *data)
 {
+	if (mmc->cfg->ops->send_cmd_start)
+		return mmc->cfg->ops->send_cmd_start(mmc, cmd, data);
+
+	return mmc_send_cmd(mmc, cmd, data);
+}
+
+/*
+ * Start a transfer of up to mmc_max_blocks(). With SET_BLOCK_COUNT the card
+ * knows where the transfer ends, so it does not need to be stopped.
+ */
+static int mmc_xfer_start(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			  void *buf, uint flags)
+{
+	struct mmc_xfer *xfer = &mmc->xfer;
 	struct mmc_cmd cmd;
-	struct mmc_data data;
+	int write = flags == MMC_DATA_WRITE;
+	uint blksz = write ? mmc->write_bl_len : mmc->read_bl_len;
+	int err;
+
+	xfer->stop = false;
+	if (blkcnt > 1 && (mmc->card_caps & MMC_MODE_CMD23)) {
+		cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+		cmd.cmdarg = blkcnt;
+		cmd.resp_type = MMC_RSP_R1;
+		err = mmc_send_cmd(mmc, &cmd, NULL);
+		if (err)
+			return err;
+	} else if (blkcnt > 1) {
+		/*
+		 * SPI multiblock writes terminate using a special token,
+		 * not a STOP_TRANSMISSION request
+		 */
+		xfer->stop = !write || !mmc_host_is_spi(mmc);
+	}
 
-	if (blkcnt > 1)
-		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+	if (write)
+		xfer->cmd.cmdidx = blkcnt > 1 ? MMC_CMD_WRITE_MULTIPLE_BLOCK :
+				MMC_CMD_WRITE_SINGLE_BLOCK;
 	else
-		cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+		xfer->cmd.cmdidx = blkcnt > 1 ? MMC_CMD_READ_MULTIPLE_BLOCK :
+				MMC_CMD_READ_SINGLE_BLOCK;
 
 	if (mmc->high_capacity)
-		cmd.cmdarg = start;
+		xfer->cmd.cmdarg = start;
 	else
-		cmd.cmdarg = start * mmc->read_bl_len;
+		xfer->cmd.cmdarg = start * blksz;
 
-	cmd.resp_type = MMC_RSP_R1;
+	xfer->cmd.resp_type = MMC_RSP_R1;
 
-	data.dest = dst;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	xfer->data.dest = buf;
+	xfer->data.blocks = blkcnt;
+	xfer->data.blocksize = blksz;
+	xfer->data.flags = flags;
 
-	if (mmc_send_cmd(mmc, &cmd, &data))
+	err = mmc_send_cmd_start(mmc, &xfer->cmd, &xfer->data);
+	if (err)
+		xfer->data.blocks = 0;
+
+	return err;
+}
+
+int mmc_bxfer_wait(struct mmc *mmc)
+{
+	struct mmc_xfer *xfer = &mmc->xfer;
+	struct mmc_cmd cmd;
+	int err = 0;
+
+	if (!xfer->data.blocks)
 		return 0;
+	if (mmc->cfg->ops->send_cmd_start)
+		err = mmc->cfg->ops->send_cmd_wait(mmc, &xfer->cmd,
+						   &xfer->data);
 
-	if (blkcnt > 1) {
+	if (xfer->stop) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -224,22 +274,37 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
 			printf("mmc fail to send stop cmd\n");
 #endif
-			return 0;
+			if (!err)
+				err = COMM_ERR;
 		}
 	}
 
-	return blkcnt;
+	/* A write is not done until the card has finished programming */
+	if (!err && xfer->data.flags == MMC_DATA_WRITE)
+		err = mmc_send_status(mmc, 1000);
+	xfer->data.blocks = 0;
+
+	return err;
 }
 
-static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
+/* Largest transfer the host can do, which SET_BLOCK_COUNT also limits */
+static lbaint_t mmc_max_blocks(struct mmc *mmc)
 {
-	lbaint_t cur, blocks_todo = blkcnt;
+	if (mmc->card_caps & MMC_MODE_CMD23)
+		return min(mmc->cfg->b_max, 0xffffU);
 
-	if (blkcnt == 0)
-		return 0;
+	return mmc->cfg->b_max;
+}
 
-	struct mmc *mmc = find_mmc_device(dev_num);
-	if (!mmc)
+ulong mmc_bxfer_start(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		      void *buf, uint flags)
+{
+	lbaint_t cur, blocks_todo = blkcnt, max_blocks;
+	uint blksz;
+
+	if (mmc_bxfer_wait(mmc))
+		return 0;
+	if (blkcnt == 0)
 		return 0;
 
 	if ((start + blkcnt) > mmc->block_dev.lba) {
@@ -250,18 +315,46 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 		return 0;
 	}
 
-	if (mmc_set_blocklen(mmc, mmc->read_bl_len))
+	blksz = flags == MMC_DATA_WRITE ? mmc->write_bl_len :
+			mmc->read_bl_len;
+	if (mmc_set_blocklen(mmc, blksz))
 		return 0;
 
-	do {
-		cur = (blocks_todo > mmc->cfg->b_max) ?
-			mmc->cfg->b_max : blocks_todo;
-		if(mmc_read_blocks(mmc, dst, start, cur) != cur)
+	/* Everything but the last part is finished before returning */
+	max_blocks = mmc_max_blocks(mmc);
+	for (;;) {
+		cur = min(blocks_todo, max_blocks);
+		if (mmc_xfer_start(mmc, start, cur, buf, flags))
 			return 0;
 		blocks_todo -= cur;
+		if (!blocks_todo)
+			break;
+		if (mmc_bxfer_wait(mmc))
+			return 0;
 		start += cur;
-		dst += cur * mmc->read_bl_len;
-	} while (blocks_todo > 0);
+		buf += cur * blksz;
+	}
+
+	return blkcnt;
+}
+
+ulong mmc_bread_start(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		      void *dst)
+{
+	return mmc_bxfer_start(mmc, start, blkcnt, dst, MMC_DATA_READ);
+}
+
+static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
+{
+	struct mmc *mmc = find_mmc_device(dev_num);
+
+	if (!mmc)
+		return 0;
+
+	if (mmc_bread_start(mmc, start, blkcnt, dst) != blkcnt)
+		return 0;
+	if (mmc_bxfer_wait(mmc))
+		return 0;
 
 	return blkcnt;
 }
@@ -287,54 +380,75 @@ static int mmc_go_idle(struct mmc *mmc)
 	return 0;
 }
 
-static int sd_send_op_cond(struct mmc *mmc)
+static int sd_send_op_cond_iter(struct mmc *mmc)
 {
-	int timeout = 1000;
-	int err;
 	struct mmc_cmd cmd;
+	int err;
 
-	while (1) {
-		cmd.cmdidx = MMC_CMD_APP_CMD;
-		cmd.resp_type = MMC_RSP_R1;
-		cmd.cmdarg = 0;
-
-		err = mmc_send_cmd(mmc, &cmd, NULL);
+	cmd.cmdidx = MMC_CMD_APP_CMD;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
 
-		if (err)
-			return err;
+	err = mmc_send_cmd(mmc, &cmd, NULL);
 
-		cmd.cmdidx = SD_CMD_APP_SEND_OP_COND;
-		cmd.resp_type = MMC_RSP_R3;
+	if (err)
+		return err;
 
-		/*
-		 * Most cards do not answer if some reserved bits
-		 * in the ocr are set. However, Some controller
-		 * can set bit 7 (reserved for low voltages), but
-		 * how to manage low voltages SD card is not yet
-		 * specified.
-		 */
-		cmd.cmdarg = mmc_host_is_spi(mmc) ? 0 :
-			(mmc->cfg->voltages & 0xff8000);
+	cmd.cmdidx = SD_CMD_APP_SEND_OP_COND;
+	cmd.resp_type = MMC_RSP_R3;
 
-		if (mmc->version == SD_VERSION_2)
-			cmd.cmdarg |= OCR_HCS;
+	/*
+	 * Most cards do not answer if some reserved bits
+	 * in the ocr are set. However, Some controller
+	 * can set bit 7 (reserved for low voltages), but
+	 * how to manage low voltages SD card is not yet
+	 * specified.
+	 */
+	cmd.cmdarg = mmc_host_is_spi(mmc) ? 0 :
+		(mmc->cfg->voltages & 0xff8000);
 
-		err = mmc_send_cmd(mmc, &cmd, NULL);
+	if (mmc->version == SD_VERSION_2)
+		cmd.cmdarg |= OCR_HCS;
 
-		if (err)
-			return err;
+	err = mmc_send_cmd(mmc, &cmd, NULL);
 
-		if (cmd.response[0] & OCR_BUSY)
-			break;
+	if (err)
+		return err;
+	mmc->ocr = cmd.response[0];
+	return 0;
+}
 
-		if (timeout-- <= 0)
-			return UNUSABLE_ERR;
+static int sd_send_op_cond(struct mmc *mmc)
+{
+	int err;
 
-		udelay(1000);
-	}
+	err = sd_send_op_cond_iter(mmc);
+	if (err)
+		return err;
 
 	if (mmc->version != SD_VERSION_2)
 		mmc->version = SD_VERSION_1_0;
+	mmc->op_cond_pending = 1;
+	return 0;
+}
+
+static int sd_complete_op_cond(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+	int timeout = 1000;
+	uint start;
+	int err;
+
+	mmc->op_cond_pending = 0;
+	start = get_timer(0);
+	while (!(mmc->ocr & OCR_BUSY)) {
+		if (get_timer(start) > timeout)
+			return UNUSABLE_ERR;
+		udelay(1000);
+		err = sd_send_op_cond_iter(mmc);
+		if (err)
+			return err;
+	}
 
 	if (mmc_host_is_spi(mmc)) { /* read OCR for spi */
 		cmd.cmdidx = MMC_CMD_SPI_READ_OCR;
@@ -345,9 +459,9 @@ static int sd_send_op_cond(struct mmc *mmc)
 
 		if (err)
 			return err;
-	}
 
-	mmc->ocr = cmd.response[0];
+		mmc->ocr = cmd.response[0];
+	}
 
 	mmc->high_capacity = ((mmc->ocr & OCR_HCS) == OCR_HCS);
 	mmc->rca = 0;
@@ -393,6 +507,7 @@ static int mmc_send_op_cond(struct mmc *mmc)
 		if (mmc->ocr & OCR_BUSY)
 			break;
 	}
+	mmc->version = MMC_VERSION_UNKNOWN;
 	mmc->op_cond_pending = 1;
 	return 0;
 }
@@ -496,6 +611,9 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (mmc_host_is_spi(mmc))
 		return 0;
 
+	if (mmc->version >= MMC_VERSION_3)
+		mmc->card_caps |= MMC_MODE_CMD23;
+
 	/* Only version 4 supports high-speed */
 	if (mmc->version < MMC_VERSION_4)
 		return 0;
@@ -910,6 +1028,8 @@ retry_scr:
 
 	if (mmc->scr[0] & SD_DATA_4BIT)
 		mmc->card_caps |= MMC_MODE_4BIT;
+	if (mmc->scr[0] & SD_SCR_CMD23)
+		mmc->card_caps |= MMC_MODE_CMD23;
 
 	/* Version 1.0 doesn't support switching */
 	if (mmc->version == SD_VERSION_1_0)
@@ -1647,7 +1767,8 @@ static int mmc_complete_init(struct mmc *mmc)
 
 	mmc->init_in_progress = 0;
 	if (mmc->op_cond_pending)
-		err = mmc_complete_op_cond(mmc);
+		err = IS_SD(mmc) ? sd_complete_op_cond(mmc) :
+			mmc_complete_op_cond(mmc);
 
 	if (!err)
 		err = mmc_startup(mmc);
@@ -1739,6 +1860,30 @@ void mmc_set_preinit(struct mmc *mmc, int preinit)
 	mmc->preinit = preinit;
 }
 
+int mmc_preinit_poll(void)
+{
+	struct mmc *m;
+	struct list_head *entry;
+	int ret = 0;
+
+	list_for_each(entry, &mmc_devices) {
+		m = list_entry(entry, struct mmc, link);
+
+		if (!m->init_in_progress || !m->op_cond_pending ||
+		    (m->ocr & OCR_BUSY))
+			continue;
+		/* On error, leave it to mmc_complete_init() */
+		if (IS_SD(m) ? sd_send_op_cond_iter(m) :
+		    mmc_send_op_cond_iter(m, 1))
+			continue;
+		if (m->ocr & OCR_BUSY)
+			continue;
+		ret = -EINPROGRESS;
+	}
+
+	return ret;
+}
+
 static void do_preinit(void)
 {
 	struct mmc *m;
@@ -1749,6 +1894,11 @@ static void do_preinit(void)
 
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 		mmc_set_preinit(m, 1);
+#endif
+#ifdef CONFIG_INITCALL_DEFER
+		/* Let cards power up while the rest of init goes on */
+		if (mmc_getcd(m))
+			mmc_set_preinit(m, 1);
 #endif
 		if (m->preinit)
 			mmc_start_init(m);
@@ -124,8 +124,37 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 #endif
 #define CONFIG_SDHCI_CMD_DEFAULT_TIMEOUT	100
 
-static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
-		       struct mmc_data *data)
+static int sdhci_finish_command(struct sdhci_host *host,
+				struct mmc_data *data, int ret)
+{
+	unsigned int stat;
+
+	if (host->quirks & SDHCI_QUIRK_WAIT_SEND_CMD)
+		udelay(1000);
+
+	stat = sdhci_readl(host, SDHCI_INT_STATUS);
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	if (!ret) {
+		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
+				!host->is_aligned && (data->flags == MMC_DATA_READ))
+			memcpy(data->dest, aligned_buffer, host->trans_bytes);
+		return 0;
+	}
+
+	sdhci_reset(host, SDHCI_RESET_CMD);
+	sdhci_reset(host, SDHCI_RESET_DATA);
+	if (stat & SDHCI_INT_TIMEOUT)
+		return TIMEOUT;
+	else
+		return COMM_ERR;
+}
+
+/*
+ * Send the command, returning once the response is in. Any data is left
+ * for sdhci_send_command_wait() to transfer.
+ */
+static int sdhci_send_command_start(struct mmc *mmc, struct mmc_cmd *cmd,
+				    struct mmc_data *data)
 {
 	struct sdhci_host *host = mmc->priv;
 	unsigned int stat = 0;
@@ -221,6 +250,9 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 #ifdef CONFIG_MMC_SDMA
 	flush_cache(start_addr, trans_bytes);
 #endif
+	host->start_addr = start_addr;
+	host->trans_bytes = trans_bytes;
+	host->is_aligned = is_aligned;
 	sdhci_writew(host, SDHCI_MAKE_CMD(cmd->cmdidx, flags), SDHCI_COMMAND);
 	do {
 		stat = sdhci_readl(host, SDHCI_INT_STATUS);
@@ -246,26 +278,32 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		ret = -1;
 
 	if (!ret && data)
-		ret = sdhci_transfer_data(host, data, start_addr);
+		return 0;
 
-	if (host->quirks & SDHCI_QUIRK_WAIT_SEND_CMD)
-		udelay(1000);
+	return sdhci_finish_command(host, data, ret);
+}
 
-	stat = sdhci_readl(host, SDHCI_INT_STATUS);
-	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
-	if (!ret) {
-		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-				!is_aligned && (data->flags == MMC_DATA_READ))
-			memcpy(data->dest, aligned_buffer, trans_bytes);
-		return 0;
-	}
+static int sdhci_send_command_wait(struct mmc *mmc, struct mmc_cmd *cmd,
+				   struct mmc_data *data)
+{
+	struct sdhci_host *host = mmc->priv;
+	int ret;
 
-	sdhci_reset(host, SDHCI_RESET_CMD);
-	sdhci_reset(host, SDHCI_RESET_DATA);
-	if (stat & SDHCI_INT_TIMEOUT)
-		return TIMEOUT;
-	else
-		return COMM_ERR;
+	ret = sdhci_transfer_data(host, data, host->start_addr);
+
+	return sdhci_finish_command(host, data, ret);
+}
+
+static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data)
+{
+	int ret;
+
+	ret = sdhci_send_command_start(mmc, cmd, data);
+	if (ret || !data)
+		return ret;
+
+	return sdhci_send_command_wait(mmc, cmd, data);
 }
 
 static int sdhci_set_clock(struct mmc *mmc, unsigned int clock)
@@ -438,6 +476,8 @@ static const struct mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
 	.set_ios	= sdhci_set_ios,
 	.init		= sdhci_init,
+	.send_cmd_start	= sdhci_send_command_start,
+	.send_cmd_wait	= sdhci_send_command_wait,
 };
 
 int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
@@ -494,7 +534,8 @@ int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
 	if (host->quirks & SDHCI_QUIRK_BROKEN_VOLTAGE)
 		host->cfg.voltages |= host->voltages;
 
-	host->cfg.host_caps = MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT;
+	host->cfg.host_caps = MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT |
+			      MMC_MODE_CMD23;
 	if (SDHCI_GET_VERSION(host) >= SDHCI_SPEC_300) {
 		if (caps & SDHCI_CAN_DO_8BIT)
 			host->cfg.host_caps |= MMC_MODE_8BIT;
@@ -10,6 +10,7 @@
 
 #include <common.h>
 #include <dm.h>
+#include <fdtdec.h>
 #include <malloc.h>
 #include <spi.h>
 #include <os.h>
@@ -56,10 +57,12 @@ static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 #define STAT_WIP	(1 << 0)
 #define STAT_WEL	(1 << 1)
 
-/* Assume all SPI flashes have 3 byte addresses since they do atm */
+/* Commands take 3 address bytes, except the ones for 4-byte addressing */
 #define SF_ADDR_LEN	3
+#define SF_ADDR_LEN_4B	4
 
-#define IDCODE_LEN 3
+/* The JEDEC ID followed by the extended ID */
+#define IDCODE_LEN 5
 
 /* Used to quickly bulk erase backing store */
 static u8 sandbox_sf_0xff[0x1000];
@@ -83,21 +86,34 @@ struct sandbox_spi_flash {
 	uint erase_size;
 	/* Current position in the flash; used when reading/writing/etc... */
 	uint off;
-	/* How many address bytes we've consumed */
-	uint addr_bytes, pad_addr_bytes;
+	/* How many address bytes we've consumed, and how many there are */
+	uint addr_bytes, pad_addr_bytes, addr_len;
 	/* The current flash status (see STAT_XXX defines above) */
 	u16 status;
 	/* Data describing the flash we're emulating */
 	const struct spi_flash_params *data;
 	/* The file on disk to serv up data from */
 	int fd;
+	/* Time in microseconds when the current program/erase finishes */
+	ulong busy_until;
 };
 
+/*
+ * The time taken by each program and erase can be set in microseconds
+ * from the device tree, so that the time taken to update the flash can be
+ * measured. While an operation is in progress the flash shows STAT_WIP and
+ * accepts only status reads. By default operations take no time.
+ */
 struct sandbox_spi_flash_plat_data {
 	const char *filename;
 	const char *device_name;
 	int bus;
 	int cs;
+	uint program_us;
+	uint erase_4k_us;
+	uint erase_32k_us;
+	uint erase_64k_us;
+	uint erase_chip_us;
 };
 
 /**
@@ -221,6 +237,7 @@ static void sandbox_sf_cs_activate(struct udevice *dev)
 	sbsf->off = 0;
 	sbsf->addr_bytes = 0;
 	sbsf->pad_addr_bytes = 0;
+	sbsf->addr_len = SF_ADDR_LEN;
 	sbsf->state = SF_CMD;
 	sbsf->cmd = SF_CMD;
 }
@@ -243,12 +260,53 @@ static void sandbox_spi_tristate(u8 *buf, uint len)
 	memset(buf, 0xff, len);
 }
 
+/* Start a program or erase which takes 'us' microseconds */
+static void sandbox_sf_set_busy(struct sandbox_spi_flash *sbsf, uint us)
+{
+	if (!us)
+		return;
+	sbsf->status |= STAT_WIP;
+	sbsf->busy_until = timer_get_us() + us;
+}
+
+/* Update the status once the current program or erase is finished */
+static void sandbox_sf_check_busy(struct sandbox_spi_flash *sbsf)
+{
+	if ((sbsf->status & STAT_WIP) &&
+	    (long)(timer_get_us() - sbsf->busy_until) >= 0)
+		sbsf->status &= ~STAT_WIP;
+}
+
+static uint sandbox_sf_erase_time(struct sandbox_spi_flash *sbsf,
+				  struct sandbox_spi_flash_plat_data *pdata)
+{
+	switch (sbsf->cmd) {
+	case CMD_ERASE_4K:
+	case CMD_ERASE_4K_4B:
+		return pdata->erase_4k_us;
+	case CMD_ERASE_32K:
+		return pdata->erase_32k_us;
+	case CMD_ERASE_64K:
+	case CMD_ERASE_64K_4B:
+		return pdata->erase_64k_us;
+	default:
+		return pdata->erase_chip_us;
+	}
+}
+
 /* Figure out what command this stream is telling us to do */
 static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 				  u8 *tx)
 {
 	enum sandbox_sf_state oldstate = sbsf->state;
 
+	sandbox_sf_check_busy(sbsf);
+	if ((sbsf->status & STAT_WIP) && rx[0] != CMD_READ_STATUS &&
+	    rx[0] != CMD_READ_STATUS1) {
+		printf("sandbox_sf: cmd %#x while busy\n", rx[0]);
+		return -EIO;
+	}
+
 	/* We need to output a byte for the cmd byte we just ate */
 	if (tx)
 		sandbox_spi_tristate(tx, 1);
@@ -259,8 +317,15 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		sbsf->state = SF_ID;
 		sbsf->cmd = SF_ID;
 		break;
+	case CMD_READ_ARRAY_FAST_4B:
+		sbsf->addr_len = SF_ADDR_LEN_4B;
 	case CMD_READ_ARRAY_FAST:
 		sbsf->pad_addr_bytes = 1;
+		sbsf->state = SF_ADDR;
+		break;
+	case CMD_READ_ARRAY_SLOW_4B:
+	case CMD_PAGE_PROGRAM_4B:
+		sbsf->addr_len = SF_ADDR_LEN_4B;
 	case CMD_READ_ARRAY_SLOW:
 	case CMD_PAGE_PROGRAM:
 		sbsf->state = SF_ADDR;
@@ -286,16 +351,20 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		int flags = sbsf->data->flags;
 
 		/* we only support erase here */
+		if (sbsf->cmd == CMD_ERASE_4K_4B ||
+		    sbsf->cmd == CMD_ERASE_64K_4B)
+			sbsf->addr_len = SF_ADDR_LEN_4B;
 		if (sbsf->cmd == CMD_ERASE_CHIP) {
 			sbsf->erase_size = sbsf->data->sector_size *
 				sbsf->data->nr_sectors;
-		} else if (sbsf->cmd == CMD_ERASE_4K && (flags & SECT_4K)) {
+		} else if ((sbsf->cmd == CMD_ERASE_4K ||
+			    sbsf->cmd == CMD_ERASE_4K_4B) && (flags & SECT_4K)) {
 			sbsf->erase_size = 4 << 10;
 		} else if (sbsf->cmd == CMD_ERASE_32K && (flags & SECT_32K)) {
 			sbsf->erase_size = 32 << 10;
-		} else if (sbsf->cmd == CMD_ERASE_64K &&
-			   !(flags & (SECT_4K | SECT_32K))) {
-			sbsf->erase_size = 64 << 10;
+		} else if (sbsf->cmd == CMD_ERASE_64K ||
+			   sbsf->cmd == CMD_ERASE_64K_4B) {
+			sbsf->erase_size = sbsf->data->sector_size;
 		} else {
 			debug(" cmd unknown: %#x\n", sbsf->cmd);
 			return -EIO;
@@ -332,6 +401,7 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			   const void *rxp, void *txp, unsigned long flags)
 {
 	struct sandbox_spi_flash *sbsf = dev_get_priv(dev);
+	struct sandbox_spi_flash_plat_data *pdata = dev_get_platdata(dev);
 	const uint8_t *rx = rxp;
 	uint8_t *tx = txp;
 	uint cnt, pos = 0;
@@ -360,8 +430,9 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 
 			debug(" id: off:%u tx:", sbsf->off);
 			if (sbsf->off < IDCODE_LEN) {
-				/* Extract correct byte from ID 0x00aabbcc */
-				id = sbsf->data->jedec >>
+				/* Extract correct byte from ID 0xaabbccddee */
+				id = ((u64)sbsf->data->jedec << 16 |
+				      sbsf->data->ext_jedec) >>
 					(8 * (IDCODE_LEN - 1 - sbsf->off));
 			} else {
 				id = 0;
@@ -375,7 +446,7 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			debug(" addr: bytes:%u rx:%02x ", sbsf->addr_bytes,
 			      rx[pos]);
 
-			if (sbsf->addr_bytes++ < SF_ADDR_LEN)
+			if (sbsf->addr_bytes++ < sbsf->addr_len)
 				sbsf->off = (sbsf->off << 8) | rx[pos];
 			debug("addr:%06x\n", sbsf->off);
 
@@ -385,7 +456,7 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 
 			/* See if we're done processing */
 			if (sbsf->addr_bytes <
-					SF_ADDR_LEN + sbsf->pad_addr_bytes)
+					sbsf->addr_len + sbsf->pad_addr_bytes)
 				break;
 
 			/* Next state! */
@@ -396,9 +467,12 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			switch (sbsf->cmd) {
 			case CMD_READ_ARRAY_FAST:
 			case CMD_READ_ARRAY_SLOW:
+			case CMD_READ_ARRAY_FAST_4B:
+			case CMD_READ_ARRAY_SLOW_4B:
 				sbsf->state = SF_READ;
 				break;
 			case CMD_PAGE_PROGRAM:
+			case CMD_PAGE_PROGRAM_4B:
 				sbsf->state = SF_WRITE;
 				break;
 			default:
@@ -426,6 +500,7 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			pos += ret;
 			break;
 		case SF_READ_STATUS:
+			sandbox_sf_check_busy(sbsf);
 			debug(" read status: %#x\n", sbsf->status);
 			cnt = bytes - pos;
 			memset(tx + pos, sbsf->status, cnt);
@@ -464,6 +539,7 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			}
 			pos += ret;
 			sbsf->status &= ~STAT_WEL;
+			sandbox_sf_set_busy(sbsf, pdata->program_us);
 			break;
 		case SF_ERASE:
  case_sf_erase: {
@@ -489,12 +565,10 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 				sandbox_spi_tristate(&tx[pos], cnt);
 			pos += cnt;
 
-			/*
-			 * TODO(vapier@gentoo.org): latch WIP in status, and
-			 * delay before clearing it ?
-			 */
 			ret = sandbox_erase_part(sbsf, sbsf->erase_size);
 			sbsf->status &= ~STAT_WEL;
+			sandbox_sf_set_busy(sbsf, sandbox_sf_erase_time(sbsf,
+									pdata));
 			if (ret) {
 				debug("sandbox_sf: Erase failed\n");
 				goto done;
@@ -526,6 +600,16 @@ int sandbox_sf_ofdata_to_platdata(struct udevice *dev)
 		      __func__, pdata->filename, pdata->device_name);
 		return -EINVAL;
 	}
+	pdata->program_us = fdtdec_get_int(blob, node, "sandbox,program-us",
+					   0);
+	pdata->erase_4k_us = fdtdec_get_int(blob, node, "sandbox,erase-4k-us",
+					    0);
+	pdata->erase_32k_us = fdtdec_get_int(blob, node,
+					     "sandbox,erase-32k-us", 0);
+	pdata->erase_64k_us = fdtdec_get_int(blob, node,
+					     "sandbox,erase-64k-us", 0);
+	pdata->erase_chip_us = fdtdec_get_int(blob, node,
+					      "sandbox,erase-chip-us", 0);
 
 	return 0;
 }
@@ -17,12 +17,16 @@
 
 #include "sf_internal.h"
 
-static void spi_flash_addr(u32 addr, u8 *cmd)
+/* Put the address after the cmd byte, returning the length of the cmd */
+static int spi_flash_addr(struct spi_flash *flash, u32 addr, u8 *cmd)
 {
+	int i;
+
 	/* cmd[0] is actual command */
-	cmd[1] = addr >> 16;
-	cmd[2] = addr >> 8;
-	cmd[3] = addr >> 0;
+	for (i = flash->addr_width; i > 0; i--, addr >>= 8)
+		cmd[i] = addr;
+
+	return 1 + flash->addr_width;
 }
 
 int spi_flash_cmd_read_status(struct spi_flash *flash, u8 *rs)
@@ -263,11 +267,36 @@ int spi_flash_write_common(struct spi_flash *flash, const u8 *cmd,
 	return ret;
 }
 
+/*
+ * Pick the largest erase command which fits the region, so that a large
+ * region needs fewer erases, each of which takes little longer than a 4K one
+ */
+static u32 spi_flash_erase_cmd(struct spi_flash *flash, u32 offset,
+			       size_t len, u8 *cmd)
+{
+	u32 size;
+
+	size = flash->erase_size_64k;
+	if (size > flash->erase_size && !(offset % size) && len >= size) {
+		*cmd = flash->addr_width == SPI_FLASH_4B_ADDR_LEN ?
+			CMD_ERASE_64K_4B : CMD_ERASE_64K;
+		return size;
+	}
+	size = flash->erase_size_32k;
+	if (size > flash->erase_size && !(offset % size) && len >= size) {
+		*cmd = CMD_ERASE_32K;
+		return size;
+	}
+	*cmd = flash->erase_cmd;
+
+	return flash->erase_size;
+}
+
 int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 {
 	u32 erase_size, erase_addr;
-	u8 cmd[SPI_FLASH_CMD_LEN];
-	int ret = -1;
+	u8 cmd[SPI_FLASH_CMD_MAX_LEN];
+	int cmd_len, ret = -1;
 
 	erase_size = flash->erase_size;
 	if (offset % erase_size || len % erase_size) {
@@ -275,25 +304,26 @@ int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 		return -1;
 	}
 
-	cmd[0] = flash->erase_cmd;
 	while (len) {
 		erase_addr = offset;
+		erase_size = spi_flash_erase_cmd(flash, offset, len, &cmd[0]);
 
 #ifdef CONFIG_SF_DUAL_FLASH
 		if (flash->dual_flash > SF_SINGLE_FLASH)
 			spi_flash_dual_flash(flash, &erase_addr);
 #endif
 #ifdef CONFIG_SPI_FLASH_BAR
-		ret = spi_flash_bank(flash, erase_addr);
-		if (ret < 0)
-			return ret;
+		if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN) {
+			ret = spi_flash_bank(flash, erase_addr);
+			if (ret < 0)
+				return ret;
+		}
 #endif
-		spi_flash_addr(erase_addr, cmd);
+		cmd_len = spi_flash_addr(flash, erase_addr, cmd);
 
-		debug("SF: erase %2x %2x %2x %2x (%x)\n", cmd[0], cmd[1],
-		      cmd[2], cmd[3], erase_addr);
+		debug("SF: erase %2x (%x)\n", cmd[0], erase_addr);
 
-		ret = spi_flash_write_common(flash, cmd, sizeof(cmd), NULL, 0);
+		ret = spi_flash_write_common(flash, cmd, cmd_len, NULL, 0);
 		if (ret < 0) {
 			debug("SF: erase failed\n");
 			break;
@@ -309,14 +339,27 @@ int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 int spi_flash_cmd_write_ops(struct spi_flash *flash, u32 offset,
 		size_t len, const void *buf)
 {
+	struct spi_slave *spi = flash->spi;
 	unsigned long byte_addr, page_size;
 	u32 write_addr;
 	size_t chunk_len, actual;
-	u8 cmd[SPI_FLASH_CMD_LEN];
-	int ret = -1;
+	u8 cmd[SPI_FLASH_CMD_MAX_LEN];
+	bool busy = false;
+	int cmd_len, ret;
 
 	page_size = flash->page_size;
 
+	/*
+	 * Keep the bus for the whole write. Each page is set up while the
+	 * previous one is being programmed, and only then do we wait for
+	 * the flash to be ready for it.
+	 */
+	ret = spi_claim_bus(spi);
+	if (ret) {
+		debug("SF: unable to claim SPI bus\n");
+		return ret;
+	}
+
 	cmd[0] = flash->write_cmd;
 	for (actual = 0; actual < len; actual += chunk_len) {
 		write_addr = offset;
@@ -324,34 +367,67 @@ int spi_flash_cmd_write_ops(struct spi_flash *flash, u32 offset,
 #ifdef CONFIG_SF_DUAL_FLASH
 		if (flash->dual_flash > SF_SINGLE_FLASH)
 			spi_flash_dual_flash(flash, &write_addr);
-#endif
-#ifdef CONFIG_SPI_FLASH_BAR
-		ret = spi_flash_bank(flash, write_addr);
-		if (ret < 0)
-			return ret;
 #endif
 		byte_addr = offset % page_size;
 		chunk_len = min(len - actual, (size_t)(page_size - byte_addr));
 
-		if (flash->spi->max_write_size)
+		if (spi->max_write_size)
 			chunk_len = min(chunk_len,
-					(size_t)flash->spi->max_write_size);
+					(size_t)spi->max_write_size);
 
-		spi_flash_addr(write_addr, cmd);
+		cmd_len = spi_flash_addr(flash, write_addr, cmd);
 
-		debug("SF: 0x%p => cmd = { 0x%02x 0x%02x%02x%02x } chunk_len = %zu\n",
-		      buf + actual, cmd[0], cmd[1], cmd[2], cmd[3], chunk_len);
+		debug("SF: 0x%p => cmd = { 0x%02x 0x%08x } chunk_len = %zu\n",
+		      buf + actual, cmd[0], write_addr, chunk_len);
 
-		ret = spi_flash_write_common(flash, cmd, sizeof(cmd),
-					buf + actual, chunk_len);
+		if (busy) {
+			ret = spi_flash_cmd_wait_ready(flash,
+						       SPI_FLASH_PROG_TIMEOUT);
+			if (ret < 0) {
+				debug("SF: write program timed out\n");
+				break;
+			}
+			busy = false;
+		}
+#ifdef CONFIG_SPI_FLASH_BAR
+		/* Changing bank claims and releases the bus itself */
+		if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN &&
+		    write_addr / (SPI_FLASH_16MB_BOUN << flash->shift) !=
+		    flash->bank_curr) {
+			spi_release_bus(spi);
+			ret = spi_flash_bank(flash, write_addr);
+			if (ret < 0)
+				return ret;
+			ret = spi_claim_bus(spi);
+			if (ret)
+				return ret;
+		}
+#endif
+
+		ret = spi_flash_cmd_write_enable(flash);
+		if (ret < 0) {
+			debug("SF: enabling write failed\n");
+			break;
+		}
+
+		ret = spi_flash_cmd_write(spi, cmd, cmd_len,
+					  buf + actual, chunk_len);
 		if (ret < 0) {
 			debug("SF: write failed\n");
 			break;
 		}
+		busy = true;
 
 		offset += chunk_len;
 	}
 
+	if (busy && !ret) {
+		ret = spi_flash_cmd_wait_ready(flash, SPI_FLASH_PROG_TIMEOUT);
+		if (ret < 0)
+			debug("SF: write program timed out\n");
+	}
+	spi_release_bus(spi);
+
 	return ret;
 }
 
@@ -400,34 +476,43 @@ int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		return 0;
 	}
 
-	cmdsz = SPI_FLASH_CMD_LEN + flash->dummy_byte;
+	cmdsz = 1 + flash->addr_width + flash->dummy_byte;
 	cmd = calloc(1, cmdsz);
 	if (!cmd) {
 		debug("SF: Failed to allocate cmd\n");
 		return -ENOMEM;
 	}
 
+	/*
+	 * Each read covers as much as it can with one command: with 4-byte
+	 * addresses, everything up to the end of the flash
+	 */
 	cmd[0] = flash->read_cmd;
 	while (len) {
 		read_addr = offset;
+		read_len = len;
 
 #ifdef CONFIG_SF_DUAL_FLASH
 		if (flash->dual_flash > SF_SINGLE_FLASH)
 			spi_flash_dual_flash(flash, &read_addr);
+		if ((flash->dual_flash & SF_DUAL_STACKED_FLASH) &&
+		    offset < flash->size >> 1)
+			read_len = min(read_len, (flash->size >> 1) - offset);
 #endif
+		if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN) {
 #ifdef CONFIG_SPI_FLASH_BAR
-		bank_sel = spi_flash_bank(flash, read_addr);
-		if (bank_sel < 0)
-			return ret;
+			bank_sel = spi_flash_bank(flash, read_addr);
+			if (bank_sel < 0) {
+				ret = bank_sel;
+				break;
+			}
 #endif
-		remain_len = ((SPI_FLASH_16MB_BOUN << flash->shift) *
-				(bank_sel + 1)) - offset;
-		if (len < remain_len)
-			read_len = len;
-		else
-			read_len = remain_len;
-
-		spi_flash_addr(read_addr, cmd);
+			remain_len = ((SPI_FLASH_16MB_BOUN << flash->shift) *
+					(bank_sel + 1)) - offset;
+			read_len = min(read_len, remain_len);
+		}
+
+		spi_flash_addr(flash, read_addr, cmd);
 
 		ret = spi_flash_read_common(flash, cmd, cmdsz, data, read_len);
 		if (ret < 0) {
@@ -32,6 +32,35 @@ static u8 spi_read_cmds_array[] = {
 	CMD_READ_QUAD_IO_FAST,
 };
 
+/* Get the version of a command which takes a 4-byte address */
+static u8 spi_flash_cmd_4b(u8 cmd)
+{
+	switch (cmd) {
+	case CMD_READ_ARRAY_SLOW:
+		return CMD_READ_ARRAY_SLOW_4B;
+	case CMD_READ_ARRAY_FAST:
+		return CMD_READ_ARRAY_FAST_4B;
+	case CMD_READ_DUAL_OUTPUT_FAST:
+		return CMD_READ_DUAL_OUTPUT_FAST_4B;
+	case CMD_READ_DUAL_IO_FAST:
+		return CMD_READ_DUAL_IO_FAST_4B;
+	case CMD_READ_QUAD_OUTPUT_FAST:
+		return CMD_READ_QUAD_OUTPUT_FAST_4B;
+	case CMD_READ_QUAD_IO_FAST:
+		return CMD_READ_QUAD_IO_FAST_4B;
+	case CMD_PAGE_PROGRAM:
+		return CMD_PAGE_PROGRAM_4B;
+	case CMD_QUAD_PAGE_PROGRAM:
+		return CMD_QUAD_PAGE_PROGRAM_4B;
+	case CMD_ERASE_4K:
+		return CMD_ERASE_4K_4B;
+	case CMD_ERASE_64K:
+		return CMD_ERASE_64K_4B;
+	}
+
+	return cmd;
+}
+
 #ifdef CONFIG_SPI_FLASH_MACRONIX
 static int spi_flash_set_qeb_mxic(struct spi_flash *flash)
 {
@@ -187,6 +216,14 @@ static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 		flash->erase_size = flash->sector_size;
 	}
 
+	/*
+	 * Larger erases can be used for aligned regions. Every flash here
+	 * supports the 64K erase, which is what sector_size is based on.
+	 */
+	flash->erase_size_64k = flash->sector_size;
+	if (params->flags & SECT_32K)
+		flash->erase_size_32k = 32768 << flash->shift;
+
 	/* Now erase size becomes valid sector size */
 	flash->sector_size = flash->erase_size;
 
@@ -226,6 +263,22 @@ static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 		flash->dummy_byte = 1;
 	}
 
+	/*
+	 * Use 4-byte addresses where the flash is over 16MiB and has the
+	 * commands for them. Unlike the bank address register, this leaves
+	 * no state in the flash which a later boot could trip over.
+	 */
+	flash->addr_width = SPI_FLASH_3B_ADDR_LEN;
+	if ((params->flags & ADDR_4B) &&
+	    params->sector_size * params->nr_sectors > SPI_FLASH_16MB_BOUN) {
+		flash->addr_width = SPI_FLASH_4B_ADDR_LEN;
+		flash->read_cmd = spi_flash_cmd_4b(flash->read_cmd);
+		flash->write_cmd = spi_flash_cmd_4b(flash->write_cmd);
+		flash->erase_cmd = spi_flash_cmd_4b(flash->erase_cmd);
+		/* The 32K erase has no 4-byte version */
+		flash->erase_size_32k = 0;
+	}
+
 	/* Poll cmd selection */
 	flash->poll_cmd = CMD_READ_STATUS;
 #ifdef CONFIG_SPI_FLASH_STMICRO
@@ -236,7 +289,8 @@ static int spi_flash_validate_params(struct spi_slave *spi, u8 *idcode,
 	/* Configure the BAR - discover bank cmds and read current bank */
 #ifdef CONFIG_SPI_FLASH_BAR
 	u8 curr_bank = 0;
-	if (flash->size > SPI_FLASH_16MB_BOUN) {
+	if (flash->size > SPI_FLASH_16MB_BOUN &&
+	    flash->addr_width == SPI_FLASH_3B_ADDR_LEN) {
 		int ret;
 
 		flash->bank_read_cmd = (idcode[0] == 0x01) ?
@@ -339,7 +393,10 @@ int spi_flash_probe_slave(struct spi_slave *spi, struct spi_flash *flash)
 	/* Set the quad enable bit - only for quad commands */
 	if ((flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST) ||
 	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST) ||
-	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)) {
+	    (flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST_4B) ||
+	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST_4B) ||
+	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM) ||
+	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM_4B)) {
 		if (spi_flash_set_qeb(flash, idcode[0])) {
 			debug("SF: Fail to set QEB for %02x\n", idcode[0]);
 			ret = -EINVAL;
@@ -364,10 +421,11 @@ int spi_flash_probe_slave(struct spi_slave *spi, struct spi_flash *flash)
 	puts("\n");
 #endif
 #ifndef CONFIG_SPI_FLASH_BAR
-	if (((flash->dual_flash == SF_SINGLE_FLASH) &&
-	     (flash->size > SPI_FLASH_16MB_BOUN)) ||
+	if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN &&
+	    (((flash->dual_flash == SF_SINGLE_FLASH) &&
+	      (flash->size > SPI_FLASH_16MB_BOUN)) ||
 	     ((flash->dual_flash > SF_SINGLE_FLASH) &&
-	     (flash->size > SPI_FLASH_16MB_BOUN << 1))) {
+	      (flash->size > SPI_FLASH_16MB_BOUN << 1)))) {
 		puts("SF: Warning - Only lower 16MiB accessible,");
 		puts(" Full access #define CONFIG_SPI_FLASH_BAR\n");
 	}
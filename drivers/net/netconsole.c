@@ -7,6 +7,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <initcall.h>
 #include <stdio_dev.h>
 #include <net.h>
 
@@ -168,6 +169,12 @@ int nc_input_packet(uchar *pkt, struct in_addr src_ip, unsigned dest_port,
 	return 1;
 }
 
+/* The network may have been left to set up later (CONFIG_INITCALL_DEFER) */
+static void nc_need_net(void)
+{
+	initcall_defer_finish(BOOTSTAGE_ID_ACCUM_NET);
+}
+
 static void nc_send_packet(const char *buf, int len)
 {
 	struct eth_device *eth;
@@ -178,6 +185,7 @@ static void nc_send_packet(const char *buf, int len)
 
 	debug_cond(DEBUG_DEV_PKT, "output: \"%*.*s\"\n", len, len, buf);
 
+	nc_need_net();
 	eth = eth_get_dev();
 	if (eth == NULL)
 		return;
@@ -273,6 +281,7 @@ static int nc_stdio_getc(struct stdio_dev *dev)
 {
 	uchar c;
 
+	nc_need_net();
 	input_recursion = 1;
 
 	net_timeout = 0;	/* no timeout */
@@ -300,6 +309,7 @@ static int nc_stdio_tstc(struct stdio_dev *dev)
 	if (input_size)
 		return 1;
 
+	nc_need_net();
 	eth = eth_get_dev();
 	if (eth && eth->state == ETH_STATE_ACTIVE)
 		return 0;	/* inside net loop */
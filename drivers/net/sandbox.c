@@ -11,10 +11,52 @@
 #include <dm.h>
 #include <malloc.h>
 #include <net.h>
+#include <asm/eth.h>
 #include <asm/test.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* TFTP opcodes and the port (TID) the mock server answers from */
+#define SB_TFTP_PORT		1069
+#define SB_TFTP_RRQ		1
+#define SB_TFTP_DATA		3
+#define SB_TFTP_ACK		4
+#define SB_TFTP_OACK		6
+#define SB_TFTP_MAX_WINDOW	64
+
+/**
+ * struct sb_tftp_server - state of the mock TFTP server
+ *
+ * active: a read request is being served
+ * send_oack: the OACK still has to be sent
+ * client_hwaddr: MAC address of the client
+ * client_ip: IP address of the client
+ * client_port: UDP port of the client
+ * blksize: negotiated block size
+ * windowsize: negotiated window size (RFC 7440)
+ * oack: options acknowledged to the client
+ * oack_len: length of @oack
+ * last_block: number of the final (short) block of the file
+ * next_block: next block to send
+ * window_end: last block of the current window
+ * acked: last block acknowledged by the client
+ */
+struct sb_tftp_server {
+	bool active;
+	bool send_oack;
+	uchar client_hwaddr[ARP_HLEN];
+	struct in_addr client_ip;
+	int client_port;
+	int blksize;
+	int windowsize;
+	char oack[48];
+	int oack_len;
+	ulong last_block;
+	ulong next_block;
+	ulong window_end;
+	ulong acked;
+};
+
 /**
  * struct eth_sandbox_priv - memory for sandbox mock driver
  *
@@ -22,16 +64,21 @@ DECLARE_GLOBAL_DATA_PTR;
  * fake_host_ipaddr: IP address of mocked machine
  * recv_packet_buffer: buffer of the packet returned as received
  * recv_packet_length: length of the packet returned as received
+ * tftp: mock TFTP server
  */
 struct eth_sandbox_priv {
 	uchar fake_host_hwaddr[ARP_HLEN];
 	struct in_addr fake_host_ipaddr;
 	uchar *recv_packet_buffer;
 	int recv_packet_length;
+	struct sb_tftp_server tftp;
 };
 
 static bool disabled[8] = {false};
 static bool skip_timeout;
+static ulong tftp_file_size = 0x10000;
+static ulong tftp_drop_block;
+static struct sandbox_eth_tftp_stats tftp_stats;
 
 /*
  * sandbox_eth_disable_response()
@@ -54,6 +101,170 @@ void sandbox_eth_skip_timeout(void)
 	skip_timeout = true;
 }
 
+/*
+ * sandbox_eth_tftp_setup()
+ *
+ * file_size - Size of the file served for any read request
+ * drop_block - Block number to drop once (0 for none), to simulate loss
+ */
+void sandbox_eth_tftp_setup(ulong file_size, ulong drop_block)
+{
+	tftp_file_size = file_size;
+	tftp_drop_block = drop_block;
+	memset(&tftp_stats, '\0', sizeof(tftp_stats));
+}
+
+/*
+ * sandbox_eth_tftp_get_stats()
+ *
+ * stats - Returns the traffic seen by the mock TFTP server since setup
+ */
+void sandbox_eth_tftp_get_stats(struct sandbox_eth_tftp_stats *stats)
+{
+	*stats = tftp_stats;
+}
+
+/* Fill in the Ethernet/IP/UDP headers of a packet to the TFTP client */
+static int sb_tftp_packet(struct eth_sandbox_priv *priv, int len)
+{
+	struct sb_tftp_server *tftp = &priv->tftp;
+	struct ethernet_hdr *eth = (void *)priv->recv_packet_buffer;
+	struct ip_udp_hdr *ip = (void *)priv->recv_packet_buffer +
+		ETHER_HDR_SIZE;
+
+	memcpy(eth->et_dest, tftp->client_hwaddr, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+
+	net_set_ip_header((uchar *)ip, tftp->client_ip,
+			  priv->fake_host_ipaddr);
+	ip->ip_len = htons(IP_UDP_HDR_SIZE + len);
+	ip->ip_p = IPPROTO_UDP;
+	ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+	ip->udp_src = htons(SB_TFTP_PORT);
+	ip->udp_dst = htons(tftp->client_port);
+	ip->udp_len = htons(UDP_HDR_SIZE + len);
+	ip->udp_xsum = 0;
+
+	return ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+}
+
+/* Produce the next packet the mock TFTP server has queued, if any */
+static int sb_tftp_recv(struct eth_sandbox_priv *priv)
+{
+	struct sb_tftp_server *tftp = &priv->tftp;
+	__be16 *s = (void *)priv->recv_packet_buffer + ETHER_HDR_SIZE +
+		IP_UDP_HDR_SIZE;
+	uchar *data = (uchar *)(s + 2);
+	ulong offset;
+	int len, i;
+
+	if (!tftp->active)
+		return 0;
+
+	if (tftp->send_oack) {
+		tftp->send_oack = false;
+		s[0] = htons(SB_TFTP_OACK);
+		memcpy(s + 1, tftp->oack, tftp->oack_len);
+		return sb_tftp_packet(priv, 2 + tftp->oack_len);
+	}
+
+	if (tftp_drop_block && tftp->next_block == tftp_drop_block) {
+		tftp_drop_block = 0;
+		tftp->next_block++;
+	}
+	if (tftp->next_block > tftp->window_end)
+		return 0;
+
+	offset = (tftp->next_block - 1) * tftp->blksize;
+	len = min(tftp_file_size - offset, (ulong)tftp->blksize);
+	for (i = 0; i < len; i++)
+		data[i] = sandbox_eth_tftp_byte(offset + i);
+	s[0] = htons(SB_TFTP_DATA);
+	s[1] = htons((ushort)tftp->next_block);
+	tftp->next_block++;
+	tftp_stats.blocks++;
+
+	return sb_tftp_packet(priv, 4 + len);
+}
+
+/* Handle a read request or ACK sent to the mock TFTP server */
+static void sb_tftp_send(struct eth_sandbox_priv *priv,
+			 struct ethernet_hdr *eth, struct ip_udp_hdr *ip)
+{
+	struct sb_tftp_server *tftp = &priv->tftp;
+	char *pkt = (char *)(ip + 1);
+	int len = ntohs(ip->udp_len) - UDP_HDR_SIZE;
+	char *end = pkt + len;
+	__be16 *s = (__be16 *)pkt;
+	ulong block;
+	char *opt;
+
+	if (len < 4)
+		return;
+
+	if (ntohs(ip->udp_dst) == 69 && ntohs(s[0]) == SB_TFTP_RRQ) {
+		memset(tftp, '\0', sizeof(*tftp));
+		memcpy(tftp->client_hwaddr, eth->et_src, ARP_HLEN);
+		tftp->client_ip = net_read_ip(&ip->ip_src);
+		tftp->client_port = ntohs(ip->udp_src);
+		tftp->blksize = 512;
+		tftp->windowsize = 1;
+
+		/* skip the file name and mode, then look at the options */
+		opt = pkt + 2;
+		opt += strlen(opt) + 1;
+		opt += strlen(opt) + 1;
+		while (opt < end) {
+			char *val = opt + strlen(opt) + 1;
+			int ack = -1;
+
+			if (val >= end)
+				break;
+			if (!strcmp(opt, "blksize")) {
+				tftp->blksize = simple_strtoul(val, NULL, 10);
+				ack = tftp->blksize;
+			} else if (!strcmp(opt, "windowsize")) {
+				tftp->windowsize = min(SB_TFTP_MAX_WINDOW,
+					(int)simple_strtoul(val, NULL, 10));
+				ack = tftp->windowsize;
+			}
+			if (ack >= 0)
+				tftp->oack_len += sprintf(tftp->oack +
+							  tftp->oack_len,
+							  "%s%c%d%c", opt, 0,
+							  ack, 0);
+			opt = val + strlen(val) + 1;
+		}
+
+		tftp->last_block = tftp_file_size / tftp->blksize + 1;
+		tftp->active = true;
+		if (tftp->oack_len) {
+			tftp->send_oack = true;
+		} else {
+			tftp->next_block = 1;
+			tftp->window_end = 1;
+		}
+	} else if (ntohs(ip->udp_dst) == SB_TFTP_PORT && tftp->active &&
+		   ntohs(s[0]) == SB_TFTP_ACK) {
+		tftp_stats.acks++;
+
+		/* extend the 16-bit block number */
+		block = (tftp->acked & ~0xffffUL) | ntohs(s[1]);
+		if (block < tftp->acked)
+			block += 0x10000;
+		tftp->acked = block;
+
+		if (block >= tftp->last_block) {
+			tftp->active = false;
+			return;
+		}
+		tftp->next_block = block + 1;
+		tftp->window_end = min(block + tftp->windowsize,
+				       tftp->last_block);
+	}
+}
+
 static int sb_eth_start(struct udevice *dev)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -146,6 +357,8 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 
 				priv->recv_packet_length = length;
 			}
+		} else if (ip->ip_p == IPPROTO_UDP) {
+			sb_tftp_send(priv, eth, ip);
 		}
 	}
 
@@ -155,6 +368,7 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int length;
 
 	if (skip_timeout) {
 		sandbox_timer_add_offset(10000UL);
@@ -170,6 +384,14 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		*packetp = priv->recv_packet_buffer;
 		return lcl_recv_packet_length;
 	}
+
+	/* the mock TFTP server produces its packets as they are read */
+	length = sb_tftp_recv(priv);
+	if (length) {
+		debug("eth_sandbox: received TFTP packet %d\n", length);
+		*packetp = priv->recv_packet_buffer;
+		return length;
+	}
 	return 0;
 }
 
@@ -28,9 +28,12 @@ DECLARE_GLOBAL_DATA_PTR;
  *
  * invariants:
  *   serial_buf_write		 == serial_buf_read -> empty buffer
- *   (serial_buf_write + 1) % 16 == serial_buf_read -> full buffer
+ *   (serial_buf_write + 1) % 1024 == serial_buf_read -> full buffer
+ *
+ * This is large enough to take input from a program sending a file at full
+ * speed, e.g. tools/sersend.
  */
-static char serial_buf[16];
+static char serial_buf[1024];
 static unsigned int serial_buf_write;
 static unsigned int serial_buf_read;
 
@@ -106,25 +109,35 @@ static unsigned int increment_buffer_index(unsigned int index)
 
 static int sandbox_serial_pending(struct udevice *dev, bool input)
 {
-	const unsigned int next_index =
-		increment_buffer_index(serial_buf_write);
+	unsigned int space;
 	ssize_t count;
 
 	if (!input)
 		return 0;
 
+	/* Read as much as will fit before the end of the buffer */
+	if (serial_buf_write >= serial_buf_read)
+		space = ARRAY_SIZE(serial_buf) - serial_buf_write -
+			(serial_buf_read ? 0 : 1);
+	else
+		space = serial_buf_read - serial_buf_write - 1;
+	if (space) {
+		count = os_read_no_block(0, &serial_buf[serial_buf_write],
+					 space);
+		if (count > 0)
+			serial_buf_write = (serial_buf_write + count) %
+				ARRAY_SIZE(serial_buf);
+	}
+	if (serial_buf_write != serial_buf_read)
+		return 1;
+
+	/* Nothing waiting, so don't spin while the user thinks */
 	os_usleep(100);
 #ifdef CONFIG_LCD
 	lcd_sync();
 #endif
-	if (next_index == serial_buf_read)
-		return 1;	/* buffer full */
 
-	count = os_read_no_block(0, &serial_buf[serial_buf_write], 1);
-	if (count == 1)
-		serial_buf_write = next_index;
-
-	return serial_buf_write != serial_buf_read;
+	return 0;
 }
 
 static int sandbox_serial_getc(struct udevice *dev)
@@ -134,7 +147,8 @@ static int sandbox_serial_getc(struct udevice *dev)
 	if (!sandbox_serial_pending(dev, true))
 		return -EAGAIN;	/* buffer empty */
 
-	result = serial_buf[serial_buf_read];
+	/* Binary input must not look like an error code */
+	result = (uchar)serial_buf[serial_buf_read];
 	serial_buf_read = increment_buffer_index(serial_buf_read);
 	return result;
 }
@@ -9,6 +9,7 @@
 #include <environment.h>
 #include <errno.h>
 #include <fdtdec.h>
+#include <malloc.h>
 #include <os.h>
 #include <serial.h>
 #include <stdio_dev.h>
@@ -96,6 +97,65 @@ void serial_initialize(void)
 	serial_find_console_or_panic();
 }
 
+#ifdef CONFIG_SERIAL_RX_BUFFER
+/*
+ * Move any characters waiting in the UART into the input buffer, so that
+ * the UART's own FIFO does not overflow while we are busy elsewhere
+ */
+static void serial_rx_fill(struct udevice *dev)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+	int ch;
+
+	if (!upriv->buf)
+		return;
+	while (upriv->wr_ptr - upriv->rd_ptr < CONFIG_SERIAL_RX_BUFFER_SIZE &&
+	       ops->pending(dev, true) > 0) {
+		ch = ops->getc(dev);
+		if (ch < 0)
+			break;
+		upriv->buf[upriv->wr_ptr++ % CONFIG_SERIAL_RX_BUFFER_SIZE] = ch;
+	}
+}
+
+/* Check for input in the buffer, returning -ENOSYS if there is no buffer */
+static int serial_rx_pending(struct udevice *dev)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+
+	if (!upriv->buf)
+		return -ENOSYS;
+	serial_rx_fill(dev);
+
+	return upriv->rd_ptr != upriv->wr_ptr;
+}
+
+/* Read a character from the buffer, returning -EAGAIN if it is empty */
+static int serial_rx_getc(struct udevice *dev)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+
+	if (serial_rx_pending(dev) <= 0)
+		return -EAGAIN;
+
+	return (uchar)upriv->buf[upriv->rd_ptr++ %
+				 CONFIG_SERIAL_RX_BUFFER_SIZE];
+}
+#else
+static inline void serial_rx_fill(struct udevice *dev) {}
+
+static inline int serial_rx_pending(struct udevice *dev)
+{
+	return -ENOSYS;
+}
+
+static inline int serial_rx_getc(struct udevice *dev)
+{
+	return -EAGAIN;
+}
+#endif
+
 static void _serial_putc(struct udevice *dev, char ch)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
@@ -103,6 +163,8 @@ static void _serial_putc(struct udevice *dev, char ch)
 
 	do {
 		err = ops->putc(dev, ch);
+		if (err == -EAGAIN)
+			serial_rx_fill(dev);
 	} while (err == -EAGAIN);
 	if (ch == '\n')
 		_serial_putc(dev, '\r');
@@ -119,6 +181,9 @@ static int _serial_getc(struct udevice *dev)
 	struct dm_serial_ops *ops = serial_get_ops(dev);
 	int err;
 
+	err = serial_rx_getc(dev);
+	if (err >= 0)
+		return err;
 	do {
 		err = ops->getc(dev);
 		if (err == -EAGAIN)
@@ -131,7 +196,11 @@ static int _serial_getc(struct udevice *dev)
 static int _serial_tstc(struct udevice *dev)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
+	int ret;
 
+	ret = serial_rx_pending(dev);
+	if (ret != -ENOSYS)
+		return ret;
 	if (ops->pending)
 		return ops->pending(dev, true);
 
@@ -256,8 +325,10 @@ U_BOOT_ENV_CALLBACK(baudrate, on_baudrate);
 static int serial_post_probe(struct udevice *dev)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
-#ifdef CONFIG_DM_STDIO
+#if defined(CONFIG_DM_STDIO) || defined(CONFIG_SERIAL_RX_BUFFER)
 	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+#endif
+#ifdef CONFIG_DM_STDIO
 	struct stdio_dev sdev;
 #endif
 	int ret;
@@ -285,6 +356,15 @@ static int serial_post_probe(struct udevice *dev)
 			return ret;
 	}
 
+#ifdef CONFIG_SERIAL_RX_BUFFER
+	/* Leave the small pre-relocation malloc() area alone */
+	if ((gd->flags & GD_FLG_RELOC) && ops->pending) {
+		/* Without a buffer, input is read straight from the UART */
+		upriv->buf = malloc(CONFIG_SERIAL_RX_BUFFER_SIZE);
+		if (!upriv->buf)
+			debug("%s: no input buffer\n", dev->name);
+	}
+#endif
 #ifdef CONFIG_DM_STDIO
 	if (!(gd->flags & GD_FLG_RELOC))
 		return 0;
@@ -304,12 +384,18 @@ static int serial_post_probe(struct udevice *dev)
 
 static int serial_pre_remove(struct udevice *dev)
 {
-#ifdef CONFIG_SYS_STDIO_DEREGISTER
+#if defined(CONFIG_SYS_STDIO_DEREGISTER) || defined(CONFIG_SERIAL_RX_BUFFER)
 	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+#endif
 
+#ifdef CONFIG_SYS_STDIO_DEREGISTER
 	if (stdio_deregister_dev(upriv->sdev, 0))
 		return -EPERM;
 #endif
+#ifdef CONFIG_SERIAL_RX_BUFFER
+	free(upriv->buf);
+	upriv->buf = NULL;
+#endif
 
 	return 0;
 }
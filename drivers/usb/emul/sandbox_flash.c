@@ -6,6 +6,7 @@
  */
 
 #include <common.h>
+#include <div64.h>
 #include <dm.h>
 #include <os.h>
 #include <scsi.h>
@@ -17,6 +18,9 @@ DECLARE_GLOBAL_DATA_PTR;
  * This driver emulates a flash stick using the UFI command specification and
  * the BBB (bulk/bulk/bulk) protocol. It supports only a single logical unit
  * number (LUN 0).
+ *
+ * It can also pretend to be as slow as a real stick, so that the effect of
+ * changes to the USB stack on read throughput can be measured.
  */
 
 enum {
@@ -59,8 +63,18 @@ struct sandbox_flash_priv {
 	u8 buff[512];
 };
 
+/**
+ * struct sandbox_flash_plat - platform data for this driver
+ *
+ * @pathname:	Backing file to emulate
+ * @command_us:	Time taken to handle each command, in microseconds
+ * @read_kbs:	Rate at which data is read, in KB per second, or 0 for no
+ *		limit
+ */
 struct sandbox_flash_plat {
 	const char *pathname;
+	uint command_us;
+	uint read_kbs;
 };
 
 struct scsi_inquiry_resp {
@@ -303,6 +317,7 @@ static int handle_ufi_command(struct sandbox_flash_priv *priv, const void *buff,
 static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 			      unsigned long pipe, void *buff, int len)
 {
+	struct sandbox_flash_plat *plat = dev_get_platdata(dev);
 	struct sandbox_flash_priv *priv = dev_get_priv(dev);
 	int ep = usb_pipeendpoint(pipe);
 	struct umass_bbb_cbw *cbw = buff;
@@ -325,6 +340,8 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 				goto err;
 			priv->transfer_len = cbw->dCBWDataTransferLength;
 			priv->tag = cbw->dCBWTag;
+			if (plat->command_us)
+				udelay(plat->command_us);
 			return handle_ufi_command(priv, cbw->CBWCDB,
 						  cbw->bCDBLength);
 		case PHASE_DATA:
@@ -344,6 +361,9 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 				bytes_read = os_read(priv->fd, buff, len);
 				if (bytes_read != len)
 					return -EIO;
+				if (plat->read_kbs)
+					udelay(lldiv((u64)len * 1000000,
+						     plat->read_kbs * 1024));
 				priv->read_len -= len / SANDBOX_FLASH_BLOCK_LEN;
 				if (!priv->read_len)
 					priv->phase = PHASE_STATUS;
@@ -378,6 +398,10 @@ static int sandbox_flash_ofdata_to_platdata(struct udevice *dev)
 
 	plat->pathname = fdt_getprop(blob, dev->of_offset, "sandbox,filepath",
 				     NULL);
+	plat->command_us = fdtdec_get_int(blob, dev->of_offset,
+					  "sandbox,command-us", 0);
+	plat->read_kbs = fdtdec_get_int(blob, dev->of_offset,
+					"sandbox,read-kbs", 0);
 
 	return 0;
 }
@@ -188,11 +188,21 @@ static void handle_getstatus(struct usb_request *req)
 	struct dfu_status *dstat = (struct dfu_status *)req->buf;
 	struct f_dfu *f_dfu = req->context;
 	struct dfu_entity *dfu = dfu_get_entity(f_dfu->altsetting);
+	unsigned int busy_ms = 0;
 
 	dfu_set_poll_timeout(dstat, 0);
 
 	switch (f_dfu->dfu_state) {
 	case DFU_STATE_dfuDNLOAD_SYNC:
+		/*
+		 * If the next block would have to wait for the medium, tell
+		 * the host to wait instead
+		 */
+		busy_ms = min(dfu_get_write_timeout(dfu, DFU_USB_BUFSIZ),
+			      (unsigned int)DFU_POLL_TIMEOUT_MASK);
+		f_dfu->dfu_state = busy_ms ? DFU_STATE_dfuDNBUSY :
+				   DFU_STATE_dfuDNLOAD_IDLE;
+		break;
 	case DFU_STATE_dfuDNBUSY:
 		f_dfu->dfu_state = DFU_STATE_dfuDNLOAD_IDLE;
 		break;
@@ -210,6 +220,8 @@ static void handle_getstatus(struct usb_request *req)
 		if (!(f_dfu->blk_seq_num %
 		      (dfu_get_buf_size() / DFU_USB_BUFSIZ)))
 			dfu_set_poll_timeout(dstat, f_dfu->poll_timeout);
+	if (busy_ms)
+		dfu_set_poll_timeout(dstat, busy_ms);
 
 	/* send status response */
 	dstat->bStatus = f_dfu->dfu_status;
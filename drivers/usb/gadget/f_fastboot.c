@@ -39,12 +39,25 @@
 
 #define EP_BUFFER_SIZE			4096
 
+/*
+ * Downloads are received straight into the download buffer. Two requests are
+ * kept queued, so that the controller can fill one while the other is dealt
+ * with.
+ */
+#define RX_REQ_SIZE			(64 * 1024)
+#define RX_REQ_COUNT			2
+
+/* Space for the download, in whole high-speed packets */
+#define FASTBOOT_BUF_SIZE	(CONFIG_USB_FASTBOOT_BUF_SIZE & \
+				 ~(RX_ENDPOINT_MAXIMUM_PACKET_SIZE_2_0 - 1))
+
 struct f_fastboot {
 	struct usb_function usb_function;
 
 	/* IN/OUT EP's and corresponding requests */
 	struct usb_ep *in_ep, *out_ep;
 	struct usb_request *in_req, *out_req;
+	struct usb_request *dl_req[RX_REQ_COUNT];
 };
 
 static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
@@ -55,6 +68,7 @@ static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
 static struct f_fastboot *fastboot_func;
 static unsigned int download_size;
 static unsigned int download_bytes;
+static unsigned int download_queued;
 static bool is_high_speed;
 
 static struct usb_endpoint_descriptor fs_ep_in = {
@@ -123,6 +137,7 @@ static struct usb_gadget_strings *fastboot_strings[] = {
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req);
+static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req);
 static int strcmp_l1(const char *s1, const char *s2);
 
 static void fastboot_complete(struct usb_ep *ep, struct usb_request *req)
@@ -179,10 +194,26 @@ static void fastboot_unbind(struct usb_configuration *c, struct usb_function *f)
 static void fastboot_disable(struct usb_function *f)
 {
 	struct f_fastboot *f_fb = func_to_fastboot(f);
+	int i;
 
 	usb_ep_disable(f_fb->out_ep);
 	usb_ep_disable(f_fb->in_ep);
 
+	/*
+	 * Drop any download cut short, so that commands are received again
+	 * once the host comes back
+	 */
+	download_size = 0;
+	download_bytes = 0;
+	download_queued = 0;
+
+	/* These point into the download buffer, so have nothing to free */
+	for (i = 0; i < RX_REQ_COUNT; i++) {
+		if (f_fb->dl_req[i]) {
+			usb_ep_free_request(f_fb->out_ep, f_fb->dl_req[i]);
+			f_fb->dl_req[i] = NULL;
+		}
+	}
 	if (f_fb->out_req) {
 		free(f_fb->out_req->buf);
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
@@ -217,7 +248,7 @@ static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
 static int fastboot_set_alt(struct usb_function *f,
 			    unsigned interface, unsigned alt)
 {
-	int ret;
+	int ret, i;
 	struct usb_composite_dev *cdev = f->config->cdev;
 	struct usb_gadget *gadget = cdev->gadget;
 	struct f_fastboot *f_fb = func_to_fastboot(f);
@@ -246,6 +277,16 @@ static int fastboot_set_alt(struct usb_function *f,
 	}
 	f_fb->out_req->complete = rx_handler_command;
 
+	for (i = 0; i < RX_REQ_COUNT; i++) {
+		f_fb->dl_req[i] = usb_ep_alloc_request(f_fb->out_ep, 0);
+		if (!f_fb->dl_req[i]) {
+			puts("failed to alloc download req\n");
+			ret = -EINVAL;
+			goto err;
+		}
+		f_fb->dl_req[i]->complete = rx_handler_dl_image;
+	}
+
 	ret = usb_ep_enable(f_fb->in_ep, &fs_ep_in);
 	if (ret) {
 		puts("failed to enable in ep\n");
@@ -377,7 +418,7 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 		!strcmp_l1("max-download-size", cmd)) {
 		char str_num[12];
 
-		sprintf(str_num, "0x%08x", CONFIG_USB_FASTBOOT_BUF_SIZE);
+		sprintf(str_num, "0x%08x", FASTBOOT_BUF_SIZE);
 		strncat(response, str_num, chars_left);
 	} else if (!strcmp_l1("serialno", cmd)) {
 		s = getenv("serial#");
@@ -394,12 +435,12 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 
 static unsigned int rx_bytes_expected(unsigned int maxpacket)
 {
-	int rx_remain = download_size - download_bytes;
+	int rx_remain = download_size - download_queued;
 	int rem = 0;
-	if (rx_remain < 0)
+	if (rx_remain <= 0)
 		return 0;
-	if (rx_remain > EP_BUFFER_SIZE)
-		return EP_BUFFER_SIZE;
+	if (rx_remain > RX_REQ_SIZE)
+		return RX_REQ_SIZE;
 	if (rx_remain < maxpacket) {
 		rx_remain = maxpacket;
 	} else if (rx_remain % maxpacket != 0) {
@@ -409,26 +450,42 @@ static unsigned int rx_bytes_expected(unsigned int maxpacket)
 	return rx_remain;
 }
 
+/* Queue a request for the next part of the download, if there is more */
+static void fastboot_queue_dl(struct usb_ep *ep, struct usb_request *req)
+{
+	unsigned int max;
+
+	max = is_high_speed ? hs_ep_out.wMaxPacketSize :
+			fs_ep_out.wMaxPacketSize;
+	req->length = rx_bytes_expected(max);
+	if (!req->length)
+		return;
+	if (req->length < ep->maxpacket)
+		req->length = ep->maxpacket;
+	req->buf = (void *)CONFIG_USB_FASTBOOT_BUF_ADDR + download_queued;
+	req->actual = 0;
+	download_queued += req->length;
+	usb_ep_queue(ep, req, 0);
+}
+
 #define BYTES_PER_DOT	0x20000
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
+	struct usb_request *out_req = fastboot_func->out_req;
 	char response[RESPONSE_LEN];
 	unsigned int transfer_size = download_size - download_bytes;
-	const unsigned char *buffer = req->buf;
-	unsigned int buffer_size = req->actual;
 	unsigned int pre_dot_num, now_dot_num;
-	unsigned int max;
 
 	if (req->status != 0) {
 		printf("Bad status: %d\n", req->status);
 		return;
 	}
 
-	if (buffer_size < transfer_size)
-		transfer_size = buffer_size;
+	if (req->actual < transfer_size)
+		transfer_size = req->actual;
 
-	memcpy((void *)CONFIG_USB_FASTBOOT_BUF_ADDR + download_bytes,
-	       buffer, transfer_size);
+	/* Keep the controller busy while this data is dealt with */
+	fastboot_queue_dl(ep, req);
 
 	pre_dot_num = download_bytes / BYTES_PER_DOT;
 	download_bytes += transfer_size;
@@ -440,6 +497,10 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 			putc('\n');
 	}
 
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	fb_mmc_stream_data(download_bytes);
+#endif
+
 	/* Check if transfer is done */
 	if (download_bytes >= download_size) {
 		/*
@@ -447,50 +508,49 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		 * it will be used in the next possible flashing command
 		 */
 		download_size = 0;
-		req->complete = rx_handler_command;
-		req->length = EP_BUFFER_SIZE;
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+		fb_mmc_stream_end(download_bytes);
+#endif
 
 		sprintf(response, "OKAY");
 		fastboot_tx_write_str(response);
 
 		printf("\ndownloading of %d bytes finished\n", download_bytes);
-	} else {
-		max = is_high_speed ? hs_ep_out.wMaxPacketSize :
-				fs_ep_out.wMaxPacketSize;
-		req->length = rx_bytes_expected(max);
-		if (req->length < ep->maxpacket)
-			req->length = ep->maxpacket;
-	}
 
-	req->actual = 0;
-	usb_ep_queue(ep, req, 0);
+		/* Go back to waiting for commands */
+		out_req->length = EP_BUFFER_SIZE;
+		out_req->actual = 0;
+		usb_ep_queue(ep, out_req, 0);
+	}
 }
 
 static void cb_download(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
 	char response[RESPONSE_LEN];
-	unsigned int max;
+	int i;
 
 	strsep(&cmd, ":");
 	download_size = simple_strtoul(cmd, NULL, 16);
 	download_bytes = 0;
+	download_queued = 0;
 
 	printf("Starting download of %d bytes\n", download_size);
 
 	if (0 == download_size) {
 		sprintf(response, "FAILdata invalid size");
-	} else if (download_size > CONFIG_USB_FASTBOOT_BUF_SIZE) {
+	} else if (download_size > FASTBOOT_BUF_SIZE) {
 		download_size = 0;
 		sprintf(response, "FAILdata too large");
 	} else {
 		sprintf(response, "DATA%08x", download_size);
-		req->complete = rx_handler_dl_image;
-		max = is_high_speed ? hs_ep_out.wMaxPacketSize :
-			fs_ep_out.wMaxPacketSize;
-		req->length = rx_bytes_expected(max);
-		if (req->length < ep->maxpacket)
-			req->length = ep->maxpacket;
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+		fb_mmc_stream_start((void *)CONFIG_USB_FASTBOOT_BUF_ADDR,
+				    download_size);
+#endif
+		/* The command request is not queued again until the end */
+		for (i = 0; i < RX_REQ_COUNT; i++)
+			fastboot_queue_dl(ep, fastboot_func->dl_req[i]);
 	}
 	fastboot_tx_write_str(response);
 }
@@ -561,6 +621,12 @@ static void cb_oem(struct usb_ep *ep, struct usb_request *req)
                 else
 			fastboot_tx_write_str("OKAY");
 	} else
+#endif
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	if (strncmp("stream", cmd + 4, 6) == 0) {
+		fb_mmc_stream_select(cmd + 10);
+		fastboot_tx_write_str("OKAY");
+	} else
 #endif
 	if (strncmp("unlock", cmd + 4, 8) == 0) {
 		fastboot_tx_write_str("FAILnot implemented");
@@ -656,7 +722,8 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 		}
 	}
 
-	if (req->status == 0) {
+	/* During a download, the command request waits until it is done */
+	if (req->status == 0 && !download_size) {
 		*cmdbuf = '\0';
 		req->actual = 0;
 		usb_ep_queue(ep, req, 0);
@@ -994,6 +994,13 @@ static int do_write(struct fsg_common *common)
 			return rc;
 	}
 
+	/* FUA: the data must be on the medium before we reply */
+	if (common->cmnd[0] != SC_WRITE_6 && (common->cmnd[1] & 0x08) &&
+	    curlun->sense_data == SS_NO_SENSE && fsg_lun_fsync_sub(curlun)) {
+		curlun->sense_data = SS_WRITE_ERROR;
+		curlun->info_valid = 1;
+	}
+
 	return -EIO;		/* No default reply */
 }
 
@@ -1001,6 +1008,12 @@ static int do_write(struct fsg_common *common)
 
 static int do_synchronize_cache(struct fsg_common *common)
 {
+	struct fsg_lun	*curlun = &common->luns[common->lun];
+
+	/* We ignore the requested LBA and write out all the dirty
+	 * data buffers. */
+	if (fsg_lun_fsync_sub(curlun))
+		curlun->sense_data = SS_WRITE_ERROR;
 	return 0;
 }
 
@@ -1335,6 +1348,13 @@ static int do_start_stop(struct fsg_common *common)
 		return -EINVAL;
 	}
 
+	/* Write out the dirty data before the medium is stopped or
+	 * ejected */
+	if (!(common->cmnd[4] & 0x01) && fsg_lun_fsync_sub(curlun)) {
+		curlun->sense_data = SS_WRITE_ERROR;
+		return -EINVAL;
+	}
+
 	return 0;
 }
 
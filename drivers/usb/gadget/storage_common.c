@@ -587,10 +587,13 @@ static void fsg_lun_close(struct fsg_lun *curlun)
 
 /*
  * Sync the file data, don't bother with the metadata.
- * This code was copied from fs/buffer.c:sys_fdatasync().
+ * Here that means writing back anything the UMS backend has cached.
  */
 static int fsg_lun_fsync_sub(struct fsg_lun *curlun)
 {
+	if (ums->flush)
+		return ums->flush(ums);
+
 	return 0;
 }
 
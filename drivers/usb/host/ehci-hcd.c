@@ -339,6 +339,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	int qtd_count = 0;
 	int qtd_counter = 0;
 	volatile struct qTD *vtd;
+	unsigned long vtd_start, vtd_end;
 	unsigned long ts;
 	uint32_t *tdp;
 	uint32_t endpt, maxpacket, token, usbsts;
@@ -598,18 +599,21 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		goto fail;
 	}
 
-	/* Wait for TDs to be processed. */
+	/*
+	 * Wait for TDs to be processed. Only the last qTD is polled, since a
+	 * large transfer has thousands of them and invalidating the whole
+	 * chain each time round would slow the loop down for no benefit. The
+	 * controller is the only writer of the qTDs now, so invalidating the
+	 * cache lines shared with the qTD before it is harmless.
+	 */
 	ts = get_timer(0);
 	vtd = &qtd[qtd_counter - 1];
+	vtd_start = (unsigned long)vtd & ~(USB_DMA_MINALIGN - 1);
+	vtd_end = ALIGN((unsigned long)(vtd + 1), USB_DMA_MINALIGN);
 	timeout = USB_TIMEOUT_MS(pipe);
 	do {
 		/* Invalidate dcache */
-		invalidate_dcache_range((unsigned long)&ctrl->qh_list,
-			ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
-		invalidate_dcache_range((unsigned long)qh,
-			ALIGN_END_ADDR(struct QH, qh, 1));
-		invalidate_dcache_range((unsigned long)qtd,
-			ALIGN_END_ADDR(struct qTD, qtd, qtd_count));
+		invalidate_dcache_range(vtd_start, vtd_end);
 
 		token = hc32_to_cpu(vtd->qt_token);
 		if (!(QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE))
@@ -617,6 +621,13 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		WATCHDOG_RESET();
 	} while (get_timer(ts) < timeout);
 
+	invalidate_dcache_range((unsigned long)&ctrl->qh_list,
+		ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+	invalidate_dcache_range((unsigned long)qh,
+		ALIGN_END_ADDR(struct QH, qh, 1));
+	invalidate_dcache_range((unsigned long)qtd,
+		ALIGN_END_ADDR(struct qTD, qtd, qtd_count));
+
 	/*
 	 * Invalidate the memory area occupied by buffer
 	 * Don't try to fix the buffer alignment, if it isn't properly
@@ -1540,6 +1551,19 @@ static int _ehci_submit_int_msg(struct usb_device *dev, unsigned long pipe,
 	return result;
 }
 
+static int _ehci_get_max_xfer_size(size_t *size)
+{
+	/*
+	 * ehci_submit_async() allocates as many qTDs as the transfer needs,
+	 * so the only limit is the heap. The qTDs for a transfer of 65535
+	 * 512-byte blocks take about 128KB, as checked against
+	 * CONFIG_SYS_MALLOC_LEN above.
+	 */
+	*size = INT_MAX;
+
+	return 0;
+}
+
 #ifndef CONFIG_DM_USB
 int submit_bulk_msg(struct usb_device *dev, unsigned long pipe,
 			    void *buffer, int length)
@@ -1547,6 +1571,11 @@ int submit_bulk_msg(struct usb_device *dev, unsigned long pipe,
 	return _ehci_submit_bulk_msg(dev, pipe, buffer, length);
 }
 
+int usb_get_max_xfer_size(struct usb_device *dev, size_t *size)
+{
+	return _ehci_get_max_xfer_size(size);
+}
+
 int submit_control_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 		   int length, struct devrequest *setup)
 {
@@ -1627,6 +1656,11 @@ static int ehci_destroy_int_queue(struct udevice *dev, struct usb_device *udev,
 	return _ehci_destroy_int_queue(udev, queue);
 }
 
+static int ehci_get_max_xfer_size(struct udevice *dev, size_t *size)
+{
+	return _ehci_get_max_xfer_size(size);
+}
+
 int ehci_register(struct udevice *dev, struct ehci_hccr *hccr,
 		  struct ehci_hcor *hcor, const struct ehci_ops *ops,
 		  uint tweaks, enum usb_init_type init)
@@ -1678,6 +1712,7 @@ struct dm_usb_ops ehci_usb_ops = {
 	.create_int_queue = ehci_create_int_queue,
 	.poll_int_queue = ehci_poll_int_queue,
 	.destroy_int_queue = ehci_destroy_int_queue,
+	.get_max_xfer_size = ehci_get_max_xfer_size,
 };
 
 #endif
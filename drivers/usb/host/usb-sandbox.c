@@ -92,6 +92,14 @@ static int sandbox_alloc_device(struct udevice *dev, struct usb_device *udev)
 	return 0;
 }
 
+static int sandbox_get_max_xfer_size(struct udevice *dev, size_t *size)
+{
+	/* The emulator is handed the whole buffer, so there is no limit */
+	*size = INT_MAX;
+
+	return 0;
+}
+
 static int sandbox_usb_probe(struct udevice *dev)
 {
 	return 0;
@@ -101,6 +109,7 @@ static const struct dm_usb_ops sandbox_usb_ops = {
 	.control	= sandbox_submit_control,
 	.bulk		= sandbox_submit_bulk,
 	.alloc_device	= sandbox_alloc_device,
+	.get_max_xfer_size = sandbox_get_max_xfer_size,
 };
 
 static const struct udevice_id sandbox_usb_ids[] = {
@@ -519,11 +519,30 @@ int _xhci_alloc_device(struct usb_device *udev)
 	return 0;
 }
 
+static int _xhci_get_max_xfer_size(size_t *size)
+{
+	/*
+	 * Each endpoint has a single ring segment of TRBS_PER_SEGMENT TRBs,
+	 * the last of which links back to the start, and a whole transfer is
+	 * queued before the doorbell is rung. A TRB carries up to
+	 * TRB_MAX_BUFF_SIZE bytes but cannot cross a 64KB boundary, so an
+	 * unaligned buffer may need one more TRB than its length suggests.
+	 */
+	*size = (TRBS_PER_SEGMENT - 2) * TRB_MAX_BUFF_SIZE;
+
+	return 0;
+}
+
 #ifndef CONFIG_DM_USB
 int usb_alloc_device(struct usb_device *udev)
 {
 	return _xhci_alloc_device(udev);
 }
+
+int usb_get_max_xfer_size(struct usb_device *udev, size_t *size)
+{
+	return _xhci_get_max_xfer_size(size);
+}
 #endif
 
 /*
@@ -1177,6 +1196,11 @@ static int xhci_alloc_device(struct udevice *dev, struct usb_device *udev)
 	return _xhci_alloc_device(udev);
 }
 
+static int xhci_get_max_xfer_size(struct udevice *dev, size_t *size)
+{
+	return _xhci_get_max_xfer_size(size);
+}
+
 int xhci_register(struct udevice *dev, struct xhci_hccr *hccr,
 		  struct xhci_hcor *hcor)
 {
@@ -1229,6 +1253,7 @@ struct dm_usb_ops xhci_usb_ops = {
 	.bulk = xhci_submit_bulk_msg,
 	.interrupt = xhci_submit_int_msg,
 	.alloc_device = xhci_alloc_device,
+	.get_max_xfer_size = xhci_get_max_xfer_size,
 };
 
 #endif
@@ -32,19 +32,117 @@
 
 struct ext2_data *ext4fs_root;
 struct ext2fs_node *ext4fs_file;
-uint32_t *ext4fs_indir1_block;
-int ext4fs_indir1_size;
-int ext4fs_indir1_blkno = -1;
-uint32_t *ext4fs_indir2_block;
-int ext4fs_indir2_size;
-int ext4fs_indir2_blkno = -1;
-
-uint32_t *ext4fs_indir3_block;
-int ext4fs_indir3_size;
-int ext4fs_indir3_blkno = -1;
 struct ext2_inode *g_parent_inode;
 static int symlinknest;
 
+/*
+ * Extent index, indirect and directory blocks are looked up again for every
+ * logical block resolved and every path component, so keep the most
+ * recently used ones in memory.
+ */
+#ifndef CONFIG_EXT4_CACHE_BLOCKS
+#define CONFIG_EXT4_CACHE_BLOCKS	16
+#endif
+
+struct ext4_cache_entry {
+	lbaint_t blknr;
+	char *buf;
+	ulong last_use;
+};
+
+static struct ext4_cache_entry ext4fs_cache[CONFIG_EXT4_CACHE_BLOCKS];
+static int ext4fs_cache_blksz;
+static ulong ext4fs_cache_tick;
+static ulong ext4fs_cache_hits;
+static ulong ext4fs_cache_misses;
+
+/**
+ * ext4fs_cache_read() - Read a filesystem block through the metadata cache
+ *
+ * The returned buffer is owned by the cache and is only valid until the
+ * next call; callers which modify the block must take a copy.
+ *
+ * @blknr:	Filesystem block number
+ * @return pointer to the block contents, or NULL on error
+ */
+char *ext4fs_cache_read(lbaint_t blknr)
+{
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	struct ext4_cache_entry *entry, *victim = NULL;
+	int i;
+
+	if (blksz != ext4fs_cache_blksz) {
+		ext4fs_cache_invalidate();
+		ext4fs_cache_blksz = blksz;
+	}
+
+	for (i = 0; i < CONFIG_EXT4_CACHE_BLOCKS; i++) {
+		entry = &ext4fs_cache[i];
+		if (entry->buf && entry->blknr == blknr) {
+			entry->last_use = ++ext4fs_cache_tick;
+			ext4fs_cache_hits++;
+			return entry->buf;
+		}
+		if (!victim || !entry->buf ||
+		    (victim->buf && entry->last_use < victim->last_use))
+			victim = entry;
+	}
+
+	ext4fs_cache_misses++;
+	if (!victim->buf) {
+		victim->buf = zalloc(blksz);
+		if (!victim->buf)
+			return NULL;
+	}
+	if (!ext4fs_devread(blknr << log2_blksz, 0, blksz, victim->buf)) {
+		free(victim->buf);
+		victim->buf = NULL;
+		return NULL;
+	}
+	victim->blknr = blknr;
+	victim->last_use = ++ext4fs_cache_tick;
+
+	return victim->buf;
+}
+
+/**
+ * ext4fs_cache_invalidate() - Drop all blocks held in the metadata cache
+ *
+ * This must be called whenever the filesystem is closed or written. The
+ * hit and miss counts start again from zero.
+ */
+void ext4fs_cache_invalidate(void)
+{
+	int i;
+
+	if (ext4fs_cache_hits || ext4fs_cache_misses)
+		debug("ext4 metadata cache: %lu hits, %lu misses\n",
+		      ext4fs_cache_hits, ext4fs_cache_misses);
+	for (i = 0; i < CONFIG_EXT4_CACHE_BLOCKS; i++) {
+		free(ext4fs_cache[i].buf);
+		ext4fs_cache[i].buf = NULL;
+	}
+	ext4fs_cache_blksz = 0;
+	ext4fs_cache_hits = 0;
+	ext4fs_cache_misses = 0;
+}
+
+/**
+ * ext4fs_cache_stats() - Report the effectiveness of the metadata cache
+ *
+ * The counts cover the time since the cache was last invalidated.
+ *
+ * @hits:	Returns the number of blocks found in the cache
+ * @misses:	Returns the number of blocks read from the device
+ */
+void ext4fs_cache_stats(ulong *hits, ulong *misses)
+{
+	*hits = ext4fs_cache_hits;
+	*misses = ext4fs_cache_misses;
+}
+
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n)
 {
@@ -71,6 +169,9 @@ void put_ext4(uint64_t off, void *buf, uint32_t size)
 	if (fs->dev_desc == NULL)
 		return;
 
+	/* whatever is written may be metadata we hold in the cache */
+	ext4fs_cache_invalidate();
+
 	if ((startblock + (size >> log2blksz)) >
 	    (part_offset + fs->total_sect)) {
 		printf("part_offset is " LBAFU "\n", part_offset);
@@ -509,7 +610,6 @@ fail:
 
 static int search_dir(struct ext2_inode *parent_inode, char *dirname)
 {
-	int status;
 	int inodeno;
 	int totalbytes;
 	int templength;
@@ -534,10 +634,11 @@ static int search_dir(struct ext2_inode *parent_inode, char *dirname)
 		if (!block_buffer)
 			goto fail;
 
-		status = ext4fs_devread((lbaint_t)blknr * fs->sect_perblk,
-					0, fs->blksz, (char *)block_buffer);
-		if (status == 0)
+		/* take a copy, since the entry may be removed below */
+		ptr = ext4fs_cache_read(blknr);
+		if (!ptr)
 			goto fail;
+		memcpy(block_buffer, ptr, fs->blksz);
 
 		dir = (struct ext2_dirent *)block_buffer;
 		ptr = (char *)dir;
@@ -1405,13 +1506,11 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 #endif
 
 static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, char *buf,
-		struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+	(struct ext2_data *data, struct ext4_extent_header *ext_block,
+		uint32_t fileblock)
 {
 	struct ext4_extent_idx *index;
 	unsigned long long block;
-	int blksz = EXT2_BLOCK_SIZE(data);
 	int i;
 
 	while (1) {
@@ -1435,10 +1534,9 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
-				   buf))
-			ext_block = (struct ext4_extent_header *)buf;
-		else
+		ext_block = (struct ext4_extent_header *)
+			ext4fs_cache_read(block);
+		if (!ext_block)
 			return 0;
 	}
 }
@@ -1496,344 +1594,145 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
-long int read_allocated_block(struct ext2_inode *inode, int fileblock)
+/*
+ * Look up @fileblock in the extent tree of @inode. On success *count is set
+ * to the number of blocks from @fileblock onwards which are mapped to
+ * consecutive disk blocks (or form a hole, if 0 is returned).
+ */
+static long int read_extent_block(struct ext2_inode *inode, int fileblock,
+				  int *count)
 {
-	long int blknr;
-	int blksz;
-	int log2_blksz;
-	int status;
-	long int rblock;
-	long int perblock_parent;
-	long int perblock_child;
 	unsigned long long start;
-	/* get the blocksize of the filesystem */
-	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
-	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
-		- get_fs()->dev_desc->log2blksz;
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	int entries;
+	int i = -1;
+
+	ext_block = ext4fs_get_extent_block(ext4fs_root,
+					    (struct ext4_extent_header *)
+					    inode->b.blocks.dir_blocks,
+					    fileblock);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
 
-	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i = -1;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
+	extent = (struct ext4_extent *)(ext_block + 1);
+	entries = le16_to_cpu(ext_block->eh_entries);
+
+	do {
+		i++;
+		if (i >= entries)
+			break;
+	} while (fileblock >= le32_to_cpu(extent[i].ee_block));
+	if (--i >= 0) {
+		fileblock -= le32_to_cpu(extent[i].ee_block);
+		if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
+			/* a hole, which ends where the next extent starts */
+			*count = 1;
+			if (i + 1 < entries)
+				*count = le32_to_cpu(extent[i + 1].ee_block) -
+					le32_to_cpu(extent[i].ee_block) -
+					fileblock;
+			return 0;
 		}
 
-		extent = (struct ext4_extent *)(ext_block + 1);
+		*count = le16_to_cpu(extent[i].ee_len) - fileblock;
+		start = le16_to_cpu(extent[i].ee_start_hi);
+		start = (start << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+		return fileblock + start;
+	}
 
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(extent[i].ee_block));
-		if (--i >= 0) {
-			fileblock -= le32_to_cpu(extent[i].ee_block);
-			if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
-				free(buf);
-				return 0;
-			}
+	printf("Extent Error\n");
+	return -1;
+}
 
-			start = le16_to_cpu(extent[i].ee_start_hi);
-			start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-			free(buf);
-			return fileblock + start;
-		}
+/**
+ * read_allocated_extent() - Find the disk blocks backing part of a file
+ *
+ * For extent-mapped inodes the whole run of consecutive disk blocks starting
+ * at @fileblock is returned from a single walk of the extent tree, so that
+ * callers can read it with one device request. Other inodes are resolved
+ * one block at a time.
+ *
+ * @inode:	Inode of the file
+ * @fileblock:	Logical block number within the file
+ * @count:	Returns the number of blocks in the run, at least 1
+ * @return disk block number of @fileblock, 0 for a hole, -ve on error
+ */
+long int read_allocated_extent(struct ext2_inode *inode, int fileblock,
+			       int *count)
+{
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return read_extent_block(inode, fileblock, count);
 
-		printf("Extent Error\n");
-		free(buf);
-		return -1;
-	}
+	*count = 1;
+	return read_allocated_block(inode, fileblock);
+}
+
+long int read_allocated_block(struct ext2_inode *inode, int fileblock)
+{
+	long int blknr;
+	long int rblock;
+	long int perblock;
+	uint32_t *indir;
+	int count;
+
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return read_extent_block(inode, fileblock, &count);
+
+	/* get the number of block numbers in an indirect block */
+	perblock = EXT2_BLOCK_SIZE(ext4fs_root) / 4;
 
 	/* Direct blocks. */
 	if (fileblock < INDIRECT_BLOCKS)
-		blknr = __le32_to_cpu(inode->b.blocks.dir_blocks[fileblock]);
+		return __le32_to_cpu(inode->b.blocks.dir_blocks[fileblock]);
+
+	rblock = fileblock - INDIRECT_BLOCKS;
 
 	/* Indirect. */
-	else if (fileblock < (INDIRECT_BLOCKS + (blksz / 4))) {
-		if (ext4fs_indir1_block == NULL) {
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** SI ext2fs read block (indir 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-			ext4fs_indir1_blkno = -1;
-		}
-		if (blksz != ext4fs_indir1_size) {
-			free(ext4fs_indir1_block);
-			ext4fs_indir1_block = NULL;
-			ext4fs_indir1_size = 0;
-			ext4fs_indir1_blkno = -1;
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** SI ext2fs read block (indir 1):"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-		}
-		if ((__le32_to_cpu(inode->b.blocks.indir_block) <<
-		     log2_blksz) != ext4fs_indir1_blkno) {
-			status =
-			    ext4fs_devread((lbaint_t)__le32_to_cpu
-					   (inode->b.blocks.
-					    indir_block) << log2_blksz, 0,
-					   blksz, (char *)ext4fs_indir1_block);
-			if (status == 0) {
-				printf("** SI ext2fs read block (indir 1)"
-					"failed. **\n");
-				return 0;
-			}
-			ext4fs_indir1_blkno =
-				__le32_to_cpu(inode->b.blocks.
-					       indir_block) << log2_blksz;
+	if (rblock < perblock) {
+		indir = (uint32_t *)ext4fs_cache_read(__le32_to_cpu
+					(inode->b.blocks.indir_block));
+		if (!indir) {
+			printf("** SI ext2fs read block (indir 1)"
+				"failed. **\n");
+			return 0;
 		}
-		blknr = __le32_to_cpu(ext4fs_indir1_block
-				      [fileblock - INDIRECT_BLOCKS]);
+		blknr = __le32_to_cpu(indir[rblock]);
 	}
 	/* Double indirect. */
-	else if (fileblock < (INDIRECT_BLOCKS + (blksz / 4 *
-					(blksz / 4 + 1)))) {
-
-		long int perblock = blksz / 4;
-		long int rblock = fileblock - (INDIRECT_BLOCKS + blksz / 4);
-
-		if (ext4fs_indir1_block == NULL) {
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** DI ext2fs read block (indir 2 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-			ext4fs_indir1_blkno = -1;
-		}
-		if (blksz != ext4fs_indir1_size) {
-			free(ext4fs_indir1_block);
-			ext4fs_indir1_block = NULL;
-			ext4fs_indir1_size = 0;
-			ext4fs_indir1_blkno = -1;
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** DI ext2fs read block (indir 2 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-		}
-		if ((__le32_to_cpu(inode->b.blocks.double_indir_block) <<
-		     log2_blksz) != ext4fs_indir1_blkno) {
-			status =
-			    ext4fs_devread((lbaint_t)__le32_to_cpu
-					   (inode->b.blocks.
-					    double_indir_block) << log2_blksz,
-					   0, blksz,
-					   (char *)ext4fs_indir1_block);
-			if (status == 0) {
-				printf("** DI ext2fs read block (indir 2 1)"
-					"failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_blkno =
-			    __le32_to_cpu(inode->b.blocks.double_indir_block) <<
-			    log2_blksz;
-		}
-
-		if (ext4fs_indir2_block == NULL) {
-			ext4fs_indir2_block = zalloc(blksz);
-			if (ext4fs_indir2_block == NULL) {
-				printf("** DI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_size = blksz;
-			ext4fs_indir2_blkno = -1;
-		}
-		if (blksz != ext4fs_indir2_size) {
-			free(ext4fs_indir2_block);
-			ext4fs_indir2_block = NULL;
-			ext4fs_indir2_size = 0;
-			ext4fs_indir2_blkno = -1;
-			ext4fs_indir2_block = zalloc(blksz);
-			if (ext4fs_indir2_block == NULL) {
-				printf("** DI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_size = blksz;
-		}
-		if ((__le32_to_cpu(ext4fs_indir1_block[rblock / perblock]) <<
-		     log2_blksz) != ext4fs_indir2_blkno) {
-			status = ext4fs_devread((lbaint_t)__le32_to_cpu
-						(ext4fs_indir1_block
-						 [rblock /
-						  perblock]) << log2_blksz, 0,
-						blksz,
-						(char *)ext4fs_indir2_block);
-			if (status == 0) {
-				printf("** DI ext2fs read block (indir 2 2)"
-					"failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_blkno =
-			    __le32_to_cpu(ext4fs_indir1_block[rblock
-							      /
-							      perblock]) <<
-			    log2_blksz;
+	else if ((rblock -= perblock) < perblock * perblock) {
+		indir = (uint32_t *)ext4fs_cache_read(__le32_to_cpu
+					(inode->b.blocks.double_indir_block));
+		if (indir)
+			indir = (uint32_t *)ext4fs_cache_read(__le32_to_cpu
+						(indir[rblock / perblock]));
+		if (!indir) {
+			printf("** DI ext2fs read block (indir 2)"
+				"failed. **\n");
+			return -1;
 		}
-		blknr = __le32_to_cpu(ext4fs_indir2_block[rblock % perblock]);
+		blknr = __le32_to_cpu(indir[rblock % perblock]);
 	}
 	/* Tripple indirect. */
 	else {
-		rblock = fileblock - (INDIRECT_BLOCKS + blksz / 4 +
-				      (blksz / 4 * blksz / 4));
-		perblock_child = blksz / 4;
-		perblock_parent = ((blksz / 4) * (blksz / 4));
-
-		if (ext4fs_indir1_block == NULL) {
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-			ext4fs_indir1_blkno = -1;
-		}
-		if (blksz != ext4fs_indir1_size) {
-			free(ext4fs_indir1_block);
-			ext4fs_indir1_block = NULL;
-			ext4fs_indir1_size = 0;
-			ext4fs_indir1_blkno = -1;
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-		}
-		if ((__le32_to_cpu(inode->b.blocks.triple_indir_block) <<
-		     log2_blksz) != ext4fs_indir1_blkno) {
-			status = ext4fs_devread
-			    ((lbaint_t)
-			     __le32_to_cpu(inode->b.blocks.triple_indir_block)
-			     << log2_blksz, 0, blksz,
-			     (char *)ext4fs_indir1_block);
-			if (status == 0) {
-				printf("** TI ext2fs read block (indir 2 1)"
-					"failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_blkno =
-			    __le32_to_cpu(inode->b.blocks.triple_indir_block) <<
-			    log2_blksz;
-		}
-
-		if (ext4fs_indir2_block == NULL) {
-			ext4fs_indir2_block = zalloc(blksz);
-			if (ext4fs_indir2_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_size = blksz;
-			ext4fs_indir2_blkno = -1;
-		}
-		if (blksz != ext4fs_indir2_size) {
-			free(ext4fs_indir2_block);
-			ext4fs_indir2_block = NULL;
-			ext4fs_indir2_size = 0;
-			ext4fs_indir2_blkno = -1;
-			ext4fs_indir2_block = zalloc(blksz);
-			if (ext4fs_indir2_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_size = blksz;
-		}
-		if ((__le32_to_cpu(ext4fs_indir1_block[rblock /
-						       perblock_parent]) <<
-		     log2_blksz)
-		    != ext4fs_indir2_blkno) {
-			status = ext4fs_devread((lbaint_t)__le32_to_cpu
-						(ext4fs_indir1_block
-						 [rblock /
-						  perblock_parent]) <<
-						log2_blksz, 0, blksz,
-						(char *)ext4fs_indir2_block);
-			if (status == 0) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_blkno =
-			    __le32_to_cpu(ext4fs_indir1_block[rblock /
-							      perblock_parent])
-			    << log2_blksz;
-		}
-
-		if (ext4fs_indir3_block == NULL) {
-			ext4fs_indir3_block = zalloc(blksz);
-			if (ext4fs_indir3_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir3_size = blksz;
-			ext4fs_indir3_blkno = -1;
-		}
-		if (blksz != ext4fs_indir3_size) {
-			free(ext4fs_indir3_block);
-			ext4fs_indir3_block = NULL;
-			ext4fs_indir3_size = 0;
-			ext4fs_indir3_blkno = -1;
-			ext4fs_indir3_block = zalloc(blksz);
-			if (ext4fs_indir3_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir3_size = blksz;
-		}
-		if ((__le32_to_cpu(ext4fs_indir2_block[rblock
-						       /
-						       perblock_child]) <<
-		     log2_blksz) != ext4fs_indir3_blkno) {
-			status =
-			    ext4fs_devread((lbaint_t)__le32_to_cpu
-					   (ext4fs_indir2_block
-					    [(rblock / perblock_child)
-					     % (blksz / 4)]) << log2_blksz, 0,
-					   blksz, (char *)ext4fs_indir3_block);
-			if (status == 0) {
-				printf("** TI ext2fs read block (indir 2 2)"
-				       "failed. **\n");
-				return -1;
-			}
-			ext4fs_indir3_blkno =
-			    __le32_to_cpu(ext4fs_indir2_block[(rblock /
-							       perblock_child) %
-							      (blksz /
-							       4)]) <<
-			    log2_blksz;
+		rblock -= perblock * perblock;
+		indir = (uint32_t *)ext4fs_cache_read(__le32_to_cpu
+					(inode->b.blocks.triple_indir_block));
+		if (indir)
+			indir = (uint32_t *)ext4fs_cache_read(__le32_to_cpu
+					(indir[rblock / (perblock * perblock)]));
+		if (indir)
+			indir = (uint32_t *)ext4fs_cache_read(__le32_to_cpu
+					(indir[(rblock / perblock) % perblock]));
+		if (!indir) {
+			printf("** TI ext2fs read block (indir 3)"
+				"failed. **\n");
+			return -1;
 		}
-
-		blknr = __le32_to_cpu(ext4fs_indir3_block
-				      [rblock % perblock_child]);
+		blknr = __le32_to_cpu(indir[rblock % perblock]);
 	}
 	debug("read_allocated_block %ld\n", blknr);
 
@@ -1854,24 +1753,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
  */
 void ext4fs_reinit_global(void)
 {
-	if (ext4fs_indir1_block != NULL) {
-		free(ext4fs_indir1_block);
-		ext4fs_indir1_block = NULL;
-		ext4fs_indir1_size = 0;
-		ext4fs_indir1_blkno = -1;
-	}
-	if (ext4fs_indir2_block != NULL) {
-		free(ext4fs_indir2_block);
-		ext4fs_indir2_block = NULL;
-		ext4fs_indir2_size = 0;
-		ext4fs_indir2_blkno = -1;
-	}
-	if (ext4fs_indir3_block != NULL) {
-		free(ext4fs_indir3_block);
-		ext4fs_indir3_block = NULL;
-		ext4fs_indir3_size = 0;
-		ext4fs_indir3_blkno = -1;
-	}
+	ext4fs_cache_invalidate();
 }
 void ext4fs_close(void)
 {
@@ -1887,12 +1769,51 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
+/*
+ * Read part of a directory. Directory entries are small and a directory is
+ * scanned for each path component, so go through the metadata cache rather
+ * than issuing a device read for each entry.
+ */
+static int ext4fs_read_dir(struct ext2fs_node *dir, loff_t pos, loff_t len,
+			   char *buf)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	unsigned int dirsize = __le32_to_cpu(dir->inode.size);
+	long int blknr;
+	char *block;
+	int offset;
+	int size;
+
+	if (pos + len > dirsize)
+		return -1;
+
+	while (len) {
+		offset = pos & (blksz - 1);
+		size = min_t(loff_t, len, blksz - offset);
+		blknr = read_allocated_block(&dir->inode, pos / blksz);
+		if (blknr < 0)
+			return -1;
+		if (blknr) {
+			block = ext4fs_cache_read(blknr);
+			if (!block)
+				return -1;
+			memcpy(buf, block + offset, size);
+		} else {
+			memset(buf, 0, size);
+		}
+		pos += size;
+		buf += size;
+		len -= size;
+	}
+
+	return 0;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
 	unsigned int fpos = 0;
 	int status;
-	loff_t actread;
 	struct ext2fs_node *diro = (struct ext2fs_node *) dir;
 
 #ifdef DEBUG
@@ -1908,9 +1829,9 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 	while (fpos < __le32_to_cpu(diro->inode.size)) {
 		struct ext2_dirent dirent;
 
-		status = ext4fs_read_file(diro, fpos,
-					   sizeof(struct ext2_dirent),
-					   (char *)&dirent, &actread);
+		status = ext4fs_read_dir(diro, fpos,
+					 sizeof(struct ext2_dirent),
+					 (char *)&dirent);
 		if (status < 0)
 			return 0;
 
@@ -1919,11 +1840,10 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node *fdiro;
 			int type = FILETYPE_UNKNOWN;
 
-			status = ext4fs_read_file(diro,
-						  fpos +
-						  sizeof(struct ext2_dirent),
-						  dirent.namelen, filename,
-						  &actread);
+			status = ext4fs_read_dir(diro,
+						 fpos +
+						 sizeof(struct ext2_dirent),
+						 dirent.namelen, filename);
 			if (status < 0)
 				return 0;
 
@@ -2181,7 +2101,11 @@ int ext4fs_open(const char *filename, loff_t *len)
 	if (ext4fs_root == NULL)
 		return -1;
 
-	ext4fs_file = NULL;
+	/* The filesystem may stay mounted across several opens */
+	if (ext4fs_file) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
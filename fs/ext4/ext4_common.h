@@ -48,6 +48,9 @@ static inline void *zalloc(size_t size)
 	return p;
 }
 
+char *ext4fs_cache_read(lbaint_t blknr);
+void ext4fs_cache_invalidate(void);
+void ext4fs_cache_stats(ulong *hits, ulong *misses);
 int ext4fs_read_inode(struct ext2_data *data, int ino,
 		      struct ext2_inode *inode);
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos, loff_t len,
@@ -45,6 +45,11 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
  * reads into one potentially more efficient larger sequential read action
+ *
+ * The file is walked an extent at a time rather than block by block, so
+ * each run of contiguous blocks costs one extent lookup, and neighbouring
+ * runs which are also contiguous on disk are merged into a single read
+ * straight into the caller's buffer.
  */
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
@@ -62,46 +67,57 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	lbaint_t delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
 	char *delayed_buf = NULL;
+	int count;
 	short status;
 
 	/* Adjust len so it we can't read past the end of the file. */
-	if (len > filesize)
-		len = filesize;
+	if (pos >= filesize) {
+		*actread = 0;
+		return 0;
+	}
+	if (len > filesize - pos)
+		len = filesize - pos;
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
+	for (i = lldiv(pos, blocksize); i < blockcnt; i += count) {
 		lbaint_t blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
+		loff_t runstart = (loff_t)blocksize * i;
+		loff_t runend;
 		int skipfirst = 0;
-		blknr = read_allocated_block(&(node->inode), i);
+		int blockend;
+
+		blknr = read_allocated_extent(&(node->inode), i, &count);
 		if (blknr < 0)
 			return -1;
 
-		blknr = blknr << log2_fs_blocksize;
+		/* Don't go past the end of the data that was asked for */
+		if (count > blockcnt - i)
+			count = blockcnt - i;
+		/* ext4fs_devread() takes an int length */
+		if (count > INT_MAX / blocksize)
+			count = INT_MAX / blocksize;
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
+		blknr = blknr << log2_fs_blocksize;
 
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		runend = runstart + (loff_t)blocksize * count;
+		if (runend > len + pos)
+			runend = len + pos;
 
 		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
+		if (runstart < pos)
+			skipfirst = pos - runstart;
+		blockend = runend - runstart - skipfirst;
+
 		if (blknr) {
 			int status;
 
 			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
+				if (delayed_next == blknr &&
+				    delayed_extent <= INT_MAX - blockend) {
 					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
+					delayed_next += (lbaint_t)count <<
+						log2_fs_blocksize;
 				} else {	/* spill */
 					status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
@@ -115,7 +131,8 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 					delayed_skipfirst = skipfirst;
 					delayed_buf = buf;
 					delayed_next = blknr +
-						(blockend >> log2blksz);
+						((lbaint_t)count <<
+						 log2_fs_blocksize);
 				}
 			} else {
 				previous_block_number = blknr;
@@ -124,7 +141,7 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 				delayed_skipfirst = skipfirst;
 				delayed_buf = buf;
 				delayed_next = blknr +
-					(blockend >> log2blksz);
+					((lbaint_t)count << log2_fs_blocksize);
 			}
 		} else {
 			if (previous_block_number != -1) {
@@ -137,9 +154,9 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 					return -1;
 				previous_block_number = -1;
 			}
-			memset(buf, 0, blocksize - skipfirst);
+			memset(buf, 0, blockend);
 		}
-		buf += blocksize - skipfirst;
+		buf += blockend;
 	}
 	if (previous_block_number != -1) {
 		/* spill */
@@ -158,6 +175,7 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 int ext4fs_ls(const char *dirname)
 {
 	struct ext2fs_node *dirnode;
+	ulong hits, misses;
 	int status;
 
 	if (dirname == NULL)
@@ -173,6 +191,9 @@ int ext4fs_ls(const char *dirname)
 	ext4fs_iterate_dir(dirnode, NULL, NULL, NULL);
 	ext4fs_free_node(dirnode, &ext4fs_root->diropen);
 
+	ext4fs_cache_stats(&hits, &misses);
+	printf("\nmetadata cache: %lu hits, %lu misses\n", hits, misses);
+
 	return 0;
 }
 
@@ -190,12 +211,12 @@ int ext4fs_size(const char *filename, loff_t *size)
 	return ext4fs_open(filename, size);
 }
 
-int ext4fs_read(char *buf, loff_t len, loff_t *actread)
+int ext4fs_read(char *buf, loff_t offset, loff_t len, loff_t *actread)
 {
 	if (ext4fs_root == NULL || ext4fs_file == NULL)
 		return 0;
 
-	return ext4fs_read_file(ext4fs_file, 0, len, buf, actread);
+	return ext4fs_read_file(ext4fs_file, offset, len, buf, actread);
 }
 
 int ext4fs_probe(block_dev_desc_t *fs_dev_desc,
@@ -217,11 +238,6 @@ int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	loff_t file_len;
 	int ret;
 
-	if (offset != 0) {
-		printf("** Cannot support non-zero offset **\n");
-		return -1;
-	}
-
 	ret = ext4fs_open(filename, &file_len);
 	if (ret < 0) {
 		printf("** File not found %s **\n", filename);
@@ -231,7 +247,7 @@ int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	if (len == 0)
 		len = file_len;
 
-	return ext4fs_read(buf, len, len_read);
+	return ext4fs_read(buf, offset, len, len_read);
 }
 
 int ext4fs_uuid(char *uuid_str)
@@ -154,6 +154,53 @@ static void get_name(dir_entry *dirent, char *s_name)
 	downcase(s_name);
 }
 
+/*
+ * The FAT is read in windows of FATBUFBLOCKS sectors. Keep
+ * CONFIG_FS_FAT_CACHE_WINDOWS of them, direct-mapped by window number, so
+ * that following a fragmented chain does not keep re-reading the same
+ * parts of the FAT. With CONFIG_FS_FAT_CACHE_WHOLE there is a slot for
+ * every window, i.e. each part of the FAT is read at most once. If there
+ * is not enough memory we fall back to fewer slots.
+ */
+#ifndef CONFIG_FS_FAT_CACHE_WINDOWS
+#define CONFIG_FS_FAT_CACHE_WINDOWS	1
+#endif
+
+static int fat_cache_alloc(fsdata *mydata)
+{
+	int slots = CONFIG_FS_FAT_CACHE_WINDOWS;
+
+#ifdef CONFIG_FS_FAT_CACHE_WHOLE
+	slots = DIV_ROUND_UP(mydata->fatlength, FATBUFBLOCKS);
+#endif
+	mydata->fatbufnum = -1;
+	for (; slots > 1; slots /= 2) {
+		mydata->fatbuf = memalign(ARCH_DMA_MINALIGN,
+					  FATBUFSIZE * slots);
+		mydata->fatbufnums = malloc(slots * sizeof(int));
+		if (mydata->fatbuf && mydata->fatbufnums) {
+			memset(mydata->fatbufnums, 0xff, slots * sizeof(int));
+			mydata->fatbufslots = slots;
+			return 0;
+		}
+		free(mydata->fatbuf);
+		free(mydata->fatbufnums);
+	}
+
+	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+	mydata->fatbufnums = &mydata->fatbufnum;
+	mydata->fatbufslots = 1;
+
+	return mydata->fatbuf ? 0 : -1;
+}
+
+static void fat_cache_free(fsdata *mydata)
+{
+	free(mydata->fatbuf);
+	if (mydata->fatbufnums != &mydata->fatbufnum)
+		free(mydata->fatbufnums);
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -164,6 +211,8 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 off16, offset;
 	__u32 ret = 0x00;
 	__u16 val1, val2;
+	__u8 *fatbuf;
+	int slot;
 
 	switch (mydata->fatsize) {
 	case 32:
@@ -187,10 +236,13 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%04x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
+	slot = bufnum % mydata->fatbufslots;
+	fatbuf = mydata->fatbuf + slot * FATBUFSIZE;
+
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
+	if (bufnum != mydata->fatbufnums[slot]) {
 		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
+		__u8 *bufptr = fatbuf;
 		__u32 fatlength = mydata->fatlength;
 		__u32 startblock = bufnum * FATBUFBLOCKS;
 
@@ -201,43 +253,44 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 
 		if (disk_read(startblock, getsize, bufptr) < 0) {
 			debug("Error reading FAT blocks\n");
+			mydata->fatbufnums[slot] = -1;
 			return ret;
 		}
-		mydata->fatbufnum = bufnum;
+		mydata->fatbufnums[slot] = bufnum;
 	}
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *) fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *) fatbuf)[offset]);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
 
 		switch (offset & 0x3) {
 		case 0:
-			ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *) fatbuf)[off16]);
 			ret &= 0xfff;
 			break;
 		case 1:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xf000;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x00ff;
 			ret = (val2 << 4) | (val1 >> 12);
 			break;
 		case 2:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xff00;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x000f;
 			ret = (val2 << 8) | (val1 >> 8);
 			break;
 		case 3:
-			ret = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			ret = (ret & 0xfff0) >> 4;
 			break;
 		default:
@@ -314,6 +367,19 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Where the last read of a file started, so that a file read in pieces
+ * (e.g. by fitload) does not follow its cluster chain from the start for
+ * every piece. It is dropped along with the directory index.
+ */
+static struct {
+	block_dev_desc_t *dev;
+	lbaint_t part_start;
+	__u32 start;		/* First cluster of the file, 0 if unused */
+	loff_t offset;		/* Offset in the file of 'clust' */
+	__u32 clust;
+} fat_seek;
+
 /*
  * Read at most 'maxsize' bytes from 'pos' in the file associated with 'dentptr'
  * into 'buffer'.
@@ -346,6 +412,15 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	actsize = bytesperclust;
 
+	/* carry on from the last read of this file if it started before pos */
+	if (fat_seek.start && fat_seek.start == curclust &&
+	    fat_seek.dev == cur_dev &&
+	    fat_seek.part_start == cur_part_info.start &&
+	    fat_seek.offset <= pos) {
+		curclust = fat_seek.clust;
+		actsize += fat_seek.offset;
+	}
+
 	/* go to cluster at pos */
 	while (actsize <= pos) {
 		curclust = get_fatent(mydata, curclust);
@@ -356,6 +431,11 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 		}
 		actsize += bytesperclust;
 	}
+	fat_seek.dev = cur_dev;
+	fat_seek.part_start = cur_part_info.start;
+	fat_seek.start = START(dentptr);
+	fat_seek.offset = actsize - bytesperclust;
+	fat_seek.clust = curclust;
 
 	/* actsize > pos */
 	actsize -= bytesperclust;
@@ -567,6 +647,148 @@ static __u8 mkcksum(const char name[8], const char ext[3])
 	return ret;
 }
 
+/*
+ * Directory lookup index. Every entry seen while looking up a path is
+ * remembered, keyed by the start cluster of its directory (0 for the root
+ * directory) and its lowercase short or long name, so that later lookups
+ * in large directories do not have to rescan the directory and rebuild the
+ * VFAT names. A directory that has been scanned to its end is marked as
+ * complete (an entry with an empty name) so that misses are answered from
+ * the index too, unless an entry could not be allocated. The index is
+ * dropped by fat_close() (which fs_invalidate() calls when the device is
+ * written outside the filesystem), by any write and when a different
+ * volume is read.
+ */
+#ifndef CONFIG_FS_FAT_DIR_INDEX_SIZE
+#define CONFIG_FS_FAT_DIR_INDEX_SIZE	256
+#endif
+
+struct dir_index_entry {
+	struct dir_index_entry *next;
+	__u32 dirclust;
+	dir_entry dent;
+	char name[];
+};
+
+static struct {
+	struct dir_index_entry **table;
+	block_dev_desc_t *dev;
+	lbaint_t part_start;
+	__u8 volume_id[4];
+	int incomplete;		/* an entry was lost, so misses are unknown */
+} dir_index;
+
+static void dir_index_invalidate(void)
+{
+	struct dir_index_entry *entry, *next;
+	int i;
+
+	fat_seek.start = 0;
+	if (!dir_index.table)
+		return;
+
+	for (i = 0; i < CONFIG_FS_FAT_DIR_INDEX_SIZE; i++) {
+		for (entry = dir_index.table[i]; entry; entry = next) {
+			next = entry->next;
+			free(entry);
+		}
+	}
+	free(dir_index.table);
+	dir_index.table = NULL;
+}
+
+/* Make sure the index belongs to the volume that is about to be read */
+static void dir_index_check(volume_info *volinfo)
+{
+	if (dir_index.table && dir_index.dev == cur_dev &&
+	    dir_index.part_start == cur_part_info.start &&
+	    !memcmp(dir_index.volume_id, volinfo->volume_id, 4))
+		return;
+
+	dir_index_invalidate();
+	dir_index.table = calloc(CONFIG_FS_FAT_DIR_INDEX_SIZE,
+				 sizeof(*dir_index.table));
+	dir_index.dev = cur_dev;
+	dir_index.part_start = cur_part_info.start;
+	memcpy(dir_index.volume_id, volinfo->volume_id, 4);
+	dir_index.incomplete = 0;
+}
+
+static struct dir_index_entry **dir_index_bucket(__u32 dirclust,
+						 const char *name)
+{
+	__u32 hash = dirclust * 0x9e3779b1;
+
+	while (*name)
+		hash = hash * 31 + (__u8)*name++;
+
+	return &dir_index.table[hash % CONFIG_FS_FAT_DIR_INDEX_SIZE];
+}
+
+static struct dir_index_entry *dir_index_find(__u32 dirclust,
+					      const char *name)
+{
+	struct dir_index_entry *entry;
+
+	for (entry = *dir_index_bucket(dirclust, name); entry;
+	     entry = entry->next) {
+		if (entry->dirclust == dirclust && !strcmp(entry->name, name))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+ * Look up 'name' in the directory starting at 'dirclust'.
+ * Return 1 and copy the entry into 'dent' if found, 0 if the directory has
+ * to be scanned and -1 if the name is known not to exist.
+ */
+static int dir_index_lookup(__u32 dirclust, const char *name, dir_entry *dent)
+{
+	struct dir_index_entry *entry;
+
+	if (!dir_index.table)
+		return 0;
+
+	entry = dir_index_find(dirclust, name);
+	if (entry) {
+		memcpy(dent, &entry->dent, sizeof(dir_entry));
+		return 1;
+	}
+
+	return dir_index_find(dirclust, "") ? -1 : 0;
+}
+
+static void dir_index_add(__u32 dirclust, const char *name, dir_entry *dent)
+{
+	struct dir_index_entry **bucket, *entry;
+
+	if (!dir_index.table || dir_index_find(dirclust, name))
+		return;
+
+	entry = malloc(sizeof(*entry) + strlen(name) + 1);
+	if (!entry) {
+		dir_index.incomplete = 1;
+		return;
+	}
+
+	bucket = dir_index_bucket(dirclust, name);
+	entry->dirclust = dirclust;
+	if (dent)
+		memcpy(&entry->dent, dent, sizeof(dir_entry));
+	strcpy(entry->name, name);
+	entry->next = *bucket;
+	*bucket = entry;
+}
+
+/* Record that every entry of the directory at 'dirclust' is indexed */
+static void dir_index_complete(__u32 dirclust)
+{
+	if (!dir_index.incomplete)
+		dir_index_add(dirclust, "", NULL);
+}
+
 /*
  * Get the directory entry associated with 'filename' from the directory
  * starting at 'startsect'
@@ -580,10 +802,22 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 {
 	__u16 prevcksum = 0xffff;
 	__u32 curclust = START(retdent);
+	__u32 dirclust = curclust;
 	int files = 0, dirs = 0;
 
 	debug("get_dentfromdir: %s\n", filename);
 
+	if (!dols) {
+		switch (dir_index_lookup(dirclust, filename, retdent)) {
+		case 1:
+			debug("Indexed: %s, start: 0x%x\n", filename,
+			      START(retdent));
+			return retdent;
+		case -1:
+			return NULL;
+		}
+	}
+
 	while (1) {
 		dir_entry *dentptr;
 
@@ -657,6 +891,8 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 				if (dols) {
 					printf("\n%d file(s), %d dir(s)\n\n",
 						files, dirs);
+				} else {
+					dir_index_complete(dirclust);
 				}
 				debug("Dentname == NULL - %d\n", i);
 				return NULL;
@@ -703,6 +939,11 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 				continue;
 			}
 
+			if (*s_name)
+				dir_index_add(dirclust, s_name, dentptr);
+			if (*l_name)
+				dir_index_add(dirclust, l_name, dentptr);
+
 			if (strcmp(filename, s_name)
 			    && strcmp(filename, l_name)) {
 				debug("Mismatch: |%s|%s|\n", s_name, l_name);
@@ -815,6 +1056,7 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	fsdata datablock;
 	fsdata *mydata = &datablock;
 	dir_entry *dentptr = NULL;
+	dir_entry rootdent;
 	__u16 prevcksum = 0xffff;
 	char *subname = "";
 	__u32 cursect;
@@ -867,9 +1109,7 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 					(mydata->clust_size * 2);
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
+	if (fat_cache_alloc(mydata)) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
@@ -912,6 +1152,21 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 		isdir = 1;
 	}
 
+	dir_index_check(&volinfo);
+	if (dols != LS_ROOT) {
+		switch (dir_index_lookup(0, fnamecopy, &rootdent)) {
+		case 1:
+			dentptr = &rootdent;
+			if (isdir && !(dentptr->attr & ATTR_DIR))
+				goto exit;
+			debug("RootIndexed: %s, start: 0x%x\n", fnamecopy,
+			      START(dentptr));
+			goto rootdir_done;
+		case -1:
+			goto exit;
+		}
+	}
+
 	buffer_blk_cnt = 0;
 	firsttime = 1;
 	while (1) {
@@ -1032,6 +1287,8 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 					printf("\n%d file(s), %d dir(s)\n\n",
 						files, dirs);
 					ret = 0;
+				} else {
+					dir_index_complete(0);
 				}
 				goto exit;
 			}
@@ -1076,6 +1333,11 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 				continue;
 			}
 
+			if (*s_name)
+				dir_index_add(0, s_name, dentptr);
+			if (*l_name)
+				dir_index_add(0, l_name, dentptr);
+
 			if (strcmp(fnamecopy, s_name)
 			    && strcmp(fnamecopy, l_name)) {
 				debug("RootMismatch: |%s|%s|\n", s_name,
@@ -1135,6 +1397,8 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 				printf("\n%d file(s), %d dir(s)\n\n",
 				       files, dirs);
 				*size = 0;
+			} else {
+				dir_index_complete(0);
 			}
 			goto exit;
 		}
@@ -1193,7 +1457,7 @@ rootdir_done:
 	debug("Size: %u, got: %llu\n", FAT2CPU32(dentptr->size), *size);
 
 exit:
-	free(mydata->fatbuf);
+	fat_cache_free(mydata);
 	return ret;
 }
 
@@ -1320,4 +1584,5 @@ int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 
 void fat_close(void)
 {
+	dir_index_invalidate();
 }
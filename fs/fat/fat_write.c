@@ -944,6 +944,9 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 	*actwrite = size;
 	dir_curclust = 0;
 
+	/* Directories are about to change */
+	dir_index_invalidate();
+
 	if (read_bootsectandvi(&bs, &volinfo, &mydata->fatsize)) {
 		debug("error: reading boot sector\n");
 		return -1;
@@ -982,7 +985,10 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 					(mydata->clust_size * 2);
 	}
 
+	/* writes go through a single window, see get_fatent_value() */
 	mydata->fatbufnum = -1;
+	mydata->fatbufnums = &mydata->fatbufnum;
+	mydata->fatbufslots = 1;
 	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
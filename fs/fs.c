@@ -90,6 +90,14 @@ struct fstype_info {
 	 * filesystem.
 	 */
 	bool null_dev_desc_ok;
+	/*
+	 * Must .probe() be called again when a cached mount is reused? This
+	 * is needed if the filesystem can also be selected without going
+	 * through this file (e.g. FAT by the fat commands and env_fat), so
+	 * that it may be pointing at another device. It only makes sense if
+	 * probing is cheap.
+	 */
+	bool reprobe_cached;
 	int (*probe)(block_dev_desc_t *fs_dev_desc,
 		     disk_partition_t *fs_partition);
 	int (*ls)(const char *dirname);
@@ -109,6 +117,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_FAT,
 		.name = "fat",
 		.null_dev_desc_ok = false,
+		.reprobe_cached = true,
 		.probe = fat_set_blk_dev,
 		.close = fat_close,
 		.ls = file_fat_ls,
@@ -186,6 +195,61 @@ static struct fstype_info *fs_get_info(int fstype)
 	return info;
 }
 
+#ifdef CONFIG_FS_MOUNT_CACHE
+/*
+ * The filesystem drivers keep their state in globals, so only the most
+ * recently mounted filesystem can be kept. It is reused when the same
+ * device, partition and filesystem type are selected again, instead of
+ * probing and mounting the partition for every command.
+ */
+static struct {
+	int fstype;		/* FS_TYPE_ANY if nothing is mounted */
+	block_dev_desc_t *dev_desc;
+	disk_partition_t partition;
+} fs_mount = {
+	.fstype = FS_TYPE_ANY,
+};
+
+static int fs_mount_lookup(int fstype)
+{
+	struct fstype_info *info;
+
+	if (fs_mount.fstype == FS_TYPE_ANY ||
+	    (fstype != FS_TYPE_ANY && fstype != fs_mount.fstype) ||
+	    fs_mount.dev_desc != fs_dev_desc ||
+	    fs_mount.partition.start != fs_partition.start ||
+	    fs_mount.partition.size != fs_partition.size)
+		return -ENOENT;
+
+	info = fs_get_info(fs_mount.fstype);
+	if (info->reprobe_cached && info->probe(fs_dev_desc, &fs_partition))
+		return -ENODEV;
+
+	fs_type = fs_mount.fstype;
+	debug("%s: reusing %s mount\n", __func__, info->name);
+
+	return 0;
+}
+
+#endif
+
+void fs_invalidate(block_dev_desc_t *dev_desc)
+{
+#ifdef CONFIG_FS_FAT
+	/* FAT's directory index outlives the mount for fat_register_device() */
+	fat_close();
+#endif
+#ifdef CONFIG_FS_MOUNT_CACHE
+	if (fs_mount.fstype == FS_TYPE_ANY)
+		return;
+	if (dev_desc && dev_desc != fs_mount.dev_desc)
+		return;
+
+	fs_get_info(fs_mount.fstype)->close();
+	fs_mount.fstype = FS_TYPE_ANY;
+#endif
+}
+
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 {
 	struct fstype_info *info;
@@ -212,6 +276,12 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	if (part < 0)
 		return -1;
 
+#ifdef CONFIG_FS_MOUNT_CACHE
+	if (!fs_mount_lookup(fstype))
+		return 0;
+	fs_invalidate(NULL);
+#endif
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
 				fstype != info->fstype)
@@ -222,6 +292,11 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
+#ifdef CONFIG_FS_MOUNT_CACHE
+			fs_mount.fstype = info->fstype;
+			fs_mount.dev_desc = fs_dev_desc;
+			fs_mount.partition = fs_partition;
+#endif
 			return 0;
 		}
 	}
@@ -231,9 +306,11 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 
 static void fs_close(void)
 {
+#ifndef CONFIG_FS_MOUNT_CACHE
 	struct fstype_info *info = fs_get_info(fs_type);
 
 	info->close();
+#endif
 
 	fs_type = FS_TYPE_ANY;
 }
@@ -325,6 +402,8 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 		printf("** Unable to write file %s **\n", filename);
 		ret = -1;
 	}
+	/* The mounted filesystem state may be out of date now */
+	fs_invalidate(NULL);
 	fs_close();
 
 	return ret;
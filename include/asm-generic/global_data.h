@@ -21,6 +21,7 @@
  */
 
 #ifndef __ASSEMBLY__
+#include <dm/uclass-id.h>
 #include <linux/list.h>
 
 typedef struct global_data {
@@ -68,9 +69,16 @@ typedef struct global_data {
 	struct udevice	*dm_root;	/* Root instance for Driver Model */
 	struct udevice	*dm_root_f;	/* Pre-relocation root instance */
 	struct list_head uclass_root;	/* Head of core tree */
+	struct dm_compat_index *dm_compat_index; /* Compatible-string index */
+#ifdef CONFIG_DM_UCLASS_TABLE
+	struct uclass *uclass_table[UCLASS_COUNT]; /* uclass for each ID */
+#endif
 #endif
 
 	const void *fdt_blob;	/* Our device tree, NULL if none */
+#ifdef CONFIG_OF_LIBFDT_INDEX
+	struct fdt_index *fdt_index;	/* Index of fdt_blob, NULL if none */
+#endif
 	void *new_fdt;		/* Relocated FDT */
 	unsigned long fdt_size;	/* Space reserved for relocated FDT */
 	struct jt_funcs *jt;		/* jump table */
@@ -35,6 +35,11 @@
 #undef CONFIG_DM_DEVICE_REMOVE
 #undef CONFIG_DM_SEQ_ALIAS
 #undef CONFIG_DM_STDIO
+#undef CONFIG_DM_COMPAT_INDEX
+#undef CONFIG_DM_UCLASS_TABLE
+#undef CONFIG_OF_LIBFDT_INDEX
+#undef CONFIG_SERIAL_RX_BUFFER
+#undef CONFIG_INITCALL_DEFER
 
 #endif /* CONFIG_SPL_BUILD */
 #endif /* __CONFIG_UNCMD_SPL_H__ */
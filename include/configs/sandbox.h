@@ -23,6 +23,9 @@
 
 #define CONFIG_SYS_STDIO_DEREGISTER
 
+/* Set up the network when it is first needed */
+#define CONFIG_INITCALL_DEFER
+
 /* Number of bits in a C 'long' on this architecture */
 #define CONFIG_SANDBOX_BITS_PER_LONG	64
 
@@ -46,10 +49,14 @@
 #define CONFIG_DOS_PARTITION
 #define CONFIG_HOST_MAX_DEVICES 4
 #define CONFIG_CMD_FS_GENERIC
+#define CONFIG_FS_MOUNT_CACHE
 #define CONFIG_CMD_MD5SUM
 
 #define CONFIG_CMD_GPIO
 
+/* Streaming serial download, which tools/sersend can drive */
+#define CONFIG_CMD_LOADW
+
 #define CONFIG_CMD_GPT
 #define CONFIG_PARTITION_UUIDS
 #define CONFIG_EFI_PARTITION
@@ -77,6 +84,9 @@
 #define CONFIG_ENV_SIZE		8192
 #define CONFIG_ENV_IS_NOWHERE
 
+/* Build the log-structured environment format, so that it can be tested */
+#define CONFIG_ENV_LOG
+
 /* SPI - enable all SPI flash types for testing purposes */
 #define CONFIG_CMD_SF
 #define CONFIG_CMD_SF_TEST
@@ -118,6 +118,15 @@ struct dfu_entity {
 	int (*write_medium)(struct dfu_entity *dfu,
 			u64 offset, void *buf, long *len);
 
+	/*
+	 * Optional: start a write and return before it is finished, so that
+	 * the next buffer can be received while the medium is programmed.
+	 * The write is finished by write_medium_wait().
+	 */
+	int (*write_medium_start)(struct dfu_entity *dfu,
+			u64 offset, void *buf, long *len);
+	int (*write_medium_wait)(struct dfu_entity *dfu);
+
 	int (*flush_medium)(struct dfu_entity *dfu);
 	unsigned int (*poll_timeout)(struct dfu_entity *dfu);
 
@@ -135,9 +144,15 @@ struct dfu_entity {
 	long r_left;
 	long b_left;
 
+	/* write started by write_medium_start() and not yet finished */
+	unsigned long w_start;	/* get_timer() value when it started */
+	long w_len;
+	unsigned long w_rate;	/* measured bytes per ms, 0 if unknown */
+
 	u32 bad_skip;	/* for nand use */
 
 	unsigned int inited:1;
+	unsigned int w_busy:1;
 };
 
 #ifdef CONFIG_SET_DFU_ALT_INFO
@@ -162,6 +177,7 @@ bool dfu_usb_get_reset(void);
 int dfu_read(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_write(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_flush(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
+unsigned int dfu_get_write_timeout(struct dfu_entity *de, int size);
 /* Device specific */
 #ifdef CONFIG_DFU_MMC
 extern int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s);
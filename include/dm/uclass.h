@@ -30,12 +30,19 @@
  * @dev_head: List of devices in this uclass (devices are attached to their
  * uclass when their bind method is called)
  * @sibling_node: Next uclass in the linked list of uclasses
+ * @seq_dev: Devices indexed by sequence number (CONFIG_DM_UCLASS_TABLE)
+ * @seq_size: Number of entries in @seq_dev, or -1 if the table could not
+ * be kept, in which case the device list is searched instead
  */
 struct uclass {
 	void *priv;
 	struct uclass_driver *uc_drv;
 	struct list_head dev_head;
 	struct list_head sibling_node;
+#ifdef CONFIG_DM_UCLASS_TABLE
+	struct udevice **seq_dev;
+	int seq_size;
+#endif
 };
 
 struct udevice;
@@ -213,6 +220,17 @@ int uclass_next_device(struct udevice **devp);
  */
 int uclass_resolve_seq(struct udevice *dev);
 
+/**
+ * uclass_set_seq() - Set a device's sequence number
+ *
+ * This must be used to change dev->seq once the device is bound, so that
+ * the uclass can find the device by its sequence number.
+ *
+ * @dev: Device to update
+ * @seq: New sequence number, or -1 if none
+ */
+void uclass_set_seq(struct udevice *dev, int seq);
+
 /**
  * uclass_foreach_dev() - Helper function to iteration through devices
  *
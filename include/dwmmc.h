@@ -9,6 +9,7 @@
 #define __DWMMC_HW_H
 
 #include <asm/io.h>
+#include <bouncebuf.h>
 #include <mmc.h>
 
 #define DWMCI_CTRL		0x000
@@ -149,6 +150,10 @@ struct dwmci_host {
 	void (*board_init)(struct dwmci_host *host);
 	unsigned int (*get_mmc_clk)(struct dwmci_host *host);
 
+	/* Data transfer set up by dwmci_send_cmd_common() */
+	struct bounce_buffer bbstate;
+	struct dwmci_idmac *idmac;
+
 	struct mmc_config cfg;
 };
 
@@ -0,0 +1,148 @@
+/*
+ * Log-structured environment storage
+ *
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __ENV_LOG_H
+#define __ENV_LOG_H
+
+/*
+ * A log-structured environment region starts with a header, followed by
+ * chunks of environment data in the usual "name=value\0" form. The first
+ * chunk holds the whole environment and each later one holds the variables
+ * changed by a saveenv, with a bare "name\0" for one which was deleted. The
+ * region is only written in place while it has erased space left, so a
+ * save does not need to erase anything until the log fills up.
+ *
+ * The header is written after the first chunk, so a region which has a
+ * header also has a complete environment. With two regions, the one with
+ * the later generation number is used.
+ */
+
+/* "ELOG" */
+#define ENV_LOG_MAGIC		0x474f4c45
+
+/* Most variables to remember as changed, before saving them all instead */
+#define ENV_LOG_MAX_CHANGED	32
+
+/**
+ * struct env_log_header - Start of a log-structured environment region
+ *
+ * @magic:	ENV_LOG_MAGIC
+ * @gen:	Generation, which goes up by one each time the log is rewritten
+ */
+struct env_log_header {
+	uint32_t magic;
+	uint32_t gen;
+};
+
+/**
+ * struct env_log_chunk - Environment data added to the log by one save
+ *
+ * This is followed by @len bytes of data, then padding to a multiple of
+ * four bytes. A @len of 0xffffffff is erased flash and ends the log.
+ *
+ * @crc:	CRC32 of @len and the data
+ * @len:	Number of bytes of data
+ */
+struct env_log_chunk {
+	uint32_t crc;
+	uint32_t len;
+};
+
+/* Space taken in the region by a chunk with @len bytes of data */
+#define ENV_LOG_CHUNK_SIZE(len)	(sizeof(struct env_log_chunk) + ALIGN(len, 4))
+
+#ifdef CONFIG_ENV_LOG
+/**
+ * env_log_changed() - Note that a variable has changed since the last save
+ *
+ * @name:	Name of variable
+ */
+void env_log_changed(const char *name);
+
+/**
+ * env_log_changed_all() - Note that the whole environment has been replaced
+ *
+ * The next save writes out the whole environment.
+ */
+void env_log_changed_all(void);
+
+/**
+ * env_log_clear() - Forget about changes, once the environment is saved
+ */
+void env_log_clear(void);
+
+/**
+ * env_log_scan() - Check a log-structured environment region
+ *
+ * @buf:	Contents of region
+ * @size:	Size of region in bytes
+ * @genp:	Returns generation number of the region
+ * @freep:	Returns offset of the erased space after the log, or @size
+ *		if the log ended with a chunk that was not fully written
+ * @return offset of the end of the valid chunks, or -EINVAL if the region
+ * does not hold a valid log
+ */
+int env_log_scan(const void *buf, int size, uint32_t *genp, int *freep);
+
+/**
+ * env_log_find() - Find the copy of the environment to use
+ *
+ * This picks the copy with the latest generation which holds a valid log.
+ *
+ * @bufs:	Contents of each copy, or NULL if it could not be read
+ * @count:	Number of copies
+ * @size:	Size of each copy in bytes
+ * @endp:	Returns the end of the valid chunks in the copy picked
+ * @genp:	Returns the generation number of the copy picked
+ * @freep:	Returns the offset of the erased space in the copy picked,
+ *		as for env_log_scan()
+ * @return index of the copy picked, or -ENOENT if none holds a valid log
+ */
+int env_log_find(void *const bufs[], int count, int size, int *endp,
+		 uint32_t *genp, int *freep);
+
+/**
+ * env_log_import() - Import the environment from a log
+ *
+ * This replaces the current environment, then forgets about changes.
+ *
+ * @buf:	Contents of region, checked by env_log_scan()
+ * @end:	End of valid chunks, as returned by env_log_scan()
+ * @return 0 if OK, -ve on error
+ */
+int env_log_import(const void *buf, int end);
+
+/**
+ * env_log_build() - Build a chunk to save the environment
+ *
+ * The chunk holds the variables which have changed or, if the whole
+ * environment has been replaced or @snapshotp is already true, all of them.
+ * It is written as @chunk followed by the data; the padding after the data
+ * can be left as it is.
+ *
+ * @chunk:	Returns the chunk header. Its @len is 0 if nothing has changed
+ * @datap:	Returns allocated buffer holding the data, to be freed by the
+ *		caller
+ * @snapshotp:	On entry, true to save the whole environment. Returns true if
+ *		the chunk holds the whole environment, so the log must be
+ *		rewritten to use it
+ * @return 0 if OK, -ve on error
+ */
+int env_log_build(struct env_log_chunk *chunk, char **datap,
+		  bool *snapshotp);
+#else
+static inline void env_log_changed(const char *name)
+{
+}
+
+static inline void env_log_changed_all(void)
+{
+}
+#endif
+
+#endif /* __ENV_LOG_H */
@@ -194,6 +194,7 @@ extern uint mmc_get_env_part(struct mmc *mmc);
 #include <env_attr.h>
 #include <env_callback.h>
 #include <env_flags.h>
+#include <env_log.h>
 #include <search.h>
 
 extern struct hsearch_data env_htab;
@@ -174,6 +174,8 @@ typedef struct {
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
 	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	int	*fatbufnums;	/* FAT window held in each slot of fatbuf */
+	int	fatbufslots;	/* Number of FATBUFBLOCKS slots in fatbuf */
 } fsdata;
 
 typedef int	(file_detectfs_func)(void);
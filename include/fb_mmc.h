@@ -7,3 +7,42 @@
 void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 			unsigned int download_bytes, char *response);
 void fb_mmc_erase(const char *cmd, char *response);
+
+/**
+ * fb_mmc_stream_select() - Select a partition to write the next download to
+ *
+ * The next download is then written to the partition while it is still
+ * being received, so that the flash command for that partition has nothing
+ * left to do but report the result. The data is still kept in the download
+ * buffer, so other commands work as before. The selection is dropped once
+ * that download has been dealt with.
+ *
+ * @part:	Partition name or alias, or "" to cancel the selection
+ */
+void fb_mmc_stream_select(const char *part);
+
+/**
+ * fb_mmc_stream_start() - Start writing a download as it arrives
+ *
+ * This does nothing unless a partition has been selected.
+ *
+ * @download_buffer:	Buffer that the download is received into
+ * @download_size:	Size of the download in bytes
+ */
+void fb_mmc_stream_start(void *download_buffer, unsigned int download_size);
+
+/**
+ * fb_mmc_stream_data() - Write whatever part of a download has arrived
+ *
+ * The writes are left in progress, so this returns quickly.
+ *
+ * @download_bytes:	Number of bytes received so far
+ */
+void fb_mmc_stream_data(unsigned int download_bytes);
+
+/**
+ * fb_mmc_stream_end() - Finish writing a download once it has all arrived
+ *
+ * @download_bytes:	Number of bytes received
+ */
+void fb_mmc_stream_end(unsigned int download_bytes);
@@ -0,0 +1,151 @@
+/*
+ * Batched changes to a device tree
+ *
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __FDT_BATCH_H
+#define __FDT_BATCH_H
+
+struct fdt_batch_op;
+
+/**
+ * struct fdt_batch - A list of property changes to make to a device tree
+ *
+ * Changes are queued with fdt_batch_setprop() and fdt_batch_delprop(),
+ * which do not touch the tree. fdt_batch_apply() then makes all the changes
+ * at once.
+ *
+ * Each change records the offset of its node. While the batch is started
+ * with fdt_batch_start(), libfdt moves these offsets as it changes the
+ * tree, so the tree may be changed in other ways while the batch is built
+ * up. Changes to nodes which are deleted are dropped. A change made
+ * directly to a property with a queued change is overridden by the queued
+ * change. Other batches must not be used across changes to the tree.
+ *
+ * @fdt:	Tree whose fixups go into this batch, see fdt_batch_start()
+ * @op:		Changes, in the order they were queued
+ * @count:	Number of changes
+ * @max:	Number of changes there is space for in @op
+ */
+struct fdt_batch {
+	void *fdt;
+	struct fdt_batch_op *op;
+	int count;
+	int max;
+};
+
+/**
+ * fdt_batch_init() - Set up an empty batch
+ *
+ * @batch:	Batch to set up
+ */
+void fdt_batch_init(struct fdt_batch *batch);
+
+/**
+ * fdt_batch_start() - Collect the changes of the fixup helpers in a batch
+ *
+ * Until the batch is applied or freed, do_fixup_by_prop(),
+ * do_fixup_by_compat() and fdt_fixup_ethernet() queue their changes to
+ * @fdt in @batch instead of making them straight away. Only one batch can
+ * be started at a time.
+ *
+ * This is only safe when nothing reads back a property with a queued change
+ * before the batch is applied, and nothing changes it directly.
+ *
+ * @batch:	Batch to set up
+ * @fdt:	Tree which the changes are for
+ */
+void fdt_batch_start(struct fdt_batch *batch, void *fdt);
+
+/**
+ * fdt_batch_get() - Get the started batch for a tree
+ *
+ * @fdt:	Tree to check
+ * @return batch started for @fdt, or NULL if none
+ */
+struct fdt_batch *fdt_batch_get(const void *fdt);
+
+/**
+ * fdt_batch_setprop() - Queue setting a property
+ *
+ * If the property does not exist, it is added. If the same property is
+ * changed more than once in a batch, the last change wins.
+ *
+ * @batch:	Batch to add to
+ * @fdt:	Tree as it is now
+ * @nodeoffset:	Offset of node in @fdt
+ * @name:	Name of property
+ * @val:	Value of property, which is copied
+ * @len:	Length of value in bytes
+ * @return 0 if OK, -FDT_ERR_... on error, in which case the change is not
+ * queued but the rest of the batch is unaffected
+ */
+int fdt_batch_setprop(struct fdt_batch *batch, const void *fdt,
+		      int nodeoffset, const char *name, const void *val,
+		      int len);
+
+/**
+ * fdt_batch_delprop() - Queue deleting a property
+ *
+ * It is not an error if the property does not exist.
+ *
+ * @batch:	Batch to add to
+ * @fdt:	Tree as it is now
+ * @nodeoffset:	Offset of node in @fdt
+ * @name:	Name of property
+ * @return 0 if OK, -FDT_ERR_... on error, in which case the change is not
+ * queued but the rest of the batch is unaffected
+ */
+int fdt_batch_delprop(struct fdt_batch *batch, const void *fdt,
+		      int nodeoffset, const char *name);
+
+/**
+ * fdt_batch_apply() - Make the changes in a batch
+ *
+ * This writes the tree's structure block once, with the changes made,
+ * leaving the tree packed within its existing total size. On error the
+ * tree is not changed. Either way the batch is freed and left empty.
+ * Node offsets from before the call are not valid afterwards.
+ *
+ * If another batch is started for @fdt, the changes are moved to that one
+ * instead, and made when it is applied.
+ *
+ * @batch:	Batch to apply
+ * @fdt:	Device tree to change
+ * @return 0 if OK, -FDT_ERR_NOSPACE if the tree or malloc() does not have
+ * enough space, other -FDT_ERR_... on error
+ */
+int fdt_batch_apply(struct fdt_batch *batch, void *fdt);
+
+/**
+ * fdt_batch_free() - Drop a batch without applying it
+ *
+ * @batch:	Batch to free
+ */
+void fdt_batch_free(struct fdt_batch *batch);
+
+#if !defined(CONFIG_SPL_BUILD) && !defined(USE_HOSTCC)
+/**
+ * fdt_batch_splice() - Move the started batch's changes as a tree changes
+ *
+ * libfdt calls this when it replaces a region of a tree's structure block.
+ * Changes to nodes after the region move with them. Changes to nodes in the
+ * region are dropped.
+ *
+ * @fdt:	Tree which has changed
+ * @offset:	Offset of region in the structure block
+ * @oldlen:	Length of region before the change
+ * @newlen:	Length of region after the change
+ */
+void fdt_batch_splice(const void *fdt, int offset, int oldlen, int newlen);
+#else
+static inline void fdt_batch_splice(const void *fdt, int offset, int oldlen,
+				    int newlen)
+{
+}
+#endif
+
+#endif /* __FDT_BATCH_H */
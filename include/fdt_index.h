@@ -0,0 +1,160 @@
+/*
+ * Index of a read-only device tree, to speed up libfdt lookups
+ *
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __FDT_INDEX_H
+#define __FDT_INDEX_H
+
+/**
+ * struct fdt_index_node - A node in the index
+ *
+ * Nodes are held in the order they appear in the tree, so in order of
+ * offset. The links are indexes into the node table.
+ *
+ * @offset:	Offset of the node in the tree
+ * @parent:	Parent node, or -1 for the root node
+ * @child:	First child node, or -1 if none
+ * @sibling:	Next sibling node, or -1 if none
+ */
+struct fdt_index_node {
+	int offset;
+	int parent;
+	int child;
+	int sibling;
+};
+
+/**
+ * struct fdt_index_phandle - A phandle in the index
+ *
+ * @phandle:	Phandle value
+ * @offset:	Offset of the node with this phandle
+ */
+struct fdt_index_phandle {
+	uint32_t phandle;
+	int offset;
+};
+
+/**
+ * struct fdt_index_alias - An alias in the index
+ *
+ * @name:	Name of alias, pointing into the tree's strings block
+ * @offset:	Offset of the node the alias points to
+ */
+struct fdt_index_alias {
+	const char *name;
+	int offset;
+};
+
+/**
+ * struct fdt_index - Index of a device tree
+ *
+ * @fdt:		Tree which is indexed
+ * @node_count:		Number of nodes
+ * @node:		Nodes, in order of offset
+ * @phandle_count:	Number of phandles
+ * @phandle:		Phandles, in order of phandle value
+ * @alias_count:	Number of aliases
+ * @alias:		Aliases, in the order they are in /aliases
+ */
+struct fdt_index {
+	const void *fdt;
+	int node_count;
+	struct fdt_index_node *node;
+	int phandle_count;
+	struct fdt_index_phandle *phandle;
+	int alias_count;
+	struct fdt_index_alias *alias;
+};
+
+#if defined(CONFIG_OF_LIBFDT_INDEX) && !defined(USE_HOSTCC)
+/**
+ * fdt_index_build() - Build an index of a device tree
+ *
+ * Only one tree is indexed at a time, so this replaces any previous index.
+ * Lookups in the tree then use the index until the tree is changed
+ * through libfdt, or another tree is indexed.
+ *
+ * @fdt:	Tree to index
+ * @return 0 if OK, -ENOMEM if out of memory, -EINVAL if the tree is bad
+ */
+int fdt_index_build(const void *fdt);
+
+/**
+ * fdt_index_get() - Get the index for a device tree
+ *
+ * @fdt:	Tree to check
+ * @return index, or NULL if @fdt is not indexed
+ */
+const struct fdt_index *fdt_index_get(const void *fdt);
+
+/**
+ * fdt_index_invalidate() - Drop the index for a device tree
+ *
+ * This must be called before a tree is changed.
+ *
+ * @fdt:	Tree which will change
+ */
+void fdt_index_invalidate(const void *fdt);
+
+/**
+ * fdt_index_find_node() - Find a node in an index
+ *
+ * @index:	Index to search
+ * @offset:	Offset of node
+ * @return node index, or -1 if @offset is not the offset of a node
+ */
+int fdt_index_find_node(const struct fdt_index *index, int offset);
+
+/**
+ * fdt_index_find_phandle() - Find a node by phandle
+ *
+ * @index:	Index to search
+ * @phandle:	Phandle to find
+ * @return offset of the first node with this phandle, or -FDT_ERR_NOTFOUND
+ */
+int fdt_index_find_phandle(const struct fdt_index *index, uint32_t phandle);
+
+/**
+ * fdt_index_find_alias() - Find the node an alias points to
+ *
+ * @index:	Index to search
+ * @name:	Name of alias
+ * @namelen:	Length of name
+ * @return offset of node, or -1 if the alias is not in the index
+ */
+int fdt_index_find_alias(const struct fdt_index *index, const char *name,
+			 int namelen);
+#else
+static inline const struct fdt_index *fdt_index_get(const void *fdt)
+{
+	return NULL;
+}
+
+static inline void fdt_index_invalidate(const void *fdt)
+{
+}
+
+static inline int fdt_index_find_node(const struct fdt_index *index,
+				      int offset)
+{
+	return -1;
+}
+
+static inline int fdt_index_find_phandle(const struct fdt_index *index,
+					 uint32_t phandle)
+{
+	return -1;
+}
+
+static inline int fdt_index_find_alias(const struct fdt_index *index,
+				       const char *name, int namelen)
+{
+	return -1;
+}
+#endif
+
+#endif /* __FDT_INDEX_H */
@@ -35,6 +35,22 @@
  */
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype);
 
+/*
+ * With CONFIG_FS_MOUNT_CACHE the filesystem mounted by fs_set_blk_dev() is
+ * kept after each command and reused when the same partition is selected
+ * again. Unmount it if it is on the given block device, or in any case if
+ * dev_desc is NULL. FAT's directory index is dropped too. This must be
+ * called when a device is removed or rescanned, or is written to behind the
+ * filesystem's back.
+ */
+#ifndef CONFIG_SPL_BUILD
+void fs_invalidate(block_dev_desc_t *dev_desc);
+#else
+static inline void fs_invalidate(block_dev_desc_t *dev_desc)
+{
+}
+#endif
+
 /*
  * Print the list of files on the partition previously set by fs_set_blk_dev(),
  * in directory "dirname".
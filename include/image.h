@@ -750,6 +750,7 @@ int bootz_setup(ulong image, ulong *start, ulong *end);
 #define FIT_ALGO_PROP		"algo"
 #define FIT_VALUE_PROP		"value"
 #define FIT_IGNORE_PROP		"uboot-ignore"
+#define FIT_CHUNK_SIZE_PROP	"chunk-size"
 #define FIT_SIG_NODENAME	"signature"
 
 /* image node */
@@ -896,6 +897,77 @@ int fit_check_ramdisk(const void *fit, int os_noffset,
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len);
 
+/**
+ * fit_image_hash_calc() - Calculate the value of a hash node
+ *
+ * If the hash node has a "chunk-size" property, the data is split into
+ * chunks of that size and the value is the hash of the concatenated hashes
+ * of the chunks. The chunks are hashed in parallel when CONFIG_WORKER is
+ * enabled.
+ *
+ * @fit:	FIT holding the hash node
+ * @noffset:	Offset of the hash node
+ * @data:	Image data
+ * @size:	Size of image data in bytes
+ * @value:	Place to put the value (FIT_MAX_HASH_LEN bytes)
+ * @value_len:	Returns the length of the value in bytes
+ * @return 0 if OK, -ve on error
+ */
+int fit_image_hash_calc(const void *fit, int noffset, const void *data,
+			size_t size, uint8_t *value, int *value_len);
+
+/**
+ * struct fit_stream - a FIT which is read from storage piece by piece
+ *
+ * @read:	Read @len bytes at @offset in the FIT into @buf, returning 0
+ *		if ok or a negative error code
+ * @priv:	Private data for @read
+ * @fit:	Copy of the FIT without the image data, set up by
+ *		fit_stream_open(). It can be used with the fit_...()
+ *		functions to look up configurations and images.
+ */
+struct fit_stream {
+	int (*read)(struct fit_stream *stream, ulong offset, void *buf,
+		    ulong len);
+	void *priv;
+	void *fit;
+};
+
+/**
+ * fit_stream_open() - Read the structure of a FIT
+ *
+ * This reads everything in the FIT except for the image data, which is
+ * read by fit_stream_load() when needed.
+ *
+ * @stream:	FIT to read, with @read and @priv set up
+ * @return 0 if ok, -ve on error
+ */
+int fit_stream_open(struct fit_stream *stream);
+
+/**
+ * fit_stream_load() - Load an image from a FIT
+ *
+ * The image data is read in chunks. Each chunk is hashed and, if the image
+ * is compressed, decompressed to @load, so the data is never held in
+ * memory as a whole. The image's hash nodes are checked at the end.
+ *
+ * @stream:	FIT opened with fit_stream_open()
+ * @noffset:	Offset of the image node in @stream->fit
+ * @load:	Address to load the (decompressed) image to
+ * @max_len:	Maximum size of the decompressed image
+ * @lenp:	Returns the size of the (decompressed) image
+ * @return 0 if ok, -EBADMSG if a hash does not match, other -ve on error
+ */
+int fit_stream_load(struct fit_stream *stream, int noffset, ulong load,
+		    ulong max_len, ulong *lenp);
+
+/**
+ * fit_stream_close() - Free the memory used by fit_stream_open()
+ *
+ * @stream:	FIT to close
+ */
+void fit_stream_close(struct fit_stream *stream);
+
 /*
  * At present we only support signing on the host, and verification on the
  * device
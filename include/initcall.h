@@ -7,3 +7,76 @@
 typedef int (*init_fnc_t)(void);
 
 int initcall_run_list(const init_fnc_t init_sequence[]);
+
+/**
+ * struct initcall_defer - An init step which need not hold up the others
+ *
+ * A step is started from the init sequence by initcall_defer_start(). If
+ * it is not done by then, it is polled between the init calls which follow
+ * and during the autoboot delay. Code which needs the step done can finish
+ * it with initcall_defer_finish(). Anything still left is finished before
+ * the first command is run, since that may need it.
+ *
+ * Steps do not depend on each other: each is finished on its own, in the
+ * order that they were started.
+ *
+ * @name:	Name of the step, used for its bootstage record
+ * @id:		Bootstage ID used to add up the time spent on the step. This
+ *		also identifies the step to initcall_defer_finish()
+ * @start:	Starts the step, or NULL to leave it all to @finish. Returns 0
+ *		if the step is done, -EINPROGRESS if not, other -ve on error
+ * @poll:	Makes progress without waiting, or NULL. Returns as @start
+ * @finish:	Finishes the step, waiting as needed, or NULL if there is
+ *		nothing that must be waited for. Returns 0 if OK, -ve on error
+ * @next:	Next step which is not done yet (used internally)
+ */
+struct initcall_defer {
+	const char *name;
+	enum bootstage_id id;
+	init_fnc_t start;
+	init_fnc_t poll;
+	init_fnc_t finish;
+	struct initcall_defer *next;
+};
+
+#ifdef CONFIG_INITCALL_DEFER
+/**
+ * initcall_defer_start() - Start a deferred init step
+ *
+ * @step:	Step to start
+ * @return 0, so that this can be returned from an init call. A step which
+ * fails reports its error but does not stop the init sequence
+ */
+int initcall_defer_start(struct initcall_defer *step);
+
+/**
+ * initcall_defer_poll() - Poll deferred init steps which are not yet done
+ */
+void initcall_defer_poll(void);
+
+/**
+ * initcall_defer_finish() - Finish a deferred init step if it is not done
+ *
+ * This does nothing if the step has not been started, or is already done.
+ *
+ * @id:		Bootstage ID of the step
+ */
+void initcall_defer_finish(enum bootstage_id id);
+
+/**
+ * initcall_defer_finish_all() - Finish all deferred init steps
+ */
+void initcall_defer_finish_all(void);
+#else
+static inline void initcall_defer_poll(void)
+{
+}
+
+static inline void initcall_defer_finish(enum bootstage_id id)
+{
+}
+
+static inline void initcall_defer_finish_all(void)
+{
+}
+#endif
@@ -56,8 +56,10 @@
 #define MMC_MODE_8BIT		(1 << 3)
 #define MMC_MODE_SPI		(1 << 4)
 #define MMC_MODE_DDR_52MHz	(1 << 5)
+#define MMC_MODE_CMD23		(1 << 6)	/* SET_BLOCK_COUNT */
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_SCR_CMD23	0x00000002
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
@@ -302,6 +304,15 @@ struct mmc_ops {
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
 	int (*getwp)(struct mmc *mmc);
+	/*
+	 * Optional: send a command and start its data transfer, returning
+	 * as soon as the response is in. send_cmd_wait() then waits for
+	 * the data. Nothing else is sent to the card in between.
+	 */
+	int (*send_cmd_start)(struct mmc *mmc,
+			      struct mmc_cmd *cmd, struct mmc_data *data);
+	int (*send_cmd_wait)(struct mmc *mmc,
+			     struct mmc_cmd *cmd, struct mmc_data *data);
 };
 
 struct mmc_config {
@@ -315,6 +326,13 @@ struct mmc_config {
 	unsigned char part_type;
 };
 
+/* A block transfer started by mmc_bread_start() or mmc_bwrite_start() */
+struct mmc_xfer {
+	struct mmc_cmd cmd;
+	struct mmc_data data;	/* data.blocks is 0 if there is none */
+	bool stop;		/* send STOP_TRANSMISSION when done */
+};
+
 /* TODO struct mmc should be in mmc_private but it's hard to fix right now */
 struct mmc {
 	struct list_head link;
@@ -355,6 +373,7 @@ struct mmc {
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	int ddr_mode;
+	struct mmc_xfer xfer;
 };
 
 struct mmc_hwpart_conf {
@@ -384,6 +403,47 @@ void mmc_destroy(struct mmc *mmc);
 int mmc_initialize(bd_t *bis);
 int mmc_init(struct mmc *mmc);
 int mmc_read(struct mmc *mmc, u64 src, uchar *dst, int size);
+
+/**
+ * mmc_bread_start() - Start reading blocks from a device
+ *
+ * This returns while the last part of the data is still being transferred,
+ * so that the caller can get on with something else. It must be followed
+ * by mmc_bxfer_wait() before the data is used or the device is accessed in
+ * any other way. Where the host has no asynchronous transfers, the data is
+ * read before this returns.
+ *
+ * @mmc:	Device to read from
+ * @start:	First block to read
+ * @blkcnt:	Number of blocks to read
+ * @dst:	Place to put the data
+ * @return number of blocks started, 0 on error
+ */
+ulong mmc_bread_start(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		      void *dst);
+
+/**
+ * mmc_bwrite_start() - Start writing blocks to a device
+ *
+ * As mmc_bread_start(), but for writing. @src must not be changed until
+ * mmc_bxfer_wait() has returned.
+ *
+ * @mmc:	Device to write to
+ * @start:	First block to write
+ * @blkcnt:	Number of blocks to write
+ * @src:	Data to write
+ * @return number of blocks started, 0 on error
+ */
+ulong mmc_bwrite_start(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		       const void *src);
+
+/**
+ * mmc_bxfer_wait() - Finish a transfer started by mmc_bread/bwrite_start()
+ *
+ * @mmc:	Device being accessed
+ * @return 0 if OK (or there was no transfer), -ve on error
+ */
+int mmc_bxfer_wait(struct mmc *mmc);
 void mmc_set_clock(struct mmc *mmc, uint clock);
 struct mmc *find_mmc_device(int dev_num);
 int mmc_set_dev(int dev_num);
@@ -438,6 +498,17 @@ int mmc_start_init(struct mmc *mmc);
  */
 void mmc_set_preinit(struct mmc *mmc, int preinit);
 
+/**
+ * mmc_preinit_poll() - Check on cards whose init was started early
+ *
+ * An eMMC can take hundreds of milliseconds to power up after its init is
+ * started. This asks each one that is still busy whether it is ready yet,
+ * without waiting, so that mmc_init() has less to wait for later.
+ *
+ * @return 0 if no card is still powering up, -EINPROGRESS if one is
+ */
+int mmc_preinit_poll(void);
+
 #ifdef CONFIG_GENERIC_MMC
 #ifdef CONFIG_MMC_SPI
 #define mmc_host_is_spi(mmc)	((mmc)->cfg->host_caps & MMC_MODE_SPI)
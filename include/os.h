@@ -170,6 +170,26 @@ void os_usleep(unsigned long usec);
  */
 uint64_t os_get_nsec(void);
 
+/**
+ * Start a function running in a new host thread
+ *
+ * The function must not call anything which is not safe to run alongside
+ * U-Boot on another CPU; see struct worker_job.
+ *
+ * \param func		Function to run
+ * \param arg		Argument to pass to func
+ * \return handle to pass to os_thread_join(), or NULL on error
+ */
+void *os_thread_start(int (*func)(void *arg), void *arg);
+
+/**
+ * Wait for a thread started by os_thread_start() to finish
+ *
+ * \param thread	Thread handle
+ * \return value returned by the thread's function
+ */
+int os_thread_join(void *thread);
+
 /**
  * Parse arguments and update sandbox state.
  *
@@ -253,6 +253,11 @@ struct sdhci_host {
 	void (*set_clock)(int dev_index, unsigned int div);
 	uint	voltages;
 
+	/* Data transfer set up by sdhci_send_command_start() */
+	unsigned int start_addr;
+	int trans_bytes;
+	int is_aligned;
+
 	struct mmc_config cfg;
 };
 
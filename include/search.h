@@ -48,11 +48,19 @@ struct _ENTRY;
  * functions all work on a signle internal hashing table.
  */
 
-/* Data type for reentrant functions.  */
+/*
+ * Data type for reentrant functions.
+ *
+ * The table grows as entries are added. It keeps a list of its entries,
+ * which hexport_r() leaves in sorted order, so that exporting again after
+ * a few changes is cheap.
+ */
 struct hsearch_data {
 	struct _ENTRY *table;
 	unsigned int size;
 	unsigned int filled;
+	unsigned int deleted;	/* slots holding deleted entries */
+	int nest;		/* calls in progress, while the table can't move */
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
@@ -64,7 +72,7 @@ struct hsearch_data {
 		int flag);
 };
 
-/* Create a new hashing table which will at most contain NEL elements.  */
+/* Create a new hashing table, with space for NEL elements to start with.  */
 extern int hcreate_r(size_t __nel, struct hsearch_data *__htab);
 
 /* Destroy current internal hashing table.  */
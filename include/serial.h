@@ -156,9 +156,17 @@ struct dm_serial_ops {
  * struct serial_dev_priv - information about a device used by the uclass
  *
  * @sdev: stdio device attached to this uart
+ * @buf: Input buffer (CONFIG_SERIAL_RX_BUFFER_SIZE bytes), or NULL if none
+ * @rd_ptr: Number of characters read from @buf so far
+ * @wr_ptr: Number of characters written to @buf so far
  */
 struct serial_dev_priv {
 	struct stdio_dev *sdev;
+#ifdef CONFIG_SERIAL_RX_BUFFER
+	char *buf;
+	uint rd_ptr;
+	uint wr_ptr;
+#endif
 };
 
 /* Access the serial operations for a device */
@@ -44,6 +44,9 @@ struct spi_slave;
  * @page_size:		Write (page) size
  * @sector_size:	Sector size
  * @erase_size:	Erase size
+ * @erase_size_32k:	Size erased by the 32K erase cmd, 0 if not supported
+ * @erase_size_64k:	Size erased by the 64K erase cmd
+ * @addr_width:	Number of address bytes sent with each cmd, 3 or 4
  * @bank_read_cmd:	Bank read cmd
  * @bank_write_cmd:	Bank write cmd
  * @bank_curr:		Current flash bank
@@ -75,6 +78,9 @@ struct spi_flash {
 	u32 page_size;
 	u32 sector_size;
 	u32 erase_size;
+	u32 erase_size_32k;
+	u32 erase_size_64k;
+	u8 addr_width;
 #ifdef CONFIG_SPI_FLASH_BAR
 	u8 bank_read_cmd;
 	u8 bank_write_cmd;
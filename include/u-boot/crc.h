@@ -14,6 +14,19 @@ uint32_t crc32 (uint32_t, const unsigned char *, uint);
 uint32_t crc32_wd (uint32_t, const unsigned char *, uint, uint);
 uint32_t crc32_no_comp (uint32_t, const unsigned char *, uint);
 
+/**
+ * arch_crc32_no_comp() - Update a CRC32 using architecture support
+ *
+ * This is provided by architectures which select CONFIG_CRC32_HW_ACCEL and
+ * replaces the table-driven code in crc32_no_comp().
+ *
+ * @crc:	CRC so far, with no ones complement
+ * @buf:	Data to add (any alignment)
+ * @len:	Number of bytes in @buf
+ * @return updated CRC
+ */
+uint32_t arch_crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len);
+
 /**
  * crc32_wd_buf - Perform CRC32 on a buffer and return result in buffer
  *
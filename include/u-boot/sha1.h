@@ -104,6 +104,21 @@ void sha1_hmac(const unsigned char *key, int keylen,
 		const unsigned char *input, unsigned int ilen,
 		unsigned char *output);
 
+/**
+ * arch_sha1_blocks() - Process SHA-1 blocks using architecture support
+ *
+ * This is provided by architectures which select CONFIG_SHA_ARCH_ACCEL.
+ * The CPU features it relies on are checked on each call.
+ *
+ * @state:	Intermediate digest, updated on success
+ * @data:	Data to process (any alignment)
+ * @blocks:	Number of 64-byte blocks in @data
+ * @return 0 if OK, -ENOSYS if this CPU lacks the needed instructions, in
+ * which case the generic code is used
+ */
+int arch_sha1_blocks(uint32_t state[5], const uint8_t *data,
+		     unsigned int blocks);
+
 /**
  * \brief	   Checkup routine
  *
@@ -19,4 +19,19 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * arch_sha256_blocks() - Process SHA-256 blocks using architecture support
+ *
+ * This is provided by architectures which select CONFIG_SHA_ARCH_ACCEL.
+ * The CPU features it relies on are checked on each call.
+ *
+ * @state:	Intermediate digest, updated on success
+ * @data:	Data to process (any alignment)
+ * @blocks:	Number of 64-byte blocks in @data
+ * @return 0 if OK, -ENOSYS if this CPU lacks the needed instructions, in
+ * which case the generic code is used
+ */
+int arch_sha256_blocks(uint32_t state[8], const uint8_t *data,
+		       unsigned int blocks);
+
 #endif /* _SHA256_H */
@@ -721,6 +721,19 @@ struct dm_usb_ops {
 	 * is read). This should be NULL for EHCI, which does not need this.
 	 */
 	int (*alloc_device)(struct udevice *bus, struct usb_device *udev);
+
+	/**
+	 * get_max_xfer_size() - Get the largest transfer the controller takes
+	 *
+	 * Class drivers such as mass storage use this to size their
+	 * transfers, so that a large read needs as few commands as possible.
+	 * If this method is NULL they fall back to a small, safe size.
+	 *
+	 * @size:	Returns the maximum length in bytes of a single bulk
+	 *		transfer
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*get_max_xfer_size)(struct udevice *bus, size_t *size);
 };
 
 #define usb_get_ops(dev)	((struct dm_usb_ops *)(dev)->driver->ops)
@@ -903,6 +916,18 @@ int usb_new_device(struct usb_device *dev);
 
 int usb_alloc_device(struct usb_device *dev);
 
+/**
+ * usb_get_max_xfer_size() - Get the largest bulk transfer for a device
+ *
+ * This is limited by the host controller the device is attached to, e.g. by
+ * how many transfer descriptors it can queue at once.
+ *
+ * @dev:	USB device
+ * @size:	Returns the maximum length in bytes of a single bulk transfer
+ * @return 0 if OK, -ENOSYS if the controller does not report a limit
+ */
+int usb_get_max_xfer_size(struct usb_device *dev, size_t *size);
+
 /**
  * usb_emul_setup_device() - Set up a new USB device emulation
  *
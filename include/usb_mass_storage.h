@@ -15,11 +15,25 @@
 /* Wait at maximum 60 seconds for cable connection */
 #define UMS_CABLE_READY_TIMEOUT	60
 
+/*
+ * Sectors are cached in this many buffers of this many bytes, unless the
+ * "ums_cache_bufs" and "ums_cache_bufsiz" environment variables say
+ * otherwise. No buffers means no caching.
+ */
+#ifndef CONFIG_UMS_CACHE_BUFS
+#define CONFIG_UMS_CACHE_BUFS		4
+#endif
+#ifndef CONFIG_UMS_CACHE_BUFSIZ
+#define CONFIG_UMS_CACHE_BUFSIZ		(256 * 1024)
+#endif
+
 struct ums {
 	int (*read_sector)(struct ums *ums_dev,
 			   ulong start, lbaint_t blkcnt, void *buf);
 	int (*write_sector)(struct ums *ums_dev,
 			    ulong start, lbaint_t blkcnt, const void *buf);
+	/* Write back cached data, if there is any; 0 if OK, -ve on error */
+	int (*flush)(struct ums *ums_dev);
 	unsigned int start_sector;
 	unsigned int num_sectors;
 	const char *name;
@@ -0,0 +1,81 @@
+/*
+ * Running work on secondary CPUs
+ *
+ * Copyright (c) 2015 The Chromium OS Authors.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __WORKER_H
+#define __WORKER_H
+
+/* Most CPUs that worker_run_all() will use, including the boot CPU */
+#define WORKER_MAX_CPUS		16
+
+/**
+ * struct worker_job - A piece of work which may run on another CPU
+ *
+ * Work runs with no console, no driver model and no malloc(), none of
+ * which are safe to use from more than one CPU. It may only read memory
+ * and write to memory that no other job uses. It must not reset the
+ * watchdog or use a hardware accelerator either; the boot CPU resets the
+ * watchdog between the jobs it runs itself.
+ *
+ * @func:	Function to call
+ * @arg:	Argument to pass to @func
+ * @ret:	Value returned by @func
+ */
+struct worker_job {
+	int (*func)(void *arg);
+	void *arg;
+	int ret;
+};
+
+#if defined(CONFIG_WORKER) && !defined(USE_HOSTCC) && \
+	!defined(CONFIG_SPL_BUILD)
+/**
+ * worker_run_all() - Run a list of jobs, spread across the available CPUs
+ *
+ * The jobs are shared out between the boot CPU and the secondary CPUs
+ * which the architecture provides. This returns when all have finished.
+ *
+ * @jobs:	Jobs to run
+ * @count:	Number of jobs
+ */
+void worker_run_all(struct worker_job *jobs, int count);
+
+/**
+ * arch_worker_cpus() - Get the number of secondary CPUs which can run work
+ *
+ * @return number of CPUs, which are numbered from 0
+ */
+int arch_worker_cpus(void);
+
+/**
+ * arch_worker_start() - Start a function on a secondary CPU
+ *
+ * @cpu:	CPU to use, which must be idle
+ * @func:	Function to call
+ * @arg:	Argument to pass to @func
+ * @return 0 if OK, -ve on error, in which case the caller runs @func itself
+ */
+int arch_worker_start(int cpu, int (*func)(void *arg), void *arg);
+
+/**
+ * arch_worker_wait() - Wait for a secondary CPU to finish its function
+ *
+ * @cpu:	CPU to wait for, which must have been started
+ * @return value returned by the function
+ */
+int arch_worker_wait(int cpu);
+#else
+static inline void worker_run_all(struct worker_job *jobs, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		jobs[i].ret = jobs[i].func(jobs[i].arg);
+}
+#endif
+
+#endif /* __WORKER_H */
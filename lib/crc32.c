@@ -26,7 +26,17 @@
 
 #define tole(x) cpu_to_le32(x)
 
-#ifdef DYNAMIC_CRC_TABLE
+#if defined(CONFIG_CRC32_HW_ACCEL) && !defined(USE_HOSTCC)
+#define CRC32_ARCH
+#elif defined(CONFIG_CRC32_SLICE_BY_8) && !defined(CONFIG_SPL_BUILD)
+#define CRC32_SLICE_BY_8
+#else
+#define CRC32_BYTEWISE
+#endif
+
+#ifndef CRC32_BYTEWISE
+/* crc_table is not used */
+#elif defined(DYNAMIC_CRC_TABLE)
 
 local int crc_table_empty = 1;
 local uint32_t crc_table[256];
@@ -171,6 +181,38 @@ const uint32_t * ZEXPORT get_crc_table()
 #  define DO_CRC(x) crc = tab[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
 # endif
 
+#ifdef CRC32_SLICE_BY_8
+#include "crc32_slice8.h"
+
+/*
+ * Process eight bytes at a time. Each byte is looked up in its own table,
+ * which advances the CRC past the bytes after it, so the eight lookups are
+ * independent and the CPU can overlap them.
+ */
+local uint32_t crc32_slice8(uint32_t crc, const uint8_t *p, uInt len)
+{
+	const uint32_t (*tab)[256] = crc_slice_table;
+	uint32_t one, two;
+
+	for (; len && ((long)p & 3); len--)
+		crc = tab[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	for (; len >= 8; len -= 8, p += 8) {
+		one = le32_to_cpu(*(const uint32_t *)p) ^ crc;
+		two = le32_to_cpu(*(const uint32_t *)(p + 4));
+		crc = tab[7][one & 0xff] ^ tab[6][(one >> 8) & 0xff] ^
+		      tab[5][(one >> 16) & 0xff] ^ tab[4][one >> 24] ^
+		      tab[3][two & 0xff] ^ tab[2][(two >> 8) & 0xff] ^
+		      tab[1][(two >> 16) & 0xff] ^ tab[0][two >> 24];
+	}
+
+	for (; len; len--)
+		crc = tab[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+#endif
+
 /* ========================================================================= */
 
 /* No ones complement version. JFFS2 (and other things ?)
@@ -178,6 +220,11 @@ const uint32_t * ZEXPORT get_crc_table()
  */
 uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 {
+#if defined(CRC32_ARCH)
+    return arch_crc32_no_comp(crc, buf, len);
+#elif defined(CRC32_SLICE_BY_8)
+    return crc32_slice8(crc, buf, len);
+#else
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
     size_t rem_len;
@@ -215,6 +262,7 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
     }
 
     return le32_to_cpu(crc);
+#endif
 }
 #undef DO_CRC
 
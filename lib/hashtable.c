@@ -57,8 +57,16 @@
  * which describes the current status.
  */
 
+/*
+ * Entries are also kept in a circular list, through 'prev' and 'next'.
+ * Slot 0 of the table is never used for an entry so it is the list head.
+ * The list gives the order for hexport_r() and for moving the entries
+ * when the table grows.
+ */
 typedef struct _ENTRY {
 	int used;
+	unsigned int prev;
+	unsigned int next;
 	ENTRY entry;
 } _ENTRY;
 
@@ -116,8 +124,9 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 
 	htab->size = nel;
 	htab->filled = 0;
+	htab->deleted = 0;
 
-	/* allocate memory and zero out */
+	/* allocate memory and zero out, which also leaves the list empty */
 	htab->table = (_ENTRY *) calloc(htab->size + 1, sizeof(_ENTRY));
 	if (htab->table == NULL)
 		return 0;
@@ -126,6 +135,80 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 	return 1;
 }
 
+static void hentry_add_tail(_ENTRY *table, unsigned int idx)
+{
+	table[idx].prev = table[0].prev;
+	table[idx].next = 0;
+	table[table[0].prev].next = idx;
+	table[0].prev = idx;
+}
+
+static void hentry_del(_ENTRY *table, unsigned int idx)
+{
+	table[table[idx].prev].next = table[idx].next;
+	table[table[idx].next].prev = table[idx].prev;
+}
+
+/* Compute the first hash value for a key, which is never zero */
+static unsigned int hhash(const char *key, unsigned int size)
+{
+	unsigned int len = strlen(key);
+	unsigned int hval = len;
+	unsigned int count = len;
+
+	/* Compute an value for the given string. Perhaps use a better method. */
+	while (count-- > 0) {
+		hval <<= 4;
+		hval += key[count];
+	}
+
+	/*
+	 * First hash function:
+	 * simply take the modul but prevent zero.
+	 */
+	hval %= size;
+	if (hval == 0)
+		++hval;
+
+	return hval;
+}
+
+/*
+ * Move all entries to a new table with space for at least nel entries,
+ * which also drops deleted entries. The list order is kept.
+ */
+static int hresize_r(size_t nel, struct hsearch_data *htab)
+{
+	struct hsearch_data new = *htab;
+	unsigned int idx, new_idx, hval, hval2;
+
+	new.table = NULL;
+	if (!hcreate_r(nel, &new))
+		return 0;
+
+	for (idx = htab->table[0].next; idx; idx = htab->table[idx].next) {
+		hval = hhash(htab->table[idx].entry.key, new.size);
+		hval2 = 1 + hval % (new.size - 2);
+		for (new_idx = hval; new.table[new_idx].used; ) {
+			if (new_idx <= hval2)
+				new_idx = new.size + new_idx - hval2;
+			else
+				new_idx -= hval2;
+		}
+		new.table[new_idx].used = hval;
+		new.table[new_idx].entry = htab->table[idx].entry;
+		hentry_add_tail(new.table, new_idx);
+	}
+	debug("hresize: %u entries, size %u -> %u\n", htab->filled,
+	      htab->size, new.size);
+	free(htab->table);
+	htab->table = new.table;
+	htab->size = new.size;
+	htab->deleted = 0;
+
+	return 1;
+}
+
 
 /*
  * hdestroy()
@@ -159,6 +242,8 @@ void hdestroy_r(struct hsearch_data *htab)
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
+	htab->filled = 0;
+	htab->deleted = 0;
 }
 
 /*
@@ -268,31 +353,15 @@ static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 	return -1;
 }
 
-int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
-	      struct hsearch_data *htab, int flag)
+static int _hsearch(ENTRY item, ACTION action, ENTRY **retval,
+		    struct hsearch_data *htab, int flag)
 {
 	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
 	unsigned int idx;
 	unsigned int first_deleted = 0;
 	int ret;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
-
-	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
-	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+	hval = hhash(item.key, htab->size);
 
 	/* The first index tried. */
 	idx = hval;
@@ -361,10 +430,13 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		 * Create new entry;
 		 * create copies of item.key and item.data
 		 */
-		if (first_deleted)
+		if (first_deleted) {
 			idx = first_deleted;
+			--htab->deleted;
+		}
 
 		htab->table[idx].used = hval;
+		hentry_add_tail(htab->table, idx);
 		htab->table[idx].entry.key = strdup(item.key);
 		htab->table[idx].entry.data = strdup(item.data);
 		if (!htab->table[idx].entry.key ||
@@ -414,6 +486,31 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 	return 0;
 }
 
+int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
+	      struct hsearch_data *htab, int flag)
+{
+	size_t nel;
+	int ret;
+
+	/*
+	 * Keep the table no more than 3/4 full, counting deleted entries,
+	 * which would otherwise make searches slow. A callback may add
+	 * another variable while an entry is being changed, so the table
+	 * can only move when no other call is in progress.
+	 */
+	if (action == ENTER && htab->table && !htab->nest &&
+	    (htab->filled + htab->deleted + 1) * 4 > htab->size * 3) {
+		nel = (htab->filled + 1) * 2;
+		hresize_r(nel > htab->size ? nel : htab->size, htab);
+	}
+
+	htab->nest++;
+	ret = _hsearch(item, action, retval, htab, flag);
+	htab->nest--;
+
+	return ret;
+}
+
 
 /*
  * hdelete()
@@ -435,8 +532,10 @@ static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	ep->callback = NULL;
 	ep->flags = 0;
 	htab->table[idx].used = -1;
+	hentry_del(htab->table, idx);
 
 	--htab->filled;
+	++htab->deleted;
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
@@ -464,13 +563,16 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 	}
 
 	/* If there is a callback, call it */
+	htab->nest++;
 	if (htab->table[idx].entry.callback &&
 	    htab->table[idx].entry.callback(key, NULL, env_op_delete, flag)) {
 		debug("callback() rejected deleting variable "
 			"%s, skipping it!\n", key);
 		__set_errno(EINVAL);
+		htab->nest--;
 		return 0;
 	}
+	htab->nest--;
 
 	_hdelete(key, htab, ep, idx);
 
@@ -587,14 +689,54 @@ static int match_entry(ENTRY *ep, int flag,
 	return 0;
 }
 
+/*
+ * Sort the table's list of entries by key. After an import of sorted
+ * data, or a previous export, the list is already sorted or nearly so.
+ */
+static ENTRY **hsort_r(struct hsearch_data *htab)
+{
+	ENTRY **list;
+	unsigned int idx, prev;
+	int i, n, sorted = 1;
+
+	list = malloc((htab->filled + 1) * sizeof(ENTRY *));
+	if (!list)
+		return NULL;
+	for (idx = htab->table[0].next, n = 0; idx;
+	     idx = htab->table[idx].next) {
+		list[n] = &htab->table[idx].entry;
+		if (n && strcmp(list[n - 1]->key, list[n]->key) > 0)
+			sorted = 0;
+		n++;
+	}
+	if (sorted)
+		return list;
+
+	qsort(list, n, sizeof(ENTRY *), cmpkey);
+
+	/* Keep the sorted order for next time */
+	htab->table[0].next = 0;
+	htab->table[0].prev = 0;
+	for (i = 0, prev = 0; i < n; i++) {
+		idx = container_of(list[i], _ENTRY, entry) - htab->table;
+		htab->table[prev].next = idx;
+		htab->table[idx].prev = prev;
+		prev = idx;
+	}
+	htab->table[prev].next = 0;
+	htab->table[0].prev = prev;
+
+	return list;
+}
+
 ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char * const argv[])
 {
-	ENTRY *list[htab->size];
+	ENTRY **list;
 	char *res, *p;
 	size_t totlen;
-	int i, n;
+	int i, n, count;
 
 	/* Test for correct arguments.  */
 	if ((resp == NULL) || (htab == NULL)) {
@@ -604,61 +746,49 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	debug("EXPORT  table = %p, htab.size = %d, htab.filled = %d, "
 		"size = %zu\n", htab, htab->size, htab->filled, size);
+
+	/* Get the entries, sorted by keys */
+	list = hsort_r(htab);
+	if (!list) {
+		__set_errno(ENOMEM);
+		return (-1);
+	}
+	count = htab->filled;
+
 	/*
 	 * Pass 1:
-	 * search used entries,
-	 * save addresses and compute total length
+	 * select the entries to export and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
-
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
-
-			if ((argc > 0) && (found == 0))
-				continue;
+	for (i = 0, n = 0, totlen = 0; i < count; ++i) {
+		ENTRY *ep = list[i];
+		int found = match_entry(ep, flag, argc, argv);
+		const char *s;
 
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
+		if ((argc > 0) && (found == 0))
+			continue;
 
-			list[n++] = ep;
+		if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+			continue;
 
-			totlen += strlen(ep->key) + 2;
+		list[n++] = ep;
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		totlen += strlen(ep->key) + 2;
 
-				while (*s) {
-					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
-			}
-			totlen += 2;	/* for '=' and 'sep' char */
+		/* add room for needed escape chars, even if sep is '\0' */
+		for (s = ep->data; *s; ++s) {
+			++totlen;
+			if ((*s == sep) || (*s == '\\'))
+				++totlen;
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
-#ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
-	for (i = 0; i < n; ++i) {
-		printf("\t%3d: %p ==> %-10s => %s\n",
-		       i, list[i], list[i]->key, list[i]->data);
-	}
-#endif
-
-	/* Sort list by keys */
-	qsort(list, n, sizeof(ENTRY *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
 			printf("Env export buffer too small: %zu, "
 				"but need %zu\n", size, totlen + 1);
+			free(list);
 			__set_errno(ENOMEM);
 			return (-1);
 		}
@@ -668,13 +798,13 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	/* Check if the user provided a buffer */
 	if (*resp) {
-		/* yes; clear it */
+		/* yes; the unused part is cleared below */
 		res = *resp;
-		memset(res, '\0', size);
 	} else {
-		/* no, allocate and clear one */
-		*resp = res = calloc(1, size);
+		/* no, allocate one */
+		*resp = res = malloc(size);
 		if (res == NULL) {
+			free(list);
 			__set_errno(ENOMEM);
 			return (-1);
 		}
@@ -700,7 +830,9 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		}
 		*p++ = sep;
 	}
-	*p = '\0';		/* terminate result */
+	/* terminate result and clear the rest */
+	memset(p, '\0', res + size - p);
+	free(list);
 
 	return size;
 }
@@ -774,13 +906,73 @@ static int drop_var_from_set(const char *name, int nvars, char * vars[])
  * '\0' and '\n' have really been tested.
  */
 
+/*
+ * The data being imported, read a character at a time. Entries are copied
+ * into 'buf' as they are parsed, so the data itself is not changed.
+ */
+struct himport_src {
+	const char *p;
+	const char *end;
+	int crlf_is_lf;
+	char *buf;
+	size_t len;
+	size_t max;
+};
+
+/* Get the position of the next character, skipping a CR before an LF */
+static const char *himport_pos(struct himport_src *src, const char *p)
+{
+	if (src->crlf_is_lf && p < src->end - 1 && p[0] == '\r' &&
+	    p[1] == '\n')
+		p++;
+
+	return p;
+}
+
+/* Look at the next character (or the one after), -1 at the end */
+static int himport_peek(struct himport_src *src, int ahead)
+{
+	const char *p = himport_pos(src, src->p);
+
+	if (ahead && p < src->end)
+		p = himport_pos(src, p + 1);
+
+	return p < src->end ? (unsigned char)*p : -1;
+}
+
+/* Read the next character, -1 at the end */
+static int himport_getc(struct himport_src *src)
+{
+	src->p = himport_pos(src, src->p);
+
+	return src->p < src->end ? (unsigned char)*src->p++ : -1;
+}
+
+/* Add a character to the entry being parsed */
+static int himport_add(struct himport_src *src, char ch)
+{
+	char *buf;
+
+	if (src->len == src->max) {
+		buf = realloc(src->buf, src->max * 2 + 64);
+		if (!buf)
+			return -1;
+		src->buf = buf;
+		src->max = src->max * 2 + 64;
+	}
+	src->buf[src->len++] = ch;
+
+	return 0;
+}
+
 int himport_r(struct hsearch_data *htab,
 		const char *env, size_t size, const char sep, int flag,
 		int crlf_is_lf, int nvars, char * const vars[])
 {
-	char *data, *sp, *dp, *name, *value;
+	struct himport_src src;
+	char *name, *value;
 	char *localvars[nvars];
-	int i;
+	int ch, i;
 
 	/* Test for correct arguments.  */
 	if (htab == NULL) {
@@ -788,15 +980,6 @@ int himport_r(struct hsearch_data *htab,
 		return 0;
 	}
 
-	/* we allocate new space to make sure we can write to the array */
-	if ((data = malloc(size)) == NULL) {
-		debug("himport_r: can't malloc %zu bytes\n", size);
-		__set_errno(ENOMEM);
-		return 0;
-	}
-	memcpy(data, env, size);
-	dp = data;
-
 	/* make a local copy of the list of variables */
 	if (nvars)
 		memcpy(localvars, vars, sizeof(vars[0]) * nvars);
@@ -824,7 +1007,8 @@ int himport_r(struct hsearch_data *htab,
 	 * envrionment size), so we clip it to a reasonable value.
 	 * On the other hand we need to add some more entries for free
 	 * space when importing very small buffers. Both boundaries can
-	 * be overwritten in the board config file if needed.
+	 * be overwritten in the board config file if needed. The table
+	 * grows if more entries are added.
 	 */
 
 	if (!htab->table) {
@@ -835,53 +1019,56 @@ int himport_r(struct hsearch_data *htab,
 
 		debug("Create Hash Table: N=%d\n", nent);
 
-		if (hcreate_r(nent, htab) == 0) {
-			free(data);
+		if (hcreate_r(nent, htab) == 0)
 			return 0;
-		}
 	}
 
 	if(!size)
 		return 1;		/* everything OK */
-	if(crlf_is_lf) {
-		/* Remove Carriage Returns in front of Line Feeds */
-		unsigned ignored_crs = 0;
-		for(;dp < data + size && *dp; ++dp) {
-			if(*dp == '\r' &&
-			   dp < data + size - 1 && *(dp+1) == '\n')
-				++ignored_crs;
-			else
-				*(dp-ignored_crs) = *dp;
-		}
-		size -= ignored_crs;
-		dp = data;
-	}
-	/* Parse environment; allow for '\0' and 'sep' as separators */
-	do {
+
+	memset(&src, '\0', sizeof(src));
+	src.p = env;
+	src.end = env + size;
+	src.crlf_is_lf = crlf_is_lf;
+
+	/*
+	 * Parse environment; allow for '\0' and 'sep' as separators. Stop
+	 * at the end of the data or at an empty entry.
+	 */
+	while ((ch = himport_peek(&src, 0)) > 0) {
 		ENTRY e, *rv;
 
 		/* skip leading white space */
-		while (isblank(*dp))
-			++dp;
+		if (isblank(ch)) {
+			himport_getc(&src);
+			continue;
+		}
 
 		/* skip comment lines */
-		if (*dp == '#') {
-			while (*dp && (*dp != sep))
-				++dp;
-			++dp;
+		if (ch == '#') {
+			do {
+				ch = himport_getc(&src);
+			} while (ch > 0 && ch != sep);
 			continue;
 		}
 
 		/* parse name */
-		for (name = dp; *dp != '=' && *dp && *dp != sep; ++dp)
-			;
+		src.len = 0;
+		while ((ch = himport_peek(&src, 0)) > 0 && ch != '=' &&
+		       ch != sep) {
+			if (himport_add(&src, himport_getc(&src)))
+				goto nomem;
+		}
+		if (himport_add(&src, '\0'))
+			goto nomem;
 
 		/* deal with "name" and "name=" entries (delete var) */
-		if (*dp == '\0' || *(dp + 1) == '\0' ||
-		    *dp == sep || *(dp + 1) == sep) {
-			if (*dp == '=')
-				*dp++ = '\0';
-			*dp++ = '\0';	/* terminate name */
+		if (ch != '=' || himport_peek(&src, 1) <= 0 ||
+		    himport_peek(&src, 1) == sep) {
+			if (ch == '=')
+				himport_getc(&src);
+			himport_getc(&src);
+			name = src.buf;
 
 			debug("DELETE CANDIDATE: \"%s\"\n", name);
 			if (!drop_var_from_set(name, nvars, localvars))
@@ -892,19 +1079,23 @@ int himport_r(struct hsearch_data *htab,
 
 			continue;
 		}
-		*dp++ = '\0';	/* terminate name */
+		himport_getc(&src);	/* skip '=' */
 
 		/* parse value; deal with escapes */
-		for (value = sp = dp; *dp && (*dp != sep); ++dp) {
-			if ((*dp == '\\') && *(dp + 1))
-				++dp;
-			*sp++ = *dp;
+		while ((ch = himport_getc(&src)) > 0 && ch != sep) {
+			if (ch == '\\' && himport_peek(&src, 0) > 0)
+				ch = himport_getc(&src);
+			if (himport_add(&src, ch))
+				goto nomem;
 		}
-		*sp++ = '\0';	/* terminate value */
-		++dp;
+		if (himport_add(&src, '\0'))
+			goto nomem;
+		name = src.buf;
+		value = name + strlen(name) + 1;
 
 		if (*name == 0) {
 			debug("INSERT: unable to use an empty key\n");
+			free(src.buf);
 			__set_errno(EINVAL);
 			return 0;
 		}
@@ -925,10 +1116,8 @@ int himport_r(struct hsearch_data *htab,
 		debug("INSERT: table %p, filled %d/%d rv %p ==> name=\"%s\" value=\"%s\"\n",
 			htab, htab->filled, htab->size,
 			rv, name, value);
-	} while ((dp < data + size) && *dp);	/* size check needed for text */
-						/* without '\0' termination */
-	debug("INSERT: free(data = %p)\n", data);
-	free(data);
+	}
+	free(src.buf);
 
 	/* process variables which were not considered */
 	for (i = 0; i < nvars; i++) {
@@ -950,6 +1139,12 @@ int himport_r(struct hsearch_data *htab,
 
 	debug("INSERT: done\n");
 	return 1;		/* everything OK */
+
+nomem:
+	debug("himport_r: can't malloc entry\n");
+	free(src.buf);
+	__set_errno(ENOMEM);
+	return 0;
 }
 
 /*
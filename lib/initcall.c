@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <initcall.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -31,6 +32,97 @@ int initcall_run_list(const init_fnc_t init_sequence[])
 			       (char *)*init_fnc_ptr - reloc_ofs, ret);
 			return -1;
 		}
+		/* Deferred steps are only started after relocation */
+		if (gd->flags & GD_FLG_RELOC)
+			initcall_defer_poll();
 	}
 	return 0;
 }
+
+#ifdef CONFIG_INITCALL_DEFER
+/* Steps which are started but not done, in the order they were started */
+static struct initcall_defer *defer_list;
+
+static int initcall_defer_call(struct initcall_defer *step, init_fnc_t fn)
+{
+	int ret;
+
+	bootstage_start(step->id, step->name);
+	ret = fn();
+	bootstage_accum(step->id);
+	if (ret && ret != -EINPROGRESS)
+		printf("deferred initcall %s failed (err=%d)\n", step->name,
+		       ret);
+
+	return ret;
+}
+
+int initcall_defer_start(struct initcall_defer *step)
+{
+	struct initcall_defer **tail;
+	int ret = -EINPROGRESS;
+
+#ifdef CONFIG_NEEDS_MANUAL_RELOC
+	step->name += gd->reloc_off;
+	if (step->start)
+		step->start += gd->reloc_off;
+	if (step->poll)
+		step->poll += gd->reloc_off;
+	if (step->finish)
+		step->finish += gd->reloc_off;
+#endif
+	if (step->start)
+		ret = initcall_defer_call(step, step->start);
+	if (ret != -EINPROGRESS)
+		return 0;
+
+	step->next = NULL;
+	for (tail = &defer_list; *tail; tail = &(*tail)->next)
+		;
+	*tail = step;
+
+	return 0;
+}
+
+void initcall_defer_poll(void)
+{
+	struct initcall_defer **stepp = &defer_list;
+	struct initcall_defer *step;
+
+	while ((step = *stepp)) {
+		if (step->poll &&
+		    initcall_defer_call(step, step->poll) != -EINPROGRESS)
+			*stepp = step->next;
+		else
+			stepp = &step->next;
+	}
+}
+
+/* Take the step off the list first, in case finishing it comes back here */
+static void initcall_defer_finish_step(struct initcall_defer **stepp)
+{
+	struct initcall_defer *step = *stepp;
+
+	*stepp = step->next;
+	if (step->finish)
+		initcall_defer_call(step, step->finish);
+}
+
+void initcall_defer_finish(enum bootstage_id id)
+{
+	struct initcall_defer **stepp;
+
+	for (stepp = &defer_list; *stepp; stepp = &(*stepp)->next) {
+		if ((*stepp)->id == id) {
+			initcall_defer_finish_step(stepp);
+			break;
+		}
+	}
+}
+
+void initcall_defer_finish_all(void)
+{
+	while (defer_list)
+		initcall_defer_finish_step(&defer_list);
+}
+#endif
@@ -11,6 +11,7 @@
 #else
 #include "fdt_host.h"
 #endif
+#include <fdt_index.h>
 
 #include "libfdt_internal.h"
 
@@ -204,6 +205,7 @@ int fdt_move(const void *fdt, void *buf, int bufsize)
 	if (fdt_totalsize(fdt) > bufsize)
 		return -FDT_ERR_NOSPACE;
 
+	fdt_index_invalidate(buf);
 	memmove(buf, fdt, fdt_totalsize(fdt));
 	return 0;
 }
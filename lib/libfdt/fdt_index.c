@@ -0,0 +1,231 @@
+/*
+ * Index of a read-only device tree, to speed up libfdt lookups
+ *
+ * libfdt finds nodes by phandle, path and parent by scanning the tree from
+ * the start. For a tree which does not change, such as the control FDT,
+ * these lookups can use a table built with a single scan instead.
+ *
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <fdt_index.h>
+#include <libfdt.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Deepest nesting of nodes that the index can handle */
+#define FDT_INDEX_MAX_DEPTH	32
+
+static int fdt_index_phandle_cmp(const void *a, const void *b)
+{
+	const struct fdt_index_phandle *pa = a, *pb = b;
+
+	if (pa->phandle != pb->phandle)
+		return pa->phandle < pb->phandle ? -1 : 1;
+
+	return pa->offset - pb->offset;
+}
+
+static int fdt_index_add_aliases(const void *fdt, struct fdt_index *index)
+{
+	const char *name, *path;
+	int aliases, offset, node, len;
+
+	aliases = fdt_subnode_offset(fdt, 0, "aliases");
+	if (aliases < 0)
+		return 0;
+	for (offset = fdt_first_property_offset(fdt, aliases);
+	     offset >= 0;
+	     offset = fdt_next_property_offset(fdt, offset)) {
+		path = fdt_getprop_by_offset(fdt, offset, &name, &len);
+		if (!path || len < 2 || *path != '/' || path[len - 1])
+			continue;
+		node = fdt_path_offset(fdt, path);
+		if (node < 0)
+			continue;
+		index->alias[index->alias_count].name = name;
+		index->alias[index->alias_count].offset = node;
+		index->alias_count++;
+	}
+
+	return 0;
+}
+
+static int fdt_index_fill(const void *fdt, struct fdt_index *index)
+{
+	int tail[FDT_INDEX_MAX_DEPTH + 1];
+	int last[FDT_INDEX_MAX_DEPTH];
+	struct fdt_index_node *node;
+	uint32_t phandle;
+	int offset, depth, n;
+
+	for (offset = 0, depth = 0, n = 0;
+	     offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth), n++) {
+		if (depth >= FDT_INDEX_MAX_DEPTH)
+			return -EINVAL;
+		node = &index->node[n];
+		node->offset = offset;
+		node->parent = depth ? last[depth - 1] : -1;
+		node->child = -1;
+		node->sibling = -1;
+		if (depth && tail[depth] < 0)
+			index->node[node->parent].child = n;
+		else if (depth)
+			index->node[tail[depth]].sibling = n;
+		last[depth] = n;
+		tail[depth] = n;
+		tail[depth + 1] = -1;
+
+		phandle = fdt_get_phandle(fdt, offset);
+		if (phandle && phandle != -1) {
+			index->phandle[index->phandle_count].phandle = phandle;
+			index->phandle[index->phandle_count].offset = offset;
+			index->phandle_count++;
+		}
+	}
+	if ((offset < 0 && offset != -FDT_ERR_NOTFOUND) ||
+	    n != index->node_count)
+		return -EINVAL;
+	qsort(index->phandle, index->phandle_count, sizeof(*index->phandle),
+	      fdt_index_phandle_cmp);
+
+	return fdt_index_add_aliases(fdt, index);
+}
+
+int fdt_index_build(const void *fdt)
+{
+	struct fdt_index *index;
+	int node_count, alias_count;
+	int aliases, offset;
+	size_t size;
+	int ret;
+
+	/* Drop any old index, which must not be used while scanning */
+	free(gd->fdt_index);
+	gd->fdt_index = NULL;
+	ret = fdt_check_header(fdt);
+	if (ret)
+		return -EINVAL;
+
+	node_count = 0;
+	for (offset = 0; offset >= 0; offset = fdt_next_node(fdt, offset, NULL))
+		node_count++;
+	alias_count = 0;
+	aliases = fdt_subnode_offset(fdt, 0, "aliases");
+	for (offset = fdt_first_property_offset(fdt, aliases);
+	     aliases >= 0 && offset >= 0;
+	     offset = fdt_next_property_offset(fdt, offset))
+		alias_count++;
+
+	/* Every node might have a phandle */
+	size = sizeof(*index) +
+		node_count * sizeof(struct fdt_index_node) +
+		node_count * sizeof(struct fdt_index_phandle) +
+		alias_count * sizeof(struct fdt_index_alias);
+#ifdef CONFIG_SYS_MALLOC_F_LEN
+	/* Leave at least half of the early pool for driver model */
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT) &&
+	    size > (gd->malloc_limit - gd->malloc_ptr) / 2)
+		return -ENOMEM;
+#endif
+	index = malloc(size);
+	if (!index)
+		return -ENOMEM;
+	index->fdt = fdt;
+	index->node_count = node_count;
+	index->node = (struct fdt_index_node *)(index + 1);
+	index->phandle_count = 0;
+	index->phandle = (struct fdt_index_phandle *)
+		(index->node + node_count);
+	index->alias_count = 0;
+	index->alias = (struct fdt_index_alias *)
+		(index->phandle + node_count);
+
+	ret = fdt_index_fill(fdt, index);
+	if (ret) {
+		free(index);
+		return ret;
+	}
+	gd->fdt_index = index;
+	debug("%s: %d nodes, %d phandles, %d aliases\n", __func__,
+	      index->node_count, index->phandle_count, index->alias_count);
+
+	return 0;
+}
+
+const struct fdt_index *fdt_index_get(const void *fdt)
+{
+	struct fdt_index *index = gd->fdt_index;
+
+	return index && index->fdt == fdt ? index : NULL;
+}
+
+void fdt_index_invalidate(const void *fdt)
+{
+	struct fdt_index *index = gd->fdt_index;
+
+	if (index && index->fdt == fdt) {
+		gd->fdt_index = NULL;
+		free(index);
+	}
+}
+
+int fdt_index_find_node(const struct fdt_index *index, int offset)
+{
+	int low = 0, high = index->node_count;
+	int mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (index->node[mid].offset == offset)
+			return mid;
+		if (index->node[mid].offset < offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return -1;
+}
+
+int fdt_index_find_phandle(const struct fdt_index *index, uint32_t phandle)
+{
+	int low = 0, high = index->phandle_count;
+	int mid;
+
+	/* Find the first entry with this phandle, as a scan would */
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (index->phandle[mid].phandle < phandle)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low == index->phandle_count ||
+	    index->phandle[low].phandle != phandle)
+		return -FDT_ERR_NOTFOUND;
+
+	return index->phandle[low].offset;
+}
+
+int fdt_index_find_alias(const struct fdt_index *index, const char *name,
+			 int namelen)
+{
+	const struct fdt_index_alias *alias;
+	int i;
+
+	for (i = 0, alias = index->alias; i < index->alias_count;
+	     i++, alias++) {
+		if (!strncmp(alias->name, name, namelen) &&
+		    !alias->name[namelen])
+			return alias->offset;
+	}
+
+	return -1;
+}
@@ -11,6 +11,7 @@
 #else
 #include "fdt_host.h"
 #endif
+#include <fdt_index.h>
 
 #include "libfdt_internal.h"
 
@@ -91,10 +92,24 @@ static int _nextprop(const void *fdt, int offset)
 int fdt_subnode_offset_namelen(const void *fdt, int offset,
 			       const char *name, int namelen)
 {
+	const struct fdt_index *index;
 	int depth;
+	int node;
 
 	FDT_CHECK_HEADER(fdt);
 
+	index = fdt_index_get(fdt);
+	node = index ? fdt_index_find_node(index, offset) : -1;
+	if (node >= 0) {
+		for (node = index->node[node].child; node >= 0;
+		     node = index->node[node].sibling) {
+			offset = index->node[node].offset;
+			if (_fdt_nodename_eq(fdt, offset, name, namelen))
+				return offset;
+		}
+		return -FDT_ERR_NOTFOUND;
+	}
+
 	for (depth = 0;
 	     (offset >= 0) && (depth >= 0);
 	     offset = fdt_next_node(fdt, offset, &depth))
@@ -134,6 +149,7 @@ static const char *fdt_path_next_seperator(const char *path)
 
 int fdt_path_offset(const void *fdt, const char *path)
 {
+	const struct fdt_index *index;
 	const char *end = path + strlen(path);
 	const char *p = path;
 	int offset = 0;
@@ -147,10 +163,14 @@ int fdt_path_offset(const void *fdt, const char *path)
 		if (!q)
 			q = end;
 
-		p = fdt_get_alias_namelen(fdt, p, q - p);
-		if (!p)
-			return -FDT_ERR_BADPATH;
-		offset = fdt_path_offset(fdt, p);
+		index = fdt_index_get(fdt);
+		offset = index ? fdt_index_find_alias(index, p, q - p) : -1;
+		if (offset < 0) {
+			p = fdt_get_alias_namelen(fdt, p, q - p);
+			if (!p)
+				return -FDT_ERR_BADPATH;
+			offset = fdt_path_offset(fdt, p);
+		}
 
 		p = q;
 	}
@@ -433,8 +453,16 @@ int fdt_node_depth(const void *fdt, int nodeoffset)
 
 int fdt_parent_offset(const void *fdt, int nodeoffset)
 {
-	int nodedepth = fdt_node_depth(fdt, nodeoffset);
+	const struct fdt_index *index = fdt_index_get(fdt);
+	int nodedepth, node;
+
+	node = index ? fdt_index_find_node(index, nodeoffset) : -1;
+	if (node >= 0) {
+		node = index->node[node].parent;
+		return node < 0 ? -FDT_ERR_NOTFOUND : index->node[node].offset;
+	}
 
+	nodedepth = fdt_node_depth(fdt, nodeoffset);
 	if (nodedepth < 0)
 		return nodedepth;
 	return fdt_supernode_atdepth_offset(fdt, nodeoffset,
@@ -470,6 +498,7 @@ int fdt_node_offset_by_prop_value(const void *fdt, int startoffset,
 
 int fdt_node_offset_by_phandle(const void *fdt, uint32_t phandle)
 {
+	const struct fdt_index *index;
 	int offset;
 
 	if ((phandle == 0) || (phandle == -1))
@@ -477,6 +506,10 @@ int fdt_node_offset_by_phandle(const void *fdt, uint32_t phandle)
 
 	FDT_CHECK_HEADER(fdt);
 
+	index = fdt_index_get(fdt);
+	if (index)
+		return fdt_index_find_phandle(index, phandle);
+
 	/* FIXME: The algorithm here is pretty horrible: we
 	 * potentially scan each property of a node in
 	 * fdt_get_phandle(), then if that didn't find what
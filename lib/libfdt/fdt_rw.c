@@ -11,6 +11,8 @@
 #else
 #include "fdt_host.h"
 #endif
+#include <fdt_batch.h>
+#include <fdt_index.h>
 
 #include "libfdt_internal.h"
 
@@ -29,6 +31,7 @@ static int _fdt_blocks_misordered(const void *fdt,
 static int _fdt_rw_check_header(void *fdt)
 {
 	FDT_CHECK_HEADER(fdt);
+	fdt_index_invalidate(fdt);
 
 	if (fdt_version(fdt) < 17)
 		return -FDT_ERR_BADVERSION;
@@ -90,6 +93,8 @@ static int _fdt_splice_struct(void *fdt, void *p,
 
 	fdt_set_size_dt_struct(fdt, fdt_size_dt_struct(fdt) + delta);
 	fdt_set_off_dt_strings(fdt, fdt_off_dt_strings(fdt) + delta);
+	fdt_batch_splice(fdt, (char *)p - (char *)fdt - fdt_off_dt_struct(fdt),
+			 oldlen, newlen);
 	return 0;
 }
 
@@ -382,6 +387,7 @@ int fdt_open_into(const void *fdt, void *buf, int bufsize)
 	char *tmp;
 
 	FDT_CHECK_HEADER(fdt);
+	fdt_index_invalidate(buf);
 
 	mem_rsv_size = (fdt_num_mem_rsv(fdt)+1)
 		* sizeof(struct fdt_reserve_entry);
@@ -11,6 +11,8 @@
 #else
 #include "fdt_host.h"
 #endif
+#include <fdt_batch.h>
+#include <fdt_index.h>
 
 #include "libfdt_internal.h"
 
@@ -20,6 +22,7 @@ int fdt_setprop_inplace(void *fdt, int nodeoffset, const char *name,
 	void *propval;
 	int proplen;
 
+	fdt_index_invalidate(fdt);
 	propval = fdt_getprop_w(fdt, nodeoffset, name, &proplen);
 	if (! propval)
 		return proplen;
@@ -44,6 +47,7 @@ int fdt_nop_property(void *fdt, int nodeoffset, const char *name)
 	struct fdt_property *prop;
 	int len;
 
+	fdt_index_invalidate(fdt);
 	prop = fdt_get_property_w(fdt, nodeoffset, name, &len);
 	if (! prop)
 		return len;
@@ -67,12 +71,15 @@ int fdt_nop_node(void *fdt, int nodeoffset)
 {
 	int endoffset;
 
+	fdt_index_invalidate(fdt);
 	endoffset = _fdt_node_end_offset(fdt, nodeoffset);
 	if (endoffset < 0)
 		return endoffset;
 
 	_fdt_nop_region(fdt_offset_ptr_w(fdt, nodeoffset, 0),
 			endoffset - nodeoffset);
+	fdt_batch_splice(fdt, nodeoffset, endoffset - nodeoffset,
+			 endoffset - nodeoffset);
 	return 0;
 }
 
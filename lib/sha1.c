@@ -227,6 +227,26 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 	ctx->state[4] += E;
 }
 
+/* Process whole blocks, using architecture support if the CPU has it */
+static void sha1_process_blocks(sha1_context *ctx, const unsigned char *data,
+				unsigned int blocks)
+{
+#if defined(CONFIG_SHA_ARCH_ACCEL) && !defined(USE_HOSTCC)
+	uint32_t state[5];
+	int i;
+
+	for (i = 0; i < 5; i++)
+		state[i] = ctx->state[i];
+	if (!arch_sha1_blocks(state, data, blocks)) {
+		for (i = 0; i < 5; i++)
+			ctx->state[i] = state[i];
+		return;
+	}
+#endif
+	for (; blocks; blocks--, data += 64)
+		sha1_process(ctx, data);
+}
+
 /*
  * SHA-1 process buffer
  */
@@ -250,16 +270,16 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
 
 	if (left && ilen >= fill) {
 		memcpy ((void *) (ctx->buffer + left), (void *) input, fill);
-		sha1_process (ctx, ctx->buffer);
+		sha1_process_blocks(ctx, ctx->buffer, 1);
 		input += fill;
 		ilen -= fill;
 		left = 0;
 	}
 
-	while (ilen >= 64) {
-		sha1_process (ctx, input);
-		input += 64;
-		ilen -= 64;
+	if (ilen >= 64) {
+		sha1_process_blocks(ctx, input, ilen / 64);
+		input += ilen & ~0x3f;
+		ilen &= 0x3f;
 	}
 
 	if (ilen > 0) {
@@ -181,6 +181,18 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 	ctx->state[7] += H;
 }
 
+/* Process whole blocks, using architecture support if the CPU has it */
+static void sha256_process_blocks(sha256_context *ctx, const uint8_t *data,
+				  uint32_t blocks)
+{
+#if defined(CONFIG_SHA_ARCH_ACCEL) && !defined(USE_HOSTCC)
+	if (!arch_sha256_blocks(ctx->state, data, blocks))
+		return;
+#endif
+	for (; blocks; blocks--, data += 64)
+		sha256_process(ctx, data);
+}
+
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 {
 	uint32_t left, fill;
@@ -199,16 +211,16 @@ void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 
 	if (left && length >= fill) {
 		memcpy((void *) (ctx->buffer + left), (void *) input, fill);
-		sha256_process(ctx, ctx->buffer);
+		sha256_process_blocks(ctx, ctx->buffer, 1);
 		length -= fill;
 		input += fill;
 		left = 0;
 	}
 
-	while (length >= 64) {
-		sha256_process(ctx, input);
-		length -= 64;
-		input += 64;
+	if (length >= 64) {
+		sha256_process_blocks(ctx, input, length / 64);
+		input += length & ~0x3f;
+		length &= 0x3f;
 	}
 
 	if (length)
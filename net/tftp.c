@@ -133,6 +133,26 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * RFC 7440 lets the server send several blocks before waiting for an ACK,
+ * so a transfer is no longer limited to one block per round trip. We ask
+ * for CONFIG_TFTP_WINDOWSIZE blocks (or $tftpwindowsize) and fall back to
+ * lock-step transfers if the server does not acknowledge the option.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+static unsigned short tftp_window_size_option = TFTP_WINDOWSIZE;
+/* Window size agreed with the server */
+static unsigned short tftp_windowsize;
+/* Block number at which we next need to send an ACK */
+static ushort	tftp_next_ack;
+/* Set once we have re-acknowledged a gap in the window, until it is filled */
+static int	tftp_gap_acked;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -369,6 +389,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* windowed transfers are only supported for reads */
+		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, tftp_window_size_option, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!tftp_mcast_disabled) {
@@ -537,6 +561,17 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				/* the server may only reduce the window */
+				if (!tftp_windowsize ||
+				    tftp_windowsize > tftp_window_size_option)
+					tftp_windowsize = 1;
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -546,6 +581,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			}
 #endif
 		}
+		/* ACK(0) below opens the first window */
+		tftp_next_ack = tftp_windowsize;
 #ifdef CONFIG_MCAST_TFTP
 		parse_multicast_oack((char *)pkt, len - 1);
 		if ((tftp_mcast_active) && (!tftp_mcast_master_client))
@@ -565,6 +602,33 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (len < 2)
 			return;
 		len -= 2;
+
+		/*
+		 * With a window several blocks are in flight. Anything other
+		 * than the next block in sequence means a block was lost or
+		 * arrived late; re-acknowledge the last block we stored so
+		 * that the server restarts the window from there. Only do
+		 * this once per gap: every remaining block of the window
+		 * would otherwise trigger another ACK and flood the server.
+		 * Losing block 1 of the first window is the same case, with
+		 * block 0 (the OACK) re-acknowledged.
+		 */
+		if (tftp_windowsize > 1 &&
+		    (tftp_state == STATE_DATA || tftp_state == STATE_OACK) &&
+		    ntohs(*(__be16 *)pkt) != (ushort)(tftp_cur_block + 1)) {
+			debug("Received unexpected block: %d, expected: %d\n",
+			      ntohs(*(__be16 *)pkt),
+			      (ushort)(tftp_cur_block + 1));
+			if (!tftp_gap_acked) {
+				tftp_send();
+				tftp_gap_acked = 1;
+				tftp_next_ack = (ushort)(tftp_cur_block +
+							 tftp_windowsize);
+			}
+			break;
+		}
+		tftp_gap_acked = 0;
+
 		tftp_cur_block = ntohs(*(__be16 *)pkt);
 
 		update_block_number();
@@ -605,6 +669,19 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		store_block(tftp_cur_block - 1, pkt + 2, len);
 
+		/*
+		 * Only the last block of each window is acknowledged, which
+		 * prompts the remote for the next window. The final (short)
+		 * block always is.
+		 */
+		if (tftp_windowsize > 1) {
+			if (len == tftp_block_size &&
+			    (ushort)tftp_cur_block != tftp_next_ack)
+				break;
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
+		}
+
 		/*
 		 *	Acknowledge the block just received, which will prompt
 		 *	the remote for the next one.
@@ -687,6 +764,8 @@ static void tftp_timeout_handler(void)
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		/* the ACK restarts the window after the last block stored */
+		tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
@@ -705,6 +784,10 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		tftp_window_size_option = simple_strtol(ep, NULL, 10);
+
 	ep = getenv("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -715,8 +798,8 @@ void tftp_start(enum proto_t protocol)
 		timeout_ms = 1000;
 	}
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (net_boot_file_name[0] == '\0') {
@@ -818,6 +901,10 @@ void tftp_start(enum proto_t protocol)
 	memset(net_server_ethaddr, 0, 6);
 	/* Revert tftp_block_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	/* Lock-step transfers until the server agrees to a window */
+	tftp_windowsize = 1;
+	tftp_next_ack = 1;
+	tftp_gap_acked = 0;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -847,6 +934,9 @@ void tftp_start_server(void)
 
 	/* Revert tftp_block_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
+	tftp_next_ack = 1;
+	tftp_gap_acked = 0;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
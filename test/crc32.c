@@ -0,0 +1,137 @@
+/*
+ * Tests and benchmark for crc32()
+ *
+ * Copyright (c) 2015 The Chromium OS Authors.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <u-boot/crc.h>
+
+#define TEST_BUFFER_SIZE	(1 << 20)
+#define TEST_MAX_ALIGN		8
+
+/* Amount of data to checksum for each benchmark result */
+#define BENCH_TOTAL		(64 << 20)
+
+/* Bit-at-a-time reference, which shares no code or tables with crc32() */
+static uint32_t crc32_ref(uint32_t crc, const uint8_t *buf, uint len)
+{
+	int bit;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *buf++;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320 : 0);
+	}
+
+	return ~crc;
+}
+
+static void fill_buffer(uint8_t *buf, uint size)
+{
+	uint32_t val = 0x12345678;
+	uint i;
+
+	for (i = 0; i < size; i++) {
+		val = val * 1103515245 + 12345;
+		buf[i] = val >> 16;
+	}
+}
+
+static int check_crc(const uint8_t *buf, uint len, uint32_t seed)
+{
+	uint32_t expect = crc32_ref(seed, buf, len);
+	uint32_t crc = crc32(seed, buf, len);
+
+	if (crc != expect) {
+		printf("crc32() of %u bytes at %p: %08x, expected %08x\n",
+		       len, buf, crc, expect);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int do_ut_crc32(cmd_tbl_t *cmdtp, int flag, int argc,
+		       char *const argv[])
+{
+	uint8_t *buf;
+	uint align, len;
+	int err = 0;
+
+	if (crc32(0, (const uint8_t *)"123456789", 9) != 0xcbf43926) {
+		puts("crc32() of check string is wrong\n");
+		err++;
+	}
+
+	buf = malloc(TEST_BUFFER_SIZE + TEST_MAX_ALIGN);
+	if (!buf)
+		return CMD_RET_FAILURE;
+	fill_buffer(buf, TEST_BUFFER_SIZE + TEST_MAX_ALIGN);
+
+	/* Every head/body/tail split the implementations might make */
+	for (align = 0; align < TEST_MAX_ALIGN; align++) {
+		for (len = 0; len <= 64; len++)
+			err -= check_crc(buf + align, len, 0);
+		err -= check_crc(buf + align, 4093, 0x5a5a5a5a);
+		err -= check_crc(buf + align, TEST_BUFFER_SIZE, 0);
+	}
+
+	/* Adding data in pieces must give the same result */
+	if (crc32(crc32(0, buf, 1001), buf + 1001, TEST_BUFFER_SIZE - 1001) !=
+	    crc32(0, buf, TEST_BUFFER_SIZE)) {
+		puts("crc32() in pieces does not match\n");
+		err++;
+	}
+
+	free(buf);
+	printf("ut_crc32 %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+static int do_crc32_bench(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char *const argv[])
+{
+	static const uint sizes[] = { 64, 512, 4096, 65536, 1 << 20 };
+	volatile uint32_t crc = 0;
+	ulong start, us;
+	uint8_t *buf;
+	uint align, count, i, n;
+
+	buf = malloc(TEST_BUFFER_SIZE + TEST_MAX_ALIGN);
+	if (!buf)
+		return CMD_RET_FAILURE;
+	fill_buffer(buf, TEST_BUFFER_SIZE + TEST_MAX_ALIGN);
+
+	puts("    size  align    MB/s\n");
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (align = 0; align < TEST_MAX_ALIGN; align += 3) {
+			count = BENCH_TOTAL / sizes[i];
+			start = timer_get_us();
+			for (n = 0; n < count; n++)
+				crc = crc32(crc, buf + align, sizes[i]);
+			us = timer_get_us() - start;
+			printf("%8u  %5u  %6lu\n", sizes[i], align,
+			       us ? (ulong)BENCH_TOTAL / us : 0);
+		}
+	}
+	free(buf);
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_crc32,	1,	1,	do_ut_crc32,
+	"Check crc32() against a reference at all alignments", ""
+);
+
+U_BOOT_CMD(
+	crc32_bench,	1,	1,	do_crc32_bench,
+	"Report crc32() speed for several sizes and alignments", ""
+);
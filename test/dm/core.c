@@ -791,3 +791,122 @@ static int dm_test_device_get_uclass_id(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_device_get_uclass_id, DM_TESTF_SCAN_PDATA);
+
+/* The list walks which the uclass and sequence-number tables replace */
+static struct uclass *walk_uclass_find(enum uclass_id id)
+{
+	struct uclass *uc;
+
+	list_for_each_entry(uc, &gd->uclass_root, sibling_node) {
+		if (uc->uc_drv->id == id)
+			return uc;
+	}
+
+	return NULL;
+}
+
+static struct udevice *walk_find_by_seq(struct uclass *uc, int seq)
+{
+	struct udevice *dev;
+
+	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+		if (dev->seq == seq)
+			return dev;
+	}
+
+	return NULL;
+}
+
+/* Check the table lookups against a list walk */
+static int dm_test_uclass_lookup(struct unit_test_state *uts)
+{
+	struct udevice *dev, *found;
+	struct uclass *uc;
+	int count = 0;
+	int seq = 0;
+
+	/* The root uclass is created first, so is at the end of the list */
+	ut_asserteq_ptr(walk_uclass_find(UCLASS_ROOT), uclass_find(UCLASS_ROOT));
+	ut_asserteq_ptr(walk_uclass_find(UCLASS_TEST), uclass_find(UCLASS_TEST));
+	list_for_each_entry(uc, &gd->uclass_root, sibling_node)
+		ut_asserteq_ptr(uc, uclass_find(uc->uc_drv->id));
+
+	ut_assertok(uclass_get(UCLASS_TEST, &uc));
+	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+		ut_assert(dev->seq >= 0);
+		ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, dev->seq,
+						      false, &found));
+		ut_asserteq_ptr(dev, found);
+		ut_asserteq_ptr(walk_find_by_seq(uc, dev->seq), found);
+		seq = max(seq, dev->seq);
+		count++;
+	}
+	ut_assert(count > 0);
+
+	/* Sequence numbers outside the table are not found */
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, seq + 1,
+						       false, &found));
+	ut_asserteq_ptr(NULL, found);
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, -2, false,
+						       &found));
+	ut_asserteq_ptr(NULL, found);
+
+	/* A removed device must no longer be found by its old sequence */
+	ut_assertok(uclass_get_device(UCLASS_TEST, 0, &dev));
+	seq = dev->seq;
+	ut_assertok(device_remove(dev));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, seq, false,
+						       &found));
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_lookup, DM_TESTF_SCAN_PDATA | DM_TESTF_PROBE_TEST |
+	DM_TESTF_SCAN_FDT);
+
+/* Report how long the table lookups take compared with a list walk */
+static int dm_test_uclass_lookup_speed(struct unit_test_state *uts)
+{
+	const int loops = 10000;
+	struct udevice *volatile seq_dev;
+	struct uclass *volatile uc_found;
+	ulong start, table_us, walk_us;
+	struct udevice *dev, *found;
+	struct uclass *uc;
+	int count = 0;
+	int seq = 0;
+	int i;
+
+	/* The root uclass is at the end of the list, so is the slowest */
+	start = timer_get_us();
+	for (i = 0; i < loops; i++)
+		uc_found = uclass_find(UCLASS_ROOT);
+	table_us = timer_get_us() - start;
+	start = timer_get_us();
+	for (i = 0; i < loops; i++)
+		uc_found = walk_uclass_find(UCLASS_ROOT);
+	walk_us = timer_get_us() - start;
+	printf("uclass_find(): %lu us, list walk: %lu us, %d uclasses\n",
+	       table_us, walk_us, list_count_items(&gd->uclass_root));
+	ut_asserteq_ptr(uclass_find(UCLASS_ROOT), uc_found);
+
+	ut_assertok(uclass_get(UCLASS_TEST, &uc));
+	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+		seq = max(seq, dev->seq);
+		count++;
+	}
+	start = timer_get_us();
+	for (i = 0; i < loops; i++)
+		uclass_find_device_by_seq(UCLASS_TEST, seq, false, &found);
+	table_us = timer_get_us() - start;
+	start = timer_get_us();
+	for (i = 0; i < loops; i++)
+		seq_dev = walk_find_by_seq(uc, seq);
+	walk_us = timer_get_us() - start;
+	printf("uclass_find_device_by_seq(): %lu us, list walk: %lu us, %d devices\n",
+	       table_us, walk_us, count);
+	ut_asserteq_ptr(found, seq_dev);
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_lookup_speed, DM_TESTF_SCAN_PDATA |
+	DM_TESTF_PROBE_TEST | DM_TESTF_SCAN_FDT);
@@ -11,6 +11,7 @@
 #include <dm.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <dm/test.h>
 #include <asm/eth.h>
@@ -190,3 +191,80 @@ static int dm_test_net_retry(struct unit_test_state *uts)
 	return retval;
 }
 DM_TEST(dm_test_net_retry, DM_TESTF_SCAN_FDT);
+
+/* Size of the file used by the TFTP tests: 64 full blocks plus a short one */
+#define TFTP_TEST_SIZE		(0x10000 + 0x100)
+#define TFTP_TEST_ADDR		0x100000
+
+/* Fetch the test file over TFTP and check what arrived in memory */
+static int tftp_test_get(struct unit_test_state *uts,
+			 struct sandbox_eth_tftp_stats *stats, ulong drop_block)
+{
+	u8 *buf;
+	int i;
+
+	sandbox_eth_tftp_setup(TFTP_TEST_SIZE, drop_block);
+	load_addr = TFTP_TEST_ADDR;
+	buf = map_sysmem(load_addr, TFTP_TEST_SIZE);
+	memset(buf, '\0', TFTP_TEST_SIZE);
+	ut_asserteq(TFTP_TEST_SIZE, net_loop(TFTPGET));
+	for (i = 0; i < TFTP_TEST_SIZE; i++)
+		ut_asserteq(sandbox_eth_tftp_byte(i), buf[i]);
+	unmap_sysmem(buf);
+	sandbox_eth_tftp_get_stats(stats);
+
+	return 0;
+}
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_eth_tftp_window(struct unit_test_state *uts)
+{
+	struct sandbox_eth_tftp_stats stats;
+
+	/* Without a window every block is a round trip, plus the OACK */
+	ut_assertok(tftp_test_get(uts, &stats, 0));
+	ut_asserteq(65, stats.blocks);
+	ut_asserteq(66, stats.acks);
+
+	/* With a window of 8 only the last block of each window is ACKed */
+	setenv("tftpwindowsize", "8");
+	ut_assertok(tftp_test_get(uts, &stats, 0));
+	ut_asserteq(65, stats.blocks);
+	ut_asserteq(10, stats.acks);
+
+	/*
+	 * Losing block 12 makes block 13 arrive out of order. It is dropped
+	 * and block 11 is re-acknowledged so that the window restarts at 12.
+	 */
+	ut_assertok(tftp_test_get(uts, &stats, 12));
+	ut_asserteq(66, stats.blocks);
+	ut_asserteq(10, stats.acks);
+
+	/*
+	 * Losing block 1 makes block 2 arrive first. The OACK (block 0) is
+	 * re-acknowledged rather than the transfer being started again.
+	 */
+	ut_assertok(tftp_test_get(uts, &stats, 1));
+	ut_asserteq(66, stats.blocks);
+	ut_asserteq(11, stats.acks);
+
+	return 0;
+}
+
+static int dm_test_eth_tftp_window(struct unit_test_state *uts)
+{
+	int retval;
+
+	setenv("ethact", "eth@10002000");
+	net_server_ip = string_to_ip("1.1.2.2");
+	setenv("tftpblocksize", "1024");
+
+	retval = _dm_test_eth_tftp_window(uts);
+
+	/* Restore the env */
+	setenv("tftpwindowsize", NULL);
+	setenv("tftpblocksize", NULL);
+
+	return retval;
+}
+DM_TEST(dm_test_eth_tftp_window, DM_TESTF_SCAN_FDT);
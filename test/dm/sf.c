@@ -7,6 +7,9 @@
 #include <common.h>
 #include <dm.h>
 #include <fdtdec.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <os.h>
 #include <spi.h>
 #include <spi_flash.h>
 #include <asm/state.h>
@@ -41,3 +44,116 @@ static int dm_test_spi_flash(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that flash over 16MiB is written and read with 4-byte addresses */
+static int dm_test_spi_flash_4b(struct unit_test_state *uts)
+{
+	struct sandbox_state *state = state_get_current();
+	const ulong flash_size = 32 << 20, offset = 0xff0000, size = 0x20000;
+	const ulong src = 0x1000000, dst = 0x2000000;
+	u8 *buf, *data;
+	ulong i;
+	int fd;
+
+	/* An empty flash, which is large enough to need 4-byte addresses */
+	os_unlink("spi4b.bin");
+	fd = os_open("spi4b.bin", OS_O_RDWR | OS_O_CREAT);
+	ut_assert(fd >= 0);
+	ut_asserteq(flash_size - 1, os_lseek(fd, flash_size - 1, OS_SEEK_SET));
+	ut_asserteq(1, os_write(fd, "", 1));
+
+	/* Write data across the 16MiB boundary and read it back */
+	buf = map_sysmem(src, size);
+	for (i = 0; i < size; i++)
+		buf[i] = i * 7 + (i >> 8);
+	state->spi[0][1].spec = "s25fl256s_64k:spi4b.bin";
+	ut_assertok(run_command_list(
+		"sf probe 0:1;"
+		"sf update 1000000 ff0000 20000;"
+		"sf read 2000000 ff0000 20000", -1, 0));
+	ut_assertok(memcmp(buf, map_sysmem(dst, size), size));
+
+	/* Check that it ended up in the right place, not at the start */
+	data = malloc(size);
+	ut_assertnonnull(data);
+	ut_asserteq(offset, os_lseek(fd, offset, OS_SEEK_SET));
+	ut_asserteq(size, os_read(fd, data, size));
+	ut_assertok(memcmp(buf, data, size));
+	ut_asserteq(0, os_lseek(fd, 0, OS_SEEK_SET));
+	ut_asserteq(size, os_read(fd, data, size));
+	for (i = 0; i < size; i++)
+		ut_asserteq(0, data[i]);
+	free(data);
+	os_close(fd);
+	os_unlink("spi4b.bin");
+
+	sandbox_sf_unbind_emul(state, 0, 1);
+	state->spi[0][1].spec = NULL;
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_4b, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Run a command, returning the time it took in milliseconds */
+static ulong sf_test_time(struct unit_test_state *uts, const char *cmd)
+{
+	ulong start = get_timer(0);
+
+	if (run_command(cmd, 0))
+		return ~0UL;
+
+	return get_timer(start);
+}
+
+/*
+ * Test that erases use the largest command which fits, and that 'sf update'
+ * only erases and programs what changes. The flash in the device tree takes
+ * 10ms for a 4KiB erase and 40ms for a 64KiB one, so the time taken shows
+ * which were used. The upper limits leave room for a busy host.
+ */
+static int dm_test_spi_flash_erase(struct unit_test_state *uts)
+{
+	const ulong size = 0x20000;
+	ulong ms;
+	u8 *buf;
+	ulong i;
+
+	ut_assertok(run_command_list(
+		"sb save hostfs - 0 spi-timing.bin 400000;"
+		"sf probe 0:2", -1, 0));
+
+	/* Two 64KiB erases rather than 32 4KiB ones (320ms) */
+	ms = sf_test_time(uts, "sf erase 0 20000");
+	ut_assert(ms >= 80 && ms < 240);
+
+	/* An unaligned start needs 4KiB erases up to the first block */
+	ms = sf_test_time(uts, "sf erase 1e000 12000");
+	ut_assert(ms >= 60 && ms < 140);
+
+	/* Writing to erased flash erases whole blocks again */
+	buf = map_sysmem(0x1000000, size);
+	for (i = 0; i < size; i++)
+		buf[i] = i * 7 + (i >> 8);
+	ms = sf_test_time(uts, "sf update 1000000 40000 20000");
+	ut_assert(ms >= 80 && ms < 240);
+
+	/* Nothing changes, so nothing is erased */
+	ms = sf_test_time(uts, "sf update 1000000 40000 20000");
+	ut_assert(ms < 10);
+
+	/* One sector changes, so it is erased on its own */
+	buf[0x5000] ^= 1;
+	ms = sf_test_time(uts, "sf update 1000000 40000 20000");
+	ut_assert(ms >= 10 && ms < 40);
+
+	ut_assertok(run_command_list(
+		"sf read 2000000 40000 20000;"
+		"cmp.b 1000000 2000000 20000", -1, 0));
+	unmap_sysmem(buf);
+
+	sandbox_sf_unbind_emul(state_get_current(), 0, 2);
+	os_unlink("spi-timing.bin");
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_erase, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
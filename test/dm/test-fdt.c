@@ -8,13 +8,16 @@
 #include <dm.h>
 #include <errno.h>
 #include <fdtdec.h>
+#include <fdt_index.h>
 #include <malloc.h>
 #include <asm/io.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <dm/root.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
 #include <test/ut.h>
+#include <linux/err.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -183,6 +186,57 @@ static int dm_test_fdt_pre_reloc(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_fdt_pre_reloc, 0);
 
+/* Test that binding picks the same drivers with and without the index */
+static int dm_test_fdt_compat_scan(struct unit_test_state *uts)
+{
+	struct dm_compat_index *index;
+	struct {
+		const struct driver *driver;
+		ulong driver_data;
+		int of_offset;
+	} bound[20];
+	struct udevice *dev, *next;
+	int count, i, ret;
+
+	ut_assertok(dm_scan_fdt(gd->fdt_blob, false));
+	index = gd->dm_compat_index;
+	ut_assert(index && !IS_ERR(index));
+	count = 0;
+	list_for_each_entry(dev, &gd->dm_root->child_head, sibling_node) {
+		ut_assert(count < ARRAY_SIZE(bound));
+		bound[count].driver = dev->driver;
+		bound[count].driver_data = dev->driver_data;
+		bound[count].of_offset = dev->of_offset;
+		count++;
+	}
+	ut_assert(count > 0);
+	list_for_each_entry_safe(dev, next, &gd->dm_root->child_head,
+				 sibling_node)
+		ut_assertok(device_unbind(dev));
+
+	/* Before relocation the index is not built: the drivers are scanned */
+	gd->dm_compat_index = NULL;
+	gd->flags &= ~GD_FLG_RELOC;
+	ret = dm_scan_fdt(gd->fdt_blob, false);
+	gd->flags |= GD_FLG_RELOC;
+	ut_asserteq_ptr(NULL, gd->dm_compat_index);
+	gd->dm_compat_index = index;
+	ut_assertok(ret);
+
+	i = 0;
+	list_for_each_entry(dev, &gd->dm_root->child_head, sibling_node) {
+		ut_assert(i < count);
+		ut_asserteq_ptr(bound[i].driver, dev->driver);
+		ut_asserteq(bound[i].driver_data, dev->driver_data);
+		ut_asserteq(bound[i].of_offset, dev->of_offset);
+		i++;
+	}
+	ut_asserteq(count, i);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_compat_scan, 0);
+
 /* Test that sequence numbers are allocated properly */
 static int dm_test_fdt_uclass_seq(struct unit_test_state *uts)
 {
@@ -266,3 +320,105 @@ static int dm_test_fdt_offset(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_fdt_offset, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_OF_LIBFDT_INDEX
+/* Check lookups in an indexed tree against a copy which is not indexed */
+static int check_fdt_index_lookups(struct unit_test_state *uts,
+				   const void *fdt, const void *ref)
+{
+	const char *name, *alias;
+	char path[256];
+	int offset, node, len;
+	uint32_t phandle;
+
+	for (offset = 0; offset >= 0; offset = fdt_next_node(ref, offset, NULL)) {
+		ut_asserteq(fdt_parent_offset(ref, offset),
+			    fdt_parent_offset(fdt, offset));
+		ut_assertok(fdt_get_path(ref, offset, path, sizeof(path)));
+		ut_asserteq(offset, fdt_path_offset(fdt, path));
+		ut_asserteq(fdt_first_subnode(ref, offset),
+			    fdt_first_subnode(fdt, offset));
+		node = fdt_first_subnode(ref, offset);
+		if (node >= 0) {
+			name = fdt_get_name(ref, node, NULL);
+			ut_asserteq(fdt_subnode_offset(ref, offset, name),
+				    fdt_subnode_offset(fdt, offset, name));
+		}
+		ut_asserteq(-FDT_ERR_NOTFOUND,
+			    fdt_subnode_offset(fdt, offset, "no-such-node"));
+		phandle = fdt_get_phandle(ref, offset);
+		if (phandle)
+			ut_asserteq(fdt_node_offset_by_phandle(ref, phandle),
+				    fdt_node_offset_by_phandle(fdt, phandle));
+	}
+
+	node = fdt_path_offset(ref, "/aliases");
+	ut_assert(node > 0);
+	for (offset = fdt_first_property_offset(ref, node);
+	     offset >= 0;
+	     offset = fdt_next_property_offset(ref, offset)) {
+		fdt_getprop_by_offset(ref, offset, &alias, &len);
+		ut_asserteq(fdt_path_offset(ref, alias),
+			    fdt_path_offset(fdt, alias));
+	}
+	ut_asserteq(fdt_path_offset(ref, "testbus3/c-test@5"),
+		    fdt_path_offset(fdt, "testbus3/c-test@5"));
+
+	return 0;
+}
+
+/* Test that the index gives the same answers as a scan */
+static int dm_test_fdt_index(struct unit_test_state *uts)
+{
+	int size = fdt_totalsize(gd->fdt_blob) + 1024;
+	void *fdt, *ref;
+	int node;
+
+	fdt = malloc(size);
+	ref = malloc(size);
+	ut_assert(fdt && ref);
+	ut_assertok(fdt_open_into(gd->fdt_blob, fdt, size));
+	ut_assertok(fdt_open_into(gd->fdt_blob, ref, size));
+
+	ut_assertok(fdt_index_build(fdt));
+	ut_assertnonnull(fdt_index_get(fdt));
+	ut_asserteq_ptr(NULL, fdt_index_get(ref));
+	ut_assertok(check_fdt_index_lookups(uts, fdt, ref));
+
+	/* Each kind of change drops the index, and lookups stay correct */
+	ut_assertok(fdt_setprop_inplace_u32(fdt, 0, "#size-cells", 0));
+	ut_asserteq_ptr(NULL, fdt_index_get(fdt));
+	ut_assertok(check_fdt_index_lookups(uts, fdt, ref));
+
+	ut_assertok(fdt_index_build(fdt));
+	node = fdt_add_subnode(fdt, 0, "new-node");
+	ut_assert(node > 0);
+	ut_asserteq_ptr(NULL, fdt_index_get(fdt));
+	ut_asserteq(node, fdt_path_offset(fdt, "/new-node"));
+	ut_asserteq(node, fdt_add_subnode(ref, 0, "new-node"));
+	ut_assertok(check_fdt_index_lookups(uts, fdt, ref));
+
+	ut_assertok(fdt_index_build(fdt));
+	ut_assertok(fdt_move(fdt, fdt, size));
+	ut_asserteq_ptr(NULL, fdt_index_get(fdt));
+
+	ut_assertok(fdt_index_build(fdt));
+	ut_assertok(fdt_open_into(fdt, fdt, size));
+	ut_asserteq_ptr(NULL, fdt_index_get(fdt));
+	ut_assertok(check_fdt_index_lookups(uts, fdt, ref));
+
+	/* Changing another tree leaves the index alone */
+	ut_assertok(fdt_index_build(fdt));
+	ut_assertok(fdt_setprop_u32(ref, 0, "new-prop", 1));
+	ut_assertnonnull(fdt_index_get(fdt));
+
+	/* Put back the index of the control FDT */
+	ut_assertok(fdt_index_build(gd->fdt_blob));
+	ut_assertnonnull(fdt_index_get(gd->fdt_blob));
+	free(ref);
+	free(fdt);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_index, 0);
+#endif
@@ -6,6 +6,7 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
 #include <usb.h>
 #include <asm/io.h>
 #include <dm/test.h>
@@ -48,3 +49,30 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_usb_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test a large read, which is done with as few commands as possible */
+static int dm_test_usb_flash_large(struct unit_test_state *uts)
+{
+	block_dev_desc_t *dev_desc;
+	const int count = 1000;
+	char *buf;
+	int i;
+
+	ut_assertok(usb_init());
+	ut_assertok(get_device("usb", "0", &dev_desc));
+
+	buf = malloc(count * dev_desc->blksz);
+	ut_assertnonnull(buf);
+	memset(buf, '\xff', count * dev_desc->blksz);
+	ut_asserteq(count, dev_desc->block_read(dev_desc->dev, 0, count, buf));
+	ut_assertok(strcmp(buf, "this is a test"));
+	for (i = dev_desc->blksz; i < count * dev_desc->blksz; i++) {
+		if (buf[i])
+			break;
+	}
+	ut_asserteq(count * dev_desc->blksz, i);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_usb_flash_large, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <search.h>
+#include <test/env.h>
+#include <test/ut.h>
+
+/* Enough entries to make a small table grow several times */
+#define HTAB_TEST_COUNT		1000
+
+/* Get the value of a variable, or "" if not found */
+static const char *htab_test_get(struct hsearch_data *htab, const char *name)
+{
+	ENTRY e, *ep;
+
+	e.key = name;
+	e.data = NULL;
+	hsearch_r(e, FIND, &ep, htab, 0);
+
+	return ep ? ep->data : "";
+}
+
+static int env_test_htab_grow(struct unit_test_state *uts)
+{
+	struct hsearch_data htab, copy;
+	char name[20], val[20];
+	char *res = NULL, *p, *prev;
+	ENTRY e, *ep;
+	int i, count;
+
+	memset(&htab, '\0', sizeof(htab));
+	memset(&copy, '\0', sizeof(copy));
+	ut_assert(hcreate_r(5, &htab));
+
+	for (i = 0; i < HTAB_TEST_COUNT; i++) {
+		snprintf(name, sizeof(name), "var%d", i);
+		snprintf(val, sizeof(val), "%d", i * 3);
+		e.key = name;
+		e.data = val;
+		ut_assert(hsearch_r(e, ENTER, &ep, &htab, 0));
+	}
+	ut_asserteq(HTAB_TEST_COUNT, htab.filled);
+	ut_assert(htab.size > HTAB_TEST_COUNT);
+
+	for (i = 0; i < HTAB_TEST_COUNT; i++) {
+		snprintf(name, sizeof(name), "var%d", i);
+		snprintf(val, sizeof(val), "%d", i * 3);
+		ut_asserteq_str(val, htab_test_get(&htab, name));
+	}
+
+	/* Delete every other entry and check the rest are still there */
+	for (i = 0; i < HTAB_TEST_COUNT; i += 2) {
+		snprintf(name, sizeof(name), "var%d", i);
+		ut_assert(hdelete_r(name, &htab, 0));
+	}
+	ut_asserteq(HTAB_TEST_COUNT / 2, htab.filled);
+	for (i = 0; i < HTAB_TEST_COUNT; i++) {
+		snprintf(name, sizeof(name), "var%d", i);
+		snprintf(val, sizeof(val), "%d", i * 3);
+		ut_asserteq_str(i & 1 ? val : "", htab_test_get(&htab, name));
+	}
+
+	/* The export must come out sorted by name */
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	prev = NULL;
+	count = 0;
+	for (p = strtok(res, "\n"); p; p = strtok(NULL, "\n")) {
+		*strchr(p, '=') = '\0';
+		if (prev)
+			ut_assert(strcmp(prev, p) < 0);
+		prev = p;
+		count++;
+	}
+	ut_asserteq(HTAB_TEST_COUNT / 2, count);
+	free(res);
+
+	/* Export again, and import it into another table which should match */
+	res = NULL;
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	ut_assert(himport_r(&copy, res, strlen(res), '\n', 0, 0, 0, NULL));
+	free(res);
+	ut_asserteq(htab.filled, copy.filled);
+	for (i = 1; i < HTAB_TEST_COUNT; i += 2) {
+		snprintf(name, sizeof(name), "var%d", i);
+		snprintf(val, sizeof(val), "%d", i * 3);
+		ut_asserteq_str(val, htab_test_get(&copy, name));
+	}
+
+	hdestroy_r(&htab);
+	hdestroy_r(&copy);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_grow, 0);
+
+static int env_test_htab_import(struct unit_test_state *uts)
+{
+	static const char data[] = "# comment\r\none=1\r\n  two=a\\\nb\r\n"
+		"three=3\r\nthree\r\n";
+	struct hsearch_data htab;
+
+	memset(&htab, '\0', sizeof(htab));
+	ut_assert(himport_r(&htab, data, sizeof(data) - 1, '\n', 0, 1, 0,
+			    NULL));
+	ut_asserteq(2, htab.filled);
+	ut_asserteq_str("1", htab_test_get(&htab, "one"));
+	ut_asserteq_str("a\nb", htab_test_get(&htab, "two"));
+	ut_asserteq_str("", htab_test_get(&htab, "three"));
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_import, 0);
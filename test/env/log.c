@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <environment.h>
+#include <errno.h>
+#include <malloc.h>
+#include <search.h>
+#include <test/env.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+/* Size of each test region */
+#define LOG_TEST_SIZE		8192
+
+/* Start an erased region with a header */
+static void log_test_init(uint8_t *buf, uint32_t gen)
+{
+	struct env_log_header *hdr = (struct env_log_header *)buf;
+
+	memset(buf, 0xff, LOG_TEST_SIZE);
+	hdr->magic = ENV_LOG_MAGIC;
+	hdr->gen = gen;
+}
+
+/* Add a chunk at @offset, returning the offset after it */
+static int log_test_add(uint8_t *buf, int offset, const char *data, int len)
+{
+	struct env_log_chunk *chunk = (struct env_log_chunk *)(buf + offset);
+	uint32_t crc;
+
+	chunk->len = len;
+	crc = crc32(0, (const uchar *)&chunk->len, sizeof(chunk->len));
+	chunk->crc = crc32(crc, (const uchar *)data, len);
+	memcpy(chunk + 1, data, len);
+
+	return offset + ENV_LOG_CHUNK_SIZE(len);
+}
+
+/* The first chunk and two later ones, which change and delete variables */
+static int log_test_fill(uint8_t *buf, int *ends)
+{
+	static const char first[] = "log_a=1\0log_b=2\0log_c=3";
+	static const char second[] = "log_b=22\0log_a";
+	static const char third[] = "log_d=4";
+	int offset;
+
+	offset = log_test_add(buf, sizeof(struct env_log_header), first,
+			      sizeof(first));
+	ends[0] = offset;
+	offset = log_test_add(buf, offset, second, sizeof(second));
+	ends[1] = offset;
+	offset = log_test_add(buf, offset, third, sizeof(third));
+	ends[2] = offset;
+
+	return offset;
+}
+
+static const char *log_test_get(const char *name)
+{
+	ENTRY e, *ep;
+
+	e.key = name;
+	e.data = NULL;
+	hsearch_r(e, FIND, &ep, &env_htab, 0);
+
+	return ep ? ep->data : "";
+}
+
+/* Keep the real environment safe while a log is imported */
+static char *log_test_save_env(int *lenp)
+{
+	char *saved = NULL;
+
+	*lenp = hexport_r(&env_htab, '\0', 0, &saved, 0, 0, NULL);
+
+	return *lenp < 0 ? NULL : saved;
+}
+
+static void log_test_restore_env(char *saved, int len)
+{
+	himport_r(&env_htab, saved, len, '\0', 0, 0, 0, NULL);
+	free(saved);
+	env_log_clear();
+}
+
+/* A complete log is read back with the changes in order */
+static int env_test_log_scan(struct unit_test_state *uts)
+{
+	uint8_t buf[LOG_TEST_SIZE];
+	int ends[3], end, free_ofs;
+	uint32_t gen;
+	char *saved;
+	int len;
+
+	log_test_init(buf, 5);
+	end = log_test_fill(buf, ends);
+	ut_asserteq(end, env_log_scan(buf, LOG_TEST_SIZE, &gen, &free_ofs));
+	ut_asserteq(5, gen);
+	ut_asserteq(end, free_ofs);
+
+	saved = log_test_save_env(&len);
+	ut_assertnonnull(saved);
+	ut_assertok(env_log_import(buf, end));
+	ut_asserteq_str("", log_test_get("log_a"));
+	ut_asserteq_str("22", log_test_get("log_b"));
+	ut_asserteq_str("3", log_test_get("log_c"));
+	ut_asserteq_str("4", log_test_get("log_d"));
+	log_test_restore_env(saved, len);
+
+	/* A region without a header, or with no chunks, is not used */
+	memset(buf, 0xff, LOG_TEST_SIZE);
+	ut_asserteq(-EINVAL, env_log_scan(buf, LOG_TEST_SIZE, &gen,
+					  &free_ofs));
+	log_test_init(buf, 5);
+	ut_asserteq(-EINVAL, env_log_scan(buf, LOG_TEST_SIZE, &gen,
+					  &free_ofs));
+
+	return 0;
+}
+ENV_TEST(env_test_log_scan, 0);
+
+/* A chunk which was only partly written is dropped, with what follows */
+static int env_test_log_partial(struct unit_test_state *uts)
+{
+	uint8_t buf[LOG_TEST_SIZE];
+	int ends[3], end, free_ofs;
+	uint32_t gen;
+	char *saved;
+	int len;
+
+	/* The last chunk stopped part-way through its data */
+	log_test_init(buf, 1);
+	end = log_test_fill(buf, ends);
+	memset(buf + end - 4, 0xff, 4);
+	ut_asserteq(ends[1], env_log_scan(buf, LOG_TEST_SIZE, &gen,
+					  &free_ofs));
+	ut_asserteq(LOG_TEST_SIZE, free_ofs);
+
+	saved = log_test_save_env(&len);
+	ut_assertnonnull(saved);
+	ut_assertok(env_log_import(buf, ends[1]));
+	ut_asserteq_str("22", log_test_get("log_b"));
+	ut_asserteq_str("", log_test_get("log_d"));
+	log_test_restore_env(saved, len);
+
+	/* Only the CRC of the last chunk was written */
+	log_test_init(buf, 1);
+	log_test_fill(buf, ends);
+	memset(buf + ends[1] + sizeof(uint32_t), 0xff,
+	       LOG_TEST_SIZE - ends[1] - sizeof(uint32_t));
+	ut_asserteq(ends[1], env_log_scan(buf, LOG_TEST_SIZE, &gen,
+					  &free_ofs));
+	ut_asserteq(LOG_TEST_SIZE, free_ofs);
+
+	/* Nothing of the last chunk was written, so the log can grow */
+	memset(buf + ends[1], 0xff, LOG_TEST_SIZE - ends[1]);
+	ut_asserteq(ends[1], env_log_scan(buf, LOG_TEST_SIZE, &gen,
+					  &free_ofs));
+	ut_asserteq(ends[1], free_ofs);
+
+	return 0;
+}
+ENV_TEST(env_test_log_partial, 0);
+
+/* A chunk with a bad CRC ends the log */
+static int env_test_log_crc(struct unit_test_state *uts)
+{
+	uint8_t buf[LOG_TEST_SIZE];
+	int ends[3], free_ofs;
+	uint32_t gen;
+
+	log_test_init(buf, 1);
+	log_test_fill(buf, ends);
+	buf[ends[1] - 5] ^= 1;
+	ut_asserteq(ends[0], env_log_scan(buf, LOG_TEST_SIZE, &gen,
+					  &free_ofs));
+	ut_asserteq(LOG_TEST_SIZE, free_ofs);
+
+	/* Without a good first chunk there is no environment at all */
+	log_test_init(buf, 1);
+	log_test_fill(buf, ends);
+	buf[sizeof(struct env_log_header) + sizeof(struct env_log_chunk)] ^= 1;
+	ut_asserteq(-EINVAL, env_log_scan(buf, LOG_TEST_SIZE, &gen,
+					  &free_ofs));
+
+	return 0;
+}
+ENV_TEST(env_test_log_crc, 0);
+
+/* The copy with the latest generation is used */
+static int env_test_log_find(struct unit_test_state *uts)
+{
+	uint8_t buf0[LOG_TEST_SIZE], buf1[LOG_TEST_SIZE];
+	void *bufs[] = { buf0, buf1 };
+	int ends[3], end, free_ofs;
+	uint32_t gen;
+
+	log_test_init(buf0, 7);
+	log_test_fill(buf0, ends);
+	log_test_init(buf1, 8);
+	log_test_fill(buf1, ends);
+	ut_asserteq(1, env_log_find(bufs, 2, LOG_TEST_SIZE, &end, &gen,
+				    &free_ofs));
+	ut_asserteq(8, gen);
+	ut_asserteq(ends[2], end);
+
+	/* The generation number wraps around */
+	log_test_init(buf0, 0);
+	log_test_fill(buf0, ends);
+	log_test_init(buf1, 0xffffffff);
+	log_test_fill(buf1, ends);
+	ut_asserteq(0, env_log_find(bufs, 2, LOG_TEST_SIZE, &end, &gen,
+				    &free_ofs));
+	ut_asserteq(0, gen);
+
+	/* A later copy without a valid log is not used */
+	log_test_init(buf1, 1);
+	ut_asserteq(0, env_log_find(bufs, 2, LOG_TEST_SIZE, &end, &gen,
+				    &free_ofs));
+
+	/* Nor is one which could not be read */
+	bufs[0] = NULL;
+	ut_asserteq(-ENOENT, env_log_find(bufs, 2, LOG_TEST_SIZE, &end,
+					  &gen, &free_ofs));
+
+	return 0;
+}
+ENV_TEST(env_test_log_find, 0);
+
+/* A chunk built after some changes holds just those changes */
+static int env_test_log_build(struct unit_test_state *uts)
+{
+	uint8_t buf[LOG_TEST_SIZE];
+	struct env_log_chunk chunk;
+	int first_end, offset, free_ofs;
+	bool snapshot;
+	uint32_t gen;
+	char *data;
+	char *saved;
+	int len;
+
+	saved = log_test_save_env(&len);
+	ut_assertnonnull(saved);
+
+	/* Start with a snapshot of the whole environment */
+	setenv("log_a", "1");
+	setenv("log_b", "back\\slash");
+	snapshot = true;
+	ut_assertok(env_log_build(&chunk, &data, &snapshot));
+	ut_assert(snapshot);
+	ut_assert(ENV_LOG_CHUNK_SIZE(chunk.len) < LOG_TEST_SIZE / 2);
+	log_test_init(buf, 1);
+	offset = log_test_add(buf, sizeof(struct env_log_header), data,
+			      chunk.len);
+	first_end = offset;
+	ut_asserteq(chunk.crc, ((struct env_log_chunk *)
+				(buf + sizeof(struct env_log_header)))->crc);
+	free(data);
+	env_log_clear();
+
+	/* Nothing has changed since */
+	snapshot = false;
+	ut_assertok(env_log_build(&chunk, &data, &snapshot));
+	ut_assert(!snapshot);
+	ut_asserteq(0, chunk.len);
+	free(data);
+
+	/* Then a change and a deletion */
+	setenv("log_a", "2");
+	setenv("log_b", NULL);
+	ut_assertok(env_log_build(&chunk, &data, &snapshot));
+	ut_assert(!snapshot);
+	ut_asserteq(sizeof("log_a=2") + sizeof("log_b"), chunk.len);
+	ut_assertok(memcmp(data, "log_a=2\0log_b", chunk.len));
+	offset = log_test_add(buf, offset, data, chunk.len);
+	free(data);
+
+	/* Reading the log back gives the environment as it was saved */
+	setenv("log_a", "3");
+	ut_asserteq(offset, env_log_scan(buf, LOG_TEST_SIZE, &gen, &free_ofs));
+	ut_assertok(env_log_import(buf, first_end));
+	ut_asserteq_str("1", log_test_get("log_a"));
+	ut_asserteq_str("back\\slash", log_test_get("log_b"));
+	ut_assertok(env_log_import(buf, offset));
+	ut_asserteq_str("2", log_test_get("log_a"));
+	ut_asserteq_str("", log_test_get("log_b"));
+	log_test_restore_env(saved, len);
+
+	return 0;
+}
+ENV_TEST(env_test_log_build, 0);
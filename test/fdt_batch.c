@@ -0,0 +1,287 @@
+/*
+ * Tests for batched device tree changes
+ *
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <fdt_support.h>
+#include <malloc.h>
+#include <net.h>
+
+#define TEST_FDT_SIZE		4096
+
+/* Build the test tree in 'fdt', with some free space at the end */
+static int make_fdt(void *fdt)
+{
+	static const uint8_t zero_mac[6];
+
+	if (fdt_create(fdt, TEST_FDT_SIZE) ||
+	    fdt_finish_reservemap(fdt) ||
+	    fdt_begin_node(fdt, "") ||
+	    fdt_property_string(fdt, "compatible", "sandbox") ||
+	    fdt_begin_node(fdt, "aliases") ||
+	    fdt_property_string(fdt, "ethernet0", "/eth@0") ||
+	    fdt_property_string(fdt, "ethernet1", "/eth@1") ||
+	    fdt_end_node(fdt) ||
+	    fdt_begin_node(fdt, "eth@0") ||
+	    fdt_property_string(fdt, "compatible", "test,eth") ||
+	    fdt_property(fdt, "mac-address", zero_mac, sizeof(zero_mac)) ||
+	    fdt_end_node(fdt) ||
+	    fdt_begin_node(fdt, "eth@1") ||
+	    fdt_property_string(fdt, "compatible", "test,eth") ||
+	    fdt_end_node(fdt) ||
+	    fdt_begin_node(fdt, "uart@0") ||
+	    fdt_property_string(fdt, "compatible", "test,uart") ||
+	    fdt_property_string(fdt, "status", "disabled") ||
+	    fdt_property_u32(fdt, "clock", 1) ||
+	    fdt_end_node(fdt) ||
+	    fdt_begin_node(fdt, "uart@1") ||
+	    fdt_property_string(fdt, "compatible", "test,uart") ||
+	    fdt_property_u32(fdt, "clock", 2) ||
+	    fdt_end_node(fdt) ||
+	    fdt_end_node(fdt) ||
+	    fdt_finish(fdt))
+		return -EINVAL;
+	if (fdt_pack(fdt))
+		return -EINVAL;
+
+	return fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 512);
+}
+
+/* Check that two trees have the same nodes and properties */
+static int compare_fdt(const void *fdt, const void *ref)
+{
+	const char *name, *val;
+	int offset, node, prop;
+	int len, ref_len;
+	int count, ref_count;
+	char path[256];
+
+	for (offset = 0; offset >= 0; offset = fdt_next_node(ref, offset, NULL)) {
+		if (fdt_get_path(ref, offset, path, sizeof(path)))
+			return -EINVAL;
+		node = fdt_path_offset(fdt, path);
+		if (node < 0) {
+			printf("Missing node %s\n", path);
+			return -EINVAL;
+		}
+		ref_count = 0;
+		for (prop = fdt_first_property_offset(ref, offset);
+		     prop >= 0;
+		     prop = fdt_next_property_offset(ref, prop)) {
+			val = fdt_getprop_by_offset(ref, prop, &name, &ref_len);
+			ref_count++;
+			if (!val || fdt_getprop(fdt, node, name, &len) == NULL ||
+			    len != ref_len ||
+			    memcmp(fdt_getprop(fdt, node, name, NULL), val,
+				   len)) {
+				printf("Wrong property %s:%s\n", path, name);
+				return -EINVAL;
+			}
+		}
+		count = 0;
+		for (prop = fdt_first_property_offset(fdt, node);
+		     prop >= 0;
+		     prop = fdt_next_property_offset(fdt, prop))
+			count++;
+		if (count != ref_count) {
+			printf("Extra properties in %s\n", path);
+			return -EINVAL;
+		}
+	}
+	count = 0;
+	for (offset = 0; offset >= 0; offset = fdt_next_node(fdt, offset, NULL))
+		count++;
+	ref_count = 0;
+	for (offset = 0; offset >= 0; offset = fdt_next_node(ref, offset, NULL))
+		ref_count++;
+	if (count != ref_count) {
+		puts("Extra nodes\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int report(const char *name, int ret)
+{
+	printf(" %s: %s\n", name, ret ? "FAILED" : "ok");
+
+	return ret;
+}
+
+/* A batch must end up with the same tree as making the changes directly */
+static int test_changes(void *fdt, void *ref)
+{
+	struct fdt_batch batch;
+	int uart0, uart1;
+	int ret;
+
+	uart0 = fdt_path_offset(fdt, "/uart@0");
+	uart1 = fdt_path_offset(fdt, "/uart@1");
+	fdt_batch_init(&batch);
+	fdt_batch_setprop(&batch, fdt, uart0, "status", "okay", 5);
+	fdt_batch_setprop(&batch, fdt, uart0, "status", "reserved", 9);
+	fdt_batch_delprop(&batch, fdt, uart0, "clock");
+	fdt_batch_setprop(&batch, fdt, uart1, "new-prop", "value", 6);
+	fdt_batch_delprop(&batch, fdt, uart1, "no-such-prop");
+	fdt_batch_setprop(&batch, fdt, 0, "model", "test", 5);
+	ret = fdt_batch_apply(&batch, fdt);
+	if (ret)
+		return ret;
+
+	uart0 = fdt_path_offset(ref, "/uart@0");
+	fdt_setprop_string(ref, uart0, "status", "reserved");
+	fdt_delprop(ref, uart0, "clock");
+	uart1 = fdt_path_offset(ref, "/uart@1");
+	fdt_setprop_string(ref, uart1, "new-prop", "value");
+	fdt_setprop_string(ref, 0, "model", "test");
+
+	return compare_fdt(fdt, ref);
+}
+
+/* A batch which does not fit leaves the tree alone */
+static int test_no_space(void *fdt, void *ref)
+{
+	struct fdt_batch batch;
+	char big[1024];
+
+	memset(big, 'x', sizeof(big));
+	memcpy(ref, fdt, fdt_totalsize(fdt));
+	fdt_batch_init(&batch);
+	fdt_batch_setprop(&batch, fdt, fdt_path_offset(fdt, "/uart@1"),
+			  "big", big, sizeof(big));
+	if (fdt_batch_apply(&batch, fdt) != -FDT_ERR_NOSPACE)
+		return -EINVAL;
+
+	return memcmp(fdt, ref, fdt_totalsize(ref)) ? -EINVAL : 0;
+}
+
+/*
+ * The fixup helpers queue their changes in a started batch, which copes
+ * with the tree changing underneath it. Another batch applied meanwhile
+ * joins it.
+ */
+static int test_started(void *fdt, void *ref)
+{
+	struct fdt_batch batch, own;
+	const char *status;
+	int ret;
+
+	fdt_batch_start(&batch, fdt);
+	do_fixup_by_compat(fdt, "test,uart", "status", "okay", 5, 1);
+	fdt_setprop_u32(fdt, fdt_path_offset(fdt, "/eth@0"), "extra", 1);
+	do_fixup_by_prop_u32(fdt, "compatible", "test,eth", 9, "phy", 3, 1);
+	fdt_del_node(fdt, fdt_path_offset(fdt, "/uart@1"));
+	fdt_add_subnode(fdt, 0, "added");
+	fdt_batch_init(&own);
+	fdt_batch_setprop(&own, fdt, fdt_path_offset(fdt, "/eth@1"), "own",
+			  "x", 2);
+	if (fdt_batch_apply(&own, fdt))
+		return -EINVAL;
+
+	/* None of the queued changes has been made yet */
+	status = fdt_getprop(fdt, fdt_path_offset(fdt, "/uart@0"), "status",
+			     NULL);
+	if (!status || strcmp(status, "disabled"))
+		return -EINVAL;
+	if (fdt_getprop(fdt, fdt_path_offset(fdt, "/eth@1"), "own", NULL))
+		return -EINVAL;
+	if (fdt_batch_get(fdt) != &batch || fdt_batch_get(ref))
+		return -EINVAL;
+	ret = fdt_batch_apply(&batch, fdt);
+	if (ret)
+		return ret;
+	if (fdt_batch_get(fdt))
+		return -EINVAL;
+
+	do_fixup_by_compat(ref, "test,uart", "status", "okay", 5, 1);
+	fdt_setprop_u32(ref, fdt_path_offset(ref, "/eth@0"), "extra", 1);
+	do_fixup_by_prop_u32(ref, "compatible", "test,eth", 9, "phy", 3, 1);
+	fdt_del_node(ref, fdt_path_offset(ref, "/uart@1"));
+	fdt_add_subnode(ref, 0, "added");
+	fdt_setprop_string(ref, fdt_path_offset(ref, "/eth@1"), "own", "x");
+
+	return compare_fdt(fdt, ref);
+}
+
+/* MAC addresses go to the aliased nodes */
+static int test_ethernet(void *fdt)
+{
+	uint8_t mac[6], mac1[6];
+	const void *val;
+	struct fdt_batch batch;
+	int node, len;
+	int ret;
+
+	/* The addresses can only be set once, so use any already there */
+	if (!getenv("ethaddr"))
+		setenv("ethaddr", "02:00:11:22:33:44");
+	if (!getenv("eth1addr"))
+		setenv("eth1addr", "02:00:11:22:33:55");
+	if (!getenv("ethaddr") || !getenv("eth1addr"))
+		return -EINVAL;
+	eth_parse_enetaddr(getenv("ethaddr"), mac);
+	eth_parse_enetaddr(getenv("eth1addr"), mac1);
+
+	fdt_batch_start(&batch, fdt);
+	fdt_fixup_ethernet(fdt);
+	ret = fdt_batch_apply(&batch, fdt);
+	if (ret)
+		return ret;
+
+	node = fdt_path_offset(fdt, "/eth@0");
+	val = fdt_getprop(fdt, node, "mac-address", &len);
+	if (!val || len != 6 || memcmp(val, mac, 6))
+		return -EINVAL;
+	val = fdt_getprop(fdt, node, "local-mac-address", &len);
+	if (!val || len != 6 || memcmp(val, mac, 6))
+		return -EINVAL;
+	node = fdt_path_offset(fdt, "/eth@1");
+	if (fdt_getprop(fdt, node, "mac-address", NULL))
+		return -EINVAL;
+	val = fdt_getprop(fdt, node, "local-mac-address", &len);
+	if (!val || len != 6 || memcmp(val, mac1, 6))
+		return -EINVAL;
+
+	return 0;
+}
+
+static int do_ut_fdt_batch(cmd_tbl_t *cmdtp, int flag, int argc,
+			   char *const argv[])
+{
+	void *fdt, *ref;
+	int err = 0;
+
+	fdt = malloc(TEST_FDT_SIZE);
+	ref = malloc(TEST_FDT_SIZE);
+	if (!fdt || !ref) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	err |= make_fdt(fdt) || make_fdt(ref);
+	err |= report("changes", test_changes(fdt, ref));
+	err |= report("no space", test_no_space(fdt, ref));
+	err |= make_fdt(fdt) || make_fdt(ref);
+	err |= report("started batch", test_started(fdt, ref));
+	err |= make_fdt(fdt);
+	err |= report("ethernet", test_ethernet(fdt));
+
+out:
+	free(ref);
+	free(fdt);
+	printf("ut_fdt_batch %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err ? CMD_RET_FAILURE : 0;
+}
+
+U_BOOT_CMD(
+	ut_fdt_batch,	1,	1,	do_ut_fdt_batch,
+	"Check batched device tree changes", ""
+);
@@ -0,0 +1,165 @@
+/*
+ * Tests for calculating FIT hashes, whole or in chunks, on the workers
+ *
+ * Copyright (c) 2015 The Chromium OS Authors.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <image.h>
+#include <malloc.h>
+
+#define TEST_DATA_LEN		(300 * 1024 + 123)
+#define TEST_CHUNK_SIZE		(64 * 1024)
+#define TEST_FIT_SIZE		(TEST_DATA_LEN + 4096)
+
+static const char *const test_algos[] = { "crc32", "md5", "sha1", "sha256" };
+
+/* Build a FIT with a plain and a chunked hash node for each algorithm */
+static int make_fit(char *fit, const uint8_t *data)
+{
+	char name[20];
+	int i;
+
+	if (fdt_create(fit, TEST_FIT_SIZE) ||
+	    fdt_finish_reservemap(fit) ||
+	    fdt_begin_node(fit, "") ||
+	    fdt_property_string(fit, FIT_DESC_PROP, "fit_hash test") ||
+	    fdt_property_u32(fit, FIT_TIMESTAMP_PROP, 0) ||
+	    fdt_begin_node(fit, "images") ||
+	    fdt_begin_node(fit, "image@1") ||
+	    fdt_property(fit, FIT_DATA_PROP, data, TEST_DATA_LEN) ||
+	    fdt_property_string(fit, FIT_TYPE_PROP, "kernel") ||
+	    fdt_property_string(fit, FIT_COMP_PROP, "none"))
+		return -EINVAL;
+	for (i = 0; i < ARRAY_SIZE(test_algos) * 2; i++) {
+		snprintf(name, sizeof(name), FIT_HASH_NODENAME "@%d", i + 1);
+		if (fdt_begin_node(fit, name) ||
+		    fdt_property_string(fit, FIT_ALGO_PROP, test_algos[i / 2]))
+			return -EINVAL;
+		if ((i & 1) && fdt_property_u32(fit, FIT_CHUNK_SIZE_PROP,
+						TEST_CHUNK_SIZE))
+			return -EINVAL;
+		if (fdt_end_node(fit))
+			return -EINVAL;
+	}
+	if (fdt_end_node(fit) ||
+	    fdt_end_node(fit) ||
+	    fdt_end_node(fit) ||
+	    fdt_finish(fit))
+		return -EINVAL;
+
+	return fdt_open_into(fit, fit, TEST_FIT_SIZE);
+}
+
+/* Work out the value of a hash node one piece after another */
+static int serial_hash(const uint8_t *data, const char *algo, bool chunked,
+		       uint8_t *value, int *value_len)
+{
+	uint8_t *values;
+	int chunks, len, i;
+	ulong size;
+	int ret;
+
+	if (!chunked)
+		return calculate_hash(data, TEST_DATA_LEN, algo, value,
+				      value_len);
+
+	chunks = DIV_ROUND_UP(TEST_DATA_LEN, TEST_CHUNK_SIZE);
+	values = malloc(chunks * FIT_MAX_HASH_LEN);
+	if (!values)
+		return -ENOMEM;
+	for (i = 0, len = 0; i < chunks; i++) {
+		size = min(TEST_DATA_LEN - i * TEST_CHUNK_SIZE,
+			   TEST_CHUNK_SIZE);
+		ret = calculate_hash(data + i * TEST_CHUNK_SIZE, size, algo,
+				     values + len, value_len);
+		if (ret)
+			break;
+		len += *value_len;
+	}
+	if (!ret)
+		ret = calculate_hash(values, len, algo, value, value_len);
+	free(values);
+
+	return ret;
+}
+
+static int do_ut_fit_hash(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char *const argv[])
+{
+	uint8_t expect[FIT_MAX_HASH_LEN], value[FIT_MAX_HASH_LEN];
+	int expect_len, value_len;
+	int image_noffset, noffset;
+	uint8_t *data, *fit_data;
+	char *fit;
+	int err = 0;
+	int i;
+
+	fit = malloc(TEST_FIT_SIZE);
+	data = malloc(TEST_DATA_LEN);
+	if (!fit || !data) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < TEST_DATA_LEN; i++)
+		data[i] = i * 7 + (i >> 9);
+	if (make_fit(fit, data)) {
+		puts("Cannot build FIT\n");
+		err = -EINVAL;
+		goto out;
+	}
+	image_noffset = fdt_path_offset(fit, "/images/image@1");
+
+	/* Each node must get the same value as working it out serially */
+	i = 0;
+	fdt_for_each_subnode(fit, noffset, image_noffset) {
+		const char *algo = test_algos[i / 2];
+		bool chunked = i & 1;
+		int ret;
+
+		ret = serial_hash(data, algo, chunked, expect, &expect_len);
+		if (!ret)
+			ret = fit_image_hash_calc(fit, noffset, data,
+						  TEST_DATA_LEN, value,
+						  &value_len);
+		if (!ret && (value_len != expect_len ||
+			     memcmp(value, expect, value_len)))
+			ret = -EINVAL;
+		if (!ret)
+			ret = fdt_setprop(fit, noffset, FIT_VALUE_PROP, value,
+					  value_len);
+		printf(" %s%s: %s\n", algo, chunked ? ", chunked" : "",
+		       ret ? "FAILED" : "ok");
+		err |= ret;
+		i++;
+	}
+
+	/* Checking all the nodes at once spreads them across the workers */
+	if (!fit_image_verify(fit, image_noffset))
+		err = -EINVAL;
+	puts("\n");
+
+	/* A change in the last chunk must be noticed */
+	noffset = fdt_path_offset(fit, "/images/image@1");
+	fit_data = (uint8_t *)fdt_getprop(fit, noffset, FIT_DATA_PROP, NULL);
+	fit_data[TEST_DATA_LEN - 1] ^= 1;
+	if (fit_image_verify(fit, image_noffset))
+		err = -EINVAL;
+	puts("\n");
+
+out:
+	free(data);
+	free(fit);
+	printf("ut_fit_hash %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err ? CMD_RET_FAILURE : 0;
+}
+
+U_BOOT_CMD(
+	ut_fit_hash,	1,	1,	do_ut_fit_hash,
+	"Check calculating FIT hashes in parallel", ""
+);
@@ -0,0 +1,218 @@
+/*
+ * Tests for loading images from a FIT a chunk at a time
+ *
+ * Copyright (c) 2015 The Chromium OS Authors.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <u-boot/crc.h>
+
+/* This must match the chunk size used by image-fit-stream.c */
+#ifndef CONFIG_FIT_STREAM_CHUNK
+#define CONFIG_FIT_STREAM_CHUNK		(64 << 10)
+#endif
+
+#define TEST_DATA_MAX		(3 * CONFIG_FIT_STREAM_CHUNK)
+#define TEST_FIT_SIZE		(TEST_DATA_MAX + 4096)
+#define TEST_LOAD_ADDR		0x100000
+
+struct fit_stream_test {
+	const char *name;
+	char *fit;
+	uint8_t *plain;		/* Uncompressed image */
+	ulong plain_len;
+	uint8_t *data;		/* Image data as held in the FIT */
+	ulong data_len;
+};
+
+static int fit_stream_test_read(struct fit_stream *stream, ulong offset,
+				void *buf, ulong len)
+{
+	struct fit_stream_test *test = stream->priv;
+
+	if (offset + len > fdt_totalsize(test->fit))
+		return -EIO;
+	memcpy(buf, test->fit + offset, len);
+
+	return 0;
+}
+
+/* Data which does not compress, so its gzip size follows its length */
+static void fill_plain(uint8_t *buf, ulong len)
+{
+	uint32_t val = 0x12345678;
+	ulong i;
+
+	for (i = 0; i < len; i++) {
+		val = val * 1103515245 + 12345;
+		buf[i] = val >> 16;
+	}
+}
+
+/* Build a FIT holding one image, with a CRC32 over its data */
+static int make_fit(struct fit_stream_test *test, const char *comp,
+		    bool bad_hash)
+{
+	uint32_t crc = crc32(0, test->data, test->data_len);
+	char *fit = test->fit;
+
+	if (bad_hash)
+		crc ^= 1;
+	if (fdt_create(fit, TEST_FIT_SIZE) ||
+	    fdt_finish_reservemap(fit) ||
+	    fdt_begin_node(fit, "") ||
+	    fdt_property_string(fit, FIT_DESC_PROP, "fit_stream test") ||
+	    fdt_property_u32(fit, FIT_TIMESTAMP_PROP, 0) ||
+	    fdt_begin_node(fit, "images") ||
+	    fdt_begin_node(fit, "image@1") ||
+	    fdt_property(fit, FIT_DATA_PROP, test->data, test->data_len) ||
+	    fdt_property_string(fit, FIT_TYPE_PROP, "kernel") ||
+	    fdt_property_string(fit, FIT_COMP_PROP, comp) ||
+	    fdt_begin_node(fit, FIT_HASH_NODENAME "@1") ||
+	    fdt_property_string(fit, FIT_ALGO_PROP, "crc32") ||
+	    fdt_property_u32(fit, FIT_VALUE_PROP, crc) ||
+	    fdt_end_node(fit) ||
+	    fdt_end_node(fit) ||
+	    fdt_end_node(fit) ||
+	    fdt_end_node(fit) ||
+	    fdt_finish(fit)) {
+		printf("%s: cannot build FIT\n", test->name);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Stream the image to TEST_LOAD_ADDR and check the result */
+static int run_test(struct fit_stream_test *test, const char *comp,
+		    bool bad_hash, ulong max_len, int expect)
+{
+	struct fit_stream stream;
+	uint8_t *load;
+	ulong len = 0;
+	int noffset;
+	int ret;
+
+	ret = make_fit(test, comp, bad_hash);
+	if (ret)
+		return ret;
+	stream.read = fit_stream_test_read;
+	stream.priv = test;
+	if (fit_stream_open(&stream)) {
+		printf("%s: cannot open FIT\n", test->name);
+		return -EINVAL;
+	}
+	noffset = fdt_path_offset(stream.fit, "/images/image@1");
+	load = map_sysmem(TEST_LOAD_ADDR, test->plain_len);
+	memset(load, '\0', test->plain_len);
+	ret = fit_stream_load(&stream, noffset, TEST_LOAD_ADDR, max_len,
+			      &len);
+	puts("\n");
+	fit_stream_close(&stream);
+
+	if (ret != expect) {
+		printf("%s: got %d, expected %d\n", test->name, ret, expect);
+		ret = -EINVAL;
+	} else if (!ret && (len != test->plain_len ||
+			    memcmp(load, test->plain, len))) {
+		printf("%s: wrong data loaded\n", test->name);
+		ret = -EINVAL;
+	} else {
+		ret = 0;
+	}
+	unmap_sysmem(load);
+	printf(" %s: %s\n", test->name, ret ? "FAILED" : "ok");
+
+	return ret;
+}
+
+/* Compress 'len' bytes of test data, returning the compressed size */
+static ulong make_gzip(struct fit_stream_test *test, ulong len)
+{
+	unsigned long out_len = TEST_DATA_MAX;
+
+	test->plain_len = len;
+	if (gzip(test->data, &out_len, test->plain, len))
+		return 0;
+	test->data_len = out_len;
+
+	return out_len;
+}
+
+static int do_ut_fit_stream(cmd_tbl_t *cmdtp, int flag, int argc,
+			    char *const argv[])
+{
+	struct fit_stream_test test;
+	ulong len, gz_len;
+	int err = 0;
+	int tries;
+
+	test.fit = malloc(TEST_FIT_SIZE);
+	test.plain = malloc(TEST_DATA_MAX);
+	test.data = malloc(TEST_DATA_MAX);
+	if (!test.fit || !test.plain || !test.data) {
+		err = -ENOMEM;
+		goto out;
+	}
+	fill_plain(test.plain, TEST_DATA_MAX);
+
+	/* An uncompressed image must still fit in max_len */
+	test.name = "none";
+	test.plain_len = 2 * CONFIG_FIT_STREAM_CHUNK + 100;
+	test.data_len = test.plain_len;
+	memcpy(test.data, test.plain, test.data_len);
+	err |= run_test(&test, "none", false, test.plain_len, 0);
+	test.name = "none, too large";
+	err |= run_test(&test, "none", false, test.plain_len - 1, -E2BIG);
+	test.name = "none, bad hash";
+	err |= run_test(&test, "none", true, test.plain_len, -EBADMSG);
+
+	/*
+	 * Find a size whose compressed data ends just after a chunk, so that
+	 * the output is full before the last chunk, which holds the trailer.
+	 */
+	len = CONFIG_FIT_STREAM_CHUNK;
+	for (tries = 0; tries < 10; tries++) {
+		gz_len = make_gzip(&test, len);
+		if (!gz_len || gz_len == CONFIG_FIT_STREAM_CHUNK + 4)
+			break;
+		len += CONFIG_FIT_STREAM_CHUNK + 4 - (long)gz_len;
+	}
+	if (gz_len != CONFIG_FIT_STREAM_CHUNK + 4) {
+		puts("Cannot make gzip data of the right size\n");
+		err = -EINVAL;
+		goto out;
+	}
+	test.name = "gzip, exact fit";
+	err |= run_test(&test, "gzip", false, test.plain_len, 0);
+	test.name = "gzip, too large";
+	err |= run_test(&test, "gzip", false, test.plain_len - 1, -E2BIG);
+	test.name = "gzip, bad hash";
+	err |= run_test(&test, "gzip", true, test.plain_len, -EBADMSG);
+
+	/* Padding after the compressed data, in a later chunk, is ignored */
+	test.name = "gzip, padded";
+	memset(test.data + test.data_len, '\0', CONFIG_FIT_STREAM_CHUNK);
+	test.data_len += CONFIG_FIT_STREAM_CHUNK;
+	err |= run_test(&test, "gzip", false, TEST_DATA_MAX, 0);
+
+out:
+	free(test.data);
+	free(test.plain);
+	free(test.fit);
+	printf("ut_fit_stream %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err ? CMD_RET_FAILURE : 0;
+}
+
+U_BOOT_CMD(
+	ut_fit_stream,	1,	1,	do_ut_fit_stream,
+	"Check loading images from a FIT a chunk at a time", ""
+);
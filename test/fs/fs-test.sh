@@ -10,13 +10,14 @@
 # Expected results are as follows:
 # EXT4 tests:
 # fs-test.sb.ext4.out: Summary: PASS: 17 FAIL: 2
-# fs-test.ext4.out: Summary: PASS: 11 FAIL: 8
-# fs-test.fs.ext4.out: Summary: PASS: 11 FAIL: 8
+# fs-test.ext4.out: Summary: PASS: 19 FAIL: 0
+# fs-test.fs.ext4.out: Summary: PASS: 19 FAIL: 0
 # FAT tests:
 # fs-test.sb.fat.out: Summary: PASS: 17 FAIL: 2
 # fs-test.fat.out: Summary: PASS: 19 FAIL: 0
 # fs-test.fs.fat.out: Summary: PASS: 19 FAIL: 0
-# Total Summary: TOTAL PASS: 94 TOTAL FAIL: 20
+# Raw write test: PASS: 1 FAIL: 0 for each of ext4 and fat
+# Total Summary: TOTAL PASS: 112 TOTAL FAIL: 4
 
 # pre-requisite binaries list.
 PREREQ_BINS="md5sum mkfs mount umount dd fallocate mkdir"
@@ -246,7 +247,6 @@ printenv filesize
 md5sum $addr \$filesize
 setenv filesize
 
-# fails for ext as no offset support
 # Test Case 6a - Last 1MB of big file
 ${PREFIX}load host${SUFFIX} $addr $FILE_BIG $length 0x9C300000
 printenv filesize
@@ -254,7 +254,6 @@ printenv filesize
 md5sum $addr \$filesize
 setenv filesize
 
-# fails for ext as no offset support
 # Test Case 7a - One from the last 1MB chunk of 2GB
 ${PREFIX}load host${SUFFIX} $addr $FILE_BIG $length 0x7FF00000
 printenv filesize
@@ -262,7 +261,6 @@ printenv filesize
 md5sum $addr \$filesize
 setenv filesize
 
-# fails for ext as no offset support
 # Test Case 8a - One from the start 1MB chunk from 2GB
 ${PREFIX}load host${SUFFIX} $addr $FILE_BIG $length 0x80000000
 printenv filesize
@@ -270,7 +268,6 @@ printenv filesize
 md5sum $addr \$filesize
 setenv filesize
 
-# fails for ext as no offset support
 # Test Case 9a - One 1MB chunk crossing the 2GB boundary
 ${PREFIX}load host${SUFFIX} $addr $FILE_BIG $length 0x7FF80000
 printenv filesize
@@ -496,6 +493,82 @@ function test_fs_nonfs() {
 	echo "--------------------------------------------"
 }
 
+# 1st parameter is the image file
+# 2nd parameter is the name of the small file
+# Runs the test -e/size/load sequence of a typical boot script many times
+# against the same partition, once reusing the cached mount and once with
+# 'fs reset' before every command, and reports how long each run took.
+# This only reports the timing and is not counted as a test.
+function test_mount_cache() {
+	addr="0x01000008"
+
+	for mode in cached uncached; do
+		if [ "$mode" = "cached" ]; then
+			RESET=""
+		else
+			RESET="fs reset"
+		fi
+		CMDS="sb bind 0 $1"
+		for i in `seq 1 100`; do
+			CMDS="${CMDS}
+${RESET}
+test -e host 0:0 $2
+${RESET}
+size host 0:0 $2
+${RESET}
+load host 0:0 $addr $2"
+		done
+
+		START=`date +%s%N`
+		echo "${CMDS}
+reset" | $UBOOT > /dev/null
+		END=`date +%s%N`
+		echo "Mount cache: $fs $mode: $(((END - START) / 1000000)) ms"
+	done
+}
+
+# 1st parameter is the name of the small file
+# Loads the small file from a separate small image, so that its mount is
+# cached, then overwrites the start of the device with 'gpt write'. That
+# destroys the superblock or boot sector, so the second load must fail
+# rather than be served from the stale mount.
+function test_raw_write() {
+	addr="0x01000008"
+	img="${OUT_DIR}/raw.${fs}.img"
+	disk="uuid_disk=bd2a2bf6-e5f0-4b34-bc4b-1a5e9d1e3e8f"
+	part="name=raw,start=1MiB,size=1MiB"
+	part="${part},uuid=2b6b1e0f-8f3d-4e54-9f53-5e0fd8d5f5c6"
+	OUT_FILE="${OUT}.raw.${fs}.out"
+
+	rm -f "$img"
+	fallocate -l 16M "$img" &> /dev/null
+	mkfs -t "$fs" $MKFS_OPTION "$img" &> /dev/null
+	if [ $? -ne 0 -a "$fs" = "fat" ]; then
+		mkfs -t vfat $MKFS_OPTION "$img" &> /dev/null
+	fi
+	mkdir -p "$MOUNT_DIR"
+	sudo mount -o loop,rw "$img" "$MOUNT_DIR"
+	sudo dd if=/dev/urandom of="${MOUNT_DIR}/$1" bs=64K count=1 \
+		&> /dev/null
+	sync
+	sudo umount "$MOUNT_DIR"
+	rmdir "$MOUNT_DIR"
+
+	echo "sb bind 0 $img
+load host 0:0 $addr $1
+gpt write host 0 \"${disk};${part}\"
+load host 0:0 $addr $1
+reset" | $UBOOT > ${OUT_FILE}
+
+	PASS=0
+	FAIL=0
+	[ `grep -c "bytes read" ${OUT_FILE}` -eq 1 ]
+	pass_fail "Raw write: load after gpt write fails"
+	TOTAL_FAIL=$((TOTAL_FAIL + FAIL))
+	TOTAL_PASS=$((TOTAL_PASS + PASS))
+	rm -f "$img"
+}
+
 # ********************
 # * End of functions *
 # ********************
@@ -548,6 +621,10 @@ for fs in ext4 fat; do
 
 	test_fs_nonfs nonfs
 	test_fs_nonfs fs
+
+	test_mount_cache $IMAGE $SMALL_FILE
+	test_raw_write $SMALL_FILE
+	echo "--------------------------------------------"
 done
 
 echo "Total Summary: TOTAL PASS: $TOTAL_PASS TOTAL FAIL: $TOTAL_FAIL"
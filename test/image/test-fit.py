@@ -127,6 +127,16 @@ sb save hostfs 0 %(loadables2_addr)x %(loadables2_out)s %(loadables2_size)x
 reset
 '''
 
+# This script loads the same images with 'fitload', which reads the FIT from
+# the filesystem in pieces instead of loading all of it first.
+stream_script = '''
+fitload hostfs - %(fit)s
+sb save hostfs 0 %(kernel_addr)x %(kernel_out)s %(kernel_size)x
+sb save hostfs 0 %(fdt_addr)x %(fdt_out)s %(fdt_size)x
+sb save hostfs 0 %(ramdisk_addr)x %(ramdisk_out)s %(ramdisk_size)x
+reset
+'''
+
 def debug_stdout(stdout):
     if DEBUG:
         print stdout
@@ -432,6 +442,20 @@ def run_fit_test(mkimage, u_boot):
     if read_file(loadables2) != read_file(loadables2_out):
         fail('Loadables2 (ramdisk) not loaded', stdout)
 
+    # The same images, streamed from the filesystem
+    set_test('Streaming load')
+    for fname in [kernel_out, fdt_out, ramdisk_out]:
+        os.remove(fname)
+    cmd = stream_script % params
+    stdout = command.Output(u_boot, '-d', control_dtb, '-c', cmd)
+    debug_stdout(stdout)
+    if read_file(kernel) != read_file(kernel_out):
+        fail('Kernel not loaded', stdout)
+    if read_file(control_dtb) != read_file(fdt_out):
+        fail('FDT not loaded', stdout)
+    if read_file(ramdisk) != read_file(ramdisk_out):
+        fail('Ramdisk not loaded', stdout)
+
 def run_tests():
     """Parse options, run the FIT tests and print the result"""
     global base_path, base_dir
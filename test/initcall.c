@@ -0,0 +1,197 @@
+/*
+ * Tests for init steps which are deferred (CONFIG_INITCALL_DEFER)
+ *
+ * Copyright (c) 2015 The Chromium OS Authors.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <initcall.h>
+
+#define TEST_ID_A		BOOTSTAGE_ID_USER
+#define TEST_ID_B		(BOOTSTAGE_ID_USER + 1)
+#define TEST_ID_C		(BOOTSTAGE_ID_USER + 2)
+
+/* Number of times each function has been called */
+static int start_count, poll_count, finish_a_count, finish_b_count;
+static int finish_c_count;
+
+/* What to return from start() and how many polls it takes to be done */
+static int start_ret, polls_needed;
+
+/* Order in which the steps were finished */
+static char finish_order[4];
+static int finish_pos;
+
+static int test_start(void)
+{
+	start_count++;
+
+	return start_ret;
+}
+
+static int test_poll(void)
+{
+	return ++poll_count < polls_needed ? -EINPROGRESS : 0;
+}
+
+static void test_finished(char name)
+{
+	if (finish_pos < sizeof(finish_order) - 1)
+		finish_order[finish_pos++] = name;
+}
+
+static int test_finish_a(void)
+{
+	finish_a_count++;
+	test_finished('a');
+
+	return 0;
+}
+
+/* Like netconsole, which asks for the network while it is being set up */
+static int test_finish_b(void)
+{
+	finish_b_count++;
+	test_finished('b');
+	initcall_defer_finish(TEST_ID_B);
+
+	return 0;
+}
+
+static int test_finish_c(void)
+{
+	finish_c_count++;
+	test_finished('c');
+
+	return 0;
+}
+
+static struct initcall_defer step_a = {
+	.name = "test_a",
+	.id = TEST_ID_A,
+	.start = test_start,
+	.poll = test_poll,
+	.finish = test_finish_a,
+};
+
+static struct initcall_defer step_b = {
+	.name = "test_b",
+	.id = TEST_ID_B,
+	.finish = test_finish_b,
+};
+
+static struct initcall_defer step_c = {
+	.name = "test_c",
+	.id = TEST_ID_C,
+	.finish = test_finish_c,
+};
+
+static void reset_counts(void)
+{
+	start_count = 0;
+	poll_count = 0;
+	finish_a_count = 0;
+	finish_b_count = 0;
+	finish_c_count = 0;
+	memset(finish_order, '\0', sizeof(finish_order));
+	finish_pos = 0;
+}
+
+static int report(const char *name, int ret)
+{
+	printf(" %s: %s\n", name, ret ? "FAILED" : "ok");
+
+	return ret;
+}
+
+/* A step which is done, or fails, as it starts is never finished */
+static int test_done_at_start(void)
+{
+	int ret = 0;
+
+	reset_counts();
+	start_ret = 0;
+	if (initcall_defer_start(&step_a))
+		ret = -EINVAL;
+	start_ret = -EIO;
+	if (initcall_defer_start(&step_a))
+		ret = -EINVAL;
+	initcall_defer_poll();
+	initcall_defer_finish_all();
+	if (start_count != 2 || poll_count || finish_a_count)
+		ret = -EINVAL;
+
+	return ret;
+}
+
+/* A step which is done after some polls is not finished either */
+static int test_polled(void)
+{
+	int i;
+
+	reset_counts();
+	start_ret = -EINPROGRESS;
+	polls_needed = 3;
+	initcall_defer_start(&step_a);
+	for (i = 0; i < 5; i++)
+		initcall_defer_poll();
+	initcall_defer_finish_all();
+	if (start_count != 1 || poll_count != 3 || finish_a_count)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* One step can be finished on its own, and only once */
+static int test_finish_one(void)
+{
+	reset_counts();
+	start_ret = -EINPROGRESS;
+	polls_needed = 100;
+	initcall_defer_start(&step_a);
+	initcall_defer_start(&step_b);
+	initcall_defer_start(&step_c);
+
+	initcall_defer_finish(TEST_ID_B);
+	if (finish_a_count || finish_b_count != 1 || finish_c_count)
+		return -EINVAL;
+	initcall_defer_finish(TEST_ID_B);
+	initcall_defer_poll();
+	initcall_defer_finish_all();
+	if (finish_a_count != 1 || finish_b_count != 1 || finish_c_count != 1)
+		return -EINVAL;
+
+	/* The rest are finished in the order they were started */
+	if (strcmp(finish_order, "bac"))
+		return -EINVAL;
+
+	/* Nothing is left to do */
+	initcall_defer_finish(TEST_ID_C);
+	initcall_defer_finish_all();
+	if (finish_pos != 3)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int do_ut_initcall(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char *const argv[])
+{
+	int err = 0;
+
+	err |= report("done at start", test_done_at_start());
+	err |= report("polled", test_polled());
+	err |= report("finish one", test_finish_one());
+	printf("ut_initcall %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err ? CMD_RET_FAILURE : 0;
+}
+
+U_BOOT_CMD(
+	ut_initcall,	1,	1,	do_ut_initcall,
+	"Check deferred init steps", ""
+);
@@ -0,0 +1,44 @@
+# Copyright (c) 2015 Google, Inc
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+
+# Test the 'loadw' streaming download with sandbox, using tools/sersend
+
+BASE="$(dirname $0)/.."
+. $BASE/common.sh
+
+# Somewhere in sandbox's RAM, well clear of address 0
+LOAD_ADDR=1000000
+
+# run_loadw <file> <sersend options>
+# Download a file to sandbox, save it back to the host and compare the two
+run_loadw() {
+	file=$1
+	shift
+	cmd="loadw ${LOAD_ADDR}; save hostfs - ${LOAD_ADDR} ${tmp}.out \${filesize}"
+	rm -f ${tmp}.out
+	./${OUTPUT_DIR}/tools/sersend "$@" \
+		-x "./${OUTPUT_DIR}/u-boot -c '${cmd}'" ${file} >${tmp}.log 2>&1 ||
+		fail "sersend $@: $(tail -1 ${tmp}.log)"
+	cmp -s ${file} ${tmp}.out || fail "sersend $@: data differs"
+	grep "bytes/s" ${tmp}.log
+}
+
+echo "Streaming download test using sandbox"
+echo
+tmp="$(mktemp)"
+build_uboot
+
+# All byte values, and a last frame which is not full
+dd if=/dev/urandom of=${tmp}.bin bs=1000 count=1001 2>/dev/null
+run_loadw ${tmp}.bin
+run_loadw ${tmp}.bin -f 4096 -w 64
+run_loadw ${tmp}.bin -f 100 -w 16
+
+# A file which fits in one frame
+head -c 10 ${tmp}.bin >${tmp}.small
+run_loadw ${tmp}.small
+
+rm -f ${tmp} ${tmp}.bin ${tmp}.small ${tmp}.out ${tmp}.log
+echo "Test passed"
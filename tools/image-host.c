@@ -73,7 +73,7 @@ static int fit_image_process_hash(void *fit, const char *image_name,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (fit_image_hash_calc(fit, noffset, data, size, value, &value_len)) {
 		printf("Unsupported hash algorithm (%s) for '%s' hash node in '%s' image node\n",
 		       algo, node_name, image_name);
 		return -1;
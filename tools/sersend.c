@@ -0,0 +1,424 @@
+/*
+ * Send a file to U-Boot's 'loadw' command over a serial line
+ *
+ * Copyright (c) 2015 Google, Inc
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ *
+ * The protocol is described in common/cmd_load.c. Frames are sent without
+ * waiting for each to be acknowledged, keeping up to a window of them in
+ * flight. Anything else that U-Boot prints is copied to stdout.
+ *
+ * With -x the command is run with its stdin and stdout connected to us,
+ * which allows sandbox to be tested without a serial line, e.g.:
+ *
+ *   sersend -x "./u-boot -c 'loadw 100000; crc32 100000 \$filesize'" file
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "compiler.h"
+#include <u-boot/crc.h>
+
+/* These must match common/cmd_load.c */
+#define LOADW_STX		0x02
+#define LOADW_ACK		0x06
+#define LOADW_NAK		0x15
+#define LOADW_FLAG_LAST		(1 << 0)
+#define LOADW_HDR_SIZE		8
+#define LOADW_MAX_DATA		4096
+#define LOADW_ACK_EVERY		8
+
+#define ARRAY_SIZE(x)		(sizeof(x) / sizeof((x)[0]))
+
+#define SERSEND_TIMEOUT_MS	1000	/* resend if no reply in this time */
+#define SERSEND_RETRIES		10
+#define SERSEND_READY_SECS	60	/* time to wait for U-Boot to start */
+
+struct sersend {
+	int rfd;		/* to read replies from */
+	int wfd;		/* to write frames to */
+	const uint8_t *data;
+	size_t size;
+	int frame_size;
+	uint32_t frames;	/* total number of frames */
+	uint32_t base;		/* first frame not yet acknowledged */
+	uint32_t next;		/* next frame to send */
+	int reply_type;		/* reply being received, or 0 */
+	int reply_len;		/* number of hex digits received */
+	char reply[9];
+	int replies;		/* number of replies seen */
+};
+
+static const struct {
+	int baud;
+	speed_t speed;
+} baud_table[] = {
+	{ 9600, B9600 },
+	{ 19200, B19200 },
+	{ 38400, B38400 },
+	{ 57600, B57600 },
+	{ 115200, B115200 },
+	{ 230400, B230400 },
+#ifdef B460800
+	{ 460800, B460800 },
+#endif
+#ifdef B921600
+	{ 921600, B921600 },
+#endif
+#ifdef B1500000
+	{ 1500000, B1500000 },
+#endif
+#ifdef B3000000
+	{ 3000000, B3000000 },
+#endif
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-b baud] [-f frame_size] [-w window] -t tty file\n"
+		"       %s [-f frame_size] [-w window] -x command file\n"
+		"\n"
+		"  -b baud       baud rate for tty (default 115200)\n"
+		"  -f size       data bytes per frame (default 1024, max %d)\n"
+		"  -w window     frames to send before waiting (default 32)\n"
+		"  -t tty        serial device to use\n"
+		"  -x command    run command and talk to its stdin/stdout\n",
+		prog, prog, LOADW_MAX_DATA);
+	exit(EXIT_FAILURE);
+}
+
+static int open_tty(const char *path, int baud)
+{
+	struct termios tio;
+	unsigned int i;
+	int fd;
+
+	for (i = 0; i < ARRAY_SIZE(baud_table); i++) {
+		if (baud_table[i].baud == baud)
+			break;
+	}
+	if (i == ARRAY_SIZE(baud_table)) {
+		fprintf(stderr, "Unsupported baud rate %d\n", baud);
+		return -1;
+	}
+
+	fd = open(path, O_RDWR | O_NOCTTY);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	memset(&tio, '\0', sizeof(tio));
+	tio.c_cflag = CREAD | CLOCAL | CS8;
+	tio.c_cc[VMIN] = 1;
+	cfsetospeed(&tio, baud_table[i].speed);
+	cfsetispeed(&tio, baud_table[i].speed);
+	if (tcsetattr(fd, TCSANOW, &tio)) {
+		perror("tcsetattr");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Run a command with pipes to its stdin and stdout */
+static pid_t run_command(const char *cmd, int *rfd, int *wfd)
+{
+	int to_child[2], from_child[2];
+	pid_t pid;
+
+	if (pipe(to_child) || pipe(from_child)) {
+		perror("pipe");
+		return -1;
+	}
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+	if (!pid) {
+		dup2(to_child[0], 0);
+		dup2(from_child[1], 1);
+		close(to_child[0]);
+		close(to_child[1]);
+		close(from_child[0]);
+		close(from_child[1]);
+		execl("/bin/sh", "sh", "-c", cmd, NULL);
+		perror("/bin/sh");
+		exit(EXIT_FAILURE);
+	}
+	close(to_child[0]);
+	close(from_child[1]);
+	*wfd = to_child[1];
+	*rfd = from_child[0];
+
+	return pid;
+}
+
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+	ssize_t done;
+
+	while (len) {
+		done = write(fd, buf, len);
+		if (done < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("write");
+			return -1;
+		}
+		buf += done;
+		len -= done;
+	}
+
+	return 0;
+}
+
+static void put_le16(uint8_t *p, uint16_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t val)
+{
+	put_le16(p, val);
+	put_le16(p + 2, val >> 16);
+}
+
+static int send_frame(struct sersend *ss, uint32_t seq)
+{
+	uint8_t frame[1 + LOADW_HDR_SIZE + LOADW_MAX_DATA + 4];
+	size_t offset = (size_t)seq * ss->frame_size;
+	size_t len = ss->size - offset;
+	uint32_t crc;
+
+	if (len > (size_t)ss->frame_size)
+		len = ss->frame_size;
+	frame[0] = LOADW_STX;
+	frame[1] = seq == ss->frames - 1 ? LOADW_FLAG_LAST : 0;
+	frame[2] = 0;
+	put_le16(frame + 3, len);
+	put_le32(frame + 5, seq);
+	memcpy(frame + 1 + LOADW_HDR_SIZE, ss->data + offset, len);
+	crc = crc32(0, frame + 1, LOADW_HDR_SIZE + len);
+	put_le32(frame + 1 + LOADW_HDR_SIZE + len, crc);
+
+	return write_all(ss->wfd, frame, 1 + LOADW_HDR_SIZE + len + 4);
+}
+
+/* Act on a reply from U-Boot */
+static void handle_reply(struct sersend *ss, int type, uint32_t seq)
+{
+	ss->replies++;
+	if (seq > ss->frames)
+		return;
+	if (type == LOADW_ACK) {
+		if (seq > ss->base)
+			ss->base = seq;
+		if (ss->next < ss->base)
+			ss->next = ss->base;
+	} else if (seq < ss->next) {
+		/* Go back and send again from the frame that was lost */
+		if (seq > ss->base)
+			ss->base = seq;
+		ss->next = ss->base;
+	}
+}
+
+/*
+ * Read what U-Boot has sent, acting on replies and copying anything else
+ * to stdout
+ *
+ * @return 1 if anything was read, 0 on timeout, -1 on end of file or error
+ */
+static int read_replies(struct sersend *ss, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = ss->rfd, .events = POLLIN };
+	uint8_t buf[256];
+	ssize_t len;
+	int i, ret;
+
+	ret = poll(&pfd, 1, timeout_ms);
+	if (ret <= 0)
+		return ret < 0 && errno != EINTR ? -1 : 0;
+	len = read(ss->rfd, buf, sizeof(buf));
+	if (len <= 0)
+		return -1;
+
+	for (i = 0; i < len; i++) {
+		if (buf[i] == LOADW_ACK || buf[i] == LOADW_NAK) {
+			ss->reply_type = buf[i];
+			ss->reply_len = 0;
+		} else if (ss->reply_type) {
+			ss->reply[ss->reply_len++] = buf[i];
+			if (ss->reply_len == 8) {
+				ss->reply[8] = '\0';
+				handle_reply(ss, ss->reply_type,
+					     strtoul(ss->reply, NULL, 16));
+				ss->reply_type = 0;
+			}
+		} else {
+			putchar(buf[i]);
+		}
+	}
+	fflush(stdout);
+
+	return 1;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int send_file(struct sersend *ss, int window)
+{
+	int ret, retries = 0, wait = 0;
+	uint32_t base;
+	double start;
+
+	/* U-Boot asks for frame 0 once a second until we start */
+	while (!ss->replies) {
+		ret = read_replies(ss, 1000);
+		if (ret < 0)
+			return -1;
+		if (!ret && ++wait > SERSEND_READY_SECS) {
+			fprintf(stderr, "sersend: U-Boot is not ready\n");
+			return -1;
+		}
+	}
+	ss->base = 0;
+	ss->next = 0;
+
+	start = now();
+	while (ss->base < ss->frames) {
+		while (ss->next < ss->frames && ss->next - ss->base < window) {
+			if (send_frame(ss, ss->next++))
+				return -1;
+			/* Pick up any replies without waiting */
+			if (read_replies(ss, 0) < 0)
+				return -1;
+		}
+
+		base = ss->base;
+		ret = read_replies(ss, SERSEND_TIMEOUT_MS);
+		if (ret < 0)
+			return -1;
+		if (ss->base != base) {
+			retries = 0;
+		} else if (!ret) {
+			if (++retries > SERSEND_RETRIES) {
+				fprintf(stderr, "sersend: no reply\n");
+				return -1;
+			}
+			ss->next = ss->base;
+		}
+	}
+	fprintf(stderr, "sersend: %zu bytes in %.2f seconds, %.0f bytes/s\n",
+		ss->size, now() - start, ss->size / (now() - start));
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *tty = NULL, *cmd = NULL;
+	int baud = 115200, window = 32;
+	struct sersend ss;
+	struct stat st;
+	uint8_t *data;
+	pid_t pid = 0;
+	int fd, opt, ret, status;
+
+	memset(&ss, '\0', sizeof(ss));
+	ss.frame_size = 1024;
+	while ((opt = getopt(argc, argv, "b:f:t:w:x:")) != -1) {
+		switch (opt) {
+		case 'b':
+			baud = atoi(optarg);
+			break;
+		case 'f':
+			ss.frame_size = atoi(optarg);
+			break;
+		case 't':
+			tty = optarg;
+			break;
+		case 'w':
+			window = atoi(optarg);
+			break;
+		case 'x':
+			cmd = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !tty == !cmd)
+		usage(argv[0]);
+	if (ss.frame_size < 1 || ss.frame_size > LOADW_MAX_DATA) {
+		fprintf(stderr, "Frame size must be 1 to %d\n", LOADW_MAX_DATA);
+		return EXIT_FAILURE;
+	}
+	/* U-Boot only acknowledges every few frames */
+	if (window < LOADW_ACK_EVERY)
+		window = LOADW_ACK_EVERY;
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(argv[optind]);
+		return EXIT_FAILURE;
+	}
+	data = malloc(st.st_size + 1);
+	if (!data || read(fd, data, st.st_size) != st.st_size) {
+		fprintf(stderr, "Cannot read %s\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	ss.data = data;
+	ss.size = st.st_size;
+	ss.frames = ss.size ? (ss.size + ss.frame_size - 1) / ss.frame_size : 1;
+
+	if (tty) {
+		ss.rfd = open_tty(tty, baud);
+		ss.wfd = ss.rfd;
+		if (ss.rfd < 0)
+			return EXIT_FAILURE;
+	} else {
+		signal(SIGPIPE, SIG_IGN);
+		pid = run_command(cmd, &ss.rfd, &ss.wfd);
+		if (pid < 0)
+			return EXIT_FAILURE;
+	}
+
+	ret = send_file(&ss, window);
+	if (!pid)
+		return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	/* Show the rest of what the command prints, and wait for it */
+	close(ss.wfd);
+	while (read_replies(&ss, -1) >= 0)
+		;
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+		return EXIT_FAILURE;
+
+	return ret ? EXIT_FAILURE : WEXITSTATUS(status);
+}